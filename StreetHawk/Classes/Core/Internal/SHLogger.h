@@ -84,6 +84,11 @@
  */
 + (BOOL)checkSentApnsModeForFreshInstall;
 
+/**
+ Number of loglines accepted in this launch, not including those disabled by App Status. Used to measure how many logs a feature produces.
+ */
+@property (nonatomic, readonly) NSUInteger logCount;
+
 @end
 
 #import "SHApp.h"
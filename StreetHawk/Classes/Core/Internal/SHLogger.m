@@ -17,9 +17,13 @@
 
 #import "SHLogger.h"
 //header from StreetHawk
-#import "SHAppStatus.h" //for `uploadLocationChange`
+#import "SHAppStatus.h" //for `uploadLocationChange` and log codes
 #import "SHApp.h" //for register install
 #import "SHUtils.h" //for streetHawkIsEnabled
+#import "SHNetworkQuality.h" //for upload batch size
+#import "SHRequestScheduler.h" //for background class upload
+#import "SHStateStore.h" //for logid and session history
+#import "SHPageTracker.h" //for clear page history
 
 #define tableName @"table_log" //not change table name, if need upgrade db schema, change to another file.
 #define LOG_UPLOAD_INTERVAL 50  //local has this number then upload
@@ -55,6 +59,7 @@ enum
 @property (nonatomic) dispatch_semaphore_t upload_semaphore;  //a semaphore to control selecting and uploading, make sure it happen in sequence, so that avoid selecting duplicated records which the previous uploading is not finished and database not deleted.
 @property (nonatomic) int numLogsWritten;  //current local record number
 @property (nonatomic) NSInteger fgbgSession;  //When App start or go to FG, session+1; when App go to BG session ends.
+@property (nonatomic) NSUInteger logCount; //accessed under lock of self.
 
 //Log the information into local sqlite database. Normal events are uploaded after enough number. Special events are logged and uploaded immediately. This function has the flexibility, however for convenience [StreetHawk sendLogForCode:withComment:] is recommended.
 - (void)logComment:(NSString *)comment atTime:(NSDate *)created forCode:(NSInteger)code forAssocId:(NSString *)assocId withResult:(NSInteger)result withHandler:(SHCallbackHandler)handler;
@@ -97,7 +102,7 @@ enum
 {
     if (self = [super init])
     {
-        NSObject *sessionValue = [[NSUserDefaults standardUserDefaults] objectForKey:FGBG_SESSION]; //read history session id
+        NSObject *sessionValue = [[SHStateStore sharedInstance] objectForKey:FGBG_SESSION]; //read history session id
         if (sessionValue != nil && [sessionValue isKindOfClass:[NSNumber class]])
         {
             self.fgbgSession = [(NSNumber *)sessionValue integerValue];
@@ -137,7 +142,7 @@ enum
     }
     
     //check app_status's ignore codes
-    NSArray *arrayIgnoreCodes = [[NSUserDefaults standardUserDefaults] objectForKey:@"APPSTATUS_DISABLECODES"];
+    NSArray *arrayIgnoreCodes = (NSArray *)[SHAppStatus sharedInstance].logDisableCodes;
     BOOL isIgnored = NO;
     for (id ignoreCode in arrayIgnoreCodes)
     {
@@ -159,28 +164,27 @@ enum
     if (code == LOG_CODE_APP_VISIBLE) //From BG to FG (either launch or resume from BG), is a new session.
     {
         self.fgbgSession++;
-        [[NSUserDefaults standardUserDefaults] setInteger:self.fgbgSession forKey:FGBG_SESSION];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHStateStore sharedInstance] setInteger:self.fgbgSession forKey:FGBG_SESSION];
     }
     if (code == LOG_CODE_APP_VISIBLE || code == LOG_CODE_APP_INVISIBLE)
     {
         //check previous must be reverse side: if now is "to visible" previous must be "to invisible" or none; if now is "to invisible" previous must be "to visible". Crash is an exception but this assert not happen in release so not affect customer.
         NSInteger previousVisible = 0;
-        NSObject *previousVisibleObj = [[NSUserDefaults standardUserDefaults] objectForKey:@"Previous_Visible_Status"];
+        NSObject *previousVisibleObj = [[SHStateStore sharedInstance] objectForKey:@"Previous_Visible_Status"];
         if (previousVisibleObj != nil && [previousVisibleObj isKindOfClass:[NSNumber class]])
         {
             previousVisible = [(NSNumber *)previousVisibleObj integerValue];
         }
         if (code == LOG_CODE_APP_VISIBLE)
         {
-            [[NSUserDefaults standardUserDefaults] setObject:@([[NSDate date] timeIntervalSinceReferenceDate]) forKey:@"Previous_Visible_Time"];
+            [[SHStateStore sharedInstance] setObject:@([[NSDate date] timeIntervalSinceReferenceDate]) forKey:@"Previous_Visible_Time"];
             //NSAssert(previousVisible == 0 || previousVisible == LOG_CODE_SYSTEM_INVISIBLE, @"App to visible but previous is not none or invisible."); //Not do this as it cause crash when debugging.
         }
         if (code == LOG_CODE_APP_INVISIBLE)
         {
             //NSAssert(previousVisible == LOG_CODE_APP_VISIBLE, @"App to invisible but previous is not visible."); //Disable this assert, as router's first launch not have visible, so cause crash.
             NSDate *visibleTime = nil;
-            NSObject *visibleTimeObj = [[NSUserDefaults standardUserDefaults] objectForKey:@"Previous_Visible_Time"];
+            NSObject *visibleTimeObj = [[SHStateStore sharedInstance] objectForKey:@"Previous_Visible_Time"];
             if (visibleTimeObj != nil && [visibleTimeObj isKindOfClass:[NSNumber class]])
             {
                 double visibleTimeVal = [(NSNumber *)visibleTimeObj doubleValue];
@@ -197,11 +201,14 @@ enum
                 dictAppSession[@"invisible"] = shFormatISODate([NSDate date]);
                 dictAppSession[@"duration"] = @([[NSDate date] timeIntervalSinceDate:visibleTime]);
                 [StreetHawk sendLogForCode:LOG_CODE_APP_COMPLETE withComment:shSerializeObjToJson(dictAppSession)];
-                [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:@"Previous_Visible_Time"];
+                [[SHStateStore sharedInstance] setObject:@(0) forKey:@"Previous_Visible_Time"];
             }
         }
-        [[NSUserDefaults standardUserDefaults] setObject:@(code) forKey:@"Previous_Visible_Status"]; //all pass, record this time as previous.
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHStateStore sharedInstance] setObject:@(code) forKey:@"Previous_Visible_Status"]; //all pass, record this time as previous.
+    }
+    @synchronized(self)
+    {
+        self.logCount ++;
     }
     handler = [handler copy];
     dispatch_async(self.logger_queue, ^(void)
@@ -241,12 +248,11 @@ enum
             sqlite3_finalize(insert_sql);
             insert_sql = NULL;
             int logid = (int)sqlite3_last_insert_rowid(database);
-            [[NSUserDefaults standardUserDefaults] setObject:@(logid) forKey:MAX_LOGID];
-            [[NSUserDefaults standardUserDefaults] synchronize];
+            [[SHStateStore sharedInstance] setObject:@(logid) forKey:MAX_LOGID];
             SHLog(@"LOG (%d @ %@) <%d> %@", logid, shFormatISODate(created), code, comment);
         }
         BOOL isForce = NO;
-        NSArray *arrayPriorityCodes = [[NSUserDefaults standardUserDefaults] objectForKey:@"APPSTATUS_PRIORITYCODES"];
+        NSArray *arrayPriorityCodes = (NSArray *)[SHAppStatus sharedInstance].logPriorityCodes;
         if (arrayPriorityCodes == nil) //not set, same as before
         {
             isForce = (code == LOG_CODE_LOCATION_GEO || code == LOG_CODE_LOCATION_IBEACON || code == LOG_CODE_LOCATION_GEOFENCE || code == LOG_CODE_LOCATION_DENIED)  //immediately send for geo and ibeacon location, but not for code 19.
@@ -353,7 +359,7 @@ enum
         return NO; //This is actually really a fresh new install
     }
     //check local flag cache whether need re-register
-    NSObject *reregisterObj = [[NSUserDefaults standardUserDefaults] objectForKey:@"APPSTATUS_REREGISTER"];
+    NSObject *reregisterObj = [[SHStateStore sharedInstance] objectForKey:@"APPSTATUS_REREGISTER"];
     if (reregisterObj != nil && [reregisterObj isKindOfClass:[NSNumber class]])
     {
         if ([(NSNumber *)reregisterObj boolValue])
@@ -368,7 +374,7 @@ enum
     {
         int maxLogidUserDefaults = -1;
         int maxlogidDb = -1;
-        NSObject *maxLogidVal = [[NSUserDefaults standardUserDefaults] objectForKey:MAX_LOGID];
+        NSObject *maxLogidVal = [[SHStateStore sharedInstance] objectForKey:MAX_LOGID];
         if (maxLogidVal != nil && [maxLogidVal isKindOfClass:[NSNumber class]])
         {
             maxLogidUserDefaults = [(NSNumber *)maxLogidVal intValue];
@@ -412,7 +418,7 @@ enum
             {
                 if (maxLogidUserDefaults <= maxlogidDb) //use <= not ==, because maxLogidUserDefaults fail to permanently save when crash, causing it's less than maxlogidDb. Local SQLite logid larger than server is OK, it will not cause duplicate conflict. https://bitbucket.org/shawk/streethawk/issue/518/check-max-logid-in-sqlite-and. maxLogidUserDefaults will be recover when next log saved.
                 {
-                    needClear = NO; //local SQLite match last record in NSUserDefaults, expected, no need to refresh install.
+                    needClear = NO; //local SQLite match last record in state store, expected, no need to refresh install.
                 }
             }
         }
@@ -441,7 +447,7 @@ enum
     {
         return NO; //This is actually really a fresh new install
     }
-    SHAppMode sentMode = [[[NSUserDefaults standardUserDefaults] objectForKey:@"SentInstall_Mode"] intValue];
+    SHAppMode sentMode = [[[SHStateStore sharedInstance] objectForKey:@"SentInstall_Mode"] intValue];
     BOOL needClear = (sentMode != shAppMode());
     if (needClear)
     {
@@ -500,9 +506,10 @@ enum
 - (NSMutableArray *)loadLogRecords
 {
     NSMutableArray *logRecords = [NSMutableArray array];
-    NSString *select_sql_str = [NSString stringWithFormat:@"SELECT * from '%@' WHERE status = 0 ORDER BY logid LIMIT %d",
+    //smaller batch on slow link, so one request is less likely to timeout and be resent as a whole.
+    NSString *select_sql_str = [NSString stringWithFormat:@"SELECT * from '%@' WHERE status = 0 ORDER BY logid LIMIT %lu",
                                 tableName,
-                                LOG_UPLOAD_INTERVAL];
+                                (unsigned long)[[SHNetworkQuality sharedInstance] batchSizeForDefault:LOG_UPLOAD_INTERVAL]];
     @synchronized(self)
     {
         sqlite3_stmt *select_sql = NULL;
@@ -545,7 +552,7 @@ enum
             {
                 NSDictionary *dictLoc = shParseObjectToDict(shCstringToNSString(comment));
                 NSAssert(dictLoc != nil, @"Fail to parse code 19 and 20 lat/lng json.");
-                NSAssert(dictLoc.allKeys.count == 2 && [dictLoc.allKeys containsObject:@"lat"] && [dictLoc.allKeys containsObject:@"lng"], @"Wrong format for 19 and 20 json.");
+                NSAssert((dictLoc.allKeys.count == 2 || (dictLoc.allKeys.count == 3 && [dictLoc[@"points"] isKindOfClass:[NSArray class]])) && [dictLoc.allKeys containsObject:@"lat"] && [dictLoc.allKeys containsObject:@"lng"], @"Wrong format for 19 and 20 json.");
                 double lat = [dictLoc[@"lat"] doubleValue];
                 if (lat == 0)
                 {
@@ -559,6 +566,10 @@ enum
                 NSAssert(lat != 0 && lng != 0, @"Assert fail try to send 19 or 20 with location 0.");
                 logRecord[@"latitude"] = @(lat);
                 logRecord[@"longitude"] = @(lng);
+                if ([dictLoc[@"points"] isKindOfClass:[NSArray class]]) //batched trajectory, latitude/longitude above is latest location.
+                {
+                    logRecord[@"json"] = @{@"points": dictLoc[@"points"]};
+                }
             }
             //Code: 21. Beacon Update
             else if (code == LOG_CODE_LOCATION_IBEACON)
@@ -772,67 +783,69 @@ enum
             return;
         }
         handler = [handler copy];
-        [[SHHTTPSessionManager sharedInstance] POST:@"installs/log/" hostVersion:SHHostVersion_V2 body:@{@"records": postBody} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+        //log upload is bulk telemetry, give way to interactive requests such as feed load.
+        [[SHRequestScheduler sharedInstance] scheduleBackgroundRequest:^(dispatch_block_t finish)
         {
-            //record last successfully post logs time.
-            BOOL postHeartbeat = NO;
-            BOOL postLocation = NO;
-            for (NSDictionary *logRecord in logRecords)
+            [[SHHTTPSessionManager sharedInstance] POST:@"installs/log/" hostVersion:SHHostVersion_V2 body:@{@"records": postBody} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
             {
-                int code = [logRecord[@"code"] intValue];
-                if (code == LOG_CODE_HEARTBEAT)
+                //record last successfully post logs time.
+                BOOL postHeartbeat = NO;
+                BOOL postLocation = NO;
+                for (NSDictionary *logRecord in logRecords)
                 {
-                    postHeartbeat = YES;
+                    int code = [logRecord[@"code"] intValue];
+                    if (code == LOG_CODE_HEARTBEAT)
+                    {
+                        postHeartbeat = YES;
+                    }
+                    if (code == LOG_CODE_LOCATION_MORE || code == LOG_CODE_LOCATION_GEO)
+                    {
+                        postLocation = YES;
+                    }
+                    if (postHeartbeat && postLocation)
+                    {
+                        break;
+                    }
                 }
-                if (code == LOG_CODE_LOCATION_MORE || code == LOG_CODE_LOCATION_GEO)
+                if (postHeartbeat)
                 {
-                    postLocation = YES;
+                    [[SHStateStore sharedInstance] setObject:[NSNumber numberWithDouble:[[NSDate date] timeIntervalSinceReferenceDate]] forKey:REGULAR_HEARTBEAT_LOGTIME];
                 }
-                if (postHeartbeat && postLocation)
+                if (postLocation)
                 {
-                    break;
+                    [[SHStateStore sharedInstance] setObject:[NSNumber numberWithDouble:[[NSDate date] timeIntervalSinceReferenceDate]] forKey:REGULAR_LOCATION_LOGTIME];
                 }
-            }
-            if (postHeartbeat)
-            {
-                [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithDouble:[[NSDate date] timeIntervalSinceReferenceDate]] forKey:REGULAR_HEARTBEAT_LOGTIME];
-            }
-            if (postLocation)
-            {
-                [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithDouble:[[NSDate date] timeIntervalSinceReferenceDate]] forKey:REGULAR_LOCATION_LOGTIME];
-            }
-            if (postHeartbeat || postLocation)
-            {
-                [[NSUserDefaults standardUserDefaults] synchronize];
-            }
-            [self clearLogRecords:logRecords];
-            dispatch_semaphore_signal(self.upload_semaphore);
-            //finish
-            if (handler)
-                handler(nil, nil);
-        } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
-        {
-            //Since 2014-02-10, server save log in asynchronous way, so it does not return any error.
-            //Update on 2015-02-27: dev returns error message for debugging, api return immediately.
-            if (![error.domain isEqualToString:@"NSURLErrorDomain"] && StreetHawk.isDebugMode && shAppMode() != SHAppMode_AppStore && shAppMode() != SHAppMode_Enterprise)
-            {
-                //NSAssert(NO, @"Log meets error (%@) for records: %@.", logRequest.error, logRecords); //comment this as dev returns error and crash App, make it cannot continue.
-            }
-            NSInteger statusCode = 0;
-            if ([task.response isKindOfClass:[NSHTTPURLResponse class]])
-            {
-                NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)task.response;
-                statusCode = httpResponse.statusCode;
-            }
-            if (error.code == 404 || statusCode == 404)
+                [self clearLogRecords:logRecords];
+                dispatch_semaphore_signal(self.upload_semaphore);
+                finish();
+                //finish
+                if (handler)
+                    handler(nil, nil);
+            } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
             {
-                StreetHawk.currentInstall = nil;
-                [StreetHawk registerOrUpdateInstallWithHandler:nil];
-            }
-            dispatch_semaphore_signal(self.upload_semaphore);
-            //finish
-            if (handler)
-                handler(nil, error);
+                //Since 2014-02-10, server save log in asynchronous way, so it does not return any error.
+                //Update on 2015-02-27: dev returns error message for debugging, api return immediately.
+                if (![error.domain isEqualToString:@"NSURLErrorDomain"] && StreetHawk.isDebugMode && shAppMode() != SHAppMode_AppStore && shAppMode() != SHAppMode_Enterprise)
+                {
+                    //NSAssert(NO, @"Log meets error (%@) for records: %@.", logRequest.error, logRecords); //comment this as dev returns error and crash App, make it cannot continue.
+                }
+                NSInteger statusCode = 0;
+                if ([task.response isKindOfClass:[NSHTTPURLResponse class]])
+                {
+                    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)task.response;
+                    statusCode = httpResponse.statusCode;
+                }
+                if (error.code == 404 || statusCode == 404)
+                {
+                    StreetHawk.currentInstall = nil;
+                    [StreetHawk registerOrUpdateInstallWithHandler:nil];
+                }
+                dispatch_semaphore_signal(self.upload_semaphore);
+                finish();
+                //finish
+                if (handler)
+                    handler(nil, error);
+            }];
         }];
     }    
 }
@@ -871,21 +884,21 @@ enum
 + (void)clearLocalToMakeFreshInstall
 {
     [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"INSTALL_SUID_KEY"]; //clear local install id, next will register a new one. This is most important, otherwise logs cannot submit due to conflict logid.
-    [[NSUserDefaults standardUserDefaults] setObject:@(NO) forKey:@"APPSTATUS_REREGISTER"];  //clear reregister flag
-    [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:@"NumTimesAppUsed"]; //report "App first run" instead of "App started and engine initialized".
-    [[NSUserDefaults standardUserDefaults] setObject:@(NO) forKey:@"RouteChecked"]; //re-flag route check for new install
-    [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:@"TAG_SHLANGUAGE"]; //re-tag sh_language for new install
-    [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:MAX_LOGID]; //local SQLite will be delete and rebuild, sent record reset to 0.
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"SETTING_UTC_OFFSET"]; //make new install submit utc offset for first time.
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"ENTER_PAGE_HISTORY"];  //new install not have enter/exit history
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"ENTERBAK_PAGE_HISTORY"];
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"EXIT_PAGE_HISTORY"];
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"APPSTATUS_IBEACON_FETCH_TIME"]; //although App may still monitor these iBeacon regions, fetch them again for new intall.
-    [[NSUserDefaults standardUserDefaults] setObject:[NSArray array] forKey:@"APPSTATUS_IBEACON_FETCH_LIST"]; //server side iBeacon UUID format changed in 1.6.0, must clear and re-register.
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"APPSTATUS_GEOFENCE_FETCH_TIME"]; //although App may still monitor these geofence regions, fetch them again for new install.
-    [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:@"LOCATION_DENIED_SENT"]; //new install should send location denied log once.
-    [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:FGBG_SESSION]; //new install session start from 1.
+    [[SHStateStore sharedInstance] setObject:@(NO) forKey:@"APPSTATUS_REREGISTER"];  //clear reregister flag
+    [[SHStateStore sharedInstance] setObject:@(0) forKey:@"NumTimesAppUsed"]; //report "App first run" instead of "App started and engine initialized".
+    [[SHStateStore sharedInstance] setObject:@(NO) forKey:@"RouteChecked"]; //re-flag route check for new install
+    [[SHStateStore sharedInstance] setObject:@(0) forKey:@"TAG_SHLANGUAGE"]; //re-tag sh_language for new install
+    [[SHStateStore sharedInstance] setObject:@(0) forKey:MAX_LOGID]; //local SQLite will be delete and rebuild, sent record reset to 0.
+    [[SHStateStore sharedInstance] setObject:@"" forKey:@"SETTING_UTC_OFFSET"]; //make new install submit utc offset for first time.
+    [[SHPageTracker sharedInstance] reset];  //new install not have enter/exit history
+    [[SHStateStore sharedInstance] setObject:@"" forKey:@"APPSTATUS_IBEACON_FETCH_TIME"]; //although App may still monitor these iBeacon regions, fetch them again for new intall.
+    [[SHStateStore sharedInstance] setObject:[NSData data] forKey:@"APPSTATUS_IBEACON_FETCH_LIST"]; //server side iBeacon UUID format changed in 1.6.0, must clear and re-register.
+    [[SHStateStore sharedInstance] setObject:[NSDictionary dictionary] forKey:@"APPSTATUS_IBEACON_DISTANCE"]; //distance of fetch list cleared above.
+    [[SHStateStore sharedInstance] setObject:@"" forKey:@"APPSTATUS_GEOFENCE_FETCH_TIME"]; //although App may still monitor these geofence regions, fetch them again for new install.
+    [[SHStateStore sharedInstance] setObject:@"" forKey:@"LOCATION_DENIED_SENT"]; //new install should send location denied log once.
+    [[SHStateStore sharedInstance] setObject:@(0) forKey:FGBG_SESSION]; //new install session start from 1.
     [[NSUserDefaults standardUserDefaults] synchronize];
+    [[SHStateStore sharedInstance] synchronize]; //local SQLite is deleted next, reset must be on disk before that.
     //These not need to update
     //Remote notification: APNS_DISABLE_TIMESTAMP, APNS_SENT_DISABLE_TIMESTAMP, APNS_DEVICE_TOKEN. Because old data is correct when register new install, and old data is passed in install/register to server. Note: if revoked=timestamp, this will make revoked earlier than created, it's correct as revoked means first time when notification is disabled.
     //Sent history: SentInstall_AppKey, SentInstall_ClientVersion, SentInstall_ShVersion, SentInstall_Mode, SentInstall_Carrier, SentInstall_OSVersion, SentInstall_IBeacon. They are reset after install/register.
@@ -23,6 +23,68 @@
  */
 extern NSString * const SHAppStatusChangeNotification;
 
+/**
+ Url of route check which decides alive host, used when no stand-in host override.
+ */
+extern NSString * const SHAppStatusRouteUrl;
+
+/**
+ Values of app status at one moment. It's immutable after published by `SHAppStatus`, so reading it needs no lock, and fields read from one snapshot are consistent with each other.
+ */
+@interface SHAppStatusSnapshot : NSObject <NSCopying>
+
+/**
+ Match to `app_status` dictionary's `streethawk`.
+ */
+@property (nonatomic, readonly) BOOL streethawkEnabled;
+
+/**
+ Alive host root url without version and last "/", for example @"https://api.streethawk.com". nil if route not checked yet.
+ */
+@property (nonatomic, strong, readonly) NSString *aliveHost;
+
+/**
+ Match to `app_status` dictionary's `growth_host`.
+ */
+@property (nonatomic, strong, readonly) NSString *growthHost;
+
+/**
+ Match to `app_status` dictionary's `location_updates`.
+ */
+@property (nonatomic, readonly) BOOL uploadLocationChange;
+
+/**
+ Match to `app_status` dictionary's `submit_views`.
+ */
+@property (nonatomic, readonly) BOOL allowSubmitFriendlyNames;
+
+/**
+ Match to `app_status` dictionary's `submit_interactive_button`.
+ */
+@property (nonatomic, readonly) BOOL allowSubmitInteractiveButton;
+
+/**
+ Match to `app_status` dictionary's `app_store_id`.
+ */
+@property (nonatomic, strong, readonly) NSString *appstoreId;
+
+/**
+ Match to `app_status` dictionary's `disable_logs`. nil if not set.
+ */
+@property (nonatomic, strong, readonly) NSArray *logDisableCodes;
+
+/**
+ Match to `app_status` dictionary's `priority`. nil if not set.
+ */
+@property (nonatomic, strong, readonly) NSArray *logPriorityCodes;
+
+/**
+ Time interval since reference date of last successful app status check, 0 if never.
+ */
+@property (nonatomic, readonly) NSTimeInterval checkTime;
+
+@end
+
 /**
  StreetHawk server can control each install's status by request return `app_status` section. This object is the central management of app status. It has property for server controls, and send notification if anything changes.
  */
@@ -37,6 +99,11 @@ extern NSString * const SHAppStatusChangeNotification;
 
 /** @name Properties */
 
+/**
+ Current values as a whole. Getters below read from it; a response's `app_status` section is applied into a new snapshot which replaces this one at once, and written to `SHStateStore` which persists it behind.
+ */
+@property (atomic, strong, readonly) SHAppStatusSnapshot *snapshot;
+
 /**
  Match to `app_status` dictionary's `streethawk`. If set to NO, all visible functions of SDK are disabled, only leave minimum subset functions which for recover to enable.
  */
@@ -98,17 +165,30 @@ extern NSString * const SHAppStatusChangeNotification;
 @property (nonatomic, strong) NSString *appstoreId;
 
 /**
- Match to `app_status` dictionary's `disable_logs`. It's for setting up disabled logline code. It would be nil means clear, or array of code list.
+ Match to `app_status` dictionary's `disable_logs`. It's for setting up disabled logline code. It would be nil means clear, or array of code list. Get returns the array or nil.
  */
 @property (nonatomic, strong) NSObject *logDisableCodes;
 
 /**
- Match to `app_status` dictionary's `priority`. It's for setting up priority logline code. It would be nil means clear, or array of code list.
+ Match to `app_status` dictionary's `priority`. It's for setting up priority logline code. It would be nil means clear, or array of code list. Get returns the array or nil.
  */
 @property (nonatomic, strong) NSObject *logPriorityCodes;
 
 /** @name Functions */
 
+/**
+ Compare a response's `app_status` section with values seen before, and remember the new values. Values seen are forgotten every few minutes, so a whole section is applied again and downstream can retry a failed fetch or submission.
+ @param dictStatus The `app_status` dictionary, may contain only some keys.
+ @return Keys whose value is new or different, with their values; nil if nothing changed.
+ */
+- (NSDictionary *)changedKeysOfAppStatus:(NSDictionary *)dictStatus;
+
+/**
+ Apply a response's `app_status` section. Keys kept in snapshot are compared and applied into one new snapshot, and `SHAppStatusChangeNotification` is sent once if anything changed; timestamps and "reregister" are forwarded to modules. Must not call in main thread.
+ @param dictStatus The `app_status` dictionary, may contain only some keys.
+ */
+- (void)applyAppStatus:(NSDictionary *)dictStatus;
+
 /**
  App status could change for some reason, so the App needs to check current one in some situation, (start to run, from background to foreground, handle push message 8003), these are handled by StreetHawk automatically. This call is a utility function to do the check. Although all request may contain "app_status", this send "/apps/status" request.
  @param force If NO do not check for a. `streethawkEnabled`=YES as request send often; b. previous check in a day. If YES do check whatever.
@@ -126,4 +206,9 @@ extern NSString * const SHAppStatusChangeNotification;
  */
 - (void)checkRouteWithCompleteHandler:(void(^)(BOOL isEnabled, NSString *hostUrl))handler;
 
+/**
+ Called when App becomes active. Check route again if the last route result is older than a day or alive host is unhealthy, and preconnect to the host requests will go to. If alive host keeps failing `aliveHostForVersion:` fails over to default host until it recovers.
+ */
+- (void)refreshRouteAndPreconnect;
+
 @end
@@ -21,6 +21,8 @@
 #import "SHApp.h" //for `StreetHawk.currentInstall`
 #import "SHLogger.h" //for sending logline
 #import "SHDeepLinking.h" //for handle pointzi deeplinking
+#import "SHHostHealth.h" //for host failover and preconnect
+#import "SHStateStore.h" //for persist app status
 
 #define APPSTATUS_STREETHAWKENABLED         @"APPSTATUS_STREETHAWKENABLED" //whether enable library functions
 #define APPSTATUS_ALIVE_HOST                @"APPSTATUS_ALIVE_HOST" //currently used alive host url
@@ -34,23 +36,64 @@
 #define APPSTATUS_PRIORITYCODES             @"APPSTATUS_PRIORITYCODES" //priority logline codes
 
 #define APPSTATUS_CHECK_TIME                @"APPSTATUS_CHECK_TIME"  //the last successfully check app status time, record to avoid frequently call server.
+#define APPSTATUS_ROUTE_CHECK_TIME          @"APPSTATUS_ROUTE_CHECK_TIME" //the last successfully check route time, route is refreshed when it's older than TTL.
+
+#define APPSTATUS_DEFAULT_HOST              @"https://api.streethawk.com" //fail over to this host when alive host keeps failing.
+#define APPSTATUS_ROUTE_TTL                 (60*60*24) //seconds a route check result is trusted.
+#define APPSTATUS_ROUTE_RETRY_INTERVAL      (5*60) //not check route again within this time even if host is unhealthy.
+#define APPSTATUS_DIFF_EXPIRE               (5*60) //seconds after which a whole app_status section is applied again, so downstream retries a failed fetch or submission.
 
 NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification";
+NSString * const SHAppStatusRouteUrl = @"https://route.streethawk.com/v1/apps/status";
+
+@interface SHAppStatusSnapshot ()
+
+@property (nonatomic, readwrite) BOOL streethawkEnabled;
+@property (nonatomic, strong, readwrite) NSString *aliveHost;
+@property (nonatomic, strong, readwrite) NSString *growthHost;
+@property (nonatomic, readwrite) BOOL uploadLocationChange;
+@property (nonatomic, readwrite) BOOL allowSubmitFriendlyNames;
+@property (nonatomic, readwrite) BOOL allowSubmitInteractiveButton;
+@property (nonatomic, strong, readwrite) NSString *appstoreId;
+@property (nonatomic, strong, readwrite) NSArray *logDisableCodes;
+@property (nonatomic, strong, readwrite) NSArray *logPriorityCodes;
+@property (nonatomic, readwrite) NSTimeInterval checkTime;
+
+@end
+
+@implementation SHAppStatusSnapshot
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    SHAppStatusSnapshot *copy = [[SHAppStatusSnapshot allocWithZone:zone] init];
+    copy.streethawkEnabled = self.streethawkEnabled;
+    copy.aliveHost = self.aliveHost;
+    copy.growthHost = self.growthHost;
+    copy.uploadLocationChange = self.uploadLocationChange;
+    copy.allowSubmitFriendlyNames = self.allowSubmitFriendlyNames;
+    copy.allowSubmitInteractiveButton = self.allowSubmitInteractiveButton;
+    copy.appstoreId = self.appstoreId;
+    copy.logDisableCodes = self.logDisableCodes;
+    copy.logPriorityCodes = self.logPriorityCodes;
+    copy.checkTime = self.checkTime;
+    return copy;
+}
+
+@end
 
 @interface SHAppStatus ()
 
-@property (nonatomic, strong) NSString *aliveHostInner; //inner memory variable
+@property (atomic, strong, readwrite) SHAppStatusSnapshot *snapshot; //only replaced as a whole, never mutated after published.
+@property (nonatomic, strong) NSDate *lastRouteCheckAttempt; //avoid checking route often when host is unhealthy
 
-//make sure update happens in sequence for each property
-@property (nonatomic) dispatch_semaphore_t semaphore_streethawkEnabled;
-@property (nonatomic) dispatch_semaphore_t semaphore_aliveHost;
-@property (nonatomic) dispatch_semaphore_t semaphore_growthHost;
-@property (nonatomic) dispatch_semaphore_t semaphore_uploadLocationChange;
-@property (nonatomic) dispatch_semaphore_t semaphore_allowSubmitFriendlyNames;
-@property (nonatomic) dispatch_semaphore_t semaphore_allowSubmitInteractiveButtons;
-@property (nonatomic) dispatch_semaphore_t semaphore_appstoreId;
-@property (nonatomic) dispatch_semaphore_t semaphore_disableCodes;
-@property (nonatomic) dispatch_semaphore_t semaphore_priorityCodes;
+@property (nonatomic) dispatch_semaphore_t semaphore_update; //make sure updates happen in sequence, each copies the latest snapshot.
+@property (nonatomic, strong) NSMutableDictionary *dictSeenAppStatus; //merged app_status values seen since `seenAppStatusTime`, accessed under lock of self.
+@property (nonatomic, strong) NSDate *seenAppStatusTime;
+
++ (NSString *)trimHost:(NSString *)host; //remove last "/".
++ (SHAppStatusSnapshot *)loadSnapshot; //read persisted values, only at launch.
+- (void)publishSnapshot:(SHAppStatusSnapshot *)snapshot; //swap and persist.
+- (void)persistSnapshot:(SHAppStatusSnapshot *)snapshot; //write to state store, which writes file behind.
 
 @end
 
@@ -68,7 +111,7 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
         initialDefaults[APPSTATUS_SUBMIT_FRIENDLYNAME] = @(NO); //by default not allow submit friendly name
         initialDefaults[APPSTATUS_REREGISTER] = @(NO); //by default not need to reregister
 
-        [[NSUserDefaults standardUserDefaults] registerDefaults:initialDefaults];
+        [[SHStateStore sharedInstance] registerDefaults:initialDefaults];
     }
 }
 
@@ -87,72 +130,64 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
 {
     if (self = [super init])
     {
-        self.semaphore_streethawkEnabled = dispatch_semaphore_create(1);
-        self.semaphore_aliveHost = dispatch_semaphore_create(1);
-        self.semaphore_growthHost = dispatch_semaphore_create(1);
-        self.semaphore_uploadLocationChange = dispatch_semaphore_create(1);
-        self.semaphore_allowSubmitFriendlyNames = dispatch_semaphore_create(1);
-        self.semaphore_allowSubmitInteractiveButtons = dispatch_semaphore_create(1);
-        self.semaphore_appstoreId = dispatch_semaphore_create(1);
-        self.semaphore_disableCodes = dispatch_semaphore_create(1);
-        self.semaphore_priorityCodes = dispatch_semaphore_create(1);
+        self.snapshot = [SHAppStatus loadSnapshot];
+        self.semaphore_update = dispatch_semaphore_create(1);
+        self.dictSeenAppStatus = [NSMutableDictionary dictionary];
+        self.seenAppStatusTime = nil;
     }
     return self;
 }
 
-- (void)dealloc
-{
-    [[NSNotificationCenter defaultCenter] removeObserver:self];
-}
-
 #pragma mark - properties
 
 - (BOOL)streethawkEnabled
 {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:APPSTATUS_STREETHAWKENABLED];
+    return self.snapshot.streethawkEnabled;
 }
 
 - (void)setStreethawkEnabled:(BOOL)streethawkEnabled
 {
-    NSAssert(![NSThread isMainThread], @"setStreethawkEnabled wait in main thread.");
-    if (![NSThread isMainThread])
-    {
-        dispatch_semaphore_wait(self.semaphore_streethawkEnabled, DISPATCH_TIME_FOREVER);
-        if (self.streethawkEnabled != streethawkEnabled)
-        {
-            [[NSUserDefaults standardUserDefaults] setBool:streethawkEnabled forKey:APPSTATUS_STREETHAWKENABLED];
-            [[NSUserDefaults standardUserDefaults] synchronize];
-            [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-        }
-        dispatch_semaphore_signal(self.semaphore_streethawkEnabled);
-    }
+    [self applyAppStatus:@{@"streethawk": @(streethawkEnabled)}];
 }
 
 - (NSString *)aliveHostForVersion:(SHHostVersion)hostVersion
 {
-    //For sake of performance, keep a memory variable instead of fetch from NSUserDefaults each time.
-    if (shStrIsEmpty(self.aliveHostInner))
+    NSString *hostOverride = StreetHawk.hostOverride;
+    if (!shStrIsEmpty(hostOverride)) //stand-in server for testing wins, not switch by app_status.
     {
-        self.aliveHostInner = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_ALIVE_HOST];
-        if (shStrIsEmpty(self.aliveHostInner))  //not setup yet, return nil
+        hostOverride = [SHAppStatus trimHost:hostOverride];
+        switch (hostVersion)
         {
-            return nil;
+            case SHHostVersion_V1:
+                return [NSString stringWithFormat:@"%@/%@", hostOverride, @"v1"];
+            case SHHostVersion_V2:
+                return [NSString stringWithFormat:@"%@/%@", hostOverride, @"v2"];
+            case SHHostVersion_V3:
+                return [NSString stringWithFormat:@"%@/%@", hostOverride, @"v3"];
+            default:
+                return hostOverride;
         }
     }
-    if ([self.aliveHostInner hasSuffix:@"/"])
+    NSString *host = self.snapshot.aliveHost; //already trimmed when set.
+    if (shStrIsEmpty(host))  //not setup yet, return nil
+    {
+        return nil;
+    }
+    //Alive host keeps failing, use default host until its circuit is half-open again. Not persist, app_status or route decides the real host.
+    if (![[SHHostHealth sharedInstance] isHostAvailable:host] && [[SHHostHealth sharedInstance] isHostAvailable:APPSTATUS_DEFAULT_HOST])
     {
-        self.aliveHostInner = [self.aliveHostInner substringToIndex:self.aliveHostInner.length - 1]; //remove last "/"
+        host = APPSTATUS_DEFAULT_HOST;
     }
     switch (hostVersion)
     {
         case SHHostVersion_V1:
-            return [NSString stringWithFormat:@"%@/%@", self.aliveHostInner, @"v1"];
+            return [NSString stringWithFormat:@"%@/%@", host, @"v1"];
         case SHHostVersion_V2:
-            return [NSString stringWithFormat:@"%@/%@", self.aliveHostInner, @"v2"];
+            return [NSString stringWithFormat:@"%@/%@", host, @"v2"];
         case SHHostVersion_V3:
-            return [NSString stringWithFormat:@"%@/%@", self.aliveHostInner, @"v3"];
+            return [NSString stringWithFormat:@"%@/%@", host, @"v3"];
         case SHHostVersion_Unknown:
-            return self.aliveHostInner; //some just for test
+            return host; //some just for test
             break;
         default:
             NSAssert(NO, @"Meet unknown host version;");
@@ -165,123 +200,55 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
 {
     if (!shStrIsEmpty(aliveHost))
     {
-        //server must guarantee host address is complete and correct, no check here.
-        if ([aliveHost hasSuffix:@"/"])
-        {
-            aliveHost = [aliveHost substringToIndex:aliveHost.length - 1]; //remove last "/"
-        }
-        NSAssert(![NSThread isMainThread], @"setAliveHost wait in main thread.");
-        if (![NSThread isMainThread])
-        {
-            dispatch_semaphore_wait(self.semaphore_aliveHost, DISPATCH_TIME_FOREVER);
-            if (self.aliveHostInner == nil) //try to read from local cache first
-            {
-                self.aliveHostInner = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_ALIVE_HOST];
-            }
-            if (self.aliveHostInner == nil || [self.aliveHostInner compare:aliveHost options:NSCaseInsensitiveSearch] != NSOrderedSame)
-            {
-                NSString *oldHost = self.aliveHostInner;
-                //change to new host
-                [[NSUserDefaults standardUserDefaults] setObject:aliveHost forKey:APPSTATUS_ALIVE_HOST];
-                [[NSUserDefaults standardUserDefaults] synchronize];
-                self.aliveHostInner = aliveHost;
-                [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-                SHLog(@"Host change from %@ to %@.", oldHost, self.aliveHostInner);
-            }
-            dispatch_semaphore_signal(self.semaphore_aliveHost);
-        }
+        [self applyAppStatus:@{@"host": aliveHost}];
     }
 }
 
 - (NSString *)growthHost
 {
-    return [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_GROWTH_HOST];
+    if (!shStrIsEmpty(StreetHawk.hostOverride))
+    {
+        return [NSString stringWithFormat:@"%@/growth", [self aliveHostForVersion:SHHostVersion_Unknown]];
+    }
+    return self.snapshot.growthHost;
 }
 
 - (void)setGrowthHost:(NSString *)growthHost
 {
     if (!shStrIsEmpty(growthHost))
     {
-        //server must guarantee host address is complete and correct, no check here.
-        if ([growthHost hasSuffix:@"/"])
-        {
-            growthHost = [growthHost substringToIndex:growthHost.length - 1]; //remove last "/"
-        }
-        NSAssert(![NSThread isMainThread], @"setGrowthHost wait in main thread.");
-        if (![NSThread isMainThread])
-        {
-            dispatch_semaphore_wait(self.semaphore_growthHost, DISPATCH_TIME_FOREVER);
-            NSString *localGrowthHost = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_GROWTH_HOST];
-            if ([growthHost compare:localGrowthHost options:NSCaseInsensitiveSearch] != NSOrderedSame)
-            {
-                //change to new host
-                [[NSUserDefaults standardUserDefaults] setObject:growthHost forKey:APPSTATUS_GROWTH_HOST];
-                [[NSUserDefaults standardUserDefaults] synchronize];
-                [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-                SHLog(@"Growth host change from %@ to %@.", localGrowthHost, growthHost);
-            }
-            dispatch_semaphore_signal(self.semaphore_growthHost);
-        }
+        [self applyAppStatus:@{@"growth_host": growthHost}];
     }
 }
 
 - (BOOL)uploadLocationChange
 {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:APPSTATUS_UPLOAD_LOCATION];
+    return self.snapshot.uploadLocationChange;
 }
 
 - (void)setUploadLocationChange:(BOOL)uploadLocationChange
 {
-    NSAssert(![NSThread isMainThread], @"setUploadLocationChange wait in main thread.");
-    if (![NSThread isMainThread])
-    {
-        dispatch_semaphore_wait(self.semaphore_uploadLocationChange, DISPATCH_TIME_FOREVER);
-        if (self.uploadLocationChange != uploadLocationChange)
-        {
-            [[NSUserDefaults standardUserDefaults] setBool:uploadLocationChange forKey:APPSTATUS_UPLOAD_LOCATION];
-            [[NSUserDefaults standardUserDefaults] synchronize];
-            [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-        }
-        dispatch_semaphore_signal(self.semaphore_uploadLocationChange);
-    }
+    [self applyAppStatus:@{@"location_updates": @(uploadLocationChange)}];
 }
 
 - (BOOL)allowSubmitFriendlyNames
 {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:APPSTATUS_SUBMIT_FRIENDLYNAME];
+    return self.snapshot.allowSubmitFriendlyNames;
 }
 
 - (void)setAllowSubmitFriendlyNames:(BOOL)allowSubmitFriendlyNames
 {
-    NSAssert(![NSThread isMainThread], @"setAllowSubmitFriendlyNames wait in main thread.");
-    if (![NSThread isMainThread])
-    {
-        dispatch_semaphore_wait(self.semaphore_allowSubmitFriendlyNames, DISPATCH_TIME_FOREVER);
-        //not compare `if (self.allowSubmitFriendlyNames != allowSubmitFriendlyNames)` otherwise once submission failure cause following not submit.
-        [[NSUserDefaults standardUserDefaults] setBool:allowSubmitFriendlyNames forKey:APPSTATUS_SUBMIT_FRIENDLYNAME];
-        [[NSUserDefaults standardUserDefaults] synchronize];
-        [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-        dispatch_semaphore_signal(self.semaphore_allowSubmitFriendlyNames);
-    }
+    [self applyAppStatus:@{@"submit_views": @(allowSubmitFriendlyNames)}];
 }
 
 - (BOOL)allowSubmitInteractiveButton
 {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:APPSTATUS_SUBMIT_INTERACTIVEBUTTONS];
+    return self.snapshot.allowSubmitInteractiveButton;
 }
 
 - (void)setAllowSubmitInteractiveButton:(BOOL)allowSubmitInteractiveButton
 {
-    NSAssert(![NSThread isMainThread], @"setAllowSubmitInteractiveButton wait in main thread.");
-    if (![NSThread isMainThread])
-    {
-        dispatch_semaphore_wait(self.semaphore_allowSubmitInteractiveButtons, DISPATCH_TIME_FOREVER);
-        //not compare `if (self.allowSubmitInteractiveButton != allowSubmitInteractiveButton)` otherwise once submission failure cause following not submit.
-        [[NSUserDefaults standardUserDefaults] setBool:allowSubmitInteractiveButton forKey:APPSTATUS_SUBMIT_INTERACTIVEBUTTONS];
-        [[NSUserDefaults standardUserDefaults] synchronize];
-        [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-        dispatch_semaphore_signal(self.semaphore_allowSubmitInteractiveButtons);
-    }
+    [self applyAppStatus:@{@"submit_interactive_button": @(allowSubmitInteractiveButton)}];
 }
 
 - (NSString *)iBeaconTimestamp
@@ -328,113 +295,208 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
     if (reregister)
     {
         //During App running it cannot re-register a fresh install, for example db is running so cannot delete it. Record a flag locally so that next launch will do re-register.
-        [[NSUserDefaults standardUserDefaults] setObject:@(YES) forKey:APPSTATUS_REREGISTER];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHStateStore sharedInstance] setObject:@(YES) forKey:APPSTATUS_REREGISTER];
     }
 }
 
 - (NSString *)appstoreId
 {
-    NSObject *obj = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_APPSTOREID];
-    if ([obj isKindOfClass:[NSString class]] && !shStrIsEmpty((NSString *)obj))
-    {
-        return (NSString *)obj;
-    }
-    return nil;
+    return self.snapshot.appstoreId;
 }
 
 - (void)setAppstoreId:(NSString *)appstoreId
 {
-    NSAssert(![NSThread isMainThread], @"setAppstoreId wait in main thread.");
-    if (![NSThread isMainThread])
+    if ([appstoreId isKindOfClass:[NSString class]] && !shStrIsEmpty(appstoreId))
     {
-        dispatch_semaphore_wait(self.semaphore_appstoreId, DISPATCH_TIME_FOREVER);
-        if ([appstoreId isKindOfClass:[NSString class]] && !shStrIsEmpty(appstoreId))
-        {
-            if (shStrIsEmpty(self.appstoreId) || [appstoreId compare:self.appstoreId] != NSOrderedSame) //local not setup or server push a different one
-            {
-                [[NSUserDefaults standardUserDefaults] setObject:appstoreId forKey:APPSTATUS_APPSTOREID];
-                [[NSUserDefaults standardUserDefaults] synchronize];
-                [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-            }
-        }
-        dispatch_semaphore_signal(self.semaphore_appstoreId);
+        [self applyAppStatus:@{@"app_store_id": appstoreId}];
     }
 }
 
 - (NSObject *)logDisableCodes
 {
-    NSAssert(NO, @"Should not call logDisableCodes.");
-    return nil;
+    return self.snapshot.logDisableCodes;
 }
 
 - (void)setLogDisableCodes:(NSObject *)logDisableCodes
 {
-    NSAssert(![NSThread isMainThread], @"setLogDisableCodes wait in main thread.");
-    if (![NSThread isMainThread])
-    {
-        dispatch_semaphore_wait(self.semaphore_disableCodes, DISPATCH_TIME_FOREVER);
-        NSArray *arrayLocal = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_DISABLECODES];
-        if (logDisableCodes == nil && arrayLocal != nil) //server get nil, local should clear.
-        {
-            [[NSUserDefaults standardUserDefaults] removeObjectForKey:APPSTATUS_DISABLECODES];
-            [[NSUserDefaults standardUserDefaults] synchronize];
-            [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-        }
-        else if (logDisableCodes != nil)
-        {
-            NSAssert([logDisableCodes isKindOfClass:[NSArray class]], @"logDisableCodes should be array.");
-            if ([logDisableCodes isKindOfClass:[NSArray class]])
-            {
-                if (!shArrayIsSame((NSArray *)logDisableCodes, arrayLocal))
-                {
-                    [[NSUserDefaults standardUserDefaults] setObject:logDisableCodes forKey:APPSTATUS_DISABLECODES];
-                    [[NSUserDefaults standardUserDefaults] synchronize];
-                    [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
-                }
-            }
-        }
-        dispatch_semaphore_signal(self.semaphore_disableCodes);
-    }
+    [self applyAppStatus:@{@"disable_logs": (logDisableCodes != nil) ? logDisableCodes : [NSNull null]}];
 }
 
 - (NSObject *)logPriorityCodes
 {
-    NSAssert(NO, @"Should not call logPriorityCodes.");
-    return nil;
+    return self.snapshot.logPriorityCodes;
 }
 
 - (void)setLogPriorityCodes:(NSObject *)logPriorityCodes
 {
-    NSAssert(![NSThread isMainThread], @"setLogPriorityCodes wait in main thread.");
-    if (![NSThread isMainThread])
+    [self applyAppStatus:@{@"priority": (logPriorityCodes != nil) ? logPriorityCodes : [NSNull null]}];
+}
+
+#pragma mark - public functions
+
+- (NSDictionary *)changedKeysOfAppStatus:(NSDictionary *)dictStatus
+{
+    if (![dictStatus isKindOfClass:[NSDictionary class]] || dictStatus.count == 0)
+    {
+        return nil;
+    }
+    @synchronized(self)
     {
-        dispatch_semaphore_wait(self.semaphore_priorityCodes, DISPATCH_TIME_FOREVER);
-        NSArray *arrayLocal = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_PRIORITYCODES];
-        if (logPriorityCodes == nil && arrayLocal != nil) //server get nil, local should clear.
+        if (self.seenAppStatusTime == nil || -[self.seenAppStatusTime timeIntervalSinceNow] > APPSTATUS_DIFF_EXPIRE)
+        {
+            [self.dictSeenAppStatus removeAllObjects]; //expired, everything counts as changed.
+            self.seenAppStatusTime = [NSDate date];
+        }
+        if ([self.dictSeenAppStatus isEqualToDictionary:dictStatus])
         {
-            [[NSUserDefaults standardUserDefaults] removeObjectForKey:APPSTATUS_PRIORITYCODES];
-            [[NSUserDefaults standardUserDefaults] synchronize];
-            [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
+            return nil; //most responses carry the same full section, one deep compare and done.
         }
-        else if (logPriorityCodes != nil)
+        NSMutableDictionary *dictChanged = nil;
+        for (NSString *key in dictStatus)
         {
-            NSAssert([logPriorityCodes isKindOfClass:[NSArray class]], @"logPriorityCodes should be array.");
-            if ([logPriorityCodes isKindOfClass:[NSArray class]])
+            NSObject *value = dictStatus[key];
+            if (![self.dictSeenAppStatus[key] isEqual:value])
             {
-                if (!shArrayIsSame((NSArray *)logPriorityCodes, arrayLocal))
+                if (dictChanged == nil)
                 {
-                    [[NSUserDefaults standardUserDefaults] setObject:logPriorityCodes forKey:APPSTATUS_PRIORITYCODES];
-                    [[NSUserDefaults standardUserDefaults] synchronize];
-                    [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil];
+                    dictChanged = [NSMutableDictionary dictionary];
                 }
+                dictChanged[key] = value;
+                self.dictSeenAppStatus[key] = value;
             }
         }
-        dispatch_semaphore_signal(self.semaphore_priorityCodes);
+        return dictChanged;
     }
 }
 
-#pragma mark - public functions
+- (void)applyAppStatus:(NSDictionary *)dictStatus
+{
+    NSAssert(![NSThread isMainThread], @"applyAppStatus wait in main thread.");
+    if ([NSThread isMainThread] || ![dictStatus isKindOfClass:[NSDictionary class]])
+    {
+        return;
+    }
+    dispatch_semaphore_wait(self.semaphore_update, DISPATCH_TIME_FOREVER);
+    SHAppStatusSnapshot *current = self.snapshot;
+    SHAppStatusSnapshot *next = [current copy];
+    BOOL isChanged = NO;
+    //check "streethawk" to enable/disable library function
+    if ([dictStatus[@"streethawk"] respondsToSelector:@selector(boolValue)] && [dictStatus[@"streethawk"] boolValue] != current.streethawkEnabled)
+    {
+        next.streethawkEnabled = [dictStatus[@"streethawk"] boolValue];
+        isChanged = YES;
+    }
+    //check "host", server must guarantee host address is complete and correct, no check here.
+    if ([dictStatus[@"host"] isKindOfClass:[NSString class]] && !shStrIsEmpty(dictStatus[@"host"]))
+    {
+        NSString *aliveHost = [SHAppStatus trimHost:dictStatus[@"host"]];
+        if (current.aliveHost == nil || [current.aliveHost compare:aliveHost options:NSCaseInsensitiveSearch] != NSOrderedSame)
+        {
+            SHLog(@"Host change from %@ to %@.", current.aliveHost, aliveHost);
+            next.aliveHost = aliveHost;
+            isChanged = YES;
+        }
+    }
+    //check "growth_host"
+    if ([dictStatus[@"growth_host"] isKindOfClass:[NSString class]] && !shStrIsEmpty(dictStatus[@"growth_host"]))
+    {
+        NSString *growthHost = [SHAppStatus trimHost:dictStatus[@"growth_host"]];
+        if (current.growthHost == nil || [growthHost compare:current.growthHost options:NSCaseInsensitiveSearch] != NSOrderedSame)
+        {
+            SHLog(@"Growth host change from %@ to %@.", current.growthHost, growthHost);
+            next.growthHost = growthHost;
+            isChanged = YES;
+        }
+    }
+    //check "location_updates"
+    if ([dictStatus[@"location_updates"] respondsToSelector:@selector(boolValue)] && [dictStatus[@"location_updates"] boolValue] != current.uploadLocationChange)
+    {
+        next.uploadLocationChange = [dictStatus[@"location_updates"] boolValue];
+        isChanged = YES;
+    }
+    //check "submit_views". Not compare with current, otherwise once submission failure cause following not submit.
+    if ([dictStatus[@"submit_views"] respondsToSelector:@selector(boolValue)])
+    {
+        next.allowSubmitFriendlyNames = [dictStatus[@"submit_views"] boolValue];
+        isChanged = YES;
+    }
+    //check "submit_interactive_button". Not compare with current, same reason as "submit_views".
+    if ([dictStatus[@"submit_interactive_button"] respondsToSelector:@selector(boolValue)])
+    {
+        next.allowSubmitInteractiveButton = [dictStatus[@"submit_interactive_button"] boolValue];
+        isChanged = YES;
+    }
+    //check "app_store_id", local not setup or server push a different one
+    if ([dictStatus[@"app_store_id"] isKindOfClass:[NSString class]] && !shStrIsEmpty(dictStatus[@"app_store_id"])
+        && (shStrIsEmpty(current.appstoreId) || [dictStatus[@"app_store_id"] compare:current.appstoreId] != NSOrderedSame))
+    {
+        next.appstoreId = dictStatus[@"app_store_id"];
+        isChanged = YES;
+    }
+    //check "disable_logs", nil means clear, or array of code list.
+    if ([dictStatus.allKeys containsObject:@"disable_logs"])
+    {
+        NSObject *logDisableCodes = (dictStatus[@"disable_logs"] == [NSNull null]) ? nil : dictStatus[@"disable_logs"];
+        NSAssert(logDisableCodes == nil || [logDisableCodes isKindOfClass:[NSArray class]], @"logDisableCodes should be array.");
+        if (logDisableCodes == nil && current.logDisableCodes != nil) //server get nil, local should clear.
+        {
+            next.logDisableCodes = nil;
+            isChanged = YES;
+        }
+        else if ([logDisableCodes isKindOfClass:[NSArray class]] && !shArrayIsSame((NSArray *)logDisableCodes, current.logDisableCodes))
+        {
+            next.logDisableCodes = (NSArray *)logDisableCodes;
+            isChanged = YES;
+        }
+    }
+    //check "priority", nil means clear, or array of code list.
+    if ([dictStatus.allKeys containsObject:@"priority"])
+    {
+        NSObject *logPriorityCodes = (dictStatus[@"priority"] == [NSNull null]) ? nil : dictStatus[@"priority"];
+        NSAssert(logPriorityCodes == nil || [logPriorityCodes isKindOfClass:[NSArray class]], @"logPriorityCodes should be array.");
+        if (logPriorityCodes == nil && current.logPriorityCodes != nil) //server get nil, local should clear.
+        {
+            next.logPriorityCodes = nil;
+            isChanged = YES;
+        }
+        else if ([logPriorityCodes isKindOfClass:[NSArray class]] && !shArrayIsSame((NSArray *)logPriorityCodes, current.logPriorityCodes))
+        {
+            next.logPriorityCodes = (NSArray *)logPriorityCodes;
+            isChanged = YES;
+        }
+    }
+    if (isChanged)
+    {
+        [self publishSnapshot:next];
+    }
+    dispatch_semaphore_signal(self.semaphore_update);
+    if (isChanged)
+    {
+        [[NSNotificationCenter defaultCenter] postNotificationName:SHAppStatusChangeNotification object:nil]; //once for the whole section, observer reads the new snapshot.
+    }
+    //below are not kept in snapshot, forward to modules.
+    //check "ibeacon"
+    if ([dictStatus.allKeys containsObject:@"ibeacon"])
+    {
+        self.iBeaconTimestamp = NONULL(dictStatus[@"ibeacon"]); //it may be nil
+    }
+    //check "geofences"
+    if ([dictStatus.allKeys containsObject:@"geofences"])
+    {
+        self.geofenceTimestamp = NONULL(dictStatus[@"geofences"]);
+    }
+    //check "feed_updated"
+    if ([dictStatus.allKeys containsObject:@"feed_updated"])
+    {
+        SHLog(@"feed timestamp in app_status: %@", dictStatus[@"feed_updated"]);
+        self.feedTimestamp = NONULL(dictStatus[@"feed_updated"]);
+    }
+    //check "reregister"
+    if ([dictStatus.allKeys containsObject:@"reregister"])
+    {
+        self.reregister = [NONULL(dictStatus[@"reregister"]) boolValue];
+    }
+}
 
 - (void)sendAppStatusCheckRequest:(BOOL)force
 {
@@ -444,16 +506,12 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
         {
             return;
         }
-        NSObject *lastCheckTimeVal = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_CHECK_TIME];
-        if (lastCheckTimeVal != nil/*fresh launch must check first*/ && self.streethawkEnabled/*No need to send request, as when StreetHawk is enabled, normal request are sent frequently*/)
+        SHAppStatusSnapshot *snapshot = self.snapshot;
+        if (snapshot.checkTime != 0/*fresh launch must check first*/ && snapshot.streethawkEnabled/*No need to send request, as when StreetHawk is enabled, normal request are sent frequently*/)
         {
             return;
         }
-        double lastCheckTime = 0;
-        if ([lastCheckTimeVal isKindOfClass:[NSNumber class]])
-        {
-            lastCheckTime = [(NSNumber *)lastCheckTimeVal doubleValue];
-        }
+        double lastCheckTime = snapshot.checkTime;
         if (lastCheckTime != 0 && [NSDate date].timeIntervalSinceReferenceDate - lastCheckTime < 60*60*24) //not check again once in a day, ticket https://bitbucket.org/shawk/streethawk/issue/379/app-status-reworked
         {
             return;
@@ -469,17 +527,29 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
 
 - (void)recordCheckTime
 {
-    [[NSUserDefaults standardUserDefaults] setObject:@([NSDate date].timeIntervalSinceReferenceDate) forKey:APPSTATUS_CHECK_TIME];
-    [[NSUserDefaults standardUserDefaults] synchronize];
+    //called for every response with app_status, only keep in memory and let state store write it behind.
+    NSTimeInterval now = [NSDate date].timeIntervalSinceReferenceDate;
+    if (now - self.snapshot.checkTime < 60)
+    {
+        return; //check time is compared in days, not need to copy snapshot for each response.
+    }
+    dispatch_semaphore_wait(self.semaphore_update, DISPATCH_TIME_FOREVER);
+    SHAppStatusSnapshot *next = [self.snapshot copy];
+    next.checkTime = now;
+    [self publishSnapshot:next];
+    dispatch_semaphore_signal(self.semaphore_update);
 }
 
 - (void)checkRouteWithCompleteHandler:(void(^)(BOOL isEnabled, NSString *hostUrl))handler
 {
-    [[SHHTTPSessionManager sharedInstance] GET:@"https://route.streethawk.com/v1/apps/status" hostVersion:SHHostVersion_Unknown parameters:@{@"app_key": NONULL(StreetHawk.appKey)} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+    NSString *routeUrl = shStrIsEmpty(StreetHawk.hostOverride) ? SHAppStatusRouteUrl : [NSString stringWithFormat:@"%@/apps/status", [self aliveHostForVersion:SHHostVersion_V1]];
+    self.lastRouteCheckAttempt = [NSDate date];
+    [[SHHTTPSessionManager sharedInstance] GET:routeUrl hostVersion:SHHostVersion_Unknown parameters:@{@"app_key": NONULL(StreetHawk.appKey)} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
      {
+         [[SHStateStore sharedInstance] setObject:@([NSDate date].timeIntervalSinceReferenceDate) forKey:APPSTATUS_ROUTE_CHECK_TIME];
          if (handler)
          {
-             handler(self.streethawkEnabled, self.aliveHostInner);
+             handler(self.streethawkEnabled, self.snapshot.aliveHost);
          }
      }
     failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
@@ -491,4 +561,110 @@ NSString * const SHAppStatusChangeNotification = @"SHAppStatusChangeNotification
      }];
 }
 
+- (void)refreshRouteAndPreconnect
+{
+    if (!shStrIsEmpty(StreetHawk.hostOverride) || shStrIsEmpty(StreetHawk.appKey))
+    {
+        return; //stand-in server not route, or not registered yet.
+    }
+    NSString *selectedHost = [self aliveHostForVersion:SHHostVersion_Unknown]; //host requests are going to, may be failed over.
+    NSString *preferredHost = self.snapshot.aliveHost;
+    if (shStrIsEmpty(selectedHost) || shStrIsEmpty(preferredHost))
+    {
+        return; //first launch route check is done by register.
+    }
+    //refresh route when result is old, or alive host is unhealthy, route may give a new host.
+    double lastRouteCheckTime = [[[SHStateStore sharedInstance] objectForKey:APPSTATUS_ROUTE_CHECK_TIME] doubleValue];
+    BOOL isExpired = ([NSDate date].timeIntervalSinceReferenceDate - lastRouteCheckTime > APPSTATUS_ROUTE_TTL);
+    BOOL isUnhealthy = ([[SHHostHealth sharedInstance] circuitStateForHost:preferredHost] != SHHostCircuitState_Closed);
+    BOOL isRecentlyTried = (self.lastRouteCheckAttempt != nil && [[NSDate date] timeIntervalSinceDate:self.lastRouteCheckAttempt] < APPSTATUS_ROUTE_RETRY_INTERVAL);
+    if ((isExpired || isUnhealthy) && !isRecentlyTried)
+    {
+        SHLog(@"Refresh route as %@.", isExpired ? @"route check expires" : @"alive host is unhealthy");
+        [self checkRouteWithCompleteHandler:nil];
+    }
+    //warm up connection to the host requests are going to. When preferred host's circuit is half-open it's selected again, so this is also its probe.
+    [[SHHostHealth sharedInstance] preconnectHost:selectedHost];
+}
+
+#pragma mark - private functions
+
++ (NSString *)trimHost:(NSString *)host
+{
+    if ([host hasSuffix:@"/"])
+    {
+        return [host substringToIndex:host.length - 1]; //remove last "/"
+    }
+    return host;
+}
+
++ (SHAppStatusSnapshot *)loadSnapshot
+{
+    SHStateStore *stateStore = [SHStateStore sharedInstance];
+    SHAppStatusSnapshot *snapshot = [[SHAppStatusSnapshot alloc] init];
+    snapshot.streethawkEnabled = [stateStore boolForKey:APPSTATUS_STREETHAWKENABLED];
+    NSString *aliveHost = [stateStore objectForKey:APPSTATUS_ALIVE_HOST];
+    snapshot.aliveHost = shStrIsEmpty(aliveHost) ? nil : [SHAppStatus trimHost:aliveHost];
+    snapshot.growthHost = [stateStore objectForKey:APPSTATUS_GROWTH_HOST];
+    snapshot.uploadLocationChange = [stateStore boolForKey:APPSTATUS_UPLOAD_LOCATION];
+    snapshot.allowSubmitFriendlyNames = [stateStore boolForKey:APPSTATUS_SUBMIT_FRIENDLYNAME];
+    snapshot.allowSubmitInteractiveButton = [stateStore boolForKey:APPSTATUS_SUBMIT_INTERACTIVEBUTTONS];
+    NSObject *appstoreId = [stateStore objectForKey:APPSTATUS_APPSTOREID];
+    snapshot.appstoreId = ([appstoreId isKindOfClass:[NSString class]] && !shStrIsEmpty((NSString *)appstoreId)) ? (NSString *)appstoreId : nil;
+    NSObject *disableCodes = [stateStore objectForKey:APPSTATUS_DISABLECODES];
+    snapshot.logDisableCodes = [disableCodes isKindOfClass:[NSArray class]] ? (NSArray *)disableCodes : nil;
+    NSObject *priorityCodes = [stateStore objectForKey:APPSTATUS_PRIORITYCODES];
+    snapshot.logPriorityCodes = [priorityCodes isKindOfClass:[NSArray class]] ? (NSArray *)priorityCodes : nil;
+    NSObject *checkTime = [stateStore objectForKey:APPSTATUS_CHECK_TIME];
+    snapshot.checkTime = [checkTime isKindOfClass:[NSNumber class]] ? [(NSNumber *)checkTime doubleValue] : 0;
+    return snapshot;
+}
+
+- (void)publishSnapshot:(SHAppStatusSnapshot *)snapshot
+{
+    self.snapshot = snapshot;
+    [self persistSnapshot:snapshot];
+}
+
+- (void)persistSnapshot:(SHAppStatusSnapshot *)snapshot
+{
+    SHStateStore *stateStore = [SHStateStore sharedInstance];
+    [stateStore setBool:snapshot.streethawkEnabled forKey:APPSTATUS_STREETHAWKENABLED];
+    if (!shStrIsEmpty(snapshot.aliveHost))
+    {
+        [stateStore setObject:snapshot.aliveHost forKey:APPSTATUS_ALIVE_HOST];
+    }
+    if (!shStrIsEmpty(snapshot.growthHost))
+    {
+        [stateStore setObject:snapshot.growthHost forKey:APPSTATUS_GROWTH_HOST];
+    }
+    [stateStore setBool:snapshot.uploadLocationChange forKey:APPSTATUS_UPLOAD_LOCATION];
+    [stateStore setBool:snapshot.allowSubmitFriendlyNames forKey:APPSTATUS_SUBMIT_FRIENDLYNAME];
+    [stateStore setBool:snapshot.allowSubmitInteractiveButton forKey:APPSTATUS_SUBMIT_INTERACTIVEBUTTONS];
+    if (!shStrIsEmpty(snapshot.appstoreId))
+    {
+        [stateStore setObject:snapshot.appstoreId forKey:APPSTATUS_APPSTOREID];
+    }
+    if (snapshot.logDisableCodes != nil)
+    {
+        [stateStore setObject:snapshot.logDisableCodes forKey:APPSTATUS_DISABLECODES];
+    }
+    else
+    {
+        [stateStore removeObjectForKey:APPSTATUS_DISABLECODES];
+    }
+    if (snapshot.logPriorityCodes != nil)
+    {
+        [stateStore setObject:snapshot.logPriorityCodes forKey:APPSTATUS_PRIORITYCODES];
+    }
+    else
+    {
+        [stateStore removeObjectForKey:APPSTATUS_PRIORITYCODES];
+    }
+    if (snapshot.checkTime > 0)
+    {
+        [stateStore setObject:@(snapshot.checkTime) forKey:APPSTATUS_CHECK_TIME];
+    }
+}
+
 @end
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SHHTTPSessionManager.h" //for SHHostVersion
+
+/**
+ Immutable snapshot of everything a StreetHawk request needs from SDK state: base url for each host version, query string with install id, and default headers.
+
+ It's built once and atomically swapped when app_status changes host, alive host fails over, or install id changes, so building a request is just appending path to a prepared base url, and headers are not mutated on shared request serializer from many places.
+ */
+@interface SHEndpointContext : NSObject
+
+/** @name Creator */
+
+/**
+ The context for requests now. It's built at first call, and the returned object never changes, keep it for one request.
+ */
++ (SHEndpointContext *)currentContext;
+
+/**
+ Build a new context from current app status and install, and swap it in. Called automatically when app status changes, host circuit changes or install registers/updates; call it directly when install id is changed in code before a following request.
+ */
++ (void)rebuild;
+
+/** @name Properties */
+
+/**
+ Install id at build time. Empty string if not registered yet.
+ */
+@property (nonatomic, strong, readonly) NSString *installId;
+
+/**
+ Query string appended to StreetHawk path, "?installid=<id>"; empty string if not registered yet.
+ */
+@property (nonatomic, strong, readonly) NSString *installQuery;
+
+/**
+ Headers for SDK request to StreetHawk hosts: "User-Agent", "X-App-Key", "X-Version", "X-Installid" and "X-Install-Token" if available. Use `headersForURL:` to add them, it keeps them away from other hosts.
+ */
+@property (nonatomic, strong, readonly) NSDictionary *headers;
+
+/** @name Functions */
+
+/**
+ Base url of a host version, ends with "/", for example @"https://api.streethawk.com/v1/".
+ @param hostVersion Host version.
+ @return Base url, or nil if host is not known yet.
+ */
+- (NSString *)baseUrlForVersion:(SHHostVersion)hostVersion;
+
+/**
+ Headers to add for a request url. StreetHawk hosts are the alive host (or stand-in host override, or failed over default host), growth host and route check host, compared by scheme, host and port. Other urls, such as third-party resources requested through SDK session, get none, so install token does not leak.
+ @param url The request url.
+ @return `headers` for StreetHawk host, empty dictionary for other host.
+ */
+- (NSDictionary *)headersForURL:(NSURL *)url;
+
+@end
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHEndpointContext.h"
+//header from StreetHawk
+#import "SHApp.h" //for `StreetHawk` properties
+#import "SHInstall.h" //for install notification names
+#import "SHAppStatus.h" //for alive host
+#import "SHHostHealth.h" //for host failover notification
+#import "SHUtils.h" //for shStrIsEmpty
+
+static SHEndpointContext *g_currentContext = nil; //swapped as a whole under lock, never mutated.
+
+@interface SHEndpointContext ()
+
+@property (nonatomic, strong, readwrite) NSString *installId;
+@property (nonatomic, strong, readwrite) NSString *installQuery;
+@property (nonatomic, strong, readwrite) NSDictionary *headers;
+@property (nonatomic, strong) NSDictionary *dictBaseUrls; //@(SHHostVersion) -> base url with last "/".
+@property (nonatomic, strong) NSSet *streetHawkOrigins; //"scheme://host:port" in lower case which get SDK headers.
+
++ (NSString *)originOfURL:(NSURL *)url; //"scheme://host:port" in lower case, port is default one of scheme if not in url. nil if no host.
+
++ (SHEndpointContext *)buildContext; //read SDK state and create a context.
++ (void)stateChangeHandler:(NSNotification *)notification; //app status, install or host health changed.
+
+@end
+
+@implementation SHEndpointContext
+
+#pragma mark - life cycle
+
++ (SHEndpointContext *)currentContext
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(stateChangeHandler:) name:SHAppStatusChangeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(stateChangeHandler:) name:SHInstallRegistrationSuccessNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(stateChangeHandler:) name:SHInstallUpdateSuccessNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(stateChangeHandler:) name:SHHostHealthChangeNotification object:nil];
+    });
+    SHEndpointContext *context = nil;
+    @synchronized([SHEndpointContext class])
+    {
+        context = g_currentContext;
+    }
+    if (context == nil || shStrIsEmpty([context baseUrlForVersion:SHHostVersion_Unknown]))
+    {
+        //first time, or built before host is known.
+        [self rebuild];
+        @synchronized([SHEndpointContext class])
+        {
+            context = g_currentContext;
+        }
+    }
+    return context;
+}
+
++ (void)rebuild
+{
+    SHEndpointContext *context = [self buildContext];
+    @synchronized([SHEndpointContext class])
+    {
+        g_currentContext = context;
+    }
+}
+
+#pragma mark - public functions
+
+- (NSString *)baseUrlForVersion:(SHHostVersion)hostVersion
+{
+    return self.dictBaseUrls[@(hostVersion)];
+}
+
+- (NSDictionary *)headersForURL:(NSURL *)url
+{
+    NSString *origin = [SHEndpointContext originOfURL:url];
+    if (origin != nil && [self.streetHawkOrigins containsObject:origin])
+    {
+        return self.headers;
+    }
+    return @{};
+}
+
+#pragma mark - private functions
+
++ (SHEndpointContext *)buildContext
+{
+    SHEndpointContext *context = [[SHEndpointContext alloc] init];
+    //base urls
+    NSMutableDictionary *dictBaseUrls = [NSMutableDictionary dictionary];
+    for (NSNumber *version in @[@(SHHostVersion_Unknown), @(SHHostVersion_V1), @(SHHostVersion_V2), @(SHHostVersion_V3)])
+    {
+        NSString *hostUrl = [[SHAppStatus sharedInstance] aliveHostForVersion:(SHHostVersion)version.intValue];
+        if (!shStrIsEmpty(hostUrl))
+        {
+            dictBaseUrls[version] = [hostUrl hasSuffix:@"/"] ? hostUrl : [hostUrl stringByAppendingString:@"/"];
+        }
+    }
+    context.dictBaseUrls = [dictBaseUrls copy];
+    //hosts which get SDK headers
+    NSMutableSet *streetHawkOrigins = [NSMutableSet set];
+    NSMutableArray *streetHawkUrls = [NSMutableArray arrayWithArray:dictBaseUrls.allValues];
+    [streetHawkUrls addObject:SHAppStatusRouteUrl];
+    if (!shStrIsEmpty([SHAppStatus sharedInstance].growthHost))
+    {
+        [streetHawkUrls addObject:[SHAppStatus sharedInstance].growthHost];
+    }
+    for (NSString *streetHawkUrl in streetHawkUrls)
+    {
+        NSString *origin = [SHEndpointContext originOfURL:[NSURL URLWithString:streetHawkUrl]];
+        if (origin != nil)
+        {
+            [streetHawkOrigins addObject:origin];
+        }
+    }
+    context.streetHawkOrigins = [streetHawkOrigins copy];
+    //install
+    NSString *installId = NONULL(StreetHawk.currentInstall.suid);
+    context.installId = installId;
+    context.installQuery = shStrIsEmpty(installId) ? @"" : [NSString stringWithFormat:@"?installid=%@", installId];
+    //headers
+    NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+    headers[@"User-Agent"] = [NSString stringWithFormat:@"%@(%@)", StreetHawk.appKey, StreetHawk.version]; //e.g: "SHSample(1.5.3)"
+    headers[@"X-App-Key"] = NONULL(StreetHawk.appKey);
+    headers[@"X-Version"] = NONULL(StreetHawk.version);
+    headers[@"X-Installid"] = shStrIsEmpty(installId) ? @"null" : installId;
+    //Add install token for /v3 request. Cannot check host version here, add to all requests of StreetHawk hosts.
+    NSString *installToken = [[NSUserDefaults standardUserDefaults] objectForKey:SH_INSTALL_TOKEN];
+    if (!shStrIsEmpty(installToken))
+    {
+        headers[@"X-Install-Token"] = installToken;
+    }
+    context.headers = [headers copy];
+    return context;
+}
+
++ (void)stateChangeHandler:(NSNotification *)notification
+{
+    [self rebuild];
+}
+
++ (NSString *)originOfURL:(NSURL *)url
+{
+    NSString *scheme = url.scheme.lowercaseString;
+    NSString *host = url.host.lowercaseString;
+    if (shStrIsEmpty(scheme) || shStrIsEmpty(host))
+    {
+        return nil;
+    }
+    NSNumber *port = url.port;
+    if (port == nil)
+    {
+        port = [scheme isEqualToString:@"https"] ? @443 : @80;
+    }
+    return [NSString stringWithFormat:@"%@://%@:%@", scheme, host, port];
+}
+
+@end
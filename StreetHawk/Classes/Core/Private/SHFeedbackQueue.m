@@ -18,6 +18,7 @@
 #import "SHFeedbackQueue.h"
 //header from StreetHawk
 #import "SHHTTPSessionManager.h" //for sending request
+#import "SHRequestOutbox.h" //for retry feedback when network fails
 #import "PushDataForApplication.h" //for use pushData
 #import "SHUtils.h" //for format date utility
 #import "SHInstall.h" //for `StreetHawk.currentInstall.suid`
@@ -107,7 +108,8 @@
     }
     NSDictionary *params = @{@"title": NONULL(feedbackTitle), @"feedback_type": @(feedbackType), @"contents": NONULL(feedbackContent), @"built_at": shFormatStreetHawkDate([NSDate date]), @"anonymous": @"no", @"installid": NONULL(StreetHawk.currentInstall.suid)};
     handler = [handler copy];
-    [[SHHTTPSessionManager sharedInstance] POST:@"feedback/submit/" hostVersion:SHHostVersion_V1 body:params success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+    NSString *idempotencyKey = [NSUUID UUID].UUIDString; //same key for first try and outbox retry, server ignores repeated delivery.
+    [[SHHTTPSessionManager sharedInstance] requestMethod:@"POST" URLString:@"feedback/submit/" hostVersion:SHHostVersion_V1 parameters:params headers:@{@"X-Idempotency-Key": idempotencyKey} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
     {
         dispatch_async(dispatch_get_main_queue(), ^
            {
@@ -123,7 +125,16 @@
         }
     } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
     {
-        shPresentErrorAlertOrLog(error);
+        if ([SHRequestOutbox isRetryableError:error forTask:task])
+        {
+            //network or server temporary problem, user's feedback is not lost, put into outbox and send later.
+            SHLog(@"Fail to send feedback, retry later: %@", error);
+            [[SHRequestOutbox sharedInstance] enqueueMethod:@"POST" path:@"feedback/submit/" hostVersion:SHHostVersion_V1 body:params useJSON:NO idempotencyKey:idempotencyKey coalesceKey:nil resultNotification:nil];
+        }
+        else
+        {
+            shPresentErrorAlertOrLog(error);
+        }
         if (pushData != nil && pushData.msgID != 0)
         {
             [StreetHawk sendLogForCode:LOG_CODE_ERROR withComment:[NSString stringWithFormat:@"Send feedback meet error: %@. Push msgid: %ld.", error.localizedDescription, (long)pushData.msgID] forAssocId:0 withResult:100/*ignore*/ withHandler:nil];
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class SHFriendlyNameObject;
+
+/**
+ In-memory index of friendly names registered by `shCustomActivityList:`.
+ 
+ The list saved in NSUserDefaults is read once, at first lookup or when a new list is set, and indexed by view controller and by lower case friendly name. Page enter/exit and deeplinking then find friendly name by hash lookup without touching NSUserDefaults. When several items have same key, the first one in list wins, same as scanning the list.
+ */
+@interface SHFriendlyNameRegistry : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance.
+ */
++ (SHFriendlyNameRegistry *)sharedInstance;
+
+/** @name Update */
+
+/**
+ Replace whole list and rebuild index. Called by `shCustomActivityList:` after saving the list.
+ @param arrayFriendlyNames Array of dictionary with keys `FRIENDLYNAME_NAME`, `FRIENDLYNAME_VC` and optional xib keys, same as saved in NSUserDefaults.
+ */
+- (void)setFriendlyNames:(NSArray *)arrayFriendlyNames;
+
+/** @name Lookup */
+
+/**
+ Friendly name of the view controller, case sensitive.
+ @param vc View controller class name.
+ @return Friendly name registered for `vc`, or nil if not registered.
+ */
+- (NSString *)friendlyNameForVc:(NSString *)vc;
+
+/**
+ Find registered item by friendly name, case insensitive.
+ @param friendlyName Friendly name to find.
+ @return A new object with `friendlyName` as passed in, and vc and xibs of the matching item; nil if not registered.
+ */
+- (SHFriendlyNameObject *)objectForFriendlyName:(NSString *)friendlyName;
+
+/**
+ Distinct friendly names in registering order, for submitting to server.
+ */
+@property (nonatomic, readonly) NSArray *uniqueFriendlyNames;
+
+/**
+ Friendly names which appear more than once in list, case sensitive.
+ */
+@property (nonatomic, readonly) NSArray *redefinedFriendlyNames;
+
+@end
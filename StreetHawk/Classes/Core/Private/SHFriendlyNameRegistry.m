@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHFriendlyNameRegistry.h"
+//header from StreetHawk
+#import "SHFriendlyNameObject.h" //for FRIENDLYNAME_KEY and returned object
+
+@interface SHFriendlyNameRegistry ()
+
+//All accessed under lock of self. Replaced as a whole when rebuild, never mutated after built.
+@property (nonatomic) BOOL isLoaded; //whether index is built from list.
+@property (nonatomic, strong) NSDictionary *dictVcToName; //vc -> friendly name.
+@property (nonatomic, strong) NSDictionary *dictNameToItem; //lower case friendly name -> saved dictionary.
+@property (nonatomic, strong) NSArray *arrayUniqueNames;
+@property (nonatomic, strong) NSArray *arrayRedefinedNames;
+
+- (void)buildIndex:(NSArray *)arrayFriendlyNames; //must call under lock of self.
+- (void)loadIfNeeded; //read list from NSUserDefaults at first lookup, must call under lock of self.
+
+@end
+
+@implementation SHFriendlyNameRegistry
+
+#pragma mark - life cycle
+
++ (SHFriendlyNameRegistry *)sharedInstance
+{
+    static SHFriendlyNameRegistry *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHFriendlyNameRegistry alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.isLoaded = NO;
+    }
+    return self;
+}
+
+#pragma mark - properties
+
+- (NSArray *)uniqueFriendlyNames
+{
+    @synchronized(self)
+    {
+        [self loadIfNeeded];
+        return self.arrayUniqueNames;
+    }
+}
+
+- (NSArray *)redefinedFriendlyNames
+{
+    @synchronized(self)
+    {
+        [self loadIfNeeded];
+        return self.arrayRedefinedNames;
+    }
+}
+
+#pragma mark - public functions
+
+- (void)setFriendlyNames:(NSArray *)arrayFriendlyNames
+{
+    @synchronized(self)
+    {
+        [self buildIndex:arrayFriendlyNames];
+    }
+}
+
+- (NSString *)friendlyNameForVc:(NSString *)vc
+{
+    if (vc == nil || vc.length == 0)
+    {
+        return nil;
+    }
+    @synchronized(self)
+    {
+        [self loadIfNeeded];
+        return self.dictVcToName[vc];
+    }
+}
+
+- (SHFriendlyNameObject *)objectForFriendlyName:(NSString *)friendlyName
+{
+    if (friendlyName == nil || friendlyName.length == 0)
+    {
+        return nil;
+    }
+    NSDictionary *dict = nil;
+    @synchronized(self)
+    {
+        [self loadIfNeeded];
+        dict = self.dictNameToItem[friendlyName.lowercaseString];
+    }
+    if (dict == nil)
+    {
+        return nil;
+    }
+    //Create new one each time, caller may modify it.
+    SHFriendlyNameObject *findObj = [[SHFriendlyNameObject alloc] init];
+    findObj.friendlyName = friendlyName;
+    findObj.vc = dict[FRIENDLYNAME_VC];
+    findObj.xib_iphone = dict[FRIENDLYNAME_XIB_IPHONE];
+    findObj.xib_ipad = dict[FRIENDLYNAME_XIB_IPAD];
+    return findObj;
+}
+
+#pragma mark - private functions
+
+- (void)buildIndex:(NSArray *)arrayFriendlyNames
+{
+    NSMutableDictionary *dictVcToName = [NSMutableDictionary dictionary];
+    NSMutableDictionary *dictNameToItem = [NSMutableDictionary dictionary];
+    NSMutableArray *arrayUniqueNames = [NSMutableArray array];
+    NSMutableArray *arrayRedefinedNames = [NSMutableArray array];
+    NSMutableSet *setNames = [NSMutableSet set];
+    for (NSDictionary *dict in arrayFriendlyNames)
+    {
+        if (![dict isKindOfClass:[NSDictionary class]])
+        {
+            continue;
+        }
+        NSString *friendlyName = dict[FRIENDLYNAME_NAME];
+        NSString *vc = dict[FRIENDLYNAME_VC];
+        if (![friendlyName isKindOfClass:[NSString class]] || friendlyName.length == 0)
+        {
+            continue;
+        }
+        //first one wins, same as scanning list.
+        if ([vc isKindOfClass:[NSString class]] && vc.length > 0 && dictVcToName[vc] == nil)
+        {
+            dictVcToName[vc] = friendlyName;
+        }
+        NSString *lowerName = friendlyName.lowercaseString;
+        if (dictNameToItem[lowerName] == nil)
+        {
+            dictNameToItem[lowerName] = dict;
+        }
+        if (![setNames containsObject:friendlyName])
+        {
+            [setNames addObject:friendlyName];
+            [arrayUniqueNames addObject:friendlyName];
+        }
+        else
+        {
+            [arrayRedefinedNames addObject:friendlyName];
+        }
+    }
+    self.dictVcToName = [dictVcToName copy];
+    self.dictNameToItem = [dictNameToItem copy];
+    self.arrayUniqueNames = [arrayUniqueNames copy];
+    self.arrayRedefinedNames = [arrayRedefinedNames copy];
+    self.isLoaded = YES;
+}
+
+- (void)loadIfNeeded
+{
+    if (!self.isLoaded)
+    {
+        [self buildIndex:[[NSUserDefaults standardUserDefaults] objectForKey:FRIENDLYNAME_KEY]];
+    }
+}
+
+@end
@@ -17,6 +17,7 @@
 
 #import <Foundation/Foundation.h>
 #import "SHAFHTTPSessionManager.h"
+#import "SHJSONStreamParser.h" //for SHJSONStreamElementHandler
 
 /**
  Current supporting host versions.
@@ -60,6 +61,24 @@ typedef enum SHHostVersion SHHostVersion;
                                success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success
                                failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure;
 
+/**
+ Wrapper for `SHAFHTTPSessionManager` Get method for large response, such as geofence tree, iBeacon list and feeds. Response is decoded by `SHJSONStreamParser`, elements of the streamed container are handed to `elementHandler` so caller builds model object directly, the whole JSON tree is not kept in memory. Elements are handed out only after envelope "code" reports success, a failed response fills no model. Dictionary keys with null value are dropped while decoding.
+ @param URLString The path or complete url.
+ @param hostVersion StreetHawk's request has version /v1, /v2 etc.
+ @param parameters Request parameters. For Get request it will append as query string. The type must be NSDictionary as {key: value}.
+ @param streamKey The key of top level dictionary to be streamed, for example "value" for {code: 0, value: [...]}. If nil, the top level container is streamed.
+ @param elementHandler Called for each element of streamed container right before `success`, in completion queue. Not called if request fails.
+ @param success Success callback. `responseObject` does not contain streamed elements.
+ @param failure Failure callback.
+ */
+- (nullable NSURLSessionDataTask *)GET:(nonnull NSString *)URLString
+                           hostVersion:(SHHostVersion)hostVersion
+                            parameters:(nullable NSDictionary *)parameters
+                             streamKey:(nullable NSString *)streamKey
+                        elementHandler:(nonnull SHJSONStreamElementHandler)elementHandler
+                               success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success
+                               failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure;
+
 /**
  Wrapper for `SHAFHTTPSessionManager` POST method for post json.
  @param URLString The path or complete url.
@@ -102,6 +121,24 @@ typedef enum SHHostVersion SHHostVersion;
                                   success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success
                                   failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure;
 
+/**
+ Send request with additional headers, such as "X-Idempotency-Key" used by `SHRequestOutbox`. Same as GET/POST wrappers except headers are only set to this request, not to shared request serializer.
+ @param method HTTP method, such as "GET", "POST".
+ @param URLString The path or complete url.
+ @param hostVersion StreetHawk's request has version /v1, /v2 etc.
+ @param parameters Request parameters. For GET it appends as query string, for POST it goes to body.
+ @param headers Additional headers for this request only.
+ @param success Success callback.
+ @param failure Failure callback.
+ */
+- (nullable NSURLSessionDataTask *)requestMethod:(nonnull NSString *)method
+                                       URLString:(nonnull NSString *)URLString
+                                     hostVersion:(SHHostVersion)hostVersion
+                                      parameters:(nullable NSDictionary *)parameters
+                                         headers:(nullable NSDictionary *)headers
+                                         success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success
+                                         failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure;
+
 @end
 
 /**
@@ -20,12 +20,18 @@
 #import "SHApp.h" //for `StreetHawk` properties
 #import "SHAppStatus.h" //for alive host
 #import "SHUtils.h" //for shStrIsEmpty
+#import "SHNetworkQuality.h" //for per-request timeout
+#import "SHRequestScheduler.h" //for task priority
+#import "SHEndpointContext.h" //for base url and headers
+#import "SHHostHealth.h" //for host health tracking
 
 //Json return type: {code: 0, value: ...}, 0 for successful, other for fail.
 #define CODE_OK     0
 
 @interface SHHTTPSessionManager ()
 
++ (SHHTTPSessionManager *)streamInstance; //session manager which does not decode response, used by stream GET. It shares request serializer and completion queue with `sharedInstance`.
+- (NSURLRequest *)requestWithEndpointContext:(NSURLRequest *)request; //copy request with SDK headers from endpoint context (only for StreetHawk hosts) and timeout from network quality, not change shared request serializer which is used by concurrent requests.
 - (NSString *)completeStreetHawkSpecialUrl:(NSString *)urlString withHostVersion:(SHHostVersion)hostVersion; //StreetHawk can change base url on-fly, and has version as /v1, /v2, and must have additional header and "installid" in query string.
 - (void)processSuccessCallback:(NSURLSessionDataTask * _Nonnull)task withData:(id _Nullable)responseObject success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure; //process request successful callback.
 - (void)processFailureCallback:(NSURLSessionDataTask * _Nonnull)task withError:(NSError * _Nullable)error failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure; //process request failure callback.
@@ -45,26 +51,33 @@
         sharedHTTPSessionManager = [[SHHTTPSessionManager alloc]
                                     initWithSessionConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
         sharedHTTPSessionManager.completionQueue = dispatch_queue_create("com.streethawk.StreetHawk.network", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/); //set completionQueue otherwise completion callback runs in main thread.
-        //add header
-        [sharedHTTPSessionManager.requestSerializer setValue:[NSString stringWithFormat:@"%@(%@)", StreetHawk.appKey, StreetHawk.version]
-                                          forHTTPHeaderField:@"User-Agent"]; //e.g: "SHSample(1.5.3)"
-        [sharedHTTPSessionManager.requestSerializer setValue:NONULL(StreetHawk.appKey)
-                                          forHTTPHeaderField:@"X-App-Key"];
-        [sharedHTTPSessionManager.requestSerializer setValue:StreetHawk.version
-                                          forHTTPHeaderField:@"X-Version"];
-        [sharedHTTPSessionManager.requestSerializer setValue:!shStrIsEmpty(StreetHawk.currentInstall.suid) ? StreetHawk.currentInstall.suid : @"null"
-                                          forHTTPHeaderField:@"X-Installid"];
-        //Add install token for /v3 request. Cannot check host version here, add to all requests.
-        NSString *installToken = [[NSUserDefaults standardUserDefaults] objectForKey:SH_INSTALL_TOKEN];
-        if (!shStrIsEmpty(installToken))
-        {
-            [sharedHTTPSessionManager.requestSerializer setValue:installToken forHTTPHeaderField:@"X-Install-Token"];
-        }
+        [SHNetworkQuality sharedInstance]; //start to observe requests before the first one.
+        [SHRequestScheduler sharedInstance];
+        [SHHostHealth sharedInstance];
+        //Headers are not set on request serializer, each request gets them from `SHEndpointContext` in `requestWithEndpointContext:`.
     });
     //By default it uses HTTP request and JSON response serializer.
     return sharedHTTPSessionManager;
 }
 
++ (SHHTTPSessionManager *)streamInstance
+{
+    static SHHTTPSessionManager *streamHTTPSessionManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        SHHTTPSessionManager *sharedManager = [SHHTTPSessionManager sharedInstance];
+        streamHTTPSessionManager = [[SHHTTPSessionManager alloc]
+                                    initWithSessionConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
+        streamHTTPSessionManager.completionQueue = sharedManager.completionQueue; //same serial queue so app_status is processed in order with other requests.
+        streamHTTPSessionManager.requestSerializer = sharedManager.requestSerializer; //share serializer settings, SDK headers are added per request from endpoint context.
+        SHAFHTTPResponseSerializer *rawSerializer = [SHAFHTTPResponseSerializer serializer]; //keep raw data, decode by SHJSONStreamParser.
+        rawSerializer.acceptableContentTypes = sharedManager.responseSerializer.acceptableContentTypes;
+        streamHTTPSessionManager.responseSerializer = rawSerializer;
+    });
+    return streamHTTPSessionManager;
+}
+
 #pragma mark - override functions
 
 - (nullable NSURLSessionDataTask *)GET:(nonnull NSString *)URLString
@@ -92,6 +105,74 @@
     return task;
 }
 
+- (nullable NSURLSessionDataTask *)GET:(nonnull NSString *)URLString
+                           hostVersion:(SHHostVersion)hostVersion
+                            parameters:(nullable NSDictionary *)parameters
+                             streamKey:(nullable NSString *)streamKey
+                        elementHandler:(nonnull SHJSONStreamElementHandler)elementHandler
+                               success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success
+                               failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure
+{
+    URLString = [self completeStreetHawkSpecialUrl:URLString withHostVersion:hostVersion];
+    elementHandler = [elementHandler copy];
+    NSURLSessionDataTask *task = [[SHHTTPSessionManager streamInstance] GET:URLString
+                                                                 parameters:parameters /*append as query string*/
+                                                                   progress:nil
+                                                                    success:^(NSURLSessionDataTask * _Nonnull task, id  _Nullable responseObject) {
+                                                                        id decodeObject = responseObject;
+                                                                        NSMutableArray *arrayKeys = [NSMutableArray array]; //streamed elements wait for envelope check, NSNull for element of array.
+                                                                        NSMutableArray *arrayElements = [NSMutableArray array];
+                                                                        if ([responseObject isKindOfClass:[NSData class]])
+                                                                        {
+                                                                            NSData *data = (NSData *)responseObject;
+                                                                            if ([task.response.MIMEType compare:@"text/plain" options:NSCaseInsensitiveSearch] == NSOrderedSame)
+                                                                            {
+                                                                                decodeObject = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+                                                                            }
+                                                                            else
+                                                                            {
+                                                                                CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+                                                                                __block NSUInteger elementCount = 0;
+                                                                                NSError *decodeError = nil;
+                                                                                decodeObject = [SHJSONStreamParser parseData:data streamKey:streamKey elementHandler:^(NSString * _Nullable key, id  _Nonnull element) {
+                                                                                    elementCount++;
+                                                                                    [arrayKeys addObject:(key != nil) ? key : [NSNull null]];
+                                                                                    [arrayElements addObject:element];
+                                                                                } error:&decodeError];
+                                                                                if (decodeError != nil)
+                                                                                {
+                                                                                    [self processFailureCallback:task
+                                                                                                       withError:decodeError
+                                                                                                         failure:failure];
+                                                                                    return;
+                                                                                }
+                                                                                SHLog(@"Stream decode %lu bytes into %lu elements in %.3f seconds.", (unsigned long)data.length, (unsigned long)elementCount, CFAbsoluteTimeGetCurrent() - startTime);
+                                                                            }
+                                                                        }
+                                                                        //Elements only apply when envelope "code" is OK, same as parsing whole response and then checking it.
+                                                                        [self processSuccessCallback:task
+                                                                                            withData:decodeObject
+                                                                                             success:^(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject) {
+                                                                                                 for (NSUInteger i = 0; i < arrayElements.count; i++)
+                                                                                                 {
+                                                                                                     elementHandler((arrayKeys[i] != [NSNull null]) ? arrayKeys[i] : nil, arrayElements[i]);
+                                                                                                 }
+                                                                                                 if (success)
+                                                                                                 {
+                                                                                                     success(task, responseObject);
+                                                                                                 }
+                                                                                             }
+                                                                                             failure:failure];
+                                                                    }
+                                                                    failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nonnull error) {
+                                                                        [self processFailureCallback:task
+                                                                                           withError:error
+                                                                                             failure:failure];
+                                                                    }];
+    SHLog(@"GET - %@", task.currentRequest.URL.absoluteString);
+    return task;
+}
+
 - (nullable NSURLSessionDataTask *)POST:(nonnull NSString *)URLString
                             hostVersion:(SHHostVersion)hostVersion
                                    body:(nullable NSDictionary *)body
@@ -167,56 +248,135 @@
     return task;
 }
 
+- (nullable NSURLSessionDataTask *)requestMethod:(nonnull NSString *)method
+                                       URLString:(nonnull NSString *)URLString
+                                     hostVersion:(SHHostVersion)hostVersion
+                                      parameters:(nullable NSDictionary *)parameters
+                                         headers:(nullable NSDictionary *)headers
+                                         success:(nullable void (^)(NSURLSessionDataTask * _Nullable task, id _Nullable responseObject))success
+                                         failure:(nullable void (^)(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error))failure
+{
+    URLString = [self completeStreetHawkSpecialUrl:URLString withHostVersion:hostVersion];
+    NSError *serializationError = nil;
+    NSMutableURLRequest *request = [self.requestSerializer requestWithMethod:method URLString:URLString parameters:parameters error:&serializationError];
+    if (serializationError != nil)
+    {
+        if (failure)
+        {
+            dispatch_async(self.completionQueue ?: dispatch_get_main_queue(), ^{
+                failure(nil, serializationError);
+            });
+        }
+        return nil;
+    }
+    [headers enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop)
+    {
+        [request setValue:value forHTTPHeaderField:key];
+    }];
+    __block NSURLSessionDataTask *task = [self dataTaskWithRequest:request
+                                                    uploadProgress:nil
+                                                  downloadProgress:nil
+                                                 completionHandler:^(NSURLResponse * _Nonnull response, id  _Nullable responseObject, NSError * _Nullable error) {
+                                                     if (error != nil)
+                                                     {
+                                                         [self processFailureCallback:task
+                                                                            withError:error
+                                                                              failure:failure];
+                                                     }
+                                                     else
+                                                     {
+                                                         [self processSuccessCallback:task
+                                                                             withData:responseObject
+                                                                              success:success
+                                                                              failure:failure];
+                                                     }
+                                                 }];
+    [task resume];
+    SHLog(@"%@ - %@", method, task.currentRequest.URL.absoluteString);
+    return task;
+}
+
+- (NSURLSessionDataTask *)dataTaskWithRequest:(NSURLRequest *)request
+                               uploadProgress:(nullable void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                             downloadProgress:(nullable void (^)(NSProgress *downloadProgress))downloadProgressBlock
+                            completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject,  NSError * _Nullable error))completionHandler
+{
+    //All GET/POST/DELETE wrappers go through here.
+    NSURLSessionDataTask *task = [super dataTaskWithRequest:[self requestWithEndpointContext:request]
+                                             uploadProgress:uploadProgressBlock
+                                           downloadProgress:downloadProgressBlock
+                                          completionHandler:completionHandler];
+    task.priority = [SHRequestScheduler taskPriorityForPriority:[SHRequestScheduler priorityForURL:request.URL]];
+    return task;
+}
+
+- (NSURLSessionUploadTask *)uploadTaskWithStreamedRequest:(NSURLRequest *)request
+                                                 progress:(nullable void (^)(NSProgress *uploadProgress))uploadProgressBlock
+                                        completionHandler:(nullable void (^)(NSURLResponse *response, id _Nullable responseObject, NSError * _Nullable error))completionHandler
+{
+    //Multipart POST goes through here.
+    NSURLSessionUploadTask *task = [super uploadTaskWithStreamedRequest:[self requestWithEndpointContext:request]
+                                                               progress:uploadProgressBlock
+                                                      completionHandler:completionHandler];
+    task.priority = [SHRequestScheduler taskPriorityForPriority:[SHRequestScheduler priorityForURL:request.URL]];
+    return task;
+}
+
 #pragma mark - private functions
 
+- (NSURLRequest *)requestWithEndpointContext:(NSURLRequest *)request
+{
+    NSMutableURLRequest *preparedRequest = [request mutableCopy];
+    [[[SHEndpointContext currentContext] headersForURL:request.URL] enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop)
+    {
+        [preparedRequest setValue:value forHTTPHeaderField:key]; //override serializer's default "User-Agent"
+    }];
+    preparedRequest.timeoutInterval = [[SHNetworkQuality sharedInstance] timeoutForRequest:request];
+    return preparedRequest;
+}
+
 - (NSString *)completeStreetHawkSpecialUrl:(NSString *)urlString withHostVersion:(SHHostVersion)hostVersion
 {
-    NSMutableString *completeUrl = [NSMutableString string];
     if (urlString != nil && ([urlString.lowercaseString hasPrefix:@"http://"] || [urlString.lowercaseString hasPrefix:@"https://"]))
     {
-        [completeUrl appendString:urlString]; //urlString is just the complete url
+        return urlString; //urlString is just the complete url
     }
-    else //this case is special for StreetHawk server requirement
+    //this case is special for StreetHawk server requirement, base url and query are prepared in context, only append path.
+    SHEndpointContext *context = [SHEndpointContext currentContext];
+    NSString *baseUrl = [context baseUrlForVersion:hostVersion];
+    NSAssert(!shStrIsEmpty(baseUrl), @"No host base URL.");
+    NSUInteger pathStart = 0;
+    NSUInteger pathEnd = urlString.length;
+    if (pathEnd > 0 && [urlString characterAtIndex:0] == '/')
     {
-        //base url
-        NSString *hostUrl = [[SHAppStatus sharedInstance] aliveHostForVersion:hostVersion];
-        NSAssert(!shStrIsEmpty(hostUrl), @"No host base URL.");
-        [completeUrl appendString:hostUrl];
-        //adding path
-        if (!shStrIsEmpty(urlString))
-        {
-            if ([completeUrl hasSuffix:@"/"])
-            {
-                [completeUrl deleteCharactersInRange:NSMakeRange(completeUrl.length-1, 1)]; //remove last "/"
-            }
-            if ([urlString characterAtIndex:0] == '/')
-            {
-                urlString = [urlString substringFromIndex:1];  //remove first "/"
-            }
-            if ([urlString hasSuffix:@"/"])  //remove last "/", recent change in StreetHawk server requires NOT have "/" at path end.
-            {
-                urlString = [urlString substringToIndex:urlString.length - 1];
-            }
-            [completeUrl appendFormat:@"/%@", urlString];
-        }
-        //add "installid"
-        NSAssert([completeUrl rangeOfString:@"?"].location == NSNotFound, @"Query should not contained.");
-        if (!shStrIsEmpty(StreetHawk.currentInstall.suid))
-        {
-            [completeUrl appendFormat:@"?installid=%@", StreetHawk.currentInstall.suid];
-        }
+        pathStart = 1; //remove first "/"
     }
-    //Background fetch must be finished in 30 seconds, however when testing found `[UIApplication sharedApplication].backgroundTimeRemaining` sometimes is more than 30 seconds, for example if just enter background it's 180 seconds, if start background task it's 10 minutes. Thus cannot depend on `[UIApplication sharedApplication].backgroundTimeRemaining` to calculate timeout.
-    //To be safe and simple, if in background, timeout is 13 seconds(sometimes heartbeat follow by location update), if in foreground, timeout is 60 seconds.
-    [self.requestSerializer setTimeoutInterval:([UIApplication sharedApplication].applicationState == UIApplicationStateBackground) ? 13 : 60];
+    if (pathEnd > pathStart && [urlString characterAtIndex:pathEnd - 1] == '/')
+    {
+        pathEnd--; //remove last "/", recent change in StreetHawk server requires NOT have "/" at path end.
+    }
+    NSAssert([urlString rangeOfString:@"?"].location == NSNotFound, @"Query should not contained.");
+    NSMutableString *completeUrl = [NSMutableString stringWithCapacity:baseUrl.length + (pathEnd - pathStart) + context.installQuery.length];
+    if (pathEnd > pathStart)
+    {
+        [completeUrl appendString:NONULL(baseUrl)];
+        [completeUrl appendString:[urlString substringWithRange:NSMakeRange(pathStart, pathEnd - pathStart)]];
+    }
+    else
+    {
+        [completeUrl appendString:[NONULL(baseUrl) substringToIndex:MAX(1, baseUrl.length) - 1]]; //no path, not end with "/" same as before
+    }
+    [completeUrl appendString:context.installQuery];
+    //Timeout and headers are not set here on the shared request serializer, each request gets its own by `requestWithEndpointContext:`.
     return completeUrl;
 }
 
 - (void)processSuccessCallback:(NSURLSessionDataTask *)task withData:(id)responseObject success:(void (^)(NSURLSessionDataTask * _Nullable, id _Nullable))success failure:(void (^)(NSURLSessionDataTask * _Nullable, NSError * _Nullable))failure
 {
     NSAssert(![NSThread isMainThread], @"Successful callback wait in main thread for request %@.", task.currentRequest);
-    if ([task.response.URL.absoluteString.lowercaseString containsString:@".streethawk.com"] //since route host server is flexible to change
-        && ![task.response.URL.absoluteString.lowercaseString hasPrefix:NONULL([SHAppStatus sharedInstance].growthHost)] //growth is an exception
+    BOOL isStandinHost = !shStrIsEmpty(StreetHawk.hostOverride) && [task.response.URL.absoluteString.lowercaseString hasPrefix:StreetHawk.hostOverride.lowercaseString]; //testing stand-in server follows StreetHawk format
+    if (([task.response.URL.absoluteString.lowercaseString containsString:@".streethawk.com"] || isStandinHost) //since route host server is flexible to change
+        && ![task.response.URL.absoluteString.lowercaseString hasPrefix:NONULL([SHAppStatus sharedInstance].growthHost).lowercaseString] //growth is an exception
         && ![task.response.URL.absoluteString.lowercaseString containsString:@"/v3"]) //v3 endpoint doesn't have code-value format
     {
         //whenever success process a request, do parser as it affects AppStatus.
@@ -257,75 +417,16 @@
                 }
                 if (dictStatus != nil)
                 {
-                    //check "streethawk" to enable/disable library function
-                    if ([dictStatus.allKeys containsObject:@"streethawk"] && [dictStatus[@"streethawk"] respondsToSelector:@selector(boolValue)])
-                    {
-                        [SHAppStatus sharedInstance].streethawkEnabled = [NONULL(dictStatus[@"streethawk"]) boolValue];
-                    }
-                    //check "host"
-                    if ([dictStatus.allKeys containsObject:@"host"] && [dictStatus[@"host"] isKindOfClass:[NSString class]])
-                    {
-                        [SHAppStatus sharedInstance].aliveHost = NONULL(dictStatus[@"host"]);
-                    }
-                    //check "growth_host"
-                    if ([dictStatus.allKeys containsObject:@"growth_host"] && [dictStatus[@"growth_host"] isKindOfClass:[NSString class]])
-                    {
-                        [SHAppStatus sharedInstance].growthHost = NONULL(dictStatus[@"growth_host"]);
-                    }
-                    //check "location_updates"
-                    if ([dictStatus.allKeys containsObject:@"location_updates"] && [dictStatus[@"location_updates"] respondsToSelector:@selector(boolValue)])
-                    {
-                        [SHAppStatus sharedInstance].uploadLocationChange = [NONULL(dictStatus[@"location_updates"]) boolValue];
-                    }
-                    //check "submit_views"
-                    if ([dictStatus.allKeys containsObject:@"submit_views"] && [dictStatus[@"submit_views"] respondsToSelector:@selector(boolValue)])
-                    {
-                        [SHAppStatus sharedInstance].allowSubmitFriendlyNames = [NONULL(dictStatus[@"submit_views"]) boolValue];
-                    }
-                    if ([dictStatus.allKeys containsObject:@"submit_interactive_button"] && [dictStatus[@"submit_interactive_button"] respondsToSelector:@selector(boolValue)])
-                    {
-                        [SHAppStatus sharedInstance].allowSubmitInteractiveButton = [NONULL(dictStatus[@"submit_interactive_button"]) boolValue];
-                    }
-                    //check "ibeacon"
-                    if ([dictStatus.allKeys containsObject:@"ibeacon"])
-                    {
-                        [SHAppStatus sharedInstance].iBeaconTimestamp = NONULL(dictStatus[@"ibeacon"]); //it may be nil
-                    }
-                    //check "geofences"
-                    if ([dictStatus.allKeys containsObject:@"geofences"])
-                    {
-                        [SHAppStatus sharedInstance].geofenceTimestamp = NONULL(dictStatus[@"geofences"]);
-                    }
-                    //check "feed_updated"
-                    if ([dictStatus.allKeys containsObject:@"feed_updated"])
-                    {
-                        SHLog(@"feed timestamp in app_status: %@", dictStatus[@"feed_updated"]);
-                        [SHAppStatus sharedInstance].feedTimestamp = NONULL(dictStatus[@"feed_updated"]);
-                    }
-                    //check "reregister"
-                    if ([dictStatus.allKeys containsObject:@"reregister"])
-                    {
-                        [SHAppStatus sharedInstance].reregister = [NONULL(dictStatus[@"reregister"]) boolValue];
-                    }
-                    //check "app_store_id"
-                    if ([dictStatus.allKeys containsObject:@"app_store_id"])
-                    {
-                        [SHAppStatus sharedInstance].appstoreId = NONULL(dictStatus[@"app_store_id"]);
-                    }
-                    //check "disable_logs"
-                    if ([dictStatus.allKeys containsObject:@"disable_logs"])
-                    {
-                        [SHAppStatus sharedInstance].logDisableCodes = NONULL(dictStatus[@"disable_logs"]); //directly pass nil
-                    }
-                    //check "priority"
-                    if ([dictStatus.allKeys containsObject:@"priority"])
+                    //most responses carry same status, only dispatch changed keys so modules are not woken up for nothing.
+                    NSDictionary *dictChanged = [[SHAppStatus sharedInstance] changedKeysOfAppStatus:dictStatus];
+                    if (dictChanged.count > 0)
                     {
-                        [SHAppStatus sharedInstance].logPriorityCodes = NONULL(dictStatus[@"priority"]);
+                        [[SHAppStatus sharedInstance] applyAppStatus:dictChanged]; //apply as a whole into one new snapshot
+                        [[NSNotificationCenter defaultCenter]
+                         postNotificationName:@"SH_PointziBridge_AppStatus_Notification"
+                         object:nil
+                         userInfo:@{@"appstatus": dictStatus}];
                     }
-                    [[NSNotificationCenter defaultCenter]
-                     postNotificationName:@"SH_PointziBridge_AppStatus_Notification"
-                     object:nil
-                     userInfo:@{@"appstatus": dictStatus}];
                     //refresh app_status check time
                     [[SHAppStatus sharedInstance] recordCheckTime];
                 }
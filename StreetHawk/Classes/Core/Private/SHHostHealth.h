@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ Notification sent when a host's circuit opens, closes or becomes half-open. Its user info has "host" as the host key, read `[SHHostHealth sharedInstance]` to get current situation. It's posted in main thread.
+ */
+extern NSString * const SHHostHealthChangeNotification;
+
+/**
+ Circuit state of a host.
+ */
+enum SHHostCircuitState
+{
+    /**
+     Host works normally, requests go to it.
+     */
+    SHHostCircuitState_Closed,
+    /**
+     Host failed continuously, requests should go to another host until cool down ends.
+     */
+    SHHostCircuitState_Open,
+    /**
+     Cool down ends, let requests go to the host again to probe. One failure opens it again with longer cool down, one success closes it.
+     */
+    SHHostCircuitState_HalfOpen,
+};
+typedef enum SHHostCircuitState SHHostCircuitState;
+
+/**
+ Track health of each host the SDK talks to, so a degraded host is avoided instead of every request waiting for a full timeout.
+
+ It observes SDK tasks and keeps a moving average of success and latency for each host. Transport failures (timeout, cannot connect, TLS failure) and 5xx responses count as failure; offline or cancelled requests are not the host's fault and not counted. Several continuous failures open the circuit for a cool down which doubles each time it opens again.
+ */
+@interface SHHostHealth : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. It starts to observe SDK tasks when created.
+ */
++ (SHHostHealth *)sharedInstance;
+
+/** @name Functions */
+
+/**
+ Whether requests can go to this host now, i.e. its circuit is not open.
+ @param hostUrl Url of the host, path is ignored, for example @"https://api.streethawk.com".
+ @return YES if closed or half-open, or host is never seen.
+ */
+- (BOOL)isHostAvailable:(NSString *)hostUrl;
+
+/**
+ Circuit state of the host.
+ @param hostUrl Url of the host, path is ignored.
+ @return Circuit state, `SHHostCircuitState_Closed` if host is never seen.
+ */
+- (SHHostCircuitState)circuitStateForHost:(NSString *)hostUrl;
+
+/**
+ Moving average of success ratio of the host.
+ @param hostUrl Url of the host, path is ignored.
+ @return Value in [0, 1], 1 if host is never seen.
+ */
+- (double)successRateForHost:(NSString *)hostUrl;
+
+/**
+ Moving average of request time of the host, in seconds.
+ @param hostUrl Url of the host, path is ignored.
+ @return Seconds, 0 if host is never seen.
+ */
+- (NSTimeInterval)latencyForHost:(NSString *)hostUrl;
+
+/**
+ Send a light `HEAD` request to the host root, so TCP and TLS connection is ready in session pool before real requests, and the result is also a probe of host health.
+ @param hostUrl Url of the host, path is ignored.
+ */
+- (void)preconnectHost:(NSString *)hostUrl;
+
+@end
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHHostHealth.h"
+//header from StreetHawk
+#import "SHUtils.h" //for SHLog
+#import "SHHTTPSessionManager.h" //for preconnect request
+#import "SHAFURLSessionManager.h" //for task resume and complete notification
+
+#define HEALTH_SMOOTH_FACTOR        0.2 //weight of new sample in moving average.
+#define HEALTH_FAILURES_TO_OPEN     3 //continuous failures to open circuit.
+#define HEALTH_COOLDOWN_BASE        30 //seconds of first open, doubles for each re-open.
+#define HEALTH_COOLDOWN_MAX         (10 * 60)
+
+NSString * const SHHostHealthChangeNotification = @"SHHostHealthChangeNotification";
+
+/**
+ Health state of one host, only accessed in `healthQueue`.
+ */
+@interface SHHostHealthRecord : NSObject
+
+@property (nonatomic) double successRate;
+@property (nonatomic) NSTimeInterval latency;
+@property (nonatomic) NSInteger continuousFailures;
+@property (nonatomic) NSInteger openCount; //times opened since last close, decides cool down.
+@property (nonatomic) SHHostCircuitState state;
+@property (nonatomic, strong) NSDate *openUntil;
+
+@end
+
+@implementation SHHostHealthRecord
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.successRate = 1;
+        self.latency = 0;
+        self.continuousFailures = 0;
+        self.openCount = 0;
+        self.state = SHHostCircuitState_Closed;
+        self.openUntil = nil;
+    }
+    return self;
+}
+
+@end
+
+@interface SHHostHealth ()
+
+@property (nonatomic, strong) dispatch_queue_t healthQueue; //all state accessed in this serial queue.
+@property (nonatomic, strong) NSMutableDictionary *dictRecords; //host key -> SHHostHealthRecord.
+@property (nonatomic, strong) NSMapTable *mapStartTime; //task -> resume time, weak key so finished task is not held.
+
++ (NSString *)hostKeyForUrl:(NSURL *)url; //lower case "scheme://host:port", nil if not http url.
++ (BOOL)isHostFailure:(NSError *)error response:(NSURLResponse *)response; //whether the result tells host is unhealthy.
+- (void)taskDidResume:(NSNotification *)notification; //record start time of SDK request.
+- (void)taskDidComplete:(NSNotification *)notification; //add a sample from finished SDK request.
+- (void)addSampleForHost:(NSString *)hostKey isFailure:(BOOL)isFailure duration:(NSTimeInterval)duration; //update record and circuit, must call in `healthQueue`.
+- (SHHostHealthRecord *)recordForHost:(NSString *)hostKey; //refresh open circuit whose cool down ends, must call in `healthQueue`.
+- (void)postChangeForHost:(NSString *)hostKey;
+
+@end
+
+@implementation SHHostHealth
+
+#pragma mark - life cycle
+
++ (SHHostHealth *)sharedInstance
+{
+    static SHHostHealth *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHHostHealth alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.healthQueue = dispatch_queue_create("com.streethawk.StreetHawk.hosthealth", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/);
+        self.dictRecords = [NSMutableDictionary dictionary];
+        self.mapStartTime = [NSMapTable weakToStrongObjectsMapTable];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(taskDidResume:) name:SHAFNetworkingTaskDidResumeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(taskDidComplete:) name:SHAFNetworkingTaskDidCompleteNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - public functions
+
+- (BOOL)isHostAvailable:(NSString *)hostUrl
+{
+    return ([self circuitStateForHost:hostUrl] != SHHostCircuitState_Open);
+}
+
+- (SHHostCircuitState)circuitStateForHost:(NSString *)hostUrl
+{
+    NSString *hostKey = [SHHostHealth hostKeyForUrl:[NSURL URLWithString:NONULL(hostUrl)]];
+    if (hostKey == nil)
+    {
+        return SHHostCircuitState_Closed;
+    }
+    __block SHHostCircuitState state;
+    dispatch_sync(self.healthQueue, ^
+    {
+        state = [self recordForHost:hostKey].state;
+    });
+    return state;
+}
+
+- (double)successRateForHost:(NSString *)hostUrl
+{
+    NSString *hostKey = [SHHostHealth hostKeyForUrl:[NSURL URLWithString:NONULL(hostUrl)]];
+    if (hostKey == nil)
+    {
+        return 1;
+    }
+    __block double successRate;
+    dispatch_sync(self.healthQueue, ^
+    {
+        successRate = [self recordForHost:hostKey].successRate;
+    });
+    return successRate;
+}
+
+- (NSTimeInterval)latencyForHost:(NSString *)hostUrl
+{
+    NSString *hostKey = [SHHostHealth hostKeyForUrl:[NSURL URLWithString:NONULL(hostUrl)]];
+    if (hostKey == nil)
+    {
+        return 0;
+    }
+    __block NSTimeInterval latency;
+    dispatch_sync(self.healthQueue, ^
+    {
+        latency = [self recordForHost:hostKey].latency;
+    });
+    return latency;
+}
+
+- (void)preconnectHost:(NSString *)hostUrl
+{
+    NSURL *url = [NSURL URLWithString:NONULL(hostUrl)];
+    NSString *hostKey = [SHHostHealth hostKeyForUrl:url];
+    if (hostKey == nil)
+    {
+        return;
+    }
+    //HEAD of root has no body, any HTTP status means connection is ready; success or failure is counted by `taskDidComplete:`.
+    [[SHHTTPSessionManager sharedInstance] HEAD:[hostKey stringByAppendingString:@"/"] parameters:nil success:nil failure:nil];
+}
+
+#pragma mark - private functions
+
++ (NSString *)hostKeyForUrl:(NSURL *)url
+{
+    NSString *scheme = url.scheme.lowercaseString;
+    if (shStrIsEmpty(url.host) || !([scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"]))
+    {
+        return nil;
+    }
+    NSInteger port = (url.port != nil) ? url.port.integerValue : ([scheme isEqualToString:@"https"] ? 443 : 80);
+    return [NSString stringWithFormat:@"%@://%@:%ld", scheme, url.host.lowercaseString, (long)port];
+}
+
++ (BOOL)isHostFailure:(NSError *)error response:(NSURLResponse *)response
+{
+    if ([response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        return (((NSHTTPURLResponse *)response).statusCode >= 500); //4xx is caller's problem, host is alive.
+    }
+    if (![error.domain isEqualToString:NSURLErrorDomain])
+    {
+        return NO;
+    }
+    switch (error.code)
+    {
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorSecureConnectionFailed:
+        case NSURLErrorBadServerResponse:
+            return YES;
+        default:
+            return NO; //cancelled, offline etc, not host's fault.
+    }
+}
+
+- (void)taskDidResume:(NSNotification *)notification
+{
+    NSURLSessionTask *task = notification.object;
+    if (![task isKindOfClass:[NSURLSessionTask class]])
+    {
+        return;
+    }
+    NSDate *startTime = [NSDate date];
+    dispatch_async(self.healthQueue, ^
+    {
+        [self.mapStartTime setObject:startTime forKey:task];
+    });
+}
+
+- (void)taskDidComplete:(NSNotification *)notification
+{
+    NSURLSessionTask *task = notification.object;
+    if (![task isKindOfClass:[NSURLSessionTask class]])
+    {
+        return;
+    }
+    NSString *hostKey = [SHHostHealth hostKeyForUrl:task.originalRequest.URL];
+    if (hostKey == nil)
+    {
+        return;
+    }
+    NSError *error = notification.userInfo[SHAFNetworkingTaskDidCompleteErrorKey];
+    NSURLResponse *response = task.response;
+    BOOL isFailure = [SHHostHealth isHostFailure:error response:response];
+    if (error != nil && !isFailure && ![response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        return; //cancelled or offline, nothing about the host.
+    }
+    NSDate *endTime = [NSDate date];
+    dispatch_async(self.healthQueue, ^
+    {
+        NSDate *startTime = [self.mapStartTime objectForKey:task];
+        [self.mapStartTime removeObjectForKey:task];
+        NSTimeInterval duration = (startTime != nil) ? [endTime timeIntervalSinceDate:startTime] : 0;
+        [self addSampleForHost:hostKey isFailure:isFailure duration:duration];
+    });
+}
+
+- (void)addSampleForHost:(NSString *)hostKey isFailure:(BOOL)isFailure duration:(NSTimeInterval)duration
+{
+    SHHostHealthRecord *record = [self recordForHost:hostKey];
+    record.successRate = (1 - HEALTH_SMOOTH_FACTOR) * record.successRate + HEALTH_SMOOTH_FACTOR * (isFailure ? 0 : 1);
+    if (duration > 0)
+    {
+        record.latency = (record.latency <= 0) ? duration : (1 - HEALTH_SMOOTH_FACTOR) * record.latency + HEALTH_SMOOTH_FACTOR * duration;
+    }
+    if (!isFailure)
+    {
+        record.continuousFailures = 0;
+        if (record.state != SHHostCircuitState_Closed)
+        {
+            SHLog(@"Host %@ recovers, close circuit.", hostKey);
+            record.state = SHHostCircuitState_Closed;
+            record.openCount = 0;
+            record.openUntil = nil;
+            [self postChangeForHost:hostKey];
+        }
+        return;
+    }
+    record.continuousFailures++;
+    //half-open probe fails, or closed host fails continuously. Failures landing while already open are requests sent before opening.
+    if (record.state == SHHostCircuitState_HalfOpen || (record.state == SHHostCircuitState_Closed && record.continuousFailures >= HEALTH_FAILURES_TO_OPEN))
+    {
+        NSTimeInterval cooldown = MIN(HEALTH_COOLDOWN_MAX, HEALTH_COOLDOWN_BASE * pow(2, record.openCount));
+        record.openCount++;
+        record.state = SHHostCircuitState_Open;
+        record.openUntil = [NSDate dateWithTimeIntervalSinceNow:cooldown];
+        SHLog(@"Host %@ fails %ld times (success rate %.2f), open circuit for %.0f seconds.", hostKey, (long)record.continuousFailures, record.successRate, cooldown);
+        [self postChangeForHost:hostKey];
+        //let requests probe the host again when cool down ends, otherwise nobody asks an open host.
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(cooldown * NSEC_PER_SEC)), self.healthQueue, ^
+        {
+            if ([self recordForHost:hostKey].state == SHHostCircuitState_HalfOpen)
+            {
+                [self postChangeForHost:hostKey];
+            }
+        });
+    }
+}
+
+- (SHHostHealthRecord *)recordForHost:(NSString *)hostKey
+{
+    SHHostHealthRecord *record = self.dictRecords[hostKey];
+    if (record == nil)
+    {
+        record = [[SHHostHealthRecord alloc] init];
+        self.dictRecords[hostKey] = record;
+    }
+    if (record.state == SHHostCircuitState_Open && [record.openUntil timeIntervalSinceNow] <= 0)
+    {
+        record.state = SHHostCircuitState_HalfOpen;
+    }
+    return record;
+}
+
+- (void)postChangeForHost:(NSString *)hostKey
+{
+    //post asynchronously, observer may ask health again and must not wait for `healthQueue` inside it.
+    dispatch_async(dispatch_get_main_queue(), ^
+    {
+        [[NSNotificationCenter defaultCenter] postNotificationName:SHHostHealthChangeNotification object:nil userInfo:@{@"host": hostKey}];
+    });
+}
+
+@end
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#include "SHJSONLexer.h"
+//header from System
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SH_JSON_MAX_NUMBER_LEN  64 //longer number text is not meaningful for double or long long.
+
+static inline int shJSONHexValue(uint8_t ch)
+{
+    if (ch >= '0' && ch <= '9')
+    {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f')
+    {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F')
+    {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+static int shJSONReadHex4(const uint8_t *bytes, size_t *pos, size_t end, uint32_t *value) //read XXXX after "\u", pos stops after it.
+{
+    if (*pos + 4 > end)
+    {
+        return 0;
+    }
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int hex = shJSONHexValue(bytes[*pos + i]);
+        if (hex < 0)
+        {
+            return 0;
+        }
+        result = (result << 4) | (uint32_t)hex;
+    }
+    *pos += 4;
+    *value = result;
+    return 1;
+}
+
+static size_t shJSONWriteUTF8(uint8_t *output, uint32_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        output[0] = (uint8_t)codePoint;
+        return 1;
+    }
+    if (codePoint < 0x800)
+    {
+        output[0] = (uint8_t)(0xC0 | (codePoint >> 6));
+        output[1] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if (codePoint < 0x10000)
+    {
+        output[0] = (uint8_t)(0xE0 | (codePoint >> 12));
+        output[1] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+        output[2] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    output[0] = (uint8_t)(0xF0 | (codePoint >> 18));
+    output[1] = (uint8_t)(0x80 | ((codePoint >> 12) & 0x3F));
+    output[2] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+    output[3] = (uint8_t)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+void shJSONCursorInit(SHJSONCursor *cursor, const uint8_t *bytes, size_t length)
+{
+    cursor->bytes = bytes;
+    cursor->length = length;
+    cursor->pos = 0;
+    cursor->depth = 0;
+    cursor->errorReason = NULL;
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+    {
+        cursor->pos = 3; //skip utf-8 BOM
+    }
+}
+
+void shJSONSkipWhitespace(SHJSONCursor *cursor)
+{
+    while (cursor->pos < cursor->length)
+    {
+        uint8_t ch = cursor->bytes[cursor->pos];
+        if (ch != ' ' && ch != '\n' && ch != '\r' && ch != '\t')
+        {
+            break;
+        }
+        cursor->pos++;
+    }
+}
+
+int shJSONScanString(SHJSONCursor *cursor, size_t *start, size_t *end, int *hasEscape)
+{
+    cursor->pos++; //skip opening quote
+    *start = cursor->pos;
+    *hasEscape = 0;
+    while (cursor->pos < cursor->length)
+    {
+        uint8_t ch = cursor->bytes[cursor->pos];
+        if (ch == '"')
+        {
+            break;
+        }
+        if (ch < 0x20)
+        {
+            cursor->errorReason = "control character in string";
+            return 0;
+        }
+        if (ch == '\\')
+        {
+            *hasEscape = 1;
+            cursor->pos++; //skip escaped character so that \" not end string
+        }
+        cursor->pos++;
+    }
+    if (cursor->pos >= cursor->length)
+    {
+        cursor->errorReason = "unterminated string";
+        return 0;
+    }
+    *end = cursor->pos;
+    cursor->pos++; //skip closing quote
+    return 1;
+}
+
+size_t shJSONUnescapeString(SHJSONCursor *cursor, size_t start, size_t end, uint8_t *output)
+{
+    const uint8_t *bytes = cursor->bytes;
+    size_t pos = start;
+    size_t len = 0;
+    while (pos < end)
+    {
+        if (bytes[pos] != '\\')
+        {
+            size_t runStart = pos;
+            while (pos < end && bytes[pos] != '\\')
+            {
+                pos++;
+            }
+            memcpy(output + len, bytes + runStart, pos - runStart);
+            len += pos - runStart;
+            continue;
+        }
+        pos++; //skip "\"
+        uint8_t escaped = bytes[pos++];
+        switch (escaped)
+        {
+            case '"': case '\\': case '/':
+                output[len++] = escaped;
+                break;
+            case 'b':
+                output[len++] = '\b';
+                break;
+            case 'f':
+                output[len++] = '\f';
+                break;
+            case 'n':
+                output[len++] = '\n';
+                break;
+            case 'r':
+                output[len++] = '\r';
+                break;
+            case 't':
+                output[len++] = '\t';
+                break;
+            case 'u':
+            {
+                uint32_t codePoint = 0;
+                if (!shJSONReadHex4(bytes, &pos, end, &codePoint))
+                {
+                    cursor->errorReason = "invalid \\u escape";
+                    return (size_t)-1;
+                }
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF) //high surrogate, must follow by low surrogate.
+                {
+                    uint32_t low = 0;
+                    size_t lookahead = pos + 2;
+                    if (pos + 2 <= end && bytes[pos] == '\\' && bytes[pos + 1] == 'u' && shJSONReadHex4(bytes, &lookahead, end, &low) && low >= 0xDC00 && low <= 0xDFFF)
+                    {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        pos = lookahead;
+                    }
+                    else
+                    {
+                        codePoint = 0xFFFD; //lone surrogate, same replacement as system decoder.
+                    }
+                }
+                else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+                {
+                    codePoint = 0xFFFD;
+                }
+                len += shJSONWriteUTF8(output + len, codePoint); //at most 4 bytes from 6 or 12 bytes of escape.
+                break;
+            }
+            default:
+                cursor->errorReason = "invalid escape character";
+                return (size_t)-1;
+        }
+    }
+    return len;
+}
+
+SHJSONNumberType shJSONParseNumber(SHJSONCursor *cursor, long long *integerValue, unsigned long long *unsignedValue, double *doubleValue)
+{
+    size_t start = cursor->pos;
+    int isFloat = 0;
+    while (cursor->pos < cursor->length)
+    {
+        uint8_t ch = cursor->bytes[cursor->pos];
+        if (ch == '.' || ch == 'e' || ch == 'E')
+        {
+            isFloat = 1;
+        }
+        else if (!((ch >= '0' && ch <= '9') || ch == '-' || ch == '+'))
+        {
+            break;
+        }
+        cursor->pos++;
+    }
+    size_t len = cursor->pos - start;
+    if (len == 0 || len >= SH_JSON_MAX_NUMBER_LEN)
+    {
+        cursor->errorReason = "invalid number";
+        return SHJSONNumberType_Invalid;
+    }
+    char text[SH_JSON_MAX_NUMBER_LEN];
+    memcpy(text, cursor->bytes + start, len);
+    text[len] = '\0'; //strtod/strtoll need NUL terminated string, JSON bytes are not.
+    char *endPtr = NULL;
+    if (!isFloat)
+    {
+        errno = 0;
+        long long value = strtoll(text, &endPtr, 10);
+        if (endPtr == text + len && errno != ERANGE)
+        {
+            *integerValue = value;
+            return SHJSONNumberType_Integer;
+        }
+        if (endPtr == text + len && text[0] != '-')
+        {
+            errno = 0;
+            unsigned long long uvalue = strtoull(text, &endPtr, 10);
+            if (endPtr == text + len && errno != ERANGE)
+            {
+                *unsignedValue = uvalue;
+                return SHJSONNumberType_Unsigned;
+            }
+        }
+        //fall through to double for too large integer.
+    }
+    double value = strtod(text, &endPtr);
+    if (endPtr != text + len)
+    {
+        cursor->errorReason = "invalid number";
+        return SHJSONNumberType_Invalid;
+    }
+    *doubleValue = value;
+    return SHJSONNumberType_Double;
+}
+
+int shJSONMatchLiteral(SHJSONCursor *cursor, const char *literal, size_t len)
+{
+    if (cursor->pos + len <= cursor->length && memcmp(cursor->bytes + cursor->pos, literal, len) == 0)
+    {
+        cursor->pos += len;
+        return 1;
+    }
+    cursor->errorReason = "invalid literal";
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_JSON_LEXER_H
+#define SH_JSON_LEXER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SH_JSON_MAX_DEPTH       512 //same limit as NSJSONSerialization, avoid stack overflow by malicious deep nesting.
+
+/**
+ Reading position inside JSON bytes. Only plain C types so it can live on stack under ARC, and the lexer builds without Foundation.
+ */
+typedef struct
+{
+    const uint8_t *bytes;
+    size_t length;
+    size_t pos;
+    size_t depth;
+    const char *errorReason; //not NULL means decode fail, stop immediately.
+} SHJSONCursor;
+
+/**
+ Type of number text.
+ */
+enum SHJSONNumberType
+{
+    SHJSONNumberType_Invalid, //not a number, `errorReason` is set.
+    SHJSONNumberType_Integer, //fits in long long.
+    SHJSONNumberType_Unsigned, //positive integer only fits in unsigned long long.
+    SHJSONNumberType_Double, //float text, or integer too large.
+};
+typedef enum SHJSONNumberType SHJSONNumberType;
+
+/**
+ Initialize cursor at start of data, utf-8 BOM is skipped.
+ */
+void shJSONCursorInit(SHJSONCursor *cursor, const uint8_t *bytes, size_t length);
+
+/**
+ Move cursor over JSON whitespace.
+ */
+void shJSONSkipWhitespace(SHJSONCursor *cursor);
+
+/**
+ Find a string, cursor must be at opening quote and stops after closing quote. Content is not decoded.
+ @param start Out parameter, offset of first byte inside quotes.
+ @param end Out parameter, offset of closing quote.
+ @param hasEscape Out parameter, 1 if content has "\" escape and needs `shJSONUnescapeString`.
+ @return 1 if OK, 0 if fail and `errorReason` is set.
+ */
+int shJSONScanString(SHJSONCursor *cursor, size_t *start, size_t *end, int *hasEscape);
+
+/**
+ Decode escapes of string content found by `shJSONScanString` into utf-8. Decoded text is never longer than escaped text, so `output` holding end - start bytes is enough. Lone surrogate becomes U+FFFD, same as system decoder.
+ @return Length of decoded bytes, or (size_t)-1 if fail and `errorReason` is set.
+ */
+size_t shJSONUnescapeString(SHJSONCursor *cursor, size_t start, size_t end, uint8_t *output);
+
+/**
+ Read a number at cursor, cursor stops after it.
+ @param integerValue Out parameter for `SHJSONNumberType_Integer`.
+ @param unsignedValue Out parameter for `SHJSONNumberType_Unsigned`.
+ @param doubleValue Out parameter for `SHJSONNumberType_Double`.
+ @return Type of the number, and which out parameter is set.
+ */
+SHJSONNumberType shJSONParseNumber(SHJSONCursor *cursor, long long *integerValue, unsigned long long *unsignedValue, double *doubleValue);
+
+/**
+ Match literal such as "true" at cursor, cursor stops after it.
+ @return 1 if matched, 0 if not and `errorReason` is set.
+ */
+int shJSONMatchLiteral(SHJSONCursor *cursor, const char *literal, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
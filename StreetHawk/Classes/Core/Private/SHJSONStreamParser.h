@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ Handler called for each element of a streamed container.
+ @param key If streamed container is a dictionary, it's the key of this element; if streamed container is an array, it's nil.
+ @param element The decoded element. It's never `NSNull`, null elements are skipped.
+ */
+typedef void (^SHJSONStreamElementHandler)(NSString * _Nullable key, id _Nonnull element);
+
+/**
+ A single pass JSON decoder used for large server responses, such as geofence tree, iBeacon list and feeds.
+
+ Compare to `NSJSONSerialization` + `removesKeysWithNullValues`:
+
+ * Dictionary keys with null value are dropped while decoding, no second walk to copy every container.
+ * A container can be "streamed": each element is decoded and handed to `SHJSONStreamElementHandler` inside its own autorelease pool, caller builds model object directly from it and the element is released. The whole tree is never held in memory.
+ */
+@interface SHJSONStreamParser : NSObject
+
+/**
+ Decode JSON data into Foundation objects, dictionary keys with null value are dropped.
+ @param data The utf-8 JSON data.
+ @param error If decode fail, return the error.
+ @return Decoded object. If data is empty or decode fail, return nil.
+ */
++ (nullable id)parseData:(nullable NSData *)data error:(NSError * _Nullable __autoreleasing * _Nullable)error;
+
+/**
+ Decode JSON data and stream one container to `elementHandler`.
+ @param data The utf-8 JSON data.
+ @param streamKey If top level is dictionary, the container for this key is streamed. If nil, the top level container itself is streamed. The streamed container is replaced by an empty container of same type in the return object, so that caller still see the shape such as {code: 0, value: []}. If the value for `streamKey` is not a container, for example error message string, it's decoded as normal.
+ @param elementHandler Called for each element of streamed container, in document order.
+ @param error If decode fail, return the error. Elements before the failing point may have been handed out already.
+ @return Decoded object without the streamed elements. If data is empty or decode fail, return nil.
+ */
++ (nullable id)parseData:(nullable NSData *)data streamKey:(nullable NSString *)streamKey elementHandler:(nullable SHJSONStreamElementHandler)elementHandler error:(NSError * _Nullable __autoreleasing * _Nullable)error;
+
+@end
@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHJSONStreamParser.h"
+//header from StreetHawk
+#import "SHTypes.h" //for SHErrorDomain
+#import "SHJSONLexer.h" //for tokenizing bytes
+
+static id shJSONParseValue(SHJSONCursor *cursor);
+static id shJSONParseArray(SHJSONCursor *cursor, SHJSONStreamElementHandler elementHandler);
+static id shJSONParseObject(SHJSONCursor *cursor, NSString *streamKey, SHJSONStreamElementHandler elementHandler);
+
+static NSString *shJSONParseString(SHJSONCursor *cursor)
+{
+    size_t start = 0;
+    size_t end = 0;
+    int hasEscape = 0;
+    if (!shJSONScanString(cursor, &start, &end, &hasEscape))
+    {
+        return nil;
+    }
+    NSString *str = nil;
+    if (!hasEscape) //most strings from server have no escape, directly create from bytes without a temporary buffer.
+    {
+        str = [[NSString alloc] initWithBytes:cursor->bytes + start length:end - start encoding:NSUTF8StringEncoding];
+    }
+    else
+    {
+        NSMutableData *buffer = [NSMutableData dataWithLength:end - start];
+        size_t len = shJSONUnescapeString(cursor, start, end, buffer.mutableBytes);
+        if (len == (size_t)-1)
+        {
+            return nil;
+        }
+        str = [[NSString alloc] initWithBytes:buffer.bytes length:len encoding:NSUTF8StringEncoding];
+    }
+    if (str == nil)
+    {
+        cursor->errorReason = "invalid utf-8 in string";
+    }
+    return str;
+}
+
+static NSNumber *shJSONParseNumberObject(SHJSONCursor *cursor)
+{
+    long long integerValue = 0;
+    unsigned long long unsignedValue = 0;
+    double doubleValue = 0;
+    switch (shJSONParseNumber(cursor, &integerValue, &unsignedValue, &doubleValue))
+    {
+        case SHJSONNumberType_Integer:
+            return @(integerValue);
+        case SHJSONNumberType_Unsigned:
+            return @(unsignedValue);
+        case SHJSONNumberType_Double:
+            return @(doubleValue);
+        default:
+            return nil;
+    }
+}
+
+static id shJSONParseValue(SHJSONCursor *cursor)
+{
+    shJSONSkipWhitespace(cursor);
+    if (cursor->pos >= cursor->length)
+    {
+        cursor->errorReason = "unexpected end of data";
+        return nil;
+    }
+    uint8_t ch = cursor->bytes[cursor->pos];
+    switch (ch)
+    {
+        case '{':
+            return shJSONParseObject(cursor, nil, nil);
+        case '[':
+            return shJSONParseArray(cursor, nil);
+        case '"':
+            return shJSONParseString(cursor);
+        case 't':
+            return shJSONMatchLiteral(cursor, "true", 4) ? @YES : nil;
+        case 'f':
+            return shJSONMatchLiteral(cursor, "false", 5) ? @NO : nil;
+        case 'n':
+            return shJSONMatchLiteral(cursor, "null", 4) ? [NSNull null] : nil;
+        default:
+            if (ch == '-' || (ch >= '0' && ch <= '9'))
+            {
+                return shJSONParseNumberObject(cursor);
+            }
+            cursor->errorReason = "unexpected character";
+            return nil;
+    }
+}
+
+//Parse array. If `elementHandler` is not nil, elements are handed out instead of collected and an empty array returns.
+static id shJSONParseArray(SHJSONCursor *cursor, SHJSONStreamElementHandler elementHandler)
+{
+    if (++cursor->depth > SH_JSON_MAX_DEPTH)
+    {
+        cursor->errorReason = "too deep nesting";
+        return nil;
+    }
+    cursor->pos++; //skip "["
+    NSMutableArray *array = [NSMutableArray array];
+    shJSONSkipWhitespace(cursor);
+    if (cursor->pos < cursor->length && cursor->bytes[cursor->pos] == ']')
+    {
+        cursor->pos++;
+        cursor->depth--;
+        return array;
+    }
+    while (YES)
+    {
+        @autoreleasepool
+        {
+            id value = shJSONParseValue(cursor);
+            if (value == nil)
+            {
+                return nil;
+            }
+            if (elementHandler != nil)
+            {
+                if (value != [NSNull null])
+                {
+                    elementHandler(nil, value);
+                }
+            }
+            else
+            {
+                [array addObject:value]; //keep null inside array, same as `removesKeysWithNullValues` only remove dictionary keys.
+            }
+        }
+        shJSONSkipWhitespace(cursor);
+        if (cursor->pos >= cursor->length)
+        {
+            cursor->errorReason = "unterminated array";
+            return nil;
+        }
+        uint8_t ch = cursor->bytes[cursor->pos++];
+        if (ch == ']')
+        {
+            break;
+        }
+        if (ch != ',')
+        {
+            cursor->errorReason = "expect \",\" or \"]\" in array";
+            return nil;
+        }
+    }
+    cursor->depth--;
+    return array;
+}
+
+//Parse dictionary, keys with null value are dropped.
+//If `elementHandler` is not nil and `streamKey` is nil, every member is handed out and an empty dictionary returns.
+//If `elementHandler` and `streamKey` are both not nil, only the container for `streamKey` is streamed, it's replaced by empty container of same type.
+static id shJSONParseObject(SHJSONCursor *cursor, NSString *streamKey, SHJSONStreamElementHandler elementHandler)
+{
+    if (++cursor->depth > SH_JSON_MAX_DEPTH)
+    {
+        cursor->errorReason = "too deep nesting";
+        return nil;
+    }
+    cursor->pos++; //skip "{"
+    NSMutableDictionary *dict = [NSMutableDictionary dictionary];
+    shJSONSkipWhitespace(cursor);
+    if (cursor->pos < cursor->length && cursor->bytes[cursor->pos] == '}')
+    {
+        cursor->pos++;
+        cursor->depth--;
+        return dict;
+    }
+    while (YES)
+    {
+        shJSONSkipWhitespace(cursor);
+        if (cursor->pos >= cursor->length || cursor->bytes[cursor->pos] != '"')
+        {
+            cursor->errorReason = "expect string key in dictionary";
+            return nil;
+        }
+        NSString *key = shJSONParseString(cursor);
+        if (key == nil)
+        {
+            return nil;
+        }
+        shJSONSkipWhitespace(cursor);
+        if (cursor->pos >= cursor->length || cursor->bytes[cursor->pos] != ':')
+        {
+            cursor->errorReason = "expect \":\" in dictionary";
+            return nil;
+        }
+        cursor->pos++;
+        id value = nil;
+        if (elementHandler != nil && streamKey != nil && [key isEqualToString:streamKey])
+        {
+            shJSONSkipWhitespace(cursor);
+            uint8_t ch = (cursor->pos < cursor->length) ? cursor->bytes[cursor->pos] : 0;
+            if (ch == '[')
+            {
+                value = shJSONParseArray(cursor, elementHandler);
+            }
+            else if (ch == '{')
+            {
+                value = shJSONParseObject(cursor, nil, elementHandler);
+            }
+            else
+            {
+                value = shJSONParseValue(cursor); //not container, such as error message, decode as normal.
+            }
+        }
+        else if (elementHandler != nil && streamKey == nil)
+        {
+            @autoreleasepool
+            {
+                id element = shJSONParseValue(cursor);
+                if (element == nil)
+                {
+                    return nil;
+                }
+                if (element != [NSNull null])
+                {
+                    elementHandler(key, element);
+                }
+            }
+            value = [NSNull null]; //not store
+        }
+        else
+        {
+            value = shJSONParseValue(cursor);
+        }
+        if (value == nil)
+        {
+            return nil;
+        }
+        if (value != [NSNull null])
+        {
+            dict[key] = value; //duplicated key uses last one, same as NSJSONSerialization.
+        }
+        shJSONSkipWhitespace(cursor);
+        if (cursor->pos >= cursor->length)
+        {
+            cursor->errorReason = "unterminated dictionary";
+            return nil;
+        }
+        uint8_t ch = cursor->bytes[cursor->pos++];
+        if (ch == '}')
+        {
+            break;
+        }
+        if (ch != ',')
+        {
+            cursor->errorReason = "expect \",\" or \"}\" in dictionary";
+            return nil;
+        }
+    }
+    cursor->depth--;
+    return dict;
+}
+
+@implementation SHJSONStreamParser
+
+#pragma mark - public functions
+
++ (id)parseData:(NSData *)data error:(NSError * __autoreleasing *)error
+{
+    return [self parseData:data streamKey:nil elementHandler:nil error:error];
+}
+
++ (id)parseData:(NSData *)data streamKey:(NSString *)streamKey elementHandler:(SHJSONStreamElementHandler)elementHandler error:(NSError * __autoreleasing *)error
+{
+    if (error)
+    {
+        *error = nil;
+    }
+    SHJSONCursor cursor;
+    shJSONCursorInit(&cursor, (const uint8_t *)data.bytes, data.length);
+    shJSONSkipWhitespace(&cursor);
+    if (cursor.pos >= cursor.length)
+    {
+        return nil; //empty body, for example a single space for `head :ok`.
+    }
+    id result = nil;
+    uint8_t ch = cursor.bytes[cursor.pos];
+    if (elementHandler != nil && ch == '{')
+    {
+        result = shJSONParseObject(&cursor, streamKey, elementHandler);
+    }
+    else if (elementHandler != nil && streamKey == nil && ch == '[')
+    {
+        result = shJSONParseArray(&cursor, elementHandler);
+    }
+    else
+    {
+        result = shJSONParseValue(&cursor);
+    }
+    if (result != nil && cursor.errorReason == NULL)
+    {
+        shJSONSkipWhitespace(&cursor);
+        if (cursor.pos < cursor.length)
+        {
+            cursor.errorReason = "garbage after top level value";
+        }
+    }
+    if (cursor.errorReason != NULL)
+    {
+        if (error)
+        {
+            NSString *description = [NSString stringWithFormat:@"JSON text malformed at offset %lu: %s.", (unsigned long)cursor.pos, cursor.errorReason];
+            *error = [NSError errorWithDomain:SHErrorDomain code:INT_MIN userInfo:@{NSLocalizedDescriptionKey: description}];
+        }
+        return nil;
+    }
+    return result;
+}
+
+@end
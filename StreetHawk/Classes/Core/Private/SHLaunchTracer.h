@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ Key of launch timeline item: phase name, NSString.
+ */
+#define SHLaunchPhaseKey        @"phase"
+
+/**
+ Key of launch timeline item: seconds from SDK load to phase start, NSNumber.
+ */
+#define SHLaunchStartKey        @"start"
+
+/**
+ Key of launch timeline item: seconds the phase takes, NSNumber.
+ */
+#define SHLaunchDurationKey     @"duration"
+
+/**
+ Key of launch timeline item: whether phase ran as an idle time task, NSNumber bool.
+ */
+#define SHLaunchDeferredKey     @"deferred"
+
+/**
+ Record SDK's startup work as a timeline of phases, and run work not needed for the first frame when main thread is idle.
+
+ Phases traced by `tracePhase:block:` run immediately and count into `launchCost`, which is the time SDK adds to App's launch. Tasks added by `deferTask:dependencies:block:` run in main thread one by one when main run loop is about to sleep, after all their dependencies finish. Deferred tasks are also traced but not counted into `launchCost`. When App goes to background, pending tasks run at once so they are not lost if App is suspended.
+ */
+@interface SHLaunchTracer : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. Its creation time is the zero point of timeline, so create it as early as possible.
+ */
++ (SHLaunchTracer *)sharedInstance;
+
+/** @name Trace */
+
+/**
+ Run the block now and record its time as a launch phase.
+ @param phase Name of the phase.
+ @param block Work of the phase, run synchronously in current thread.
+ */
+- (void)tracePhase:(NSString *)phase block:(dispatch_block_t)block;
+
+/**
+ Time in seconds spent in phases traced by `tracePhase:block:`, i.e. SDK's cost on App launch.
+ */
+@property (nonatomic, readonly) NSTimeInterval launchCost;
+
+/**
+ Array of phases in start order, each is a dictionary with keys `SHLaunchPhaseKey`, `SHLaunchStartKey`, `SHLaunchDurationKey` and `SHLaunchDeferredKey`.
+ */
+@property (nonatomic, readonly) NSArray *timeline;
+
+/** @name Deferred tasks */
+
+/**
+ Run the block in main thread when it's idle, after tasks named in `dependencies` finish. Can be called in any thread.
+ @param task Name of the task, used as dependency of other tasks and as phase name in timeline.
+ @param dependencies Names of tasks must finish before this one. A name never deferred is treated as finished.
+ @param block Work of the task.
+ */
+- (void)deferTask:(NSString *)task dependencies:(NSArray *)dependencies block:(dispatch_block_t)block;
+
+@end
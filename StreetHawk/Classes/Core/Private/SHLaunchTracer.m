@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHLaunchTracer.h"
+//header from StreetHawk
+#import "SHUtils.h" //for SHLog
+#import "SHTypes.h" //for NONULL
+//header from System
+#import <UIKit/UIKit.h> //for App background notification
+
+#define LAUNCH_BUDGET           0.05 //seconds SDK is allowed to add to App launch, print warning if exceed.
+
+/**
+ A task waiting for main thread idle.
+ */
+@interface SHDeferredTask : NSObject
+
+@property (nonatomic, strong) NSString *name;
+@property (nonatomic, strong) NSArray *dependencies;
+@property (nonatomic, copy) dispatch_block_t block;
+
+@end
+
+@implementation SHDeferredTask
+
+@end
+
+@interface SHLaunchTracer ()
+
+@property (nonatomic) NSTimeInterval zeroTime; //system uptime when tracer created.
+@property (nonatomic, strong) NSMutableArray *arrayTimeline; //accessed under lock of self.
+@property (nonatomic) NSTimeInterval criticalCost; //accessed under lock of self.
+@property (nonatomic, strong) NSMutableArray *arrayPendingTasks; //only accessed in main thread.
+@property (nonatomic) CFRunLoopObserverRef idleObserver; //only accessed in main thread, exist while having pending tasks.
+@property (nonatomic) BOOL isCostReported; //only accessed in main thread.
+
+- (void)recordPhase:(NSString *)phase start:(NSTimeInterval)start duration:(NSTimeInterval)duration deferred:(BOOL)isDeferred;
+- (void)enqueueTask:(SHDeferredTask *)task; //must call in main thread.
+- (SHDeferredTask *)nextReadyTask; //first pending task whose dependencies are all finished, must call in main thread.
+- (BOOL)runNextTask; //run one ready task, return NO if nothing pending. Must call in main thread.
+- (void)mainThreadIdle; //called by run loop observer before main thread sleeps.
+- (void)reportLaunchCost; //print launch cost once, when main thread is first idle.
+- (void)appDidEnterBackgroundHandler:(NSNotification *)notification; //run pending tasks before App is suspended.
+
+@end
+
+@implementation SHLaunchTracer
+
+#pragma mark - life cycle
+
++ (SHLaunchTracer *)sharedInstance
+{
+    static SHLaunchTracer *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHLaunchTracer alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.zeroTime = [NSProcessInfo processInfo].systemUptime; //monotonic, not affected by changing device time.
+        self.arrayTimeline = [NSMutableArray array];
+        self.criticalCost = 0;
+        self.arrayPendingTasks = [NSMutableArray array];
+        self.idleObserver = NULL;
+        self.isCostReported = NO;
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appDidEnterBackgroundHandler:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    if (self.idleObserver != NULL)
+    {
+        CFRunLoopObserverInvalidate(self.idleObserver);
+        CFRelease(self.idleObserver);
+    }
+}
+
+#pragma mark - public functions
+
+- (void)tracePhase:(NSString *)phase block:(dispatch_block_t)block
+{
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    if (block != nil)
+    {
+        block();
+    }
+    [self recordPhase:phase start:start duration:[NSProcessInfo processInfo].systemUptime - start deferred:NO];
+}
+
+- (NSTimeInterval)launchCost
+{
+    @synchronized(self)
+    {
+        return self.criticalCost;
+    }
+}
+
+- (NSArray *)timeline
+{
+    @synchronized(self)
+    {
+        return [self.arrayTimeline copy];
+    }
+}
+
+- (void)deferTask:(NSString *)task dependencies:(NSArray *)dependencies block:(dispatch_block_t)block
+{
+    NSAssert(!shStrIsEmpty(task) && block != nil, @"Deferred task must have name and block.");
+    if (shStrIsEmpty(task) || block == nil)
+    {
+        return;
+    }
+    SHDeferredTask *deferredTask = [[SHDeferredTask alloc] init];
+    deferredTask.name = task;
+    deferredTask.dependencies = (dependencies != nil) ? [dependencies copy] : @[];
+    deferredTask.block = block;
+    if ([NSThread isMainThread])
+    {
+        [self enqueueTask:deferredTask];
+    }
+    else
+    {
+        dispatch_async(dispatch_get_main_queue(), ^
+        {
+            [self enqueueTask:deferredTask];
+        });
+    }
+}
+
+#pragma mark - private functions
+
+- (void)recordPhase:(NSString *)phase start:(NSTimeInterval)start duration:(NSTimeInterval)duration deferred:(BOOL)isDeferred
+{
+    NSDictionary *dictPhase = @{SHLaunchPhaseKey: NONULL(phase), SHLaunchStartKey: @(start - self.zeroTime), SHLaunchDurationKey: @(duration), SHLaunchDeferredKey: @(isDeferred)};
+    @synchronized(self)
+    {
+        [self.arrayTimeline addObject:dictPhase];
+        if (!isDeferred)
+        {
+            self.criticalCost += duration;
+        }
+    }
+}
+
+- (void)enqueueTask:(SHDeferredTask *)task
+{
+    [self.arrayPendingTasks addObject:task];
+    if (self.idleObserver == NULL)
+    {
+        __weak SHLaunchTracer *weakSelf = self;
+        //Default mode only: not run while user is scrolling (tracking mode), that is not idle.
+        self.idleObserver = CFRunLoopObserverCreateWithHandler(kCFAllocatorDefault, kCFRunLoopBeforeWaiting, YES/*repeat*/, INT_MAX/*after Core Animation commits*/, ^(CFRunLoopObserverRef observer, CFRunLoopActivity activity)
+        {
+            [weakSelf mainThreadIdle];
+        });
+        CFRunLoopAddObserver(CFRunLoopGetMain(), self.idleObserver, kCFRunLoopDefaultMode);
+    }
+}
+
+- (SHDeferredTask *)nextReadyTask
+{
+    for (SHDeferredTask *task in self.arrayPendingTasks)
+    {
+        BOOL isReady = YES;
+        for (NSString *dependency in task.dependencies)
+        {
+            for (SHDeferredTask *pendingTask in self.arrayPendingTasks)
+            {
+                if ([pendingTask.name isEqualToString:dependency])
+                {
+                    isReady = NO;
+                    break;
+                }
+            }
+            if (!isReady)
+            {
+                break;
+            }
+        }
+        if (isReady)
+        {
+            return task;
+        }
+    }
+    //Dependency cycle, should not happen. Run in adding order instead of never.
+    NSAssert(self.arrayPendingTasks.count == 0, @"Deferred tasks have dependency cycle: %@.", self.arrayPendingTasks);
+    return self.arrayPendingTasks.firstObject;
+}
+
+- (BOOL)runNextTask
+{
+    SHDeferredTask *task = [self nextReadyTask];
+    if (task == nil)
+    {
+        return NO;
+    }
+    [self.arrayPendingTasks removeObject:task]; //remove before run, in case block defers more tasks.
+    NSTimeInterval start = [NSProcessInfo processInfo].systemUptime;
+    task.block();
+    [self recordPhase:task.name start:start duration:[NSProcessInfo processInfo].systemUptime - start deferred:YES];
+    return YES;
+}
+
+- (void)mainThreadIdle
+{
+    [self reportLaunchCost];
+    //one task per idle, so a frame or an event can come between tasks.
+    [self runNextTask];
+    if (self.arrayPendingTasks.count > 0)
+    {
+        CFRunLoopWakeUp(CFRunLoopGetMain()); //otherwise run loop sleeps till next event.
+    }
+    else if (self.idleObserver != NULL)
+    {
+        CFRunLoopObserverInvalidate(self.idleObserver);
+        CFRelease(self.idleObserver);
+        self.idleObserver = NULL;
+    }
+}
+
+- (void)reportLaunchCost
+{
+    if (self.isCostReported)
+    {
+        return;
+    }
+    self.isCostReported = YES;
+    NSTimeInterval launchCost = self.launchCost;
+    if (launchCost > LAUNCH_BUDGET)
+    {
+        SHLog(@"WARNING: StreetHawk SDK takes %.1f ms in App launch, budget is %.1f ms. Timeline: %@.", launchCost * 1000, LAUNCH_BUDGET * 1000, self.timeline);
+    }
+    else
+    {
+        SHLog(@"StreetHawk SDK takes %.1f ms in App launch.", launchCost * 1000);
+    }
+}
+
+- (void)appDidEnterBackgroundHandler:(NSNotification *)notification
+{
+    while ([self runNextTask])
+    {
+    }
+}
+
+@end
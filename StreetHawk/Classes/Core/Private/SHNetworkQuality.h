@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ Coarse quality of current network link.
+ */
+enum SHNetworkQualityLevel
+{
+    /**
+     Reachability reports no network.
+     */
+    SHNetworkQualityLevel_Offline = 0,
+    /**
+     Slow or lossy link, for example edge network or weak signal. Defer optional work.
+     */
+    SHNetworkQualityLevel_Poor = 1,
+    /**
+     Usable link, or not enough samples on cellular.
+     */
+    SHNetworkQualityLevel_Moderate = 2,
+    /**
+     Fast link, or not enough samples on WiFi.
+     */
+    SHNetworkQualityLevel_Good = 3,
+};
+typedef enum SHNetworkQualityLevel SHNetworkQualityLevel;
+
+/**
+ Estimate network quality from real traffic: round trip time, download and upload throughput of finished SDK requests, and reachability type from `SHAFNetworkReachabilityManager`. Estimation is reset when reachability type changes, as it's a different link.
+
+ `SHHTTPSessionManager` uses it to set timeout for each request, instead of changing the shared request serializer. Logger, feed prefetch and geofence fetch use it to scale their work.
+ */
+@interface SHNetworkQuality : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. It starts to observe SDK requests and reachability when created.
+ */
++ (SHNetworkQuality *)sharedInstance;
+
+/** @name Properties */
+
+/**
+ Current quality level.
+ */
+@property (nonatomic, readonly) SHNetworkQualityLevel level;
+
+/**
+ Smoothed round trip time in seconds of small requests. 0 if no sample yet.
+ */
+@property (nonatomic, readonly) NSTimeInterval roundTripTime;
+
+/**
+ Smoothed download throughput in bytes per second of large responses. 0 if no sample yet.
+ */
+@property (nonatomic, readonly) double throughput;
+
+/**
+ Smoothed upload throughput in bytes per second of large requests, such as crash report or log upload. 0 if no sample yet.
+ */
+@property (nonatomic, readonly) double uploadThroughput;
+
+/**
+ Whether reachability reports WiFi.
+ */
+@property (nonatomic, readonly) BOOL isWiFi;
+
+/** @name Functions */
+
+/**
+ Timeout for a request on current link. Background fetch must finish in 30 seconds, so background timeout is always 13 seconds; foreground is between 13 and 60 seconds. With samples, foreground timeout shrinks to a multiple of round trip time plus expected upload time of the body. A large body needs an upload throughput sample, otherwise timeout stays 60 seconds.
+ @param request The request to send.
+ @return Timeout in seconds.
+ */
+- (NSTimeInterval)timeoutForRequest:(NSURLRequest *)request;
+
+/**
+ Scale a batch size to current link. Good link keeps default, moderate is half, poor is a quarter, at least 1.
+ @param defaultSize Batch size for a good link.
+ @return Batch size to use.
+ */
+- (NSUInteger)batchSizeForDefault:(NSUInteger)defaultSize;
+
+/**
+ Whether optional download, such as feed prefetch or refreshing an existing geofence tree, should go now. NO when offline or poor link.
+ */
+- (BOOL)allowPrefetch;
+
+@end
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHNetworkQuality.h"
+//header from StreetHawk
+#import "SHUtils.h" //for SHLog
+#import "SHAFNetworkReachabilityManager.h" //for reachability type
+#import "SHAFURLSessionManager.h" //for task resume and complete notification
+//header from System
+#import <UIKit/UIKit.h> //for application state
+
+#define QUALITY_SMOOTH_FACTOR       0.3 //weight of new sample in moving average.
+#define QUALITY_SMALL_TRANSFER      (16 * 1024) //request and response both smaller than this is counted as round trip time; larger one in one direction is counted as throughput of that direction.
+#define QUALITY_TIMEOUT_FOREGROUND  60
+#define QUALITY_TIMEOUT_BACKGROUND  13 //background fetch must finish in 30 seconds, sometimes heartbeat follows by location update. `backgroundTimeRemaining` cannot be used, it may be 180 seconds or 10 minutes.
+#define QUALITY_TIMEOUT_MIN         QUALITY_TIMEOUT_BACKGROUND //never shorter than the old fixed background timeout, which is known to work on slow link.
+
+@interface SHNetworkQuality ()
+
+@property (nonatomic, strong) dispatch_queue_t qualityQueue; //all estimation state accessed in this serial queue.
+@property (nonatomic, strong) NSMapTable *mapStartTime; //task -> resume time, weak key so finished task is not held.
+@property (nonatomic) SHAFNetworkReachabilityStatus reachabilityStatus;
+@property (nonatomic) BOOL isInBackground;
+@property (nonatomic) NSTimeInterval roundTripTimeInner;
+@property (nonatomic) double throughputInner;
+@property (nonatomic) double uploadThroughputInner;
+
+- (void)taskDidResume:(NSNotification *)notification; //record start time of SDK request.
+- (void)taskDidComplete:(NSNotification *)notification; //add a sample from finished SDK request.
+- (void)reachabilityDidChange:(NSNotification *)notification; //link changed, reset estimation.
+- (void)appDidEnterBackground:(NSNotification *)notification;
+- (void)appWillEnterForeground:(NSNotification *)notification;
+- (SHNetworkQualityLevel)levelInQueue; //calculate level, must call in `qualityQueue`.
+
+@end
+
+@implementation SHNetworkQuality
+
+#pragma mark - life cycle
+
++ (SHNetworkQuality *)sharedInstance
+{
+    static SHNetworkQuality *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHNetworkQuality alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.qualityQueue = dispatch_queue_create("com.streethawk.StreetHawk.networkquality", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/);
+        self.mapStartTime = [NSMapTable weakToStrongObjectsMapTable];
+        self.reachabilityStatus = SHAFNetworkReachabilityStatusUnknown;
+        self.isInBackground = ([UIApplication sharedApplication].applicationState == UIApplicationStateBackground);
+        self.roundTripTimeInner = 0;
+        self.throughputInner = 0;
+        self.uploadThroughputInner = 0;
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(taskDidResume:) name:SHAFNetworkingTaskDidResumeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(taskDidComplete:) name:SHAFNetworkingTaskDidCompleteNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(reachabilityDidChange:) name:SHAFNetworkingReachabilityDidChangeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appDidEnterBackground:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appWillEnterForeground:) name:UIApplicationWillEnterForegroundNotification object:nil];
+        [[SHAFNetworkReachabilityManager sharedManager] startMonitoring];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - properties
+
+- (SHNetworkQualityLevel)level
+{
+    __block SHNetworkQualityLevel level;
+    dispatch_sync(self.qualityQueue, ^
+    {
+        level = [self levelInQueue];
+    });
+    return level;
+}
+
+- (NSTimeInterval)roundTripTime
+{
+    __block NSTimeInterval roundTripTime;
+    dispatch_sync(self.qualityQueue, ^
+    {
+        roundTripTime = self.roundTripTimeInner;
+    });
+    return roundTripTime;
+}
+
+- (double)throughput
+{
+    __block double throughput;
+    dispatch_sync(self.qualityQueue, ^
+    {
+        throughput = self.throughputInner;
+    });
+    return throughput;
+}
+
+- (double)uploadThroughput
+{
+    __block double uploadThroughput;
+    dispatch_sync(self.qualityQueue, ^
+    {
+        uploadThroughput = self.uploadThroughputInner;
+    });
+    return uploadThroughput;
+}
+
+- (BOOL)isWiFi
+{
+    __block BOOL isWiFi;
+    dispatch_sync(self.qualityQueue, ^
+    {
+        isWiFi = (self.reachabilityStatus == SHAFNetworkReachabilityStatusReachableViaWiFi);
+    });
+    return isWiFi;
+}
+
+#pragma mark - public functions
+
+- (NSTimeInterval)timeoutForRequest:(NSURLRequest *)request
+{
+    //HTTPBodyStream (multipart upload) has no HTTPBody, its length is in "Content-Length" header if known.
+    long long bodyLength = (request.HTTPBodyStream != nil) ? [[request valueForHTTPHeaderField:@"Content-Length"] longLongValue] : (long long)request.HTTPBody.length;
+    BOOL isBodyLengthKnown = (request.HTTPBodyStream == nil || bodyLength > 0);
+    __block NSTimeInterval timeout;
+    dispatch_sync(self.qualityQueue, ^
+    {
+        NSTimeInterval maxTimeout = self.isInBackground ? QUALITY_TIMEOUT_BACKGROUND : QUALITY_TIMEOUT_FOREGROUND;
+        BOOL isLargeBody = (bodyLength >= QUALITY_SMALL_TRANSFER);
+        if (self.roundTripTimeInner <= 0 || !isBodyLengthKnown || (isLargeBody && self.uploadThroughputInner <= 0))
+        {
+            timeout = maxTimeout; //no sample, unknown body size, or large body without upload sample, keep the safe value.
+            return;
+        }
+        //upload is often much slower than download on cellular, body is only estimated by upload throughput.
+        NSTimeInterval transferTime = isLargeBody ? bodyLength / self.uploadThroughputInner : 0;
+        timeout = MAX(QUALITY_TIMEOUT_MIN, MIN(maxTimeout, 8 * self.roundTripTimeInner + 2 * transferTime + 5));
+    });
+    return timeout;
+}
+
+- (NSUInteger)batchSizeForDefault:(NSUInteger)defaultSize
+{
+    switch (self.level)
+    {
+        case SHNetworkQualityLevel_Good:
+            return defaultSize;
+        case SHNetworkQualityLevel_Moderate:
+            return MAX(1, defaultSize / 2);
+        case SHNetworkQualityLevel_Poor:
+        case SHNetworkQualityLevel_Offline:
+        default:
+            return MAX(1, defaultSize / 4);
+    }
+}
+
+- (BOOL)allowPrefetch
+{
+    SHNetworkQualityLevel level = self.level;
+    return (level == SHNetworkQualityLevel_Good || level == SHNetworkQualityLevel_Moderate);
+}
+
+#pragma mark - private functions
+
+- (void)taskDidResume:(NSNotification *)notification
+{
+    NSURLSessionTask *task = notification.object;
+    if (![task isKindOfClass:[NSURLSessionTask class]])
+    {
+        return;
+    }
+    NSDate *startTime = [NSDate date];
+    dispatch_async(self.qualityQueue, ^
+    {
+        [self.mapStartTime setObject:startTime forKey:task];
+    });
+}
+
+- (void)taskDidComplete:(NSNotification *)notification
+{
+    NSURLSessionTask *task = notification.object;
+    if (![task isKindOfClass:[NSURLSessionTask class]])
+    {
+        return;
+    }
+    NSError *error = notification.userInfo[SHAFNetworkingTaskDidCompleteErrorKey];
+    NSDate *endTime = [NSDate date];
+    int64_t bytesReceived = task.countOfBytesReceived;
+    int64_t bytesSent = task.countOfBytesSent;
+    dispatch_async(self.qualityQueue, ^
+    {
+        NSDate *startTime = [self.mapStartTime objectForKey:task];
+        [self.mapStartTime removeObjectForKey:task];
+        if (startTime == nil)
+        {
+            return;
+        }
+        NSTimeInterval duration = [endTime timeIntervalSinceDate:startTime];
+        BOOL isTimeout = ([error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorTimedOut);
+        if (error != nil && !isTimeout && ![task.response isKindOfClass:[NSHTTPURLResponse class]])
+        {
+            return; //cancelled, offline or cannot find host, not tell link speed.
+        }
+        BOOL isLargeResponse = (bytesReceived >= QUALITY_SMALL_TRANSFER);
+        BOOL isLargeRequest = (bytesSent >= QUALITY_SMALL_TRANSFER);
+        if (isTimeout || (!isLargeResponse && !isLargeRequest))
+        {
+            //timeout is a sample of at least this long, so slow link is noticed.
+            self.roundTripTimeInner = (self.roundTripTimeInner <= 0) ? duration : (1 - QUALITY_SMOOTH_FACTOR) * self.roundTripTimeInner + QUALITY_SMOOTH_FACTOR * duration;
+        }
+        else if (isLargeResponse != isLargeRequest) //large in both directions cannot tell which direction takes the time, skip.
+        {
+            NSTimeInterval transferTime = MAX(0.01, duration - self.roundTripTimeInner);
+            if (isLargeResponse)
+            {
+                double sample = bytesReceived / transferTime;
+                self.throughputInner = (self.throughputInner <= 0) ? sample : (1 - QUALITY_SMOOTH_FACTOR) * self.throughputInner + QUALITY_SMOOTH_FACTOR * sample;
+            }
+            else
+            {
+                double sample = bytesSent / transferTime;
+                self.uploadThroughputInner = (self.uploadThroughputInner <= 0) ? sample : (1 - QUALITY_SMOOTH_FACTOR) * self.uploadThroughputInner + QUALITY_SMOOTH_FACTOR * sample;
+            }
+        }
+    });
+}
+
+- (void)reachabilityDidChange:(NSNotification *)notification
+{
+    SHAFNetworkReachabilityStatus status = [notification.userInfo[SHAFNetworkingReachabilityNotificationStatusItem] integerValue];
+    dispatch_async(self.qualityQueue, ^
+    {
+        if (self.reachabilityStatus != status)
+        {
+            SHLog(@"Network reachability change from %@ to %@, reset network quality.", SHAFStringFromNetworkReachabilityStatus(self.reachabilityStatus), SHAFStringFromNetworkReachabilityStatus(status));
+            self.reachabilityStatus = status;
+            self.roundTripTimeInner = 0;
+            self.throughputInner = 0;
+            self.uploadThroughputInner = 0;
+        }
+    });
+}
+
+- (void)appDidEnterBackground:(NSNotification *)notification
+{
+    dispatch_async(self.qualityQueue, ^
+    {
+        self.isInBackground = YES;
+    });
+}
+
+- (void)appWillEnterForeground:(NSNotification *)notification
+{
+    dispatch_async(self.qualityQueue, ^
+    {
+        self.isInBackground = NO;
+    });
+}
+
+- (SHNetworkQualityLevel)levelInQueue
+{
+    if (self.reachabilityStatus == SHAFNetworkReachabilityStatusNotReachable)
+    {
+        return SHNetworkQualityLevel_Offline;
+    }
+    BOOL isWiFi = (self.reachabilityStatus == SHAFNetworkReachabilityStatusReachableViaWiFi);
+    if (self.roundTripTimeInner <= 0)
+    {
+        return isWiFi ? SHNetworkQualityLevel_Good : SHNetworkQualityLevel_Moderate; //no sample, guess by link type.
+    }
+    if (self.roundTripTimeInner > 2 || (self.throughputInner > 0 && self.throughputInner < 20 * 1024))
+    {
+        return SHNetworkQualityLevel_Poor;
+    }
+    if (self.roundTripTimeInner > 0.5 || (self.throughputInner > 0 && self.throughputInner < 200 * 1024))
+    {
+        return SHNetworkQualityLevel_Moderate;
+    }
+    return SHNetworkQualityLevel_Good;
+}
+
+@end
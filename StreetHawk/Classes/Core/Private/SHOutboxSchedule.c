@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#include "SHOutboxSchedule.h"
+//header from System
+#include <math.h>
+
+double shOutboxRetryDelay(long attempts, double baseDelay, double maxDelay)
+{
+    if (attempts < 1)
+    {
+        return 0;
+    }
+    double delay = ldexp(baseDelay, (int)((attempts < 64 ? attempts : 64) - 1)); //capped exponent, large attempts reach maxDelay anyway.
+    return (delay < maxDelay) ? delay : maxDelay;
+}
+
+double shOutboxNextDeadline(const double *nextTimes, const unsigned char *isSending, size_t count)
+{
+    double deadline = HUGE_VAL;
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((isSending == NULL || !isSending[i]) && nextTimes[i] < deadline)
+        {
+            deadline = nextTimes[i];
+        }
+    }
+    return deadline;
+}
+
+int shOutboxTimerSchedule(SHOutboxTimer *timer, double deadline, double now, double minDelay)
+{
+    double fireTime = deadline;
+    if (fireTime != HUGE_VAL && fireTime < now + minDelay)
+    {
+        fireTime = now + minDelay;
+    }
+    if (timer->fireTime >= deadline && timer->fireTime <= fireTime)
+    {
+        return 0; //armed timer is not before deadline and not later than needed, moving it again would postpone overdue entries.
+    }
+    timer->fireTime = fireTime;
+    return 1;
+}
+
+void shOutboxTimerFired(SHOutboxTimer *timer)
+{
+    timer->fireTime = HUGE_VAL;
+}
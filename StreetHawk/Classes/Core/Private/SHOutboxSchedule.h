@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_OUTBOX_SCHEDULE_H
+#define SH_OUTBOX_SCHEDULE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Retry timing of `SHRequestOutbox`. Plain C so backoff and timer re-arming can be replayed with a fake clock, `SHRequestOutbox` owns the real timer.
+ Times are seconds in same clock as entries' next time, HUGE_VAL as never.
+ */
+typedef struct
+{
+    double fireTime; //when pending timer fires, HUGE_VAL if no timer armed.
+} SHOutboxTimer;
+
+/**
+ Delay before next retry after `attempts` failures: `baseDelay` doubled each failure, not longer than `maxDelay`.
+ */
+double shOutboxRetryDelay(long attempts, double baseDelay, double maxDelay);
+
+/**
+ Earliest next time of entries not being sent, HUGE_VAL if nothing is waiting.
+ @param isSending Optional. Entry i is skipped if isSending[i] is not 0.
+ */
+double shOutboxNextDeadline(const double *nextTimes, const unsigned char *isSending, size_t count);
+
+/**
+ Move timer to `deadline`, not sooner than `minDelay` after `now`. A later deadline moves the timer later, and an earlier one, such as a fresh entry behind a long backoff, moves it earlier. HUGE_VAL deadline cancels the timer.
+ @return 1 if `fireTime` changed and real timer must be re-armed or cancelled, 0 if armed timer already fires between `deadline` and that time.
+ */
+int shOutboxTimerSchedule(SHOutboxTimer *timer, double deadline, double now, double minDelay);
+
+/**
+ Timer fired, no timer is armed until scheduled again.
+ */
+void shOutboxTimerFired(SHOutboxTimer *timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ State of page transition.
+ */
+enum SHPageState
+{
+    /**
+     No page entered, such as fresh install, or after a page exits normally.
+     */
+    SHPageState_None,
+    /**
+     A page entered and its exit log not sent yet.
+     */
+    SHPageState_Entered,
+    /**
+     Exit log sent for a page which is still recorded as entered, it happens when App goes to background. Entering a page moves to `SHPageState_Entered`.
+     */
+    SHPageState_Exited,
+};
+typedef enum SHPageState SHPageState;
+
+/**
+ In-memory state machine of page enter/exit history, used by `shNotifyPageEnter`/`shNotifyPageExit` to decide which logs to send.
+
+ History is loaded from `SHStateStore` once and each transition only changes memory; the change is handed to file writing immediately in background so page history survives a crash or App killed in background, and main thread never waits for disk. Pages are recorded as the name sent in logs, i.e. friendly name if have. Transition rules are in `SHPageTransition.h` plain C, so they are replayed by bench/page_transition_bench; page names compare case insensitive for ASCII letters.
+ */
+@interface SHPageTracker : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. It loads history saved by previous launch at first call.
+ */
++ (SHPageTracker *)sharedInstance;
+
+/** @name State */
+
+/**
+ Current state.
+ */
+@property (nonatomic, readonly) SHPageState state;
+
+/**
+ Page entered and not exited normally, nil if none. It's kept when App goes to background so App coming to foreground enters it again.
+ */
+@property (nonatomic, readonly) NSString *enterPage;
+
+/**
+ Page appearing, recorded in `viewWillAppear` as backup in case `viewDidAppear` not called such as a canceled pop up. It's view controller class name.
+ */
+@property (nonatomic, readonly) NSString *enterBackupPage;
+
+/**
+ Page whose exit log is sent and no page entered after it, nil if none.
+ */
+@property (nonatomic, readonly) NSString *exitPage;
+
+/** @name Transition */
+
+/**
+ Previous entered page which must send exit before entering `page`, nil if nothing to exit.
+ When App is killed in foreground, previous launch's page is still entered and must exit first even it's same as `page`. When App went to background its exit was already sent, so not exit again.
+ @param page Page going to enter.
+ @return Page to exit first, or nil.
+ */
+- (NSString *)pageToExitBeforeEnter:(NSString *)page;
+
+/**
+ Whether exit log for this page is already sent, so it must not send again.
+ @param page Page going to exit.
+ */
+- (BOOL)isExitSentForPage:(NSString *)page;
+
+/**
+ Record a page entered.
+ @param page Page name as sent in log.
+ @param isLogSent Whether enter log is sent. If sent, exit history is cleared so next exit can send.
+ */
+- (void)enterPage:(NSString *)page logSent:(BOOL)isLogSent;
+
+/**
+ Record exit log sent for a page.
+ @param page Page name as sent in log.
+ @param needClear YES when page really exits; NO when App goes to background and the page should enter again when App comes back.
+ */
+- (void)exitPage:(NSString *)page clearEnter:(BOOL)needClear;
+
+/**
+ Record a page appearing as backup enter.
+ @param page View controller class name.
+ */
+- (void)willAppearPage:(NSString *)page;
+
+/**
+ Clear all history, for fresh install.
+ */
+- (void)reset;
+
+@end
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHPageTracker.h"
+//header from StreetHawk
+#import "SHTypes.h" //for NONULL
+#import "SHStateStore.h" //for persist history
+#import "SHPageTransition.h" //for transition rules
+
+#define ENTER_PAGE_HISTORY                  @"ENTER_PAGE_HISTORY"  //key for record entered page history. It's set when enter a page and cleared when send exit log except go BG.
+#define ENTERBAK_PAGE_HISTORY               @"ENTERBAK_PAGE_HISTORY" //key for record entered page history as backup. It's set as backup in case ENTER_PAGE_HISTORY not set in canceled pop up.
+#define EXIT_PAGE_HISTORY                   @"EXIT_PAGE_HISTORY"  //key for record send exit log history. It's set when send exit log and cleared when send enter log. This is to avoid send duplicated exit log.
+
+@interface SHPageTracker ()
+{
+    SHPageHistory _history; //accessed under lock of self.
+}
+
++ (NSString *)loadPageForKey:(NSString *)key;
++ (NSString *)stringFromPage:(const char *)page; //nil for "".
+- (void)persistChanges:(int)changes; //mask of `SHPageHistoryChange`, must call under lock of self.
+
+@end
+
+@implementation SHPageTracker
+
+#pragma mark - life cycle
+
++ (SHPageTracker *)sharedInstance
+{
+    static SHPageTracker *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHPageTracker alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        shPageHistoryInit(&_history, [SHPageTracker loadPageForKey:ENTER_PAGE_HISTORY].UTF8String, [SHPageTracker loadPageForKey:ENTERBAK_PAGE_HISTORY].UTF8String, [SHPageTracker loadPageForKey:EXIT_PAGE_HISTORY].UTF8String);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    shPageHistoryDestroy(&_history);
+}
+
+#pragma mark - properties
+
+- (SHPageState)state
+{
+    @synchronized(self)
+    {
+        if (_history.exitPage[0] != '\0')
+        {
+            return SHPageState_Exited;
+        }
+        return (_history.enterPage[0] != '\0') ? SHPageState_Entered : SHPageState_None;
+    }
+}
+
+- (NSString *)enterPage
+{
+    @synchronized(self)
+    {
+        return [SHPageTracker stringFromPage:_history.enterPage];
+    }
+}
+
+- (NSString *)enterBackupPage
+{
+    @synchronized(self)
+    {
+        return [SHPageTracker stringFromPage:_history.enterBackupPage];
+    }
+}
+
+- (NSString *)exitPage
+{
+    @synchronized(self)
+    {
+        return [SHPageTracker stringFromPage:_history.exitPage];
+    }
+}
+
+#pragma mark - public functions
+
+- (NSString *)pageToExitBeforeEnter:(NSString *)page
+{
+    @synchronized(self)
+    {
+        return [SHPageTracker stringFromPage:shPageToExitBeforeEnter(&_history, NONULL(page).UTF8String)];
+    }
+}
+
+- (BOOL)isExitSentForPage:(NSString *)page
+{
+    @synchronized(self)
+    {
+        BOOL isExitSent = shPageIsExitSent(&_history, NONULL(page).UTF8String);
+        NSAssert(_history.exitPage[0] == '\0' || isExitSent, @"Try to send exit page (%@) different from history (%s).", page, _history.exitPage);
+        return isExitSent;
+    }
+}
+
+- (void)enterPage:(NSString *)page logSent:(BOOL)isLogSent
+{
+    @synchronized(self)
+    {
+        [self persistChanges:shPageEnter(&_history, NONULL(page).UTF8String, isLogSent)];
+    }
+}
+
+- (void)exitPage:(NSString *)page clearEnter:(BOOL)needClear
+{
+    @synchronized(self)
+    {
+        [self persistChanges:shPageExit(&_history, NONULL(page).UTF8String, needClear)];
+    }
+}
+
+- (void)willAppearPage:(NSString *)page
+{
+    @synchronized(self)
+    {
+        [self persistChanges:shPageWillAppear(&_history, NONULL(page).UTF8String)];
+    }
+}
+
+- (void)reset
+{
+    @synchronized(self)
+    {
+        [self persistChanges:shPageReset(&_history)];
+    }
+}
+
+#pragma mark - private functions
+
++ (NSString *)loadPageForKey:(NSString *)key
+{
+    NSObject *value = [[SHStateStore sharedInstance] objectForKey:key];
+    return [value isKindOfClass:[NSString class]] ? (NSString *)value : @"";
+}
+
++ (NSString *)stringFromPage:(const char *)page
+{
+    return (page != NULL && page[0] != '\0') ? [NSString stringWithUTF8String:page] : nil;
+}
+
+- (void)persistChanges:(int)changes
+{
+    SHStateStore *stateStore = [SHStateStore sharedInstance];
+    if (changes & SHPageHistoryChange_Enter)
+    {
+        [stateStore setObject:[NSString stringWithUTF8String:_history.enterPage] forKey:ENTER_PAGE_HISTORY];
+    }
+    if (changes & SHPageHistoryChange_Backup)
+    {
+        [stateStore setObject:[NSString stringWithUTF8String:_history.enterBackupPage] forKey:ENTERBAK_PAGE_HISTORY];
+    }
+    if (changes & SHPageHistoryChange_Exit)
+    {
+        [stateStore setObject:[NSString stringWithUTF8String:_history.exitPage] forKey:EXIT_PAGE_HISTORY];
+    }
+    if (changes & (SHPageHistoryChange_Enter | SHPageHistoryChange_Exit))
+    {
+        [stateStore flush]; //not wait coalescing, next launch relies on enter/exit history to recover. Backup is only used in this launch.
+    }
+}
+
+@end
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#include "SHPageTransition.h"
+//header from System
+#include <stdlib.h>
+#include <string.h>
+
+static int shPageSetName(char **field, const char *page) //replace field with copy of page, return 1 if value changed.
+{
+    const char *value = (page != NULL) ? page : "";
+    if (*field != NULL && strcmp(*field, value) == 0)
+    {
+        return 0;
+    }
+    size_t length = strlen(value);
+    char *copy = malloc(length + 1);
+    if (copy == NULL)
+    {
+        return 0; //keep old value, history is best effort same as before.
+    }
+    memcpy(copy, value, length + 1);
+    free(*field);
+    *field = copy;
+    return 1;
+}
+
+int shPageHistoryInit(SHPageHistory *history, const char *enterPage, const char *enterBackupPage, const char *exitPage)
+{
+    memset(history, 0, sizeof(*history));
+    shPageSetName(&history->enterPage, enterPage);
+    shPageSetName(&history->enterBackupPage, enterBackupPage);
+    shPageSetName(&history->exitPage, exitPage);
+    if (history->enterPage == NULL || history->enterBackupPage == NULL || history->exitPage == NULL)
+    {
+        shPageHistoryDestroy(history);
+        return 0;
+    }
+    return 1;
+}
+
+void shPageHistoryDestroy(SHPageHistory *history)
+{
+    free(history->enterPage);
+    free(history->enterBackupPage);
+    free(history->exitPage);
+    memset(history, 0, sizeof(*history));
+}
+
+int shPageNameEqual(const char *page1, const char *page2)
+{
+    const unsigned char *p1 = (const unsigned char *)(page1 != NULL ? page1 : "");
+    const unsigned char *p2 = (const unsigned char *)(page2 != NULL ? page2 : "");
+    while (*p1 != '\0' && *p2 != '\0')
+    {
+        unsigned char c1 = (*p1 >= 'A' && *p1 <= 'Z') ? (unsigned char)(*p1 + 32) : *p1;
+        unsigned char c2 = (*p2 >= 'A' && *p2 <= 'Z') ? (unsigned char)(*p2 + 32) : *p2;
+        if (c1 != c2)
+        {
+            return 0;
+        }
+        p1++;
+        p2++;
+    }
+    return *p1 == *p2;
+}
+
+const char *shPageToExitBeforeEnter(const SHPageHistory *history, const char *page)
+{
+    if (history->enterPage[0] == '\0')
+    {
+        return NULL;
+    }
+    //Not check it's not same as "page". For example, stay FG at homepage and App killed, enter history has homepage, exit history is empty. Next launch is homepage. So sends homepage exit first to match previous enter, and sends homepage enter again.
+    //Case like this: 1)App stay in page C and BG, enter history=C, exit history=C. 2)App terminated in BG, launch again. Homepage A's viewDidAppear called, it check enter history=C so try to send exit for C but stopped by exit history=C, no exit log sent, finally set enter history=A! (this enter will called as App go to FG) 3)Sadly, App in BG and terminated again, launch again. Homepage A's viewDidAppear called, this time enter history=A, exit history=C.
+    //Without this check, it will try to exit A while exit history=C.
+    int multipleBGTerminal = (shPageNameEqual(history->enterPage, page) && history->exitPage[0] != '\0');
+    return multipleBGTerminal ? NULL : history->enterPage;
+}
+
+int shPageIsExitSent(const SHPageHistory *history, const char *page)
+{
+    return history->exitPage[0] != '\0' && shPageNameEqual(history->exitPage, page);
+}
+
+int shPageEnter(SHPageHistory *history, const char *page, int isLogSent)
+{
+    int changes = SHPageHistoryChange_None;
+    if (isLogSent && history->exitPage[0] != '\0' && shPageSetName(&history->exitPage, ""))
+    {
+        changes |= SHPageHistoryChange_Exit; //clear exit history after send enter log, next exit log can send.
+    }
+    if (shPageSetName(&history->enterPage, page))
+    {
+        changes |= SHPageHistoryChange_Enter;
+    }
+    return changes;
+}
+
+int shPageExit(SHPageHistory *history, const char *page, int needClear)
+{
+    int changes = SHPageHistoryChange_None;
+    if (shPageSetName(&history->exitPage, page))
+    {
+        changes |= SHPageHistoryChange_Exit;
+    }
+    if (needClear && shPageSetName(&history->enterPage, ""))
+    {
+        changes |= SHPageHistoryChange_Enter;
+    }
+    return changes;
+}
+
+int shPageWillAppear(SHPageHistory *history, const char *page)
+{
+    return shPageSetName(&history->enterBackupPage, page) ? SHPageHistoryChange_Backup : SHPageHistoryChange_None;
+}
+
+int shPageReset(SHPageHistory *history)
+{
+    int changes = SHPageHistoryChange_None;
+    changes |= shPageSetName(&history->enterPage, "") ? SHPageHistoryChange_Enter : 0;
+    changes |= shPageSetName(&history->enterBackupPage, "") ? SHPageHistoryChange_Backup : 0;
+    changes |= shPageSetName(&history->exitPage, "") ? SHPageHistoryChange_Exit : 0;
+    return changes;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_PAGE_TRANSITION_H
+#define SH_PAGE_TRANSITION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Page enter/exit history which decides logs of page transition. Plain C so the rules can be replayed and measured without UIKit, `SHPageTracker` wraps it for App.
+ Pages are utf-8 names as sent in logs, never NULL, "" as not set. Names are compared case insensitive for ASCII letters only.
+ */
+typedef struct
+{
+    char *enterPage; //entered and not exited normally, kept when App goes to background.
+    char *enterBackupPage; //recorded in viewWillAppear in case viewDidAppear not called.
+    char *exitPage; //exit log sent and no page entered after it.
+} SHPageHistory;
+
+/**
+ Which fields a transition changed, so only they are persisted.
+ */
+enum SHPageHistoryChange
+{
+    SHPageHistoryChange_None = 0,
+    SHPageHistoryChange_Enter = 1 << 0,
+    SHPageHistoryChange_Backup = 1 << 1,
+    SHPageHistoryChange_Exit = 1 << 2,
+};
+
+/**
+ Initialize history, such as from values saved by previous launch. NULL is same as "".
+ @return 1 if OK, 0 if out of memory.
+ */
+int shPageHistoryInit(SHPageHistory *history, const char *enterPage, const char *enterBackupPage, const char *exitPage);
+
+/**
+ Free memory of history.
+ */
+void shPageHistoryDestroy(SHPageHistory *history);
+
+/**
+ Whether two page names are same, ASCII letters case insensitive.
+ */
+int shPageNameEqual(const char *page1, const char *page2);
+
+/**
+ Previous entered page which must send exit before entering `page`, NULL if nothing to exit.
+ When App is killed in foreground, previous launch's page is still entered and must exit first even it's same as `page`. When App went to background and was killed, even more than once, its exit was already sent, so not exit again.
+ */
+const char *shPageToExitBeforeEnter(const SHPageHistory *history, const char *page);
+
+/**
+ Whether exit log for this page is already sent, so it must not send again.
+ */
+int shPageIsExitSent(const SHPageHistory *history, const char *page);
+
+/**
+ Record a page entered. If enter log is sent, exit history is cleared so next exit can send.
+ @return Mask of `SHPageHistoryChange`.
+ */
+int shPageEnter(SHPageHistory *history, const char *page, int isLogSent);
+
+/**
+ Record exit log sent for a page. `needClear` is 1 when page really exits; 0 when App goes to background and the page enters again when App comes back.
+ @return Mask of `SHPageHistoryChange`.
+ */
+int shPageExit(SHPageHistory *history, const char *page, int needClear);
+
+/**
+ Record a page appearing as backup enter.
+ @return Mask of `SHPageHistoryChange`.
+ */
+int shPageWillAppear(SHPageHistory *history, const char *page);
+
+/**
+ Clear all history, for fresh install.
+ @return Mask of `SHPageHistoryChange`.
+ */
+int shPageReset(SHPageHistory *history);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
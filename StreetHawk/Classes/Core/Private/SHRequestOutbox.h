@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SHHTTPSessionManager.h" //for SHHostVersion
+
+#define SH_REQUEST_OUTBOX   @"SH_REQUEST_OUTBOX" //key for persistent outbox entries, array of dictionary.
+
+/**
+ Durable outbox for non-log requests, such as feedback, friendly names, interactive button pairs and growth register. Logs are not here because they already survive failure in logcache.db.
+
+ - Each entry has an idempotency key, sent as header "X-Idempotency-Key". The same key is never queued twice, and server can ignore a repeated delivery.
+ - Entry with a coalesce key supersedes queued entry with same coalesce key, for example only the latest friendly name set is submitted.
+ - Entries are stored in `SHStateStore`, and retried with exponential backoff by one shared scheduler: when enqueue, when App become active, when install register, and by timer while App is running. Entry is dropped when successful, when server rejects it (not retryable), or after too many attempts.
+ */
+@interface SHRequestOutbox : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. It loads pending entries and starts to observe App active and install register.
+ */
++ (SHRequestOutbox *)sharedInstance;
+
+/** @name Public functions */
+
+/**
+ Add a request into outbox and try to send it.
+ @param method HTTP method, "POST" or "GET".
+ @param path The path or complete url, same as `SHHTTPSessionManager` wrappers.
+ @param hostVersion StreetHawk's request has version /v1, /v2 etc.
+ @param body Request parameters. It must be property list object, as it's stored in `SHStateStore`.
+ @param useJSON YES to send by `SHJSONSessionManager`; NO to send by `SHHTTPSessionManager`.
+ @param idempotencyKey Unique key of this request. If nil a new UUID is used. If an entry with same key is queued, ignore this one.
+ @param coalesceKey Optional. Queued entries with same coalesce key are removed, this one wins.
+ @param notificationName Optional. When the request successfully sent, post this notification with user info {"result": responseObject}.
+ */
+- (void)enqueueMethod:(NSString *)method path:(NSString *)path hostVersion:(SHHostVersion)hostVersion body:(NSDictionary *)body useJSON:(BOOL)useJSON idempotencyKey:(NSString *)idempotencyKey coalesceKey:(NSString *)coalesceKey resultNotification:(NSString *)notificationName;
+
+/**
+ Send entries which are due now. It's called automatically, no need to call it manually.
+ */
+- (void)flush;
+
+/**
+ Check whether a failed request is worth to retry. Transport error in `NSURLErrorDomain` such as timeout, connection lost or no network, throttle (429) and server 5xx are retryable; request rejected by server, or failing before sending such as request serialization, is not.
+ @param error The error of failure callback.
+ @param task The task of failure callback.
+ @return YES if the same request should be sent again later.
+ */
++ (BOOL)isRetryableError:(NSError *)error forTask:(NSURLSessionDataTask *)task;
+
+@end
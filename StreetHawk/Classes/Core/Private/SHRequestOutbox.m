@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHRequestOutbox.h"
+//header from StreetHawk
+#import "SHApp.h" //for `StreetHawk.currentInstall`
+#import "SHInstall.h" //for SHInstallRegistrationSuccessNotification
+#import "SHUtils.h" //for streetHawkIsEnabled
+#import "SHStateStore.h" //for persist outbox
+#import "SHOutboxSchedule.h" //for backoff and timer re-arming
+//header from System
+#import <UIKit/UIKit.h> //for UIApplicationDidBecomeActiveNotification
+
+#define OUTBOX_IDEMPOTENCY_KEY      @"idempotency_key"
+#define OUTBOX_COALESCE_KEY         @"coalesce_key"
+#define OUTBOX_METHOD               @"method"
+#define OUTBOX_PATH                 @"path"
+#define OUTBOX_HOST_VERSION         @"host_version"
+#define OUTBOX_BODY                 @"body"
+#define OUTBOX_USE_JSON             @"use_json"
+#define OUTBOX_NOTIFICATION         @"notification"
+#define OUTBOX_ATTEMPTS             @"attempts"
+#define OUTBOX_NEXT_TIME            @"next_time"
+#define OUTBOX_CREATED_TIME         @"created_time"
+
+#define OUTBOX_MAX_ATTEMPTS         10 //after this many failure, drop the entry.
+#define OUTBOX_MAX_AGE              (7 * 24 * 60 * 60) //entry older than 7 days is meaningless, drop it.
+#define OUTBOX_BASE_DELAY           30 //first retry in 30 seconds, then double each time.
+#define OUTBOX_MAX_DELAY            (6 * 60 * 60) //not wait longer than 6 hours between retries.
+#define OUTBOX_MIN_TIMER_DELAY      1 //timer fires at least 1 second later, not busy loop on due entries.
+
+@interface SHRequestOutbox ()
+{
+    SHOutboxTimer _timerSchedule; //fire time of `flushTimer`, only accessed in `outboxQueue`.
+}
+
+@property (nonatomic, strong) dispatch_queue_t outboxQueue; //all entries access happen in this serial queue.
+@property (nonatomic, strong) NSMutableArray *arrayEntries; //memory copy of SH_REQUEST_OUTBOX, each is mutable dictionary.
+@property (nonatomic, strong) NSMutableSet *setSendingKeys; //idempotency keys of entries being sent, avoid sending twice by concurrent flush.
+@property (nonatomic, strong) dispatch_source_t flushTimer; //one timer for next due entry, re-armed when next deadline changes.
+
+- (void)flushInQueue; //send due entries, must call in `outboxQueue`.
+- (void)sendEntry:(NSDictionary *)entry; //send one entry with idempotency header.
+- (void)finishEntryForKey:(NSString *)idempotencyKey success:(BOOL)isSuccess retryable:(BOOL)isRetryable; //update entry after sending.
+- (void)persistEntries; //write memory entries into state store.
+- (void)scheduleNextFlush; //arm timer for next due entry, earlier or later than current one.
+- (void)appBecomeActiveHandler:(NSNotification *)notification; //retry when App become active, network is likely available.
+- (void)installRegistrationHandler:(NSNotification *)notification; //entries need install id, retry when install registers.
+
+@end
+
+@implementation SHRequestOutbox
+
+#pragma mark - life cycle
+
++ (SHRequestOutbox *)sharedInstance
+{
+    static SHRequestOutbox *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHRequestOutbox alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.outboxQueue = dispatch_queue_create("com.streethawk.StreetHawk.outbox", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/);
+        self.arrayEntries = [NSMutableArray array];
+        NSArray *arraySaved = [[SHStateStore sharedInstance] objectForKey:SH_REQUEST_OUTBOX];
+        if ([arraySaved isKindOfClass:[NSArray class]])
+        {
+            for (NSDictionary *dict in arraySaved)
+            {
+                if ([dict isKindOfClass:[NSDictionary class]] && !shStrIsEmpty(dict[OUTBOX_IDEMPOTENCY_KEY]))
+                {
+                    [self.arrayEntries addObject:[dict mutableCopy]];
+                }
+            }
+        }
+        self.setSendingKeys = [NSMutableSet set];
+        _timerSchedule.fireTime = HUGE_VAL;
+        self.flushTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.outboxQueue);
+        dispatch_source_set_timer(self.flushTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        __weak SHRequestOutbox *weakSelf = self;
+        dispatch_source_set_event_handler(self.flushTimer, ^
+        {
+            SHRequestOutbox *strongSelf = weakSelf;
+            if (strongSelf != nil)
+            {
+                shOutboxTimerFired(&strongSelf->_timerSchedule);
+                [strongSelf flushInQueue];
+            }
+        });
+        dispatch_resume(self.flushTimer);
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appBecomeActiveHandler:) name:UIApplicationDidBecomeActiveNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(installRegistrationHandler:) name:SHInstallRegistrationSuccessNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    dispatch_source_cancel(self.flushTimer);
+}
+
+#pragma mark - public functions
+
+- (void)enqueueMethod:(NSString *)method path:(NSString *)path hostVersion:(SHHostVersion)hostVersion body:(NSDictionary *)body useJSON:(BOOL)useJSON idempotencyKey:(NSString *)idempotencyKey coalesceKey:(NSString *)coalesceKey resultNotification:(NSString *)notificationName
+{
+    NSAssert(!shStrIsEmpty(method) && !shStrIsEmpty(path), @"Outbox entry must have method and path.");
+    if (shStrIsEmpty(method) || shStrIsEmpty(path))
+    {
+        return;
+    }
+    if (shStrIsEmpty(idempotencyKey))
+    {
+        idempotencyKey = [NSUUID UUID].UUIDString;
+    }
+    NSMutableDictionary *entry = [NSMutableDictionary dictionary];
+    entry[OUTBOX_IDEMPOTENCY_KEY] = idempotencyKey;
+    entry[OUTBOX_METHOD] = method;
+    entry[OUTBOX_PATH] = path;
+    entry[OUTBOX_HOST_VERSION] = @(hostVersion);
+    if (body != nil)
+    {
+        entry[OUTBOX_BODY] = body;
+    }
+    entry[OUTBOX_USE_JSON] = @(useJSON);
+    if (!shStrIsEmpty(coalesceKey))
+    {
+        entry[OUTBOX_COALESCE_KEY] = coalesceKey;
+    }
+    if (!shStrIsEmpty(notificationName))
+    {
+        entry[OUTBOX_NOTIFICATION] = notificationName;
+    }
+    entry[OUTBOX_ATTEMPTS] = @(0);
+    entry[OUTBOX_NEXT_TIME] = @(0); //due now
+    entry[OUTBOX_CREATED_TIME] = @([[NSDate date] timeIntervalSinceReferenceDate]);
+    dispatch_async(self.outboxQueue, ^
+    {
+        for (NSDictionary *existing in self.arrayEntries)
+        {
+            if ([existing[OUTBOX_IDEMPOTENCY_KEY] isEqualToString:idempotencyKey])
+            {
+                return; //same request already queued, it will be sent.
+            }
+        }
+        if (!shStrIsEmpty(coalesceKey))
+        {
+            //superseded entries not being sent are removed. The one being sent finishes by its own idempotency key.
+            NSIndexSet *superseded = [self.arrayEntries indexesOfObjectsPassingTest:^BOOL(NSDictionary *existing, NSUInteger idx, BOOL *stop)
+            {
+                return [existing[OUTBOX_COALESCE_KEY] isEqualToString:coalesceKey] && ![self.setSendingKeys containsObject:existing[OUTBOX_IDEMPOTENCY_KEY]];
+            }];
+            [self.arrayEntries removeObjectsAtIndexes:superseded];
+        }
+        [self.arrayEntries addObject:entry];
+        [self persistEntries];
+        [self flushInQueue];
+    });
+}
+
+- (void)flush
+{
+    dispatch_async(self.outboxQueue, ^
+    {
+        [self flushInQueue];
+    });
+}
+
++ (BOOL)isRetryableError:(NSError *)error forTask:(NSURLSessionDataTask *)task
+{
+    if ([task.response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        NSInteger statusCode = ((NSHTTPURLResponse *)task.response).statusCode;
+        return (statusCode == 429/*too many requests*/ || statusCode >= 500);
+    }
+    //not reach server. Only transport problem is worth retry, error such as fail to serialize request fails same way next time.
+    if (![error.domain isEqualToString:NSURLErrorDomain])
+    {
+        return NO;
+    }
+    switch (error.code)
+    {
+        case NSURLErrorTimedOut:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorNotConnectedToInternet:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorInternationalRoamingOff:
+        case NSURLErrorCallIsActive:
+        case NSURLErrorDataNotAllowed:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
+#pragma mark - private functions
+
+- (void)flushInQueue
+{
+    if (!streetHawkIsEnabled() || shStrIsEmpty(StreetHawk.currentInstall.suid))
+    {
+        return; //requests need install id, wait for install register.
+    }
+    NSTimeInterval now = [[NSDate date] timeIntervalSinceReferenceDate];
+    NSIndexSet *expired = [self.arrayEntries indexesOfObjectsPassingTest:^BOOL(NSDictionary *entry, NSUInteger idx, BOOL *stop)
+    {
+        return ![self.setSendingKeys containsObject:entry[OUTBOX_IDEMPOTENCY_KEY]]
+            && ([entry[OUTBOX_ATTEMPTS] integerValue] >= OUTBOX_MAX_ATTEMPTS || now - [entry[OUTBOX_CREATED_TIME] doubleValue] > OUTBOX_MAX_AGE);
+    }];
+    if (expired.count > 0)
+    {
+        SHLog(@"Outbox drops %lu expired requests.", (unsigned long)expired.count);
+        [self.arrayEntries removeObjectsAtIndexes:expired];
+        [self persistEntries];
+    }
+    for (NSDictionary *entry in self.arrayEntries)
+    {
+        if (![self.setSendingKeys containsObject:entry[OUTBOX_IDEMPOTENCY_KEY]] && [entry[OUTBOX_NEXT_TIME] doubleValue] <= now)
+        {
+            [self.setSendingKeys addObject:entry[OUTBOX_IDEMPOTENCY_KEY]];
+            [self sendEntry:[entry copy]];
+        }
+    }
+    [self scheduleNextFlush];
+}
+
+- (void)sendEntry:(NSDictionary *)entry
+{
+    NSString *idempotencyKey = entry[OUTBOX_IDEMPOTENCY_KEY];
+    NSString *notificationName = entry[OUTBOX_NOTIFICATION];
+    SHHTTPSessionManager *sessionManager = [entry[OUTBOX_USE_JSON] boolValue] ? [SHJSONSessionManager sharedInstance] : [SHHTTPSessionManager sharedInstance];
+    [sessionManager requestMethod:entry[OUTBOX_METHOD]
+                        URLString:entry[OUTBOX_PATH]
+                      hostVersion:(SHHostVersion)[entry[OUTBOX_HOST_VERSION] intValue]
+                       parameters:entry[OUTBOX_BODY]
+                          headers:@{@"X-Idempotency-Key": idempotencyKey}
+                          success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+    {
+        dispatch_async(self.outboxQueue, ^
+        {
+            [self finishEntryForKey:idempotencyKey success:YES retryable:NO];
+        });
+        if (!shStrIsEmpty(notificationName))
+        {
+            [[NSNotificationCenter defaultCenter] postNotificationName:notificationName object:nil userInfo:(responseObject != nil) ? @{@"result": responseObject} : nil];
+        }
+    } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
+    {
+        BOOL isRetryable = [SHRequestOutbox isRetryableError:error forTask:task];
+        SHLog(@"Outbox fail to send %@ (%@): %@", entry[OUTBOX_PATH], isRetryable ? @"retry later" : @"dropped", error);
+        dispatch_async(self.outboxQueue, ^
+        {
+            [self finishEntryForKey:idempotencyKey success:NO retryable:isRetryable];
+        });
+    }];
+}
+
+- (void)finishEntryForKey:(NSString *)idempotencyKey success:(BOOL)isSuccess retryable:(BOOL)isRetryable
+{
+    [self.setSendingKeys removeObject:idempotencyKey];
+    NSUInteger index = [self.arrayEntries indexOfObjectPassingTest:^BOOL(NSDictionary *entry, NSUInteger idx, BOOL *stop)
+    {
+        return [entry[OUTBOX_IDEMPOTENCY_KEY] isEqualToString:idempotencyKey];
+    }];
+    if (index == NSNotFound)
+    {
+        return;
+    }
+    if (isSuccess || !isRetryable)
+    {
+        [self.arrayEntries removeObjectAtIndex:index];
+    }
+    else
+    {
+        NSMutableDictionary *entry = self.arrayEntries[index];
+        NSInteger attempts = [entry[OUTBOX_ATTEMPTS] integerValue] + 1;
+        NSTimeInterval delay = shOutboxRetryDelay(attempts, OUTBOX_BASE_DELAY, OUTBOX_MAX_DELAY);
+        entry[OUTBOX_ATTEMPTS] = @(attempts);
+        entry[OUTBOX_NEXT_TIME] = @([[NSDate date] timeIntervalSinceReferenceDate] + delay);
+    }
+    [self persistEntries];
+    [self scheduleNextFlush];
+}
+
+- (void)persistEntries
+{
+    [[SHStateStore sharedInstance] setObject:[self.arrayEntries copy] forKey:SH_REQUEST_OUTBOX];
+}
+
+- (void)scheduleNextFlush
+{
+    //A fresh or short backoff entry behind a long backoff one must not wait for the long timer, so timer follows earliest deadline each time.
+    NSUInteger count = self.arrayEntries.count;
+    double nextTimes[count > 0 ? count : 1];
+    unsigned char isSending[count > 0 ? count : 1];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        NSDictionary *entry = self.arrayEntries[i];
+        nextTimes[i] = [entry[OUTBOX_NEXT_TIME] doubleValue];
+        isSending[i] = [self.setSendingKeys containsObject:entry[OUTBOX_IDEMPOTENCY_KEY]];
+    }
+    NSTimeInterval now = [[NSDate date] timeIntervalSinceReferenceDate];
+    double deadline = shOutboxNextDeadline(nextTimes, isSending, count);
+    if (!shOutboxTimerSchedule(&_timerSchedule, deadline, now, OUTBOX_MIN_TIMER_DELAY))
+    {
+        return; //already fires at that time
+    }
+    if (_timerSchedule.fireTime == HUGE_VAL)
+    {
+        dispatch_source_set_timer(self.flushTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0); //nothing waiting
+        return;
+    }
+    dispatch_source_set_timer(self.flushTimer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)((_timerSchedule.fireTime - now) * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, NSEC_PER_SEC / 10);
+}
+
+- (void)appBecomeActiveHandler:(NSNotification *)notification
+{
+    [self flush];
+}
+
+- (void)installRegistrationHandler:(NSNotification *)notification
+{
+    [self flush];
+}
+
+@end
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ Priority class of a StreetHawk request.
+ */
+enum SHRequestPriority
+{
+    /**
+     Normal requests, such as install register/update and app status.
+     */
+    SHRequestPriority_Default,
+    /**
+     User is waiting for the result, such as feed load, growth share url and feedback. Maps to `NSURLSessionTaskPriorityHigh`.
+     */
+    SHRequestPriority_Interactive,
+    /**
+     Bulk telemetry nobody waits for, such as installs/log upload and crash report. Maps to `NSURLSessionTaskPriorityLow`, and started by `scheduleBackgroundRequest:`.
+     */
+    SHRequestPriority_Background,
+};
+typedef enum SHRequestPriority SHRequestPriority;
+
+/**
+ Schedule requests by priority class, so a big log drain does not delay a feed load.
+
+ Every SDK task gets `NSURLSessionTask.priority` from its class (see `priorityForURL:`). Background class work is started through `scheduleBackgroundRequest:`: while interactive tasks are in flight only one background request runs at a time, otherwise a few run together. Queued background requests start when interactive tasks finish.
+ */
+@interface SHRequestScheduler : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. It starts to observe SDK tasks when created.
+ */
++ (SHRequestScheduler *)sharedInstance;
+
+/** @name Functions */
+
+/**
+ Priority class by request url.
+ @param url The complete request url.
+ @return Priority class.
+ */
++ (SHRequestPriority)priorityForURL:(NSURL *)url;
+
+/**
+ Task priority for a priority class.
+ @param priority Priority class.
+ @return Value for `NSURLSessionTask.priority`.
+ */
++ (float)taskPriorityForPriority:(SHRequestPriority)priority;
+
+/**
+ Start a background class request when allowed.
+ @param request Block to send the request. It's called in an internal queue, and must call `finish` exactly once when the request completes or is not sent at all.
+ */
+- (void)scheduleBackgroundRequest:(void (^)(dispatch_block_t finish))request;
+
+@end
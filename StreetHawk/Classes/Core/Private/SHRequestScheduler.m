@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHRequestScheduler.h"
+//header from StreetHawk
+#import "SHUtils.h" //for SHLog
+#import "SHAFURLSessionManager.h" //for task resume and complete notification
+
+#define SCHEDULER_BACKGROUND_LIMIT_IDLE         3 //concurrent background requests when no interactive task.
+#define SCHEDULER_BACKGROUND_LIMIT_INTERACTIVE  1 //concurrent background requests while interactive task in flight.
+
+@interface SHRequestScheduler ()
+
+@property (nonatomic, strong) dispatch_queue_t schedulerQueue; //all state accessed in this serial queue.
+@property (nonatomic, strong) NSHashTable *interactiveTasks; //interactive tasks in flight, weak so a lost complete notification does not block forever.
+@property (nonatomic, strong) NSMutableArray *arrayPendingRequests; //background requests waiting to start, FIFO.
+@property (nonatomic) NSInteger runningBackgroundCount; //background requests started and not finished.
+
+- (void)taskDidResume:(NSNotification *)notification; //count interactive task.
+- (void)taskDidComplete:(NSNotification *)notification; //remove interactive task and start pending background requests.
+- (void)startPendingRequests; //start as many pending requests as limit allows, must call in `schedulerQueue`.
+
+@end
+
+@implementation SHRequestScheduler
+
+#pragma mark - life cycle
+
++ (SHRequestScheduler *)sharedInstance
+{
+    static SHRequestScheduler *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHRequestScheduler alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.schedulerQueue = dispatch_queue_create("com.streethawk.StreetHawk.scheduler", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/);
+        self.interactiveTasks = [NSHashTable weakObjectsHashTable];
+        self.arrayPendingRequests = [NSMutableArray array];
+        self.runningBackgroundCount = 0;
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(taskDidResume:) name:SHAFNetworkingTaskDidResumeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(taskDidComplete:) name:SHAFNetworkingTaskDidCompleteNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - public functions
+
++ (SHRequestPriority)priorityForURL:(NSURL *)url
+{
+    NSString *path = url.path.lowercaseString;
+    if ([path containsString:@"/installs/log"] || [path hasSuffix:@"/crash"] || [path containsString:@"/crash/"])
+    {
+        return SHRequestPriority_Background;
+    }
+    if ([path containsString:@"/feeds"] //feed load
+        || [path containsString:@"/originate_viral_share"] //growth share url
+        || [path containsString:@"/feedback/submit"]) //user just typed feedback
+    {
+        return SHRequestPriority_Interactive;
+    }
+    return SHRequestPriority_Default;
+}
+
++ (float)taskPriorityForPriority:(SHRequestPriority)priority
+{
+    switch (priority)
+    {
+        case SHRequestPriority_Interactive:
+            return NSURLSessionTaskPriorityHigh;
+        case SHRequestPriority_Background:
+            return NSURLSessionTaskPriorityLow;
+        case SHRequestPriority_Default:
+        default:
+            return NSURLSessionTaskPriorityDefault;
+    }
+}
+
+- (void)scheduleBackgroundRequest:(void (^)(dispatch_block_t finish))request
+{
+    NSAssert(request != nil, @"Background request should not be nil.");
+    if (request == nil)
+    {
+        return;
+    }
+    dispatch_async(self.schedulerQueue, ^
+    {
+        [self.arrayPendingRequests addObject:[request copy]];
+        [self startPendingRequests];
+    });
+}
+
+#pragma mark - private functions
+
+- (void)taskDidResume:(NSNotification *)notification
+{
+    NSURLSessionTask *task = notification.object;
+    if (![task isKindOfClass:[NSURLSessionTask class]] || task.priority < NSURLSessionTaskPriorityHigh)
+    {
+        return;
+    }
+    dispatch_async(self.schedulerQueue, ^
+    {
+        [self.interactiveTasks addObject:task];
+    });
+}
+
+- (void)taskDidComplete:(NSNotification *)notification
+{
+    NSURLSessionTask *task = notification.object;
+    if (![task isKindOfClass:[NSURLSessionTask class]] || task.priority < NSURLSessionTaskPriorityHigh)
+    {
+        return;
+    }
+    dispatch_async(self.schedulerQueue, ^
+    {
+        [self.interactiveTasks removeObject:task];
+        [self startPendingRequests];
+    });
+}
+
+- (void)startPendingRequests
+{
+    NSInteger limit = (self.interactiveTasks.allObjects.count > 0) ? SCHEDULER_BACKGROUND_LIMIT_INTERACTIVE : SCHEDULER_BACKGROUND_LIMIT_IDLE;
+    while (self.arrayPendingRequests.count > 0 && self.runningBackgroundCount < limit)
+    {
+        void (^request)(dispatch_block_t) = self.arrayPendingRequests.firstObject;
+        [self.arrayPendingRequests removeObjectAtIndex:0];
+        self.runningBackgroundCount++;
+        __block BOOL isFinished = NO;
+        request(^
+        {
+            dispatch_async(self.schedulerQueue, ^
+            {
+                NSAssert(!isFinished, @"Background request finishes more than once.");
+                if (!isFinished)
+                {
+                    isFinished = YES;
+                    self.runningBackgroundCount--;
+                    [self startPendingRequests];
+                }
+            });
+        });
+    }
+    if (self.arrayPendingRequests.count > 0)
+    {
+        SHLog(@"%lu background requests wait for interactive requests.", (unsigned long)self.arrayPendingRequests.count);
+    }
+}
+
+@end
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ SDK's own key-value store for internal state, instead of writing App's `[NSUserDefaults standardUserDefaults]` and calling `synchronize` after each write.
+
+ Values live in an in-memory dictionary, read and write are memory operations. Changes are written behind: changes in a short time are coalesced into one record appended to a journal file in /Library/StreetHawk, and the journal is compacted into a snapshot file when it grows. Each record has length and checksum, a torn record from crash is dropped at next load, so the store is always a state which was flushed. App going to background or terminating flushes immediately.
+
+ Values must be property list types, same as NSUserDefaults. When first used, internal keys which previous SDK version saved in NSUserDefaults are moved here and removed from App's defaults. Keys shared with App, customer settings or other SDKs stay in NSUserDefaults.
+ */
+@interface SHStateStore : NSObject
+
+/** @name Creator */
+
+/**
+ Singleton instance. It loads snapshot and journal at first call.
+ */
++ (SHStateStore *)sharedInstance;
+
+/** @name Read */
+
+/**
+ Value for the key, or registered default, or nil.
+ @param key Key of the value.
+ @return Immutable property list value.
+ */
+- (id)objectForKey:(NSString *)key;
+
+/**
+ Bool value for the key, NO if not set or not a number or string.
+ @param key Key of the value.
+ */
+- (BOOL)boolForKey:(NSString *)key;
+
+/**
+ Integer value for the key, 0 if not set or not a number or string.
+ @param key Key of the value.
+ */
+- (NSInteger)integerForKey:(NSString *)key;
+
+/**
+ Double value for the key, 0 if not set or not a number or string.
+ @param key Key of the value.
+ */
+- (double)doubleForKey:(NSString *)key;
+
+/** @name Write */
+
+/**
+ Set value for the key. The value is deep copied so later change of a mutable value does not affect store.
+ @param value Property list value, nil to remove.
+ @param key Key of the value.
+ */
+- (void)setObject:(id)value forKey:(NSString *)key;
+
+/**
+ Remove value of the key, registered default is still returned.
+ @param key Key of the value.
+ */
+- (void)removeObjectForKey:(NSString *)key;
+
+/**
+ Set bool value for the key.
+ */
+- (void)setBool:(BOOL)value forKey:(NSString *)key;
+
+/**
+ Set integer value for the key.
+ */
+- (void)setInteger:(NSInteger)value forKey:(NSString *)key;
+
+/**
+ Set double value for the key.
+ */
+- (void)setDouble:(double)value forKey:(NSString *)key;
+
+/**
+ Register defaults returned when key is not set. Not persisted, same as NSUserDefaults.
+ @param registrationDictionary Key and default value.
+ */
+- (void)registerDefaults:(NSDictionary *)registrationDictionary;
+
+/**
+ Hand pending changes to file writing now without waiting, for state which should not wait for the coalescing delay, such as page history used to recover after crash.
+ */
+- (void)flush;
+
+/**
+ Write pending changes to file now and wait. Normally not needed, changes are flushed in a second and when App goes to background.
+ */
+- (void)synchronize;
+
+/** @name Statistics */
+
+/**
+ Number of values set or removed in this launch. Used to measure how often a feature writes state, changes are coalesced before written to file.
+ */
+@property (nonatomic, readonly) NSUInteger writeCount;
+
+@end
@@ -0,0 +1,509 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHStateStore.h"
+//header from StreetHawk
+#import "SHUtils.h" //for SHLog
+//header from System
+#import <UIKit/UIKit.h> //for App background notification
+#include <fcntl.h> //for open
+#include <unistd.h> //for write, fsync
+
+#define STORE_FLUSH_DELAY           1 //seconds to coalesce changes into one journal record.
+#define STORE_COMPACT_SIZE          (64 * 1024) //journal larger than this is compacted into snapshot.
+#define STORE_RECORD_HEADER_SIZE    8 //uint32 payload length + uint32 checksum, little endian.
+#define STORE_RECORD_SET            @"s" //record payload: changed key -> value.
+#define STORE_RECORD_REMOVE         @"r" //record payload: array of removed keys.
+#define STORE_MIGRATED_KEYS         @"SH_STATESTORE_MIGRATED" //keys already moved from NSUserDefaults, kept in store itself.
+#define STORE_SNAPSHOT_GENERATION   @"g" //snapshot: generation, only journal of the same generation is replayed.
+#define STORE_SNAPSHOT_VALUES       @"v" //snapshot: key -> value.
+
+@interface SHStateStore ()
+
+@property (nonatomic, strong) dispatch_queue_t storeQueue; //memory state accessed in this serial queue.
+@property (nonatomic, strong) dispatch_queue_t ioQueue; //file written in this serial queue, in the same order as changes.
+@property (nonatomic, strong) NSMutableDictionary *dictValues;
+@property (nonatomic, strong) NSMutableDictionary *dictDefaults;
+@property (nonatomic, strong) NSMutableDictionary *dictPending; //key -> new value, or NSNull for removed. Not flushed yet.
+@property (nonatomic) BOOL isFlushScheduled;
+@property (nonatomic) NSUInteger writeCountValue; //accessed in `storeQueue`.
+@property (nonatomic) unsigned long long journalSize; //size after pending flushes, decided in `storeQueue`.
+@property (nonatomic) NSInteger generation; //increased by each compaction, decided in `storeQueue`.
+@property (nonatomic, strong) NSString *storeDirectory;
+@property (nonatomic, strong) NSString *snapshotPath;
+
++ (NSString *)storeDirectory; //create /Library/StreetHawk if not exist.
++ (uint32_t)checksumOfBytes:(const uint8_t *)bytes length:(NSUInteger)length; //FNV-1a, enough to detect a torn record.
++ (NSArray *)keysMigratedFromUserDefaults; //internal keys previous SDK saved in NSUserDefaults.
+- (void)loadFromFile; //read snapshot and replay journal, drop torn tail.
+- (void)migrateFromUserDefaults; //move internal keys out of App's defaults.
+- (void)setValueInQueue:(id)value forKey:(NSString *)key; //value nil to remove, must call in `storeQueue`.
+- (void)flushInQueue; //hand pending changes to `ioQueue`, must call in `storeQueue`.
+- (NSString *)journalPathForGeneration:(NSInteger)generation;
+- (void)appendRecord:(NSData *)payload toJournal:(NSString *)journalPath; //must call in `ioQueue`.
+- (BOOL)writeSnapshot:(NSDictionary *)dictValues generation:(NSInteger)generation; //must call in `ioQueue`. Return NO if snapshot file is not written.
+- (void)removeJournalsBeforeGeneration:(NSInteger)generation; //journals older than snapshot are already in it.
+- (void)appWillLeaveHandler:(NSNotification *)notification; //flush before App is suspended or killed.
+
+@end
+
+@implementation SHStateStore
+
+#pragma mark - life cycle
+
++ (SHStateStore *)sharedInstance
+{
+    static SHStateStore *instance = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^
+    {
+        instance = [[SHStateStore alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        self.storeQueue = dispatch_queue_create("com.streethawk.StreetHawk.statestore", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/);
+        self.ioQueue = dispatch_queue_create("com.streethawk.StreetHawk.statestore.io", NULL/*NULL attribute same as DISPATCH_QUEUE_SERIAL, means this queue is FIFO.*/);
+        self.dictValues = [NSMutableDictionary dictionary];
+        self.dictDefaults = [NSMutableDictionary dictionary];
+        self.dictPending = [NSMutableDictionary dictionary];
+        self.isFlushScheduled = NO;
+        self.writeCountValue = 0;
+        self.journalSize = 0;
+        self.generation = 0;
+        self.storeDirectory = [SHStateStore storeDirectory];
+        self.snapshotPath = [self.storeDirectory stringByAppendingPathComponent:@"state.plist"];
+        [self loadFromFile];
+        [self migrateFromUserDefaults];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appWillLeaveHandler:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appWillLeaveHandler:) name:UIApplicationWillTerminateNotification object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+#pragma mark - public functions
+
+- (id)objectForKey:(NSString *)key
+{
+    if (key == nil)
+    {
+        return nil;
+    }
+    __block id value = nil;
+    dispatch_sync(self.storeQueue, ^
+    {
+        value = self.dictValues[key] ?: self.dictDefaults[key];
+    });
+    return value;
+}
+
+- (BOOL)boolForKey:(NSString *)key
+{
+    id value = [self objectForKey:key];
+    return ([value isKindOfClass:[NSNumber class]] || [value isKindOfClass:[NSString class]]) ? [value boolValue] : NO;
+}
+
+- (NSInteger)integerForKey:(NSString *)key
+{
+    id value = [self objectForKey:key];
+    return ([value isKindOfClass:[NSNumber class]] || [value isKindOfClass:[NSString class]]) ? [value integerValue] : 0;
+}
+
+- (double)doubleForKey:(NSString *)key
+{
+    id value = [self objectForKey:key];
+    return ([value isKindOfClass:[NSNumber class]] || [value isKindOfClass:[NSString class]]) ? [value doubleValue] : 0;
+}
+
+- (void)setObject:(id)value forKey:(NSString *)key
+{
+    NSAssert(key != nil, @"Key should not be nil.");
+    if (key == nil)
+    {
+        return;
+    }
+    id storedValue = nil;
+    if (value != nil)
+    {
+        NSAssert([NSPropertyListSerialization propertyList:value isValidForFormat:NSPropertyListBinaryFormat_v1_0], @"Value for %@ is not property list: %@.", key, value);
+        if (![NSPropertyListSerialization propertyList:value isValidForFormat:NSPropertyListBinaryFormat_v1_0])
+        {
+            return;
+        }
+        storedValue = CFBridgingRelease(CFPropertyListCreateDeepCopy(kCFAllocatorDefault, (__bridge CFPropertyListRef)value, kCFPropertyListImmutable)); //caller may change mutable value later
+    }
+    dispatch_async(self.storeQueue, ^
+    {
+        [self setValueInQueue:storedValue forKey:key];
+    });
+}
+
+- (void)removeObjectForKey:(NSString *)key
+{
+    [self setObject:nil forKey:key];
+}
+
+- (void)setBool:(BOOL)value forKey:(NSString *)key
+{
+    [self setObject:@(value) forKey:key];
+}
+
+- (void)setInteger:(NSInteger)value forKey:(NSString *)key
+{
+    [self setObject:@(value) forKey:key];
+}
+
+- (void)setDouble:(double)value forKey:(NSString *)key
+{
+    [self setObject:@(value) forKey:key];
+}
+
+- (void)registerDefaults:(NSDictionary *)registrationDictionary
+{
+    NSDictionary *dictDefaults = [registrationDictionary copy];
+    dispatch_sync(self.storeQueue, ^
+    {
+        [self.dictDefaults addEntriesFromDictionary:dictDefaults];
+    });
+}
+
+- (NSUInteger)writeCount
+{
+    __block NSUInteger count = 0;
+    dispatch_sync(self.storeQueue, ^
+    {
+        count = self.writeCountValue;
+    });
+    return count;
+}
+
+- (void)flush
+{
+    dispatch_async(self.storeQueue, ^
+    {
+        [self flushInQueue];
+    });
+}
+
+- (void)synchronize
+{
+    dispatch_sync(self.storeQueue, ^
+    {
+        [self flushInQueue];
+    });
+    dispatch_sync(self.ioQueue, ^{}); //wait for file written.
+}
+
+#pragma mark - private functions
+
++ (NSString *)storeDirectory
+{
+    NSArray *libraryDirs = NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask, YES);  //use /Library because it can be backup and restore by iTunes, same as log db.
+    NSString *streetHawkDir = [libraryDirs[0] stringByAppendingPathComponent:@"StreetHawk"];
+    NSError *error;
+    if (![[NSFileManager defaultManager] createDirectoryAtPath:streetHawkDir withIntermediateDirectories:YES attributes:nil error:&error])
+    {
+        NSLog(@"Fail to create /Library/StreetHawk dictionary: %@.", error.localizedDescription);
+    }
+    return streetHawkDir;
+}
+
++ (uint32_t)checksumOfBytes:(const uint8_t *)bytes length:(NSUInteger)length
+{
+    uint32_t hash = 2166136261u;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
++ (NSArray *)keysMigratedFromUserDefaults
+{
+    //Only SDK internal state. Keys read by App, customer settings (ENABLE_LOCATION_SERVICE etc.), install id, push token and module flags shared with other SDKs stay in NSUserDefaults.
+    return @[@"MAX_LOGID", @"FGBG_SESSION", @"ENTER_PAGE_HISTORY", @"ENTERBAK_PAGE_HISTORY", @"EXIT_PAGE_HISTORY",
+             @"REGULAR_HEARTBEAT_LOGTIME", @"REGULAR_LOCATION_LOGTIME", @"LOCATION_DENIED_SENT", @"NETWORK_RECOVER_TIME",
+             @"APPSTATUS_STREETHAWKENABLED", @"APPSTATUS_ALIVE_HOST", @"APPSTATUS_GROWTH_HOST", @"APPSTATUS_UPLOAD_LOCATION",
+             @"APPSTATUS_SUBMIT_FRIENDLYNAME", @"APPSTATUS_SUBMIT_INTERACTIVEBUTTONS", @"APPSTATUS_REREGISTER", @"APPSTATUS_APPSTOREID",
+             @"APPSTATUS_DISABLECODES", @"APPSTATUS_PRIORITYCODES", @"APPSTATUS_CHECK_TIME", @"APPSTATUS_ROUTE_CHECK_TIME",
+             @"APPSTATUS_IBEACON_FETCH_TIME", @"APPSTATUS_IBEACON_FETCH_LIST", @"APPSTATUS_GEOFENCE_FETCH_TIME", @"APPSTATUS_GEOFENCE_FETCH_LIST", @"APPSTATUS_FEED_FETCH_TIME",
+             @"SH_GEOFENCE_LATLNG_SENTTIME",
+             @"SentInstall_AppKey", @"SentInstall_ClientVersion", @"SentInstall_ShVersion", @"SentInstall_Mode", @"SentInstall_Carrier", @"SentInstall_OSVersion", @"SentInstall_IBeacon",
+             @"SH_REQUEST_OUTBOX",
+             @"Previous_Visible_Time", @"Previous_Visible_Status", @"RouteChecked", @"NumTimesAppUsed", @"TAG_SHLANGUAGE", @"SETTING_UTC_OFFSET",
+             @"CrashLog_MD5", @"APNS_SENT_DISABLE_TIMESTAMP", @"SPOTLIGHT_DEEPLINKING_MAPPING", @"GROWTH_REGISTERED"];
+}
+
+- (void)loadFromFile
+{
+    NSData *snapshotData = [NSData dataWithContentsOfFile:self.snapshotPath];
+    if (snapshotData != nil)
+    {
+        NSError *error = nil;
+        NSDictionary *dictSnapshot = [NSPropertyListSerialization propertyListWithData:snapshotData options:NSPropertyListImmutable format:NULL error:&error];
+        if ([dictSnapshot isKindOfClass:[NSDictionary class]] && [dictSnapshot[STORE_SNAPSHOT_VALUES] isKindOfClass:[NSDictionary class]])
+        {
+            self.generation = [dictSnapshot[STORE_SNAPSHOT_GENERATION] integerValue];
+            [self.dictValues addEntriesFromDictionary:dictSnapshot[STORE_SNAPSHOT_VALUES]];
+        }
+        else
+        {
+            SHLog(@"Fail to read state snapshot: %@.", error);
+        }
+    }
+    //crash after compaction may leave journals of old generations, they are already in snapshot.
+    [self removeJournalsBeforeGeneration:self.generation];
+    //if a compaction failed to write snapshot, its newer journal continues from this generation, replay it too.
+    NSString *journalPath = [self journalPathForGeneration:self.generation];
+    while (YES)
+    {
+        NSData *journalData = [NSData dataWithContentsOfFile:journalPath];
+        const uint8_t *bytes = journalData.bytes;
+        NSUInteger offset = 0;
+        while (offset + STORE_RECORD_HEADER_SIZE <= journalData.length)
+        {
+            uint32_t payloadLength = CFSwapInt32LittleToHost(*(const uint32_t *)(bytes + offset));
+            uint32_t checksum = CFSwapInt32LittleToHost(*(const uint32_t *)(bytes + offset + 4));
+            if (offset + STORE_RECORD_HEADER_SIZE + payloadLength > journalData.length
+                || [SHStateStore checksumOfBytes:bytes + offset + STORE_RECORD_HEADER_SIZE length:payloadLength] != checksum)
+            {
+                break; //torn record written when crash, records after it cannot be trusted.
+            }
+            NSData *payload = [journalData subdataWithRange:NSMakeRange(offset + STORE_RECORD_HEADER_SIZE, payloadLength)];
+            NSDictionary *dictRecord = [NSPropertyListSerialization propertyListWithData:payload options:NSPropertyListImmutable format:NULL error:nil];
+            if (![dictRecord isKindOfClass:[NSDictionary class]])
+            {
+                break;
+            }
+            [self.dictValues addEntriesFromDictionary:dictRecord[STORE_RECORD_SET]];
+            [self.dictValues removeObjectsForKeys:dictRecord[STORE_RECORD_REMOVE] ?: @[]];
+            offset += STORE_RECORD_HEADER_SIZE + payloadLength;
+        }
+        if (offset < journalData.length)
+        {
+            SHLog(@"Drop %lu bytes of torn state journal.", (unsigned long)(journalData.length - offset));
+            truncate(journalPath.fileSystemRepresentation, (off_t)offset);
+        }
+        self.journalSize = offset;
+        NSString *nextJournalPath = [self journalPathForGeneration:self.generation + 1];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:nextJournalPath])
+        {
+            break;
+        }
+        self.generation++;
+        journalPath = nextJournalPath;
+    }
+}
+
+- (void)migrateFromUserDefaults
+{
+    NSString *bundleId = [NSBundle mainBundle].bundleIdentifier;
+    NSDictionary *dictPersisted = (bundleId != nil) ? [[NSUserDefaults standardUserDefaults] persistentDomainForName:bundleId] : nil; //not registered defaults
+    NSArray *arrayMigrated = self.dictValues[STORE_MIGRATED_KEYS] ?: @[];
+    NSMutableArray *arrayNewMigrated = [NSMutableArray array];
+    for (NSString *key in [SHStateStore keysMigratedFromUserDefaults])
+    {
+        if ([arrayMigrated containsObject:key])
+        {
+            continue;
+        }
+        id value = dictPersisted[key];
+        if (value != nil)
+        {
+            if (self.dictValues[key] == nil)
+            {
+                [self setValueInQueue:value forKey:key];
+            }
+            [[NSUserDefaults standardUserDefaults] removeObjectForKey:key];
+        }
+        [arrayNewMigrated addObject:key];
+    }
+    if (arrayNewMigrated.count > 0)
+    {
+        SHLog(@"Move %lu internal keys from NSUserDefaults to state store.", (unsigned long)arrayNewMigrated.count);
+        [self setValueInQueue:[arrayMigrated arrayByAddingObjectsFromArray:arrayNewMigrated] forKey:STORE_MIGRATED_KEYS];
+        [self flushInQueue];
+        dispatch_sync(self.ioQueue, ^{}); //make sure values are in store file before remove from App's defaults.
+        [[NSUserDefaults standardUserDefaults] synchronize];
+    }
+}
+
+- (void)setValueInQueue:(id)value forKey:(NSString *)key
+{
+    self.writeCountValue ++;
+    if (value != nil)
+    {
+        self.dictValues[key] = value;
+    }
+    else
+    {
+        [self.dictValues removeObjectForKey:key];
+    }
+    self.dictPending[key] = value ?: [NSNull null];
+    if (!self.isFlushScheduled)
+    {
+        self.isFlushScheduled = YES;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(STORE_FLUSH_DELAY * NSEC_PER_SEC)), self.storeQueue, ^
+        {
+            [self flushInQueue];
+        });
+    }
+}
+
+- (void)flushInQueue
+{
+    self.isFlushScheduled = NO;
+    if (self.dictPending.count == 0)
+    {
+        return;
+    }
+    NSMutableDictionary *dictSet = [NSMutableDictionary dictionary];
+    NSMutableArray *arrayRemove = [NSMutableArray array];
+    [self.dictPending enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop)
+    {
+        if (value == [NSNull null])
+        {
+            [arrayRemove addObject:key];
+        }
+        else
+        {
+            dictSet[key] = value;
+        }
+    }];
+    [self.dictPending removeAllObjects];
+    NSError *error = nil;
+    NSData *payload = [NSPropertyListSerialization dataWithPropertyList:@{STORE_RECORD_SET: dictSet, STORE_RECORD_REMOVE: arrayRemove} format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    NSAssert(payload != nil, @"Fail to serialize state record: %@.", error);
+    if (payload == nil)
+    {
+        return;
+    }
+    if (self.journalSize + STORE_RECORD_HEADER_SIZE + payload.length > STORE_COMPACT_SIZE)
+    {
+        //snapshot of memory already contains this record, write it and start an empty journal.
+        NSDictionary *dictSnapshot = [self.dictValues copy];
+        NSString *previousJournalPath = [self journalPathForGeneration:self.generation];
+        self.generation++;
+        self.journalSize = 0;
+        NSInteger generation = self.generation;
+        dispatch_async(self.ioQueue, ^
+        {
+            if (![self writeSnapshot:dictSnapshot generation:generation])
+            {
+                //old snapshot and journal stay, keep this record after them. Next load replays old journal then continues into the new one, `ioQueue` keeps the order.
+                [self appendRecord:payload toJournal:previousJournalPath];
+            }
+        });
+    }
+    else
+    {
+        self.journalSize += STORE_RECORD_HEADER_SIZE + payload.length;
+        NSString *journalPath = [self journalPathForGeneration:self.generation];
+        dispatch_async(self.ioQueue, ^
+        {
+            [self appendRecord:payload toJournal:journalPath];
+        });
+    }
+}
+
+- (NSString *)journalPathForGeneration:(NSInteger)generation
+{
+    return [self.storeDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"state.%ld.journal", (long)generation]];
+}
+
+- (void)appendRecord:(NSData *)payload toJournal:(NSString *)journalPath
+{
+    uint32_t header[2];
+    header[0] = CFSwapInt32HostToLittle((uint32_t)payload.length);
+    header[1] = CFSwapInt32HostToLittle([SHStateStore checksumOfBytes:payload.bytes length:payload.length]);
+    NSMutableData *record = [NSMutableData dataWithBytes:header length:STORE_RECORD_HEADER_SIZE];
+    [record appendData:payload];
+    int fd = open(journalPath.fileSystemRepresentation, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        SHLog(@"Fail to open state journal, errno %d.", errno);
+        return;
+    }
+    const uint8_t *bytes = record.bytes;
+    NSUInteger written = 0;
+    while (written < record.length)
+    {
+        ssize_t result = write(fd, bytes + written, record.length - written);
+        if (result <= 0)
+        {
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            SHLog(@"Fail to write state journal, errno %d.", errno); //partial record is dropped at next load.
+            break;
+        }
+        written += result;
+    }
+    fsync(fd);
+    close(fd);
+}
+
+- (BOOL)writeSnapshot:(NSDictionary *)dictValues generation:(NSInteger)generation
+{
+    NSError *error = nil;
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:@{STORE_SNAPSHOT_GENERATION: @(generation), STORE_SNAPSHOT_VALUES: dictValues} format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    //Atomic write is a rename, snapshot file is either old or new. Old snapshot pairs with old journal, new snapshot with the new empty journal, so a crash at any point loads a flushed state.
+    if (data == nil || ![data writeToFile:self.snapshotPath options:NSDataWritingAtomic | NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication error:&error])
+    {
+        SHLog(@"Fail to write state snapshot: %@.", error);
+        return NO;
+    }
+    [self removeJournalsBeforeGeneration:generation];
+    return YES;
+}
+
+- (void)removeJournalsBeforeGeneration:(NSInteger)generation
+{
+    //a failed compaction leaves its journal behind, so older journals than generation - 1 can exist.
+    for (NSString *fileName in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.storeDirectory error:nil])
+    {
+        if (![fileName hasPrefix:@"state."] || ![fileName hasSuffix:@".journal"])
+        {
+            continue;
+        }
+        NSScanner *scanner = [NSScanner scannerWithString:fileName];
+        scanner.scanLocation = @"state.".length;
+        NSInteger journalGeneration = 0;
+        if ([scanner scanInteger:&journalGeneration] && [[fileName substringFromIndex:scanner.scanLocation] isEqualToString:@".journal"] && journalGeneration < generation)
+        {
+            [[NSFileManager defaultManager] removeItemAtPath:[self.storeDirectory stringByAppendingPathComponent:fileName] error:nil];
+        }
+    }
+}
+
+- (void)appWillLeaveHandler:(NSNotification *)notification
+{
+    [self synchronize];
+}
+
+@end
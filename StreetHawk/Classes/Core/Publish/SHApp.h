@@ -122,6 +122,13 @@ typedef void (^SHOpenUrlHandler)(NSURL * _Nullable openUrl);
  */
 @property (nonatomic) BOOL isDebugMode;
 
+/**
+ Point all StreetHawk hosts to a stand-in server, for example @"http://192.168.1.10:8080" which runs `standin_server.py` in this repository. It's for load and regression testing only, never set it in a released App.
+ When set, requests go to "<hostOverride>/v1", "<hostOverride>/v2", "<hostOverride>/v3"; growth goes to "<hostOverride>/growth"; route check goes to "<hostOverride>/v1/apps/status". Host switching by `app_status` is ignored.
+ It must be set before `registerInstallForApp`. If not set by code, try Info.plist key "SH_HOST_OVERRIDE".
+ */
+@property (nonatomic, strong, nullable) NSString *hostOverride;
+
 /**
  The App id after register in iTunes, for example @"337064413". It used for rating and upgrading App, if this id is not setup, rating or upgrading dialog will not promote.
  */
@@ -137,6 +144,16 @@ The application version and build version of current Application, formatted as @
  */
 @property (nonatomic, strong, readonly, nonnull) NSString *version;
 
+/**
+ Time in seconds StreetHawk SDK spends in main thread during App launch: bridges, local db check, logger, location manager, crash reporter and launch handling. Work not needed for the first frame, such as tags, time zone check and retry of previous requests, runs later when main thread is idle and is not counted. Use it to keep SDK's launch cost within budget; a warning is printed in debug mode when it exceeds 50 ms.
+ */
+@property (nonatomic, readonly) NSTimeInterval launchCost;
+
+/**
+ Launch phases in start order, including idle time tasks. Each item is a dictionary: "phase" is the name, "start" is seconds since SDK loads, "duration" is seconds the phase takes, "deferred" is whether it ran in idle time.
+ */
+@property (nonatomic, strong, readonly, nonnull) NSArray *launchTimeline;
+
 /**
  Before successfully install, it's nil. After install once, it's the install instance.
  */
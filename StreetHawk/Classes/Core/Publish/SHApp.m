@@ -25,7 +25,13 @@
 #import "SHDeepLinking.h"
 #import "SHFriendlyNameObject.h"
 #import "SHUtils.h"
-#import "SHHTTPSessionManager.h" //for set header "X-Installid"
+#import "SHHTTPSessionManager.h" //for send request
+#import "SHEndpointContext.h" //for rebuild "X-Installid" and "installid" query
+#import "SHRequestOutbox.h" //for retry non-log requests
+#import "SHStateStore.h" //for sent install values
+#import "SHLaunchTracer.h" //for launch phases and idle time tasks
+#import "SHPageTracker.h" //for page enter/exit history
+#import "SHFriendlyNameRegistry.h" //for friendly name index
 //header from System
 #import <CoreSpotlight/CoreSpotlight.h> //for spotlight search
 #import <MobileCoreServices/MobileCoreServices.h> //for kUTTypeImage
@@ -34,9 +40,6 @@
 
 #define APPKEY_KEY                          @"APPKEY_KEY" //key for store "app key", next time if try to read appKey before register, read from this one.
 #define INSTALL_SUID_KEY                    @"INSTALL_SUID_KEY"
-#define ENTER_PAGE_HISTORY                  @"ENTER_PAGE_HISTORY"  //key for record entered page history. It's set when enter a page and cleared when send exit log except go BG.
-#define ENTERBAK_PAGE_HISTORY               @"ENTERBAK_PAGE_HISTORY" //key for record entered page history as backup. It's set as backup in case ENTER_PAGE_HISTORY not set in canceled pop up.
-#define EXIT_PAGE_HISTORY                   @"EXIT_PAGE_HISTORY"  //key for record send exit log history. It's set when send exit log and cleared when send enter log. This is to avoid send duplicated exit log.
 
 #define ADS_IDENTIFIER                      @"ADS_IDENTIFIER" //user pass in advertising identifier
 #define ADS_CUSTOMERSET                     @"ADS_CUSTOMERSET" //customer manually set so not do automatically capture
@@ -145,6 +148,7 @@
     //To fix this, before everything starts (as load function register class to runtime), register `UIApplicationDidFinishLaunchingNotification` and delay send again in 2 seconds.
     //To keep compatible with native and xamarin, a flag is added to avoid twice call.
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(delaySendLaunchOptions:) name:UIApplicationDidFinishLaunchingNotification object:nil];
+    [SHLaunchTracer sharedInstance]; //zero point of launch timeline.
 }
 
 + (void)delaySendLaunchOptions:(NSNotification *)notification
@@ -168,65 +172,68 @@
     if (!instance.isBridgeInitCalled)
     {
         instance.isBridgeInitCalled = YES;
-        //add module init bridges. This is automatically for native, Phonegap, Xamarin.
-        //In case cannot reflect bridge class, customer need to manually add notification observer.
-        //disable warning as this selector is defined in sub-module category.
+        [[SHLaunchTracer sharedInstance] tracePhase:@"bridges" block:^
+        {
+            //add module init bridges. This is automatically for native, Phonegap, Xamarin.
+            //In case cannot reflect bridge class, customer need to manually add notification observer.
+            //disable warning as this selector is defined in sub-module category.
 #pragma GCC diagnostic push
 #pragma clang diagnostic push
 #pragma GCC diagnostic ignored "-Wundeclared-selector"
 #pragma clang diagnostic ignored "-Wundeclared-selector"
-        Class growthBridge = NSClassFromString(@"SHGrowthBridge");
-        NSLog(@"Bridge for growth: %@.", growthBridge); //cannot use SHLog as this place `isDebugMode` not configured yet. Use NSLog to make sure prints important bridge message.
-        if (growthBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:growthBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class notificationBridge = NSClassFromString(@"SHNotificationBridge");
-        NSLog(@"Bridge for notification: %@.", notificationBridge);
-        if (notificationBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:notificationBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class locationBridge = NSClassFromString(@"SHLocationBridge");
-        NSLog(@"Bridge for location: %@.", locationBridge);
-        if (locationBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:locationBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class geofenceBridge = NSClassFromString(@"SHGeofenceBridge");
-        NSLog(@"Bridge for geofence: %@.", geofenceBridge);
-        if (geofenceBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:geofenceBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class beaconBridge = NSClassFromString(@"SHBeaconBridge");
-        NSLog(@"Bridge for beacon: %@.", beaconBridge);
-        if (beaconBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:beaconBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class feedBridge = NSClassFromString(@"SHFeedBridge");
-        NSLog(@"Bridge for feed: %@.", feedBridge);
-        if (feedBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:feedBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class crashBridge = NSClassFromString(@"SHCrashBridge");
-        NSLog(@"Bridge for crash: %@.", crashBridge);
-        if (crashBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:crashBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
-        Class pointziBridge = NSClassFromString(@"SHPointziBridge");
-        NSLog(@"Bridge for pointzi: %@.", pointziBridge);
-        if (pointziBridge)
-        {
-            [[NSNotificationCenter defaultCenter] addObserver:pointziBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
-        }
+            Class growthBridge = NSClassFromString(@"SHGrowthBridge");
+            NSLog(@"Bridge for growth: %@.", growthBridge); //cannot use SHLog as this place `isDebugMode` not configured yet. Use NSLog to make sure prints important bridge message.
+            if (growthBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:growthBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class notificationBridge = NSClassFromString(@"SHNotificationBridge");
+            NSLog(@"Bridge for notification: %@.", notificationBridge);
+            if (notificationBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:notificationBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class locationBridge = NSClassFromString(@"SHLocationBridge");
+            NSLog(@"Bridge for location: %@.", locationBridge);
+            if (locationBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:locationBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class geofenceBridge = NSClassFromString(@"SHGeofenceBridge");
+            NSLog(@"Bridge for geofence: %@.", geofenceBridge);
+            if (geofenceBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:geofenceBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class beaconBridge = NSClassFromString(@"SHBeaconBridge");
+            NSLog(@"Bridge for beacon: %@.", beaconBridge);
+            if (beaconBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:beaconBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class feedBridge = NSClassFromString(@"SHFeedBridge");
+            NSLog(@"Bridge for feed: %@.", feedBridge);
+            if (feedBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:feedBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class crashBridge = NSClassFromString(@"SHCrashBridge");
+            NSLog(@"Bridge for crash: %@.", crashBridge);
+            if (crashBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:crashBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
+            Class pointziBridge = NSClassFromString(@"SHPointziBridge");
+            NSLog(@"Bridge for pointzi: %@.", pointziBridge);
+            if (pointziBridge)
+            {
+                [[NSNotificationCenter defaultCenter] addObserver:pointziBridge selector:@selector(bridgeHandler:) name:SH_InitBridge_Notification object:nil];
+            }
 #pragma GCC diagnostic pop
 #pragma clang diagnostic pop
-        //finally post notification to let bridge ready.
-        [[NSNotificationCenter defaultCenter] postNotificationName:SH_InitBridge_Notification object:nil];
+            //finally post notification to let bridge ready.
+            [[NSNotificationCenter defaultCenter] postNotificationName:SH_InitBridge_Notification object:nil];
+        }];
     }
     
     return instance;
@@ -240,14 +247,16 @@
         self.isRegisterInstallForAppCalled = NO;
         self.isFinishLaunchOptionCalled = NO;
         //Check local SQLite database and NSUserDefaults at first time before any call. If not match next will be treat as a new install. This is only checked when launch App, not check during App running. Check Apns mode also.
-        [SHLogger checkLogdbForFreshInstall];
-        [SHLogger checkSentApnsModeForFreshInstall];
+        [[SHLaunchTracer sharedInstance] tracePhase:@"freshInstallCheck" block:^
+        {
+            [SHLogger checkLogdbForFreshInstall];
+            [SHLogger checkSentApnsModeForFreshInstall];
+        }];
         //New launch makes lat/lng to be (0, 0), as must have location bridge to update them.
         [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:SH_GEOLOCATION_LAT];
         [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:SH_GEOLOCATION_LNG];
         [[NSUserDefaults standardUserDefaults] setObject:@(0)/*CBCentralManagerStateUnknown*/ forKey:SH_BEACON_BLUETOOTH];
         [[NSUserDefaults standardUserDefaults] setObject:@(3)/*SHiBeaconState_Ignore*/ forKey:SH_BEACON_iBEACON];
-        [[NSUserDefaults standardUserDefaults] synchronize];
         //Then continue normal code.
         self.isDebugMode = NO;
         self.backgroundQueue = [[NSOperationQueue alloc] init];
@@ -280,6 +289,14 @@
     {
         registerAppKey = [[NSBundle mainBundle] objectForInfoDictionaryKey:@"APP_KEY"];
     }
+    if (shStrIsEmpty(self.hostOverride)) //testing stand-in server, can set SH_HOST_OVERRIDE in Info.plist.
+    {
+        self.hostOverride = [[NSBundle mainBundle] objectForInfoDictionaryKey:@"SH_HOST_OVERRIDE"];
+    }
+    if (!shStrIsEmpty(self.hostOverride))
+    {
+        NSLog(@"WARNING: StreetHawk hosts are overridden by %@. Only use it for testing.", self.hostOverride);
+    }
     if (!shStrIsEmpty(registerAppKey))
     {
         StreetHawk.appKey = registerAppKey;
@@ -293,33 +310,63 @@
     dispatch_block_t action = ^
     {
         //initialize handlers
-        self.innerLogger = [[SHLogger alloc] init];  //this creates logs db, wait till user call `registerInstallForApp` to take action. logger must before location manager, because location manager create and start to send log, for example failure, and logger must be ready.
-        [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_CreateLocationManager" object:nil];
-        [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_CrashBridge_CreateObject" object:nil];
+        SHLaunchTracer *launchTracer = [SHLaunchTracer sharedInstance];
+        [launchTracer tracePhase:@"logger" block:^
+        {
+            self.innerLogger = [[SHLogger alloc] init];  //this creates logs db, wait till user call `registerInstallForApp` to take action. logger must before location manager, because location manager create and start to send log, for example failure, and logger must be ready.
+        }];
+        [launchTracer tracePhase:@"locationManager" block:^
+        {
+            [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_CreateLocationManager" object:nil]; //not defer, location launch needs it in `applicationDidFinishLaunching`.
+        }];
+        [launchTracer tracePhase:@"crashReporter" block:^
+        {
+            [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_CrashBridge_CreateObject" object:nil]; //not defer, crash in first seconds must be caught too.
+        }];
         //do analytics for application first run/started
-        BOOL isAppFirstLaunch = ([[NSUserDefaults standardUserDefaults] integerForKey:@"NumTimesAppUsed"] == 0);
-        if (isAppFirstLaunch)
+        [launchTracer tracePhase:@"launchLog" block:^
         {
-            [StreetHawk sendLogForCode:LOG_CODE_APP_LAUNCH withComment:@"App first run"];
-            [[NSUserDefaults standardUserDefaults] setInteger:1 forKey:@"NumTimesAppUsed"];
-        }
-        else
+            BOOL isAppFirstLaunch = ([[SHStateStore sharedInstance] integerForKey:@"NumTimesAppUsed"] == 0);
+            if (isAppFirstLaunch)
+            {
+                [StreetHawk sendLogForCode:LOG_CODE_APP_LAUNCH withComment:@"App first run"];
+                [[SHStateStore sharedInstance] setInteger:1 forKey:@"NumTimesAppUsed"];
+            }
+            else
+            {
+                [StreetHawk sendLogForCode:LOG_CODE_APP_LAUNCH withComment:@"App started and engine initialized"];
+            }
+        }];
+        //Below are not needed for first frame, run when main thread is idle.
+        [launchTracer deferTask:@"requestOutbox" dependencies:nil block:^
         {
-            [StreetHawk sendLogForCode:LOG_CODE_APP_LAUNCH withComment:@"App started and engine initialized"];
-        }
+            [[SHRequestOutbox sharedInstance] flush]; //load requests not sent in previous launch and retry them.
+        }];
+        //check time zone and register for later change
+        [launchTracer deferTask:@"utcOffset" dependencies:nil block:^
+        {
+            [self checkUtcOffsetUpdate];
+        }];
+        //Tags below go after retried requests, so an old tag from previous launch does not overwrite current value.
         //send sh_language automatically only once for an install. Not put inside "isAppFirstLaunch" branch because this is newly added after "isAppFirstLaunch", so if it's inside above branch, it won't tag for existing Apps.
-        if ([[NSUserDefaults standardUserDefaults] integerForKey:@"TAG_SHLANGUAGE"] == 0)
+        [launchTracer deferTask:@"languageTag" dependencies:@[@"requestOutbox"] block:^
         {
-            [StreetHawk tagUserLanguage:nil];
-            [[NSUserDefaults standardUserDefaults] setInteger:1 forKey:@"TAG_SHLANGUAGE"];
-        }
-        [[NSUserDefaults standardUserDefaults] synchronize];
-        //check time zone and register for later change
-        [self checkUtcOffsetUpdate];
+            if ([[SHStateStore sharedInstance] integerForKey:@"TAG_SHLANGUAGE"] == 0)
+            {
+                [StreetHawk tagUserLanguage:nil];
+                [[SHStateStore sharedInstance] setInteger:1 forKey:@"TAG_SHLANGUAGE"];
+            }
+        }];
         //check current build include which modules and send tags.
-        [self sendModuleTags];
+        [launchTracer deferTask:@"moduleTags" dependencies:@[@"requestOutbox"] block:^
+        {
+            [self sendModuleTags];
+        }];
         //capture advertising identifier in case customer enables AdSupport.framework.
-        [self autoCaptureAdvertisingIdentifierTags];
+        [launchTracer deferTask:@"advertisingIdentifier" dependencies:@[@"requestOutbox"] block:^
+        {
+            [self autoCaptureAdvertisingIdentifierTags];
+        }];
         //setup intercept app delegate
         if (self.autoIntegrateAppDelegate)
         {
@@ -336,7 +383,7 @@
     };
     //Get router for App's first launch. Must use another key instead of "NumTimesAppUsed", which is already used by previous launch.
     //When upgrade to multiple server SDK version, must do router check once.
-    BOOL routeChecked = [[NSUserDefaults standardUserDefaults] boolForKey:@"RouteChecked"];
+    BOOL routeChecked = [[SHStateStore sharedInstance] boolForKey:@"RouteChecked"];
     if (!routeChecked)
     {
         //Do route check for first launch, and must wait until this is done to continue.
@@ -344,8 +391,7 @@
         {
             if (!shStrIsEmpty(hostUrl)) //in case fail to get host url, give another try later.
             {
-                [[NSUserDefaults standardUserDefaults] setObject:@(YES) forKey:@"RouteChecked"];
-                [[NSUserDefaults standardUserDefaults] synchronize];
+                [[SHStateStore sharedInstance] setObject:@(YES) forKey:@"RouteChecked"];
             }
             if (isEnabled && !shStrIsEmpty(hostUrl))
             {
@@ -430,6 +476,16 @@
     return @"1.10.2-beta+20180717140923";
 }
 
+- (NSTimeInterval)launchCost
+{
+    return [SHLaunchTracer sharedInstance].launchCost;
+}
+
+- (NSArray *)launchTimeline
+{
+    return [SHLaunchTracer sharedInstance].timeline;
+}
+
 - (SHInstall *)currentInstall
 {
     if (_currentInstall == nil)
@@ -451,6 +507,7 @@
         //cache install id locally
         [[NSUserDefaults standardUserDefaults] setObject:(_currentInstall!=nil) ? _currentInstall.suid : @""/*if install is invalid, need to clear local cache*/ forKey:INSTALL_SUID_KEY];
         [[NSUserDefaults standardUserDefaults] synchronize];
+        [SHEndpointContext rebuild]; //next request uses new install id in header and query.
     }
 }
 
@@ -517,6 +574,7 @@
     }
     [[NSUserDefaults standardUserDefaults] setObject:arrayFriendlyNames forKey:FRIENDLYNAME_KEY];
     [[NSUserDefaults standardUserDefaults] synchronize];
+    [[SHFriendlyNameRegistry sharedInstance] setFriendlyNames:arrayFriendlyNames]; //rebuild index, later lookup not read NSUserDefaults.
     //Following should NOT trigger on an Apple Store version, it should ONLY happen on debug.
     if (StreetHawk.isDebugMode && shAppMode() != SHAppMode_AppStore && shAppMode() != SHAppMode_Enterprise /*Some customer always set debug mode = YES, but AppStore version should not always send friendly names*/
         && ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground)/*avoid send when App wake up in background. Here cannot use Active, its status is InActive for normal launch, Background for location launch.*/)
@@ -571,11 +629,11 @@
     {
         //Exit page name should match history traced enter page name.
         page = [SHFriendlyNameObject tryFriendlyName:page];  //friendly name is used in notification scenario
-        NSString *enterPage = [[NSUserDefaults standardUserDefaults] objectForKey:ENTER_PAGE_HISTORY]; //ENTER_PAGE_HISTORY is setup in viewDidAppear, normally it's called but one exception is canceled pop up, which only call viewWillAppear but not call viewDidAppear.
+        NSString *enterPage = [SHPageTracker sharedInstance].enterPage; //enter page is setup in viewDidAppear, normally it's called but one exception is canceled pop up, which only call viewWillAppear but not call viewDidAppear.
         //https://bitbucket.org/shawk/streethawk/issue/627/testfest1-assert-exit-page
         if (enterPage == nil || enterPage.length == 0) //in canceled pop up viewWillAppear called but viewDidAppear not called, use backup enter.
         {
-            enterPage = [[NSUserDefaults standardUserDefaults] objectForKey:ENTERBAK_PAGE_HISTORY];
+            enterPage = [SHPageTracker sharedInstance].enterBackupPage;
             enterPage = [SHFriendlyNameObject tryFriendlyName:enterPage]; //viewWillAppear record class vc, try using friendly name if have. Friendly name is used in notification scenario.
             if (enterPage != nil && enterPage.length > 0)
             {
@@ -665,7 +723,7 @@
 - (void)shRegularTask:(void (^)(UIBackgroundFetchResult))completionHandler needComplete:(BOOL)needComplete
 {
     BOOL needHeartbeatLog = YES;
-    NSObject *lastPostHeartbeatLogsVal = [[NSUserDefaults standardUserDefaults] objectForKey:REGULAR_HEARTBEAT_LOGTIME];
+    NSObject *lastPostHeartbeatLogsVal = [[SHStateStore sharedInstance] objectForKey:REGULAR_HEARTBEAT_LOGTIME];
     if (lastPostHeartbeatLogsVal != nil && [lastPostHeartbeatLogsVal isKindOfClass:[NSNumber class]])
     {
         NSTimeInterval lastPostHeartbeatLogs = [(NSNumber *)lastPostHeartbeatLogsVal doubleValue];
@@ -798,7 +856,7 @@
             if (!shStrIsEmpty(deeplinking))
             {
                 BOOL needSave = YES;
-                NSDictionary *dictMapping = [[NSUserDefaults standardUserDefaults] objectForKey:SPOTLIGHT_DEEPLINKING_MAPPING];
+                NSDictionary *dictMapping = [[SHStateStore sharedInstance] objectForKey:SPOTLIGHT_DEEPLINKING_MAPPING];
                 if (dictMapping != nil && [dictMapping isKindOfClass:[NSDictionary class]])
                 {
                     NSString *existingDeeplinking = dictMapping[identifier];
@@ -811,8 +869,7 @@
                 {
                     NSMutableDictionary *dictSave = dictMapping ? [NSMutableDictionary dictionaryWithDictionary:dictMapping] : [NSMutableDictionary dictionary];
                     dictSave[identifier] = deeplinking;
-                    [[NSUserDefaults standardUserDefaults] setObject:dictSave forKey:SPOTLIGHT_DEEPLINKING_MAPPING];
-                    [[NSUserDefaults standardUserDefaults] synchronize];
+                    [[SHStateStore sharedInstance] setObject:dictSave forKey:SPOTLIGHT_DEEPLINKING_MAPPING];
                 }
             }
         }
@@ -829,7 +886,7 @@
         }
         else
         {
-            NSDictionary *dictMapping = [[NSUserDefaults standardUserDefaults] objectForKey:SPOTLIGHT_DEEPLINKING_MAPPING];
+            NSDictionary *dictMapping = [[SHStateStore sharedInstance] objectForKey:SPOTLIGHT_DEEPLINKING_MAPPING];
             if (dictMapping != nil)
             {
                 NSMutableDictionary *dictSave = [NSMutableDictionary dictionaryWithDictionary:dictMapping];
@@ -837,8 +894,7 @@
                 {
                     [dictSave removeObjectForKey:identifier];
                 }
-                [[NSUserDefaults standardUserDefaults] setObject:dictSave forKey:SPOTLIGHT_DEEPLINKING_MAPPING];
-                [[NSUserDefaults standardUserDefaults] synchronize];
+                [[SHStateStore sharedInstance] setObject:dictSave forKey:SPOTLIGHT_DEEPLINKING_MAPPING];
             }
         }
     }];
@@ -854,8 +910,7 @@
         }
         else
         {
-            [[NSUserDefaults standardUserDefaults] setObject:@{} forKey:SPOTLIGHT_DEEPLINKING_MAPPING];
-            [[NSUserDefaults standardUserDefaults] synchronize];
+            [[SHStateStore sharedInstance] setObject:@{} forKey:SPOTLIGHT_DEEPLINKING_MAPPING];
         }
     }];
 }
@@ -872,7 +927,7 @@
         else
         {
             NSString *spotlightIdentifier = userActivity.userInfo[@"kCSSearchableItemActivityIdentifier"];
-            NSDictionary *dictMapping = [[NSUserDefaults standardUserDefaults] objectForKey:SPOTLIGHT_DEEPLINKING_MAPPING];
+            NSDictionary *dictMapping = [[SHStateStore sharedInstance] objectForKey:SPOTLIGHT_DEEPLINKING_MAPPING];
             NSString *deeplinking = nil;
             if (dictMapping != nil && [dictMapping isKindOfClass:[NSDictionary class]])
             {
@@ -908,87 +963,93 @@
         return;
     }
     
-    BOOL isFromDelayLaunch = [notification.name isEqualToString:@"StreetHawkDelayLaunchOptionsNotification"]; //in case from delay launch options, the remote delegate happens when app launch, and at that time StreetHawk delegate not ready, it's pass and cannot handle. Handle it again here.
-    NSDictionary *launchOptions = [notification userInfo];
-    SHLog(@"Application did finish launching (%@) with launchOptions: %@", isFromDelayLaunch ? @"Delay" : @"Normal", launchOptions);
-    
-    if (isFromDelayLaunch)
+    [[SHLaunchTracer sharedInstance] tracePhase:@"finishLaunching" block:^
     {
-        //Phonegap open url system delegate happen before StreetHawk library get ready, so `sh.shDeeplinking(function(result){alert("open url: " + result)},function(){});` not trigger when App not launch. Check delay launch options, if from open url, give it second chance to trigger again.
-        NSURL *openUrl = launchOptions[UIApplicationLaunchOptionsURLKey];
-        if (openUrl != nil)
+        BOOL isFromDelayLaunch = [notification.name isEqualToString:@"StreetHawkDelayLaunchOptionsNotification"]; //in case from delay launch options, the remote delegate happens when app launch, and at that time StreetHawk delegate not ready, it's pass and cannot handle. Handle it again here.
+        NSDictionary *launchOptions = [notification userInfo];
+        SHLog(@"Application did finish launching (%@) with launchOptions: %@", isFromDelayLaunch ? @"Delay" : @"Normal", launchOptions);
+
+        if (isFromDelayLaunch)
         {
-            [StreetHawk openURL:openUrl];
+            //Phonegap open url system delegate happen before StreetHawk library get ready, so `sh.shDeeplinking(function(result){alert("open url: " + result)},function(){});` not trigger when App not launch. Check delay launch options, if from open url, give it second chance to trigger again.
+            NSURL *openUrl = launchOptions[UIApplicationLaunchOptionsURLKey];
+            if (openUrl != nil)
+            {
+                [StreetHawk openURL:openUrl];
+            }
+            //UIApplicationLaunchOptionsURLKey works for scheme type url, however it doesn't work for universal linking url. If launch by universal url, it uses UIApplicationLaunchOptionsUserActivityDictionaryKey.
+            NSDictionary *userActivityDictionary = launchOptions[UIApplicationLaunchOptionsUserActivityDictionaryKey];
+            if (userActivityDictionary)
+            {
+                [userActivityDictionary enumerateKeysAndObjectsUsingBlock:^(id  _Nonnull key, id  _Nonnull obj, BOOL * _Nonnull stop)
+                 {
+                     if ([obj isKindOfClass:[NSUserActivity class]])
+                     {
+                         [StreetHawk continueUserActivity:(NSUserActivity *)obj];
+                         *stop = YES;
+                     }
+                 }];
+            }
         }
-        //UIApplicationLaunchOptionsURLKey works for scheme type url, however it doesn't work for universal linking url. If launch by universal url, it uses UIApplicationLaunchOptionsUserActivityDictionaryKey.
-        NSDictionary *userActivityDictionary = launchOptions[UIApplicationLaunchOptionsUserActivityDictionaryKey];
-        if (userActivityDictionary)
+        if (isFromDelayLaunch /*Phonegap handle remote notification happen before StreetHawk library get ready, so remote notification cannot be handled. Check delay launch options, if from remote notification, give it second chance to trigger again */)
         {
-            [userActivityDictionary enumerateKeysAndObjectsUsingBlock:^(id  _Nonnull key, id  _Nonnull obj, BOOL * _Nonnull stop)
-             {
-                 if ([obj isKindOfClass:[NSUserActivity class]])
-                 {
-                     [StreetHawk continueUserActivity:(NSUserActivity *)obj];
-                     *stop = YES;
-                 }
-             }];
+            NSDictionary *notificationInfo = launchOptions[UIApplicationLaunchOptionsRemoteNotificationKey];
+            if (notificationInfo != nil)
+            {
+                NSMutableDictionary *dictUserInfo = [NSMutableDictionary dictionary];
+                dictUserInfo[@"payload"] = notificationInfo;
+                dictUserInfo[@"fgbg"] = @(SHAppFGBG_BG); //this must be wake from not launch
+                dictUserInfo[@"needComplete"] = @(NO);
+                [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_PushBridge_ReceiveRemoteNotification" object:nil userInfo:dictUserInfo];
+            }
+            //local notification is not considered so far, and StreetHawk SDK doesn't use local notification now.
         }
-    }
-    if (isFromDelayLaunch /*Phonegap handle remote notification happen before StreetHawk library get ready, so remote notification cannot be handled. Check delay launch options, if from remote notification, give it second chance to trigger again */)
-    {
-        NSDictionary *notificationInfo = launchOptions[UIApplicationLaunchOptionsRemoteNotificationKey];
-        if (notificationInfo != nil)
+
+        if (launchOptions[UIApplicationLaunchOptionsLocationKey] != nil)  //happen when significate location service wake up App, the value is a number such as 1
         {
-            NSMutableDictionary *dictUserInfo = [NSMutableDictionary dictionary];
-            dictUserInfo[@"payload"] = notificationInfo;
-            dictUserInfo[@"fgbg"] = @(SHAppFGBG_BG); //this must be wake from not launch
-            dictUserInfo[@"needComplete"] = @(NO);
-            [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_PushBridge_ReceiveRemoteNotification" object:nil userInfo:dictUserInfo];
+            //To fix location service after phone power off/on.
+            //After phone power on, register significate location service App is wake up, and applicationDidFinishLaunching is called.
+            //In this situation, it stays in background, using significant location change.
+            [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_StartMonitorGeoLocation" object:nil];
         }
-        //local notification is not considered so far, and StreetHawk SDK doesn't use local notification now.
-    }
-    
-    if (launchOptions[UIApplicationLaunchOptionsLocationKey] != nil)  //happen when significate location service wake up App, the value is a number such as 1
-    {
-        //To fix location service after phone power off/on.
-        //After phone power on, register significate location service App is wake up, and applicationDidFinishLaunching is called.
-        //In this situation, it stays in background, using significant location change.
-        [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_StartMonitorGeoLocation" object:nil];
-    }
-    
-    if ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground)/*avoid send visible log when App wake up in background. Here cannot use Active, its status is InActive for normal launch, Background for location launch.*/
-    {
-        NSMutableDictionary *dictComment = [NSMutableDictionary dictionary];
-        [dictComment setObject:@"App launch from not running." forKey:@"action"];        
-        [StreetHawk sendLogForCode:LOG_CODE_APP_VISIBLE withComment:shSerializeObjToJson(dictComment)];
-    }
 
-    if ([[UIApplication sharedApplication] respondsToSelector:@selector(setMinimumBackgroundFetchInterval:)]) //available since 7.0
-    {
-        [[UIApplication sharedApplication] setMinimumBackgroundFetchInterval:30*60/*perform background fetch in half an hour to increase chance*/];
-    }
-    
-    if (StreetHawk.developmentPlatform == SHDevelopmentPlatform_Native && StreetHawk.isDebugMode && shAppMode() != SHAppMode_AppStore && shAppMode() != SHAppMode_Enterprise && ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground))  //In debug mode, not live for AppStore, not in background wake up (either by location with option has location key, or by background fetch with optional is nil), check current version and StreetHawk's latest version. Print log if current not the latest version.
-    {
-        [[SHHTTPSessionManager sharedInstance] GET:@"core/library/" hostVersion:SHHostVersion_V1 parameters:@{@"operating_system": @"ios", @"development_platform": shDevelopmentPlatformString()} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+        if ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground)/*avoid send visible log when App wake up in background. Here cannot use Active, its status is InActive for normal launch, Background for location launch.*/
+        {
+            NSMutableDictionary *dictComment = [NSMutableDictionary dictionary];
+            [dictComment setObject:@"App launch from not running." forKey:@"action"];        
+            [StreetHawk sendLogForCode:LOG_CODE_APP_VISIBLE withComment:shSerializeObjToJson(dictComment)];
+        }
+
+        if ([[UIApplication sharedApplication] respondsToSelector:@selector(setMinimumBackgroundFetchInterval:)]) //available since 7.0
+        {
+            [[UIApplication sharedApplication] setMinimumBackgroundFetchInterval:30*60/*perform background fetch in half an hour to increase chance*/];
+        }
+
+        [[SHLaunchTracer sharedInstance] deferTask:@"libraryVersionCheck" dependencies:nil block:^
         {
-            NSString *serverVersion = (NSString *)responseObject;  //it's supposed to be @"1.3.2".
-            NSAssert([serverVersion isKindOfClass:[NSString class]] && !shStrIsEmpty(serverVersion), @"Fail to get server's sh_version. %@.", serverVersion);
-            if ([serverVersion isKindOfClass:[NSString class]] && !shStrIsEmpty(serverVersion))
+            if (StreetHawk.developmentPlatform == SHDevelopmentPlatform_Native && StreetHawk.isDebugMode && shAppMode() != SHAppMode_AppStore && shAppMode() != SHAppMode_Enterprise && ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground))  //In debug mode, not live for AppStore, not in background wake up (either by location with option has location key, or by background fetch with optional is nil), check current version and StreetHawk's latest version. Print log if current not the latest version.
             {
-                if ([serverVersion compare:StreetHawk.version options:NSCaseInsensitiveSearch] != NSOrderedSame)
+                [[SHHTTPSessionManager sharedInstance] GET:@"core/library/" hostVersion:SHHostVersion_V1 parameters:@{@"operating_system": @"ios", @"development_platform": shDevelopmentPlatformString()} success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
                 {
-                    SHLog(@"INFO: A newer version of the StreetHawk Library is available: %@.", serverVersion);
-                }
+                    NSString *serverVersion = (NSString *)responseObject;  //it's supposed to be @"1.3.2".
+                    NSAssert([serverVersion isKindOfClass:[NSString class]] && !shStrIsEmpty(serverVersion), @"Fail to get server's sh_version. %@.", serverVersion);
+                    if ([serverVersion isKindOfClass:[NSString class]] && !shStrIsEmpty(serverVersion))
+                    {
+                        if ([serverVersion compare:StreetHawk.version options:NSCaseInsensitiveSearch] != NSOrderedSame)
+                        {
+                            SHLog(@"INFO: A newer version of the StreetHawk Library is available: %@.", serverVersion);
+                        }
+                    }
+                } failure:nil];
             }
-        } failure:nil];
-    }
-    
-    //If add push module later for Phonegap, if already have installs it won't register and show permission dialog until next BG to FG. `applicationDidBecomeActiveNotificationHandler` does the check however first launch it's not ready due to Phonegap web load. `applicationDidFinishLaunchingNotificationHandler` has delay load and good chance to do register at first launch.
-    if ((StreetHawk.developmentPlatform == SHDevelopmentPlatform_Phonegap || StreetHawk.developmentPlatform == SHDevelopmentPlatform_Titanium) && StreetHawk.currentInstall != nil)
-    {
-        [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_PushBridge_Register_Notification" object:nil];
-    }
+        }];
+
+        //If add push module later for Phonegap, if already have installs it won't register and show permission dialog until next BG to FG. `applicationDidBecomeActiveNotificationHandler` does the check however first launch it's not ready due to Phonegap web load. `applicationDidFinishLaunchingNotificationHandler` has delay load and good chance to do register at first launch.
+        if ((StreetHawk.developmentPlatform == SHDevelopmentPlatform_Phonegap || StreetHawk.developmentPlatform == SHDevelopmentPlatform_Titanium) && StreetHawk.currentInstall != nil)
+        {
+            [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_PushBridge_Register_Notification" object:nil];
+        }
+    }];
 }
 
 //Called when click home button to background App.
@@ -1075,6 +1136,7 @@
 {
     //check app status from background to foreground, most actually return because of "one day not call" limitation.
     [[SHAppStatus sharedInstance] sendAppStatusCheckRequest:NO];  //a chance to check if sdk was disabled, may be able to wake up again. Choose this instead of applicationWillEnterForeground because this is also called when App not launched, manually click to open.
+    [[SHAppStatus sharedInstance] refreshRouteAndPreconnect]; //refresh expired route and warm up connection before following requests.
     [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_PushBridge_SetBadge_Notification" object:nil userInfo:@{@"badge": @(0)}]; //clear badge when App open, for some user they don't like this number and would like to launch App to dismiss it.
     if (!streetHawkIsEnabled())
     {
@@ -1375,7 +1437,7 @@ forLocalNotification:(UILocalNotification *)notification
     //Not check ![SHAppStatus sharedInstance].streethawkEnabled here because: 1. it's invisible to user; 2. If this time not update, it will not happen again.
     NSInteger offset = [[NSTimeZone localTimeZone] secondsFromGMT];
     BOOL needUpdateUtcOffset = YES;
-    NSObject *utcoffsetVal = [[NSUserDefaults standardUserDefaults] objectForKey:SETTING_UTC_OFFSET];
+    NSObject *utcoffsetVal = [[SHStateStore sharedInstance] objectForKey:SETTING_UTC_OFFSET];
     if (utcoffsetVal != nil && [utcoffsetVal isKindOfClass:[NSNumber class]])
     {
         int utcOffsetLocal = [(NSNumber *)utcoffsetVal intValue];
@@ -1396,8 +1458,7 @@ forLocalNotification:(UILocalNotification *)notification
             {
                 [StreetHawk sendLogForCode:LOG_CODE_TIMEOFFSET withComment:[NSString stringWithFormat:@"%ld", (long)offset/60] forAssocId:nil withResult:100/*ignore*/ withHandler:^(id result, NSError *error)
                  {
-                     [[NSUserDefaults standardUserDefaults] setObject:@(offset/60) forKey:SETTING_UTC_OFFSET];
-                     [[NSUserDefaults standardUserDefaults] synchronize];
+                     [[SHStateStore sharedInstance] setObject:@(offset/60) forKey:SETTING_UTC_OFFSET];
                      [self endBackgroundTask:backgroundTask];
                  }];
             }
@@ -1525,31 +1586,21 @@ forLocalNotification:(UILocalNotification *)notification
 
 - (void)shNotifyPageEnter:(NSString *)page sendEnter:(BOOL)doEnter sendExit:(BOOL)doExit
 {
+    SHPageTracker *pageTracker = [SHPageTracker sharedInstance];
     if (page == nil || page.length == 0)
     {
         NSAssert(doEnter, @"Enter without page should used for App go to FG only, with doEnter = YES");
         NSAssert(!doExit, @"Enter without page should used for App go to FG only, with doExit = NO");
-        page = [[NSUserDefaults standardUserDefaults] objectForKey:ENTER_PAGE_HISTORY]; //for App go FG and log enter
+        page = pageTracker.enterPage; //for App go FG and log enter
     }
     if (doExit)
     {
         //First check whether need to send 8109 for exit previous page
-        NSString *previousEnterPage = [[NSUserDefaults standardUserDefaults] objectForKey:ENTER_PAGE_HISTORY];
-        if (previousEnterPage != nil && previousEnterPage.length > 0) //Not check it's not same as "page". For example, stay FG at homepage and App killed, enter history has homepage, exit history is empty. Next launch is homepage. So sends homepage exit first to match previous enter, and sends homepage enter again.
-        {
-            NSString *previousExitPage = [[NSUserDefaults standardUserDefaults] objectForKey:EXIT_PAGE_HISTORY];
-            BOOL multipleBGTerminal = NO;
-            //Case like this: 1)App stay in page C and BG, enter history=C, exit history=C. 2)App terminated in BG, launch again. Homepage A's viewDidAppear called, it check enter history=C so try to send exit for C but stopped by exit history=C, no exit log sent, finally set enter history=A! (this enter will called as App go to FG) 3)Sadly, App in BG and terminated again, launch again. Homepage A's viewDidAppear called, this time enter history=A, exit history=C.
-            //If not add this `multipleBGTerminal` to check, it will try to send exit, but NSAssert fail due to "try to exit A" but exit history=C.
-            if ([previousEnterPage compare:page options:NSCaseInsensitiveSearch] == NSOrderedSame && previousExitPage != nil && previousExitPage.length > 0)
-            {
-                multipleBGTerminal = YES;
-            }
-            if (!multipleBGTerminal)
-            {
-                //Has a previous record, means it enters some page before. Send it as exit and clear it.
-                [self shNotifyPageExit:previousEnterPage clearEnterHistory:YES logCompleteView:NO/*App crash and launch again, this cannot count as complete duration.*/];
-            }
+        NSString *previousEnterPage = [pageTracker pageToExitBeforeEnter:page];
+        if (previousEnterPage != nil)
+        {
+            //Has a previous record, means it enters some page before. Send it as exit and clear it.
+            [self shNotifyPageExit:previousEnterPage clearEnterHistory:YES logCompleteView:NO/*App crash and launch again, this cannot count as complete duration.*/];
         }
     }
     //Second if page not nil, send 8108 for enter this page
@@ -1561,26 +1612,23 @@ forLocalNotification:(UILocalNotification *)notification
         {
             [StreetHawk sendLogForCode:LOG_CODE_VIEW_ENTER withComment:page];
             self.currentView = [[SHViewActivity alloc] initWithViewName:page];
-            //Clear exit history after send enter log, next exit log can send.
-            [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:EXIT_PAGE_HISTORY];
-            [[NSUserDefaults standardUserDefaults] synchronize];
         }
-        [[NSUserDefaults standardUserDefaults] setObject:page forKey:ENTER_PAGE_HISTORY];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [pageTracker enterPage:page logSent:doEnter];
     }
 }
 
 - (void)shNotifyPageExit:(NSString *)page clearEnterHistory:(BOOL)needClear logCompleteView:(BOOL)logComplete
 {
+    SHPageTracker *pageTracker = [SHPageTracker sharedInstance];
     BOOL isEnterBg = (page == nil || page.length == 0);
     if (page == nil || page.length == 0)
     {
         NSAssert(!needClear, @"Exit without page should used for App go to BG only, with needClear = NO");
-        page = [[NSUserDefaults standardUserDefaults] objectForKey:ENTER_PAGE_HISTORY]; //for App go BG and log exit
+        page = pageTracker.enterPage; //for App go BG and log exit
     }
     if (needClear)
     {
-        NSAssert(page != nil && page.length > 0, @"Try to really exit a page without page name. Stop now."); //only check this when normally exit a page. If needClear=NO it's from App go to BG, and if last seen page is not StreetHawk inherit page the record in ENTER_PAGE_HISTORY is empty.
+        NSAssert(page != nil && page.length > 0, @"Try to really exit a page without page name. Stop now."); //only check this when normally exit a page. If needClear=NO it's from App go to BG, and if last seen page is not StreetHawk inherit page the recorded enter page is empty.
     }
     if (page != nil && page.length > 0)
     {
@@ -1588,14 +1636,9 @@ forLocalNotification:(UILocalNotification *)notification
         //Check whether previous send exit for this page already. If already send ignore this. It happens when:
         //1. App at page C and go to BG, send exit C.
         //2. App killed at BG, re-launch it. Home page viewDidAppear and find enter history has C. It will try to send exit C, but should be ignored.
-        NSString *previousExitPage = [[NSUserDefaults standardUserDefaults] objectForKey:EXIT_PAGE_HISTORY];
-        if (previousExitPage != nil && previousExitPage.length > 0)
+        if ([pageTracker isExitSentForPage:page])
         {
-            NSAssert([previousExitPage compare:page options:NSCaseInsensitiveSearch] == NSOrderedSame, @"Try to send exit page (%@) different from history (%@).", page, previousExitPage);
-            if ([previousExitPage compare:page options:NSCaseInsensitiveSearch] == NSOrderedSame)
-            {
-                return; //ignore duplicated exit log
-            }
+            return; //ignore duplicated exit log
         }
         [StreetHawk sendLogForCode:LOG_CODE_VIEW_EXIT withComment:page];
         if (logComplete)
@@ -1610,13 +1653,7 @@ forLocalNotification:(UILocalNotification *)notification
                 [StreetHawk sendLogForCode:LOG_CODE_VIEW_COMPLETE withComment:[self.currentView serializeToString]];
             }
         }
-        [[NSUserDefaults standardUserDefaults] setObject:page forKey:EXIT_PAGE_HISTORY]; //remember this.
-        [[NSUserDefaults standardUserDefaults] synchronize];
-        if (needClear)
-        {
-            [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:ENTER_PAGE_HISTORY];
-            [[NSUserDefaults standardUserDefaults] synchronize];
-        }
+        [pageTracker exitPage:page clearEnter:needClear]; //remember this.
     }
 }
 
@@ -1624,28 +1661,19 @@ forLocalNotification:(UILocalNotification *)notification
 {
     if (!shStrIsEmpty(StreetHawk.currentInstall.suid))
     {
-        //Read friendly name from local.
-        NSArray *arrayFriendlyNames = [[NSUserDefaults standardUserDefaults] objectForKey:FRIENDLYNAME_KEY];
-        NSMutableArray *arrayViews = [NSMutableArray array];
-        for (NSDictionary *dict in arrayFriendlyNames)
+        //Read friendly name from local, duplicated ones are removed when building registry.
+        SHFriendlyNameRegistry *registry = [SHFriendlyNameRegistry sharedInstance];
+        for (NSString *friendlyName in registry.redefinedFriendlyNames)
         {
-            NSString *friendlyName = dict[FRIENDLYNAME_NAME];
-            if (![arrayViews containsObject:friendlyName])
-            {
-                [arrayViews addObject:friendlyName];
-            }
-            else
-            {
-                NSLog(@"WARNING: friendly name \"%@\" redefined. Please choose different names.", friendlyName);
-            }
+            NSLog(@"WARNING: friendly name \"%@\" redefined. Please choose different names.", friendlyName);
         }
+        NSArray *arrayViews = registry.uniqueFriendlyNames;
         //If has friendly name to submit, do it.
         if (arrayViews.count > 0)
         {
-            [[SHHTTPSessionManager sharedInstance] POST:@"/apps/submit_views/" hostVersion:SHHostVersion_V1 body:@{SH_BODY: shSerializeObjToJson(arrayViews)} success:nil failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
-            {
-                SHLog(@"Fail to submit friendly name: %@", error); //submit friendly name not show error dialog to bother customer.
-            }];
+            //submit friendly name not show error dialog to bother customer. Go through outbox so it's retried when offline, and only latest list is submitted.
+            NSString *jsonViews = shSerializeObjToJson(arrayViews);
+            [[SHRequestOutbox sharedInstance] enqueueMethod:@"POST" path:@"/apps/submit_views/" hostVersion:SHHostVersion_V1 body:@{SH_BODY: jsonViews} useJSON:NO idempotencyKey:[NSString stringWithFormat:@"submit_views_%@", [jsonViews md5]] coalesceKey:@"submit_views" resultNotification:nil];
         }
     }
 }
@@ -1844,22 +1872,21 @@ forLocalNotification:(UILocalNotification *)notification
                                    self.currentInstall = (SHInstall *)result;
                                    dispatch_semaphore_signal(self.install_semaphore); //make sure currentInstall is set to latest.
                                    //check client version upgrade, must do it before update local cache.
-                                   NSString *sentClientVersion = [[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_ClientVersion];
+                                   NSString *sentClientVersion = [[SHStateStore sharedInstance] objectForKey:SentInstall_ClientVersion];
                                    if (sentClientVersion != nil && sentClientVersion.length > 0 && ![sentClientVersion isEqualToString:StreetHawk.clientVersion])
                                    {
                                        [StreetHawk sendLogForCode:LOG_CODE_CLIENTUPGRADE withComment:sentClientVersion];
                                    }
                                    //save sent install parameters for later compare, because install does not have local cache, and avoid query install/details/ from server. Only save it after successfully install/update.
-                                   [[NSUserDefaults standardUserDefaults] setObject:NONULL(StreetHawk.appKey) forKey:SentInstall_AppKey];
-                                   [[NSUserDefaults standardUserDefaults] setObject:StreetHawk.clientVersion forKey:SentInstall_ClientVersion];
-                                   [[NSUserDefaults standardUserDefaults] setObject:StreetHawk.version forKey:SentInstall_ShVersion];
-                                   [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithInt:shAppMode()] forKey:SentInstall_Mode];
-                                   [[NSUserDefaults standardUserDefaults] setObject:shGetCarrierName() forKey:SentInstall_Carrier];
-                                   [[NSUserDefaults standardUserDefaults] setObject:[UIDevice currentDevice].systemVersion forKey:SentInstall_OSVersion];
+                                   [[SHStateStore sharedInstance] setObject:NONULL(StreetHawk.appKey) forKey:SentInstall_AppKey];
+                                   [[SHStateStore sharedInstance] setObject:StreetHawk.clientVersion forKey:SentInstall_ClientVersion];
+                                   [[SHStateStore sharedInstance] setObject:StreetHawk.version forKey:SentInstall_ShVersion];
+                                   [[SHStateStore sharedInstance] setObject:[NSNumber numberWithInt:shAppMode()] forKey:SentInstall_Mode];
+                                   [[SHStateStore sharedInstance] setObject:shGetCarrierName() forKey:SentInstall_Carrier];
+                                   [[SHStateStore sharedInstance] setObject:[UIDevice currentDevice].systemVersion forKey:SentInstall_OSVersion];
                                    [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_UpdateiBeaconStatus" object:nil];
                                    int iBeaconSupportStatus = [[[NSUserDefaults standardUserDefaults] objectForKey:SH_BEACON_iBEACON] intValue];
-                                   [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithInt:iBeaconSupportStatus] forKey:SentInstall_IBeacon];
-                                   [[NSUserDefaults standardUserDefaults] synchronize];
+                                   [[SHStateStore sharedInstance] setObject:[NSNumber numberWithInt:iBeaconSupportStatus] forKey:SentInstall_IBeacon];
                                    NSDictionary *userInfo = @{SHInstallNotification_kInstall: self.currentInstall};
                                    [[NSNotificationCenter defaultCenter] postNotificationName:SHInstallUpdateSuccessNotification object:self userInfo:userInfo];
                                }
@@ -1883,18 +1910,16 @@ forLocalNotification:(UILocalNotification *)notification
                                {
                                    self.currentInstall = (SHInstall *)result;
                                    dispatch_semaphore_signal(self.install_semaphore); //make sure currentInstall is set to latest.
-                                   [[SHHTTPSessionManager sharedInstance].requestSerializer setValue:!shStrIsEmpty(StreetHawk.currentInstall.suid) ? StreetHawk.currentInstall.suid : @"null" forHTTPHeaderField:@"X-Installid"]; //direct set for next request
                                    //save sent install parameters for later compare, because install does not have local cache, and avoid query install/details/ from server. Only save it after successfully install/register.
-                                   [[NSUserDefaults standardUserDefaults] setObject:NONULL(StreetHawk.appKey) forKey:SentInstall_AppKey];
-                                   [[NSUserDefaults standardUserDefaults] setObject:StreetHawk.clientVersion forKey:SentInstall_ClientVersion];
-                                   [[NSUserDefaults standardUserDefaults] setObject:StreetHawk.version forKey:SentInstall_ShVersion];
-                                   [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithInt:shAppMode()] forKey:SentInstall_Mode];
-                                   [[NSUserDefaults standardUserDefaults] setObject:shGetCarrierName() forKey:SentInstall_Carrier];
-                                   [[NSUserDefaults standardUserDefaults] setObject:[UIDevice currentDevice].systemVersion forKey:SentInstall_OSVersion];
+                                   [[SHStateStore sharedInstance] setObject:NONULL(StreetHawk.appKey) forKey:SentInstall_AppKey];
+                                   [[SHStateStore sharedInstance] setObject:StreetHawk.clientVersion forKey:SentInstall_ClientVersion];
+                                   [[SHStateStore sharedInstance] setObject:StreetHawk.version forKey:SentInstall_ShVersion];
+                                   [[SHStateStore sharedInstance] setObject:[NSNumber numberWithInt:shAppMode()] forKey:SentInstall_Mode];
+                                   [[SHStateStore sharedInstance] setObject:shGetCarrierName() forKey:SentInstall_Carrier];
+                                   [[SHStateStore sharedInstance] setObject:[UIDevice currentDevice].systemVersion forKey:SentInstall_OSVersion];
                                    [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_UpdateiBeaconStatus" object:nil];
                                    int iBeaconSupportStatus = [[[NSUserDefaults standardUserDefaults] objectForKey:SH_BEACON_iBEACON] intValue];
-                                   [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithInt:iBeaconSupportStatus] forKey:SentInstall_IBeacon];
-                                   [[NSUserDefaults standardUserDefaults] synchronize];
+                                   [[SHStateStore sharedInstance] setObject:[NSNumber numberWithInt:iBeaconSupportStatus] forKey:SentInstall_IBeacon];
                                    NSDictionary *userInfo = @{SHInstallNotification_kInstall: self.currentInstall};
                                    [[NSNotificationCenter defaultCenter] postNotificationName:SHInstallRegistrationSuccessNotification object:self userInfo:userInfo];
                                }
@@ -1925,12 +1950,12 @@ NSString *SentInstall_IBeacon = @"SentInstall_IBeacon";
 
 -(BOOL)checkInstallChangeForLaunch
 {
-    NSString *sentAppKey = [[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_AppKey];
-    NSString *sentClientVersion = [[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_ClientVersion];
-    NSString *sentShVersion = [[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_ShVersion];
-    NSString *sentCarrier = [[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_Carrier];
-    NSString *sentOsVersion = [[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_OSVersion];
-    int sentiBeacon = [[[NSUserDefaults standardUserDefaults] objectForKey:SentInstall_IBeacon] intValue];
+    NSString *sentAppKey = [[SHStateStore sharedInstance] objectForKey:SentInstall_AppKey];
+    NSString *sentClientVersion = [[SHStateStore sharedInstance] objectForKey:SentInstall_ClientVersion];
+    NSString *sentShVersion = [[SHStateStore sharedInstance] objectForKey:SentInstall_ShVersion];
+    NSString *sentCarrier = [[SHStateStore sharedInstance] objectForKey:SentInstall_Carrier];
+    NSString *sentOsVersion = [[SHStateStore sharedInstance] objectForKey:SentInstall_OSVersion];
+    int sentiBeacon = [[[SHStateStore sharedInstance] objectForKey:SentInstall_IBeacon] intValue];
     [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_UpdateiBeaconStatus" object:nil];
     int currentiBeacon = [[[NSUserDefaults standardUserDefaults] objectForKey:SH_BEACON_iBEACON] intValue];
     if (currentiBeacon != 3/*SHiBeaconState_Ignore*/)
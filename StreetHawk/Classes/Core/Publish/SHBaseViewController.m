@@ -21,6 +21,7 @@
 #import "SHViewController.h" //for checking internal vc to avoid enter/exit log
 #import "SHUtils.h" //for shIsSDKViewController
 #import "SHCoverView.h" //for cover view
+#import "SHPageTracker.h" //for page history
 //header from System
 #import <objc/runtime.h> //for associate object
 
@@ -139,8 +140,7 @@
 - (void)_doViewWillAppear {
     if (!self.excludeBehavior && !shIsSDKViewController(self))
     {
-        [[NSUserDefaults standardUserDefaults] setObject:self.class.description forKey:@"ENTERBAK_PAGE_HISTORY"];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHPageTracker sharedInstance] willAppearPage:self.class.description];
     }
 }
 
@@ -364,8 +364,7 @@ NSDate *_lastChangeDate = nil;
     [super viewWillAppear:animated];
     if (!self.excludeBehavior && !shIsSDKViewController(self))
     {
-        [[NSUserDefaults standardUserDefaults] setObject:self.class.description forKey:@"ENTERBAK_PAGE_HISTORY"];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHPageTracker sharedInstance] willAppearPage:self.class.description];
     }
 }
 
@@ -476,8 +475,7 @@ NSDate *_lastChangeDate = nil;
     [super viewWillAppear:animated];
     if (!self.excludeBehavior && !shIsSDKViewController(self))
     {
-        [[NSUserDefaults standardUserDefaults] setObject:self.class.description forKey:@"ENTERBAK_PAGE_HISTORY"];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHPageTracker sharedInstance] willAppearPage:self.class.description];
     }
 }
 
@@ -16,6 +16,8 @@
  */
 
 #import "SHFriendlyNameObject.h"
+//header from StreetHawk
+#import "SHFriendlyNameRegistry.h" //for friendly name lookup
 
 @implementation SHFriendlyNameObject
 
@@ -23,39 +25,14 @@
 
 + (SHFriendlyNameObject *)findObjByFriendlyName:(NSString *)friendlyName
 {
-    SHFriendlyNameObject *findObj = nil;
-    if (friendlyName != nil && friendlyName.length > 0)
-    {
-        NSArray *arrayFriendlyNames = [[NSUserDefaults standardUserDefaults] objectForKey:FRIENDLYNAME_KEY];
-        for (NSDictionary *dict in arrayFriendlyNames)
-        {
-            if ([friendlyName compare:dict[FRIENDLYNAME_NAME] options:NSCaseInsensitiveSearch] == NSOrderedSame)
-            {
-                findObj = [[SHFriendlyNameObject alloc] init];
-                findObj.friendlyName = friendlyName;
-                findObj.vc = dict[FRIENDLYNAME_VC];
-                findObj.xib_iphone = [dict.allKeys containsObject:FRIENDLYNAME_XIB_IPHONE] ? dict[FRIENDLYNAME_XIB_IPHONE] : nil;
-                findObj.xib_ipad = [dict.allKeys containsObject:FRIENDLYNAME_XIB_IPAD] ? dict[FRIENDLYNAME_XIB_IPAD] : nil;
-                break;
-            }
-        }
-    }
-    return findObj;
+    return [[SHFriendlyNameRegistry sharedInstance] objectForFriendlyName:friendlyName];
 }
 
 + (NSString *)tryFriendlyName:(NSString *)vc
 {
     //Check whether has friendly name for this page.
-    NSArray *arrayFriendlyNames = [[NSUserDefaults standardUserDefaults] objectForKey:FRIENDLYNAME_KEY];
-    for (NSDictionary *dict in arrayFriendlyNames)
-    {
-        if ([vc compare:dict[FRIENDLYNAME_VC]] == NSOrderedSame)
-        {
-            vc = dict[FRIENDLYNAME_NAME];
-            break;
-        }
-    }
-    return vc;
+    NSString *friendlyName = [[SHFriendlyNameRegistry sharedInstance] friendlyNameForVc:vc];
+    return (friendlyName != nil) ? friendlyName : vc;
 }
 
 @end
@@ -20,6 +20,7 @@
 #import "SHApp.h" //for StreetHawk
 #import "SHLogger.h" //for sending logline
 #import "SHUtils.h" //for shParseDate
+#import "SHStateStore.h" //for iBeacon support state
 
 NSString * const SHInstallRegistrationSuccessNotification = @"SHInstallRegistrationSuccessNotification";
 NSString * const SHInstallRegistrationFailureNotification = @"SHInstallRegistrationFailureNotification";
@@ -148,8 +149,7 @@ NSString * const SHInstallNotification_kError = @"Error";
         dictParams[@"access_data"] = token;
     }
     NSNumber *disablePushTimeVal = [[NSUserDefaults standardUserDefaults] objectForKey:APNS_DISABLE_TIMESTAMP];
-    [[NSUserDefaults standardUserDefaults] setObject:disablePushTimeVal != nil ? disablePushTimeVal : @0.0 forKey:APNS_SENT_DISABLE_TIMESTAMP];
-    [[NSUserDefaults standardUserDefaults] synchronize];
+    [[SHStateStore sharedInstance] setObject:disablePushTimeVal != nil ? disablePushTimeVal : @0.0 forKey:APNS_SENT_DISABLE_TIMESTAMP];
     NSString *revokeDate = (disablePushTimeVal == nil || [disablePushTimeVal doubleValue] == 0) ?
     @"" : shFormatISODate([NSDate dateWithTimeIntervalSince1970:disablePushTimeVal.doubleValue]);
     dictParams[@"revoked"] = revokeDate;
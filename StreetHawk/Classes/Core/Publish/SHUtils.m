@@ -727,12 +727,13 @@ NSString *shDevelopmentPlatformString()
 
 BOOL streetHawkIsEnabled()
 {
-    if (![SHAppStatus sharedInstance].streethawkEnabled)
+    SHAppStatusSnapshot *snapshot = [SHAppStatus sharedInstance].snapshot; //hot path, read once without touching NSUserDefaults or host health.
+    if (!snapshot.streethawkEnabled)
     {
         NSLog(@"This App is disabled, please contact Administrator to enable it.");
         return NO;
     }
-    else if (shStrIsEmpty([[SHAppStatus sharedInstance] aliveHostForVersion:SHHostVersion_Unknown]))
+    else if (shStrIsEmpty(snapshot.aliveHost) && shStrIsEmpty(StreetHawk.hostOverride))
     {
         NSLog(@"Route to host server.");
         return NO;
@@ -45,6 +45,14 @@
  */
 - (NSString *)loadPendingCrashReport;
 
+/**
+ Load pending crash report and write its text into file. Crash report is loaded and parsed only once, and the text is released before return, so that caller can process the file in chunks without holding whole report in memory. If error happen it will log as error event and sent to server.
+ @param filePath The file to write text report. Overwritten if exists.
+ @param crashDate Return the date parsed from crash report, nil if not available.
+ @return YES if the file is written; NO if fail to load or write.
+ */
+- (BOOL)writePendingCrashReportToFile:(NSString *)filePath crashDate:(NSDate **)crashDate;
+
 /**
  Return the date parsed from current crash report. If no crash report or fail to load, it's nil.
  */
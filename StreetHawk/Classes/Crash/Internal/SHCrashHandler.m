@@ -58,6 +58,42 @@
     return [PLCrashReportTextFormatter stringValueForCrashReport:report withTextFormat:PLCrashReportTextFormatiOS];
 }
 
+- (BOOL)writePendingCrashReportToFile:(NSString *)filePath crashDate:(NSDate **)crashDate
+{
+    if (crashDate)
+    {
+        *crashDate = nil;
+    }
+    BOOL isWritten = NO;
+    @autoreleasepool //release crash data and text string as soon as they are on disk.
+    {
+        NSError *error;
+        NSData *crashData = [[PLCrashReporter sharedReporter] loadPendingCrashReportDataAndReturnError:&error];
+        if (crashData == nil)
+        {
+            [StreetHawk sendLogForCode:LOG_CODE_ERROR withComment:[NSString stringWithFormat:@"Could not load crash report: %@", error]];
+            return NO;
+        }
+        PLCrashReport *report = [[PLCrashReport alloc] initWithData:crashData error:&error];
+        if (report == nil)
+        {
+            [StreetHawk sendLogForCode:LOG_CODE_ERROR withComment:[NSString stringWithFormat:@"Could not parse crash report: %@", error]];
+            return NO;
+        }
+        if (crashDate)
+        {
+            *crashDate = report.systemInfo.timestamp;
+        }
+        NSString *text = [PLCrashReportTextFormatter stringValueForCrashReport:report withTextFormat:PLCrashReportTextFormatiOS];
+        isWritten = [text writeToFile:filePath atomically:NO encoding:NSUTF8StringEncoding error:&error];
+        if (!isWritten)
+        {
+            [StreetHawk sendLogForCode:LOG_CODE_ERROR withComment:[NSString stringWithFormat:@"Could not write crash report: %@", error]];
+        }
+    }
+    return isWritten;
+}
+
 - (NSDate *)crashReportDate
 {
     NSError *error;
@@ -20,17 +20,40 @@
 #import "SHApp+Crash.h"
 #import "SHCrashHandler.h"
 #import "SHUtils.h" //for SHLog
+#import "SHRequestScheduler.h" //for background class upload
+#import "SHStateStore.h" //for sent crash MD5
 //header from System
 #import <mach/mach.h>
 #import <mach/mach_host.h>
+#import <CommonCrypto/CommonDigest.h> //for incremental md5
 
 @interface SHCrashBridge ()
 
 + (void)createCrashHandler:(NSNotification *)notification; //for creating crash handler when register. notification name: SH_CrashBridge_CreateObject; user info: empty.
 + (void)installUpdateSucceededForCrash:(NSNotification *)notification; //Handle install update notification for sending crash report.
++ (NSString *)crashReporterKeyInfo; //Additional information replacing "CrashReporter Key:   " in crash report.
++ (NSString *)filterCrashReport:(NSString *)reportPath toUploadFile:(NSString *)uploadPath withKeyInfo:(NSString *)infoStr; //Read text report in chunks, remove "TODO", replace "CrashReporter Key:   " with `infoStr` and write upload file. Return md5 of original report text, nil if fail.
 
 @end
 
+#define SH_CRASH_CHUNK_SIZE     (16 * 1024) //crash report is read and filtered in chunks of this size.
+
+//Write `length` bytes to file, stream may accept part of them each time.
+static BOOL shWriteToStream(NSOutputStream *output, const uint8_t *bytes, NSUInteger length)
+{
+    while (length > 0)
+    {
+        NSInteger written = [output write:bytes maxLength:length];
+        if (written <= 0)
+        {
+            return NO;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return YES;
+}
+
 @implementation SHCrashBridge
 
 + (void)bridgeHandler:(NSNotification *)notification
@@ -58,61 +81,161 @@
     //update crash logs if any
     if ([StreetHawk.crashHandler hasPendingCrashReport])
     {
-        NSString *crashReport = [StreetHawk.crashHandler loadPendingCrashReport];
-        if (crashReport == nil)
+        if (StreetHawk.isSendingCrashReport)
         {
-            [StreetHawk.crashHandler purgePendingCrashReport]; //fail to load, purge to avoid next loading
-            return;
+            return; //previous upload still going on, it uses same temporary files.
         }
-        //PLCrashReporter generates text with "TODO", replace that to be "".
-        crashReport = [crashReport stringByReplacingOccurrencesOfString:@"TODO" withString:@"" options:NSCaseInsensitiveSearch range:NSMakeRange(0, crashReport.length)];
-        //Add more information. CrashReporter Key:   [Development platform], [AppStore/Simulator/Other], [SDK Version, e.g. 1/1.3.2], [Install Id, e.g. ABDEF2CBF6CYX927], [battery], [memory]
-        //battery
-        [UIDevice currentDevice].batteryMonitoringEnabled = YES;
-        NSString *battery = [UIDevice currentDevice].batteryLevel < 0.0 ? @"unknown" : [NSString stringWithFormat:@"%.0f%%", [UIDevice currentDevice].batteryLevel * 100];
-        //memory
-        NSString *memoryUsage = nil;
-        mach_port_t host_port;
-        mach_msg_type_number_t host_size;
-        vm_size_t pagesize;
-        host_port = mach_host_self();
-        host_size = sizeof(vm_statistics_data_t) / sizeof(integer_t);
-        host_page_size(host_port, &pagesize);
-        vm_statistics_data_t vm_stat;
-        if (host_statistics(host_port, HOST_VM_INFO, (host_info_t)&vm_stat, &host_size) != KERN_SUCCESS)
+        //Crash report is processed as file in chunks, right after crash relaunch device may be low memory, avoid holding several copies of whole report string.
+        NSString *reportPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"StreetHawkCrashReport.txt"];
+        NSString *uploadPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"StreetHawkCrashReportUpload.txt"];
+        NSDate *crashDate = nil;
+        if (![StreetHawk.crashHandler writePendingCrashReportToFile:reportPath crashDate:&crashDate])
         {
-            memoryUsage = @"Failed to fetch memory statistics";
+            [[NSFileManager defaultManager] removeItemAtPath:reportPath error:nil];
+            [StreetHawk.crashHandler purgePendingCrashReport]; //fail to load, purge to avoid next loading
+            return;
         }
-        else
+        NSString *md5 = [SHCrashBridge filterCrashReport:reportPath toUploadFile:uploadPath withKeyInfo:[SHCrashBridge crashReporterKeyInfo]];
+        [[NSFileManager defaultManager] removeItemAtPath:reportPath error:nil];
+        if (md5 == nil)
         {
-            natural_t mem_used = (natural_t)((vm_stat.active_count + vm_stat.inactive_count + vm_stat.wire_count) * pagesize);
-            natural_t mem_free = (natural_t)(vm_stat.free_count * pagesize);
-            natural_t mem_total = mem_used + mem_free;
-            memoryUsage = [NSString stringWithFormat:@"used %llu MB free %llu MB total %llu MB", ((mem_used/1024ll)/1024ll), ((mem_free/1024ll)/1024ll), ((mem_total/1024ll)/1024ll)];
+            [[NSFileManager defaultManager] removeItemAtPath:uploadPath error:nil];
+            return; //fail to write temporary file, keep pending report and try next time.
         }
-        NSString *infoStr = [NSString stringWithFormat:@"CrashReporter Key:   %@, %@, %@, %@, Battery %@, Memory: %@", shDevelopmentPlatformString(), shAppModeString(shAppMode()), StreetHawk.version, StreetHawk.currentInstall.suid, battery, memoryUsage];
-        crashReport = [crashReport stringByReplacingOccurrencesOfString:@"CrashReporter Key:   " withString:infoStr];
-        //store MD5 in NSUserDefaults and compare with next send to avoid double reporting of crashlogs
-        NSString *md5 = [crashReport md5];
-        NSString *previousSend = [[NSUserDefaults standardUserDefaults] objectForKey:@"CrashLog_MD5"];
-        if (previousSend != md5)
+        //store MD5 in NSUserDefaults and compare with next send to avoid double reporting of crashlogs. MD5 is for original report text, the added key information changes every time.
+        NSString *previousSend = [[SHStateStore sharedInstance] objectForKey:@"CrashLog_MD5"];
+        if (previousSend == nil || ![previousSend isEqualToString:md5])
         {
-            NSDate *crashDate = [StreetHawk.crashHandler crashReportDate] == nil ? [NSDate date] : [StreetHawk.crashHandler crashReportDate];
-            [StreetHawk sendCrashReportForInstall:StreetHawk.currentInstall.suid withContent:crashReport onCrashDate:crashDate withHandler:^(id result, NSError *error)
-             {
-                 if (!error)
+            //crash upload is not waited by user, give way to interactive requests.
+            [[SHRequestScheduler sharedInstance] scheduleBackgroundRequest:^(dispatch_block_t finish)
+            {
+                [StreetHawk sendCrashReportForInstall:StreetHawk.currentInstall.suid withFile:uploadPath onCrashDate:(crashDate == nil ? [NSDate date] : crashDate) withHandler:^(id result, NSError *error)
                  {
-                     SHLog(@"Crash Log Uploaded: %@", crashReport);
-                     [StreetHawk.crashHandler purgePendingCrashReport]; //OK, load successfully, purge local.
-                     [[NSUserDefaults standardUserDefaults] setObject:md5 forKey:@"CrashLog_MD5"];
-                 }
-             }];
+                     if (!error)
+                     {
+                         SHLog(@"Crash Log Uploaded: %@", md5);
+                         [StreetHawk.crashHandler purgePendingCrashReport]; //OK, load successfully, purge local.
+                         [[SHStateStore sharedInstance] setObject:md5 forKey:@"CrashLog_MD5"];
+                     }
+                     finish();
+                 }];
+            }];
         }
         else
         {
+            [[NSFileManager defaultManager] removeItemAtPath:uploadPath error:nil];
             [StreetHawk.crashHandler purgePendingCrashReport]; //Same as before, purge local.
         }
     }
 }
 
++ (NSString *)crashReporterKeyInfo
+{
+    //Add more information. CrashReporter Key:   [Development platform], [AppStore/Simulator/Other], [SDK Version, e.g. 1/1.3.2], [Install Id, e.g. ABDEF2CBF6CYX927], [battery], [memory]
+    //battery
+    [UIDevice currentDevice].batteryMonitoringEnabled = YES;
+    NSString *battery = [UIDevice currentDevice].batteryLevel < 0.0 ? @"unknown" : [NSString stringWithFormat:@"%.0f%%", [UIDevice currentDevice].batteryLevel * 100];
+    //memory
+    NSString *memoryUsage = nil;
+    mach_port_t host_port;
+    mach_msg_type_number_t host_size;
+    vm_size_t pagesize;
+    host_port = mach_host_self();
+    host_size = sizeof(vm_statistics_data_t) / sizeof(integer_t);
+    host_page_size(host_port, &pagesize);
+    vm_statistics_data_t vm_stat;
+    if (host_statistics(host_port, HOST_VM_INFO, (host_info_t)&vm_stat, &host_size) != KERN_SUCCESS)
+    {
+        memoryUsage = @"Failed to fetch memory statistics";
+    }
+    else
+    {
+        natural_t mem_used = (natural_t)((vm_stat.active_count + vm_stat.inactive_count + vm_stat.wire_count) * pagesize);
+        natural_t mem_free = (natural_t)(vm_stat.free_count * pagesize);
+        natural_t mem_total = mem_used + mem_free;
+        memoryUsage = [NSString stringWithFormat:@"used %llu MB free %llu MB total %llu MB", ((mem_used/1024ll)/1024ll), ((mem_free/1024ll)/1024ll), ((mem_total/1024ll)/1024ll)];
+    }
+    return [NSString stringWithFormat:@"CrashReporter Key:   %@, %@, %@, %@, Battery %@, Memory: %@", shDevelopmentPlatformString(), shAppModeString(shAppMode()), StreetHawk.version, StreetHawk.currentInstall.suid, battery, memoryUsage];
+}
+
++ (NSString *)filterCrashReport:(NSString *)reportPath toUploadFile:(NSString *)uploadPath withKeyInfo:(NSString *)infoStr
+{
+    static const char *todoPattern = "TODO"; //PLCrashReporter generates text with "TODO", remove it.
+    static const char *keyPattern = "CrashReporter Key:   ";
+    const NSUInteger todoLen = strlen(todoPattern);
+    const NSUInteger keyLen = strlen(keyPattern);
+    const NSUInteger carryLen = MAX(todoLen, keyLen) - 1; //tail kept for next chunk, as pattern may cross chunk boundary.
+    NSData *infoData = [infoStr dataUsingEncoding:NSUTF8StringEncoding];
+    NSInputStream *input = [NSInputStream inputStreamWithFileAtPath:reportPath];
+    NSOutputStream *output = [NSOutputStream outputStreamToFileAtPath:uploadPath append:NO];
+    if (input == nil || output == nil)
+    {
+        return nil;
+    }
+    CC_MD5_CTX md5Context;
+    CC_MD5_Init(&md5Context);
+    [input open];
+    [output open];
+    uint8_t readBuffer[SH_CRASH_CHUNK_SIZE];
+    NSMutableData *pending = [NSMutableData dataWithCapacity:SH_CRASH_CHUNK_SIZE + carryLen];
+    BOOL isOK = YES;
+    BOOL isLast = NO;
+    while (isOK && !isLast)
+    {
+        NSInteger readLen = [input read:readBuffer maxLength:SH_CRASH_CHUNK_SIZE];
+        if (readLen < 0)
+        {
+            isOK = NO;
+            break;
+        }
+        isLast = (readLen == 0);
+        CC_MD5_Update(&md5Context, readBuffer, (CC_LONG)readLen);
+        [pending appendBytes:readBuffer length:readLen];
+        const uint8_t *bytes = pending.bytes;
+        NSUInteger length = pending.length;
+        NSUInteger safeEnd = isLast ? length : (length > carryLen ? length - carryLen : 0); //before safeEnd, all patterns can be fully compared.
+        NSUInteger emitStart = 0;
+        NSUInteger pos = 0;
+        while (isOK && pos < safeEnd)
+        {
+            if (pos + todoLen <= length && strncasecmp((const char *)bytes + pos, todoPattern, todoLen) == 0)
+            {
+                isOK = shWriteToStream(output, bytes + emitStart, pos - emitStart);
+                pos += todoLen;
+                emitStart = pos;
+            }
+            else if (pos + keyLen <= length && memcmp(bytes + pos, keyPattern, keyLen) == 0)
+            {
+                isOK = shWriteToStream(output, bytes + emitStart, pos - emitStart) && shWriteToStream(output, infoData.bytes, infoData.length);
+                pos += keyLen;
+                emitStart = pos;
+            }
+            else
+            {
+                pos++;
+            }
+        }
+        if (isOK)
+        {
+            isOK = shWriteToStream(output, bytes + emitStart, pos - emitStart);
+        }
+        [pending replaceBytesInRange:NSMakeRange(0, pos) withBytes:NULL length:0];
+    }
+    [input close];
+    [output close];
+    if (!isOK)
+    {
+        SHLog(@"Fail to write crash report for upload.");
+        return nil;
+    }
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5_Final(digest, &md5Context);
+    NSMutableString *md5 = [NSMutableString stringWithCapacity:CC_MD5_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_MD5_DIGEST_LENGTH; i++)
+    {
+        [md5 appendFormat:@"%02x", digest[i]];
+    }
+    return md5;
+}
+
 @end
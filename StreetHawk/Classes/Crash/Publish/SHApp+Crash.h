@@ -41,8 +41,13 @@
 @property (nonatomic) BOOL isSendingCrashReport;
 
 /**
- Sends crash report content info to the server.
+ Sends crash report content info to the server. `handler` is called exactly once, with error if SDK is disabled or another report is being sent.
  */
 - (void)sendCrashReportForInstall:(NSString *)installId withContent:(NSString *)crashReportContent onCrashDate:(NSDate *)crashDate withHandler:(SHCallbackHandler)handler;
 
+/**
+ Sends crash report text file to the server, same part as `sendCrashReportForInstall:withContent:...`. The multipart body is streamed from file, the report is not loaded into memory. The file is removed when this call finishes, whether it's sent or not. `handler` is called exactly once, with error if SDK is disabled, another report is being sent, or upload fails.
+ */
+- (void)sendCrashReportForInstall:(NSString *)installId withFile:(NSString *)reportFilePath onCrashDate:(NSDate *)crashDate withHandler:(SHCallbackHandler)handler;
+
 @end
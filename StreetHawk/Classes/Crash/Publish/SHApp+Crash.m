@@ -77,16 +77,32 @@
 
 #pragma mark - private functions
 
--(void)sendCrashReportForInstall:(NSString *)installId withContent:(NSString *)crashReportContent onCrashDate:(NSDate *)crashDate withHandler:(SHCallbackHandler)handler
+- (NSError *)errorForSkippedCrashReport
 {
     if (!streetHawkIsEnabled())
     {
-        return;
+        return [NSError errorWithDomain:SHErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey: @"StreetHawk is disabled, crash report not sent."}];
     }
     if (self.isSendingCrashReport)
+    {
+        return [NSError errorWithDomain:SHErrorDomain code:0 userInfo:@{NSLocalizedDescriptionKey: @"Another crash report is being sent."}];
+    }
+    return nil;
+}
+
+-(void)sendCrashReportForInstall:(NSString *)installId withContent:(NSString *)crashReportContent onCrashDate:(NSDate *)crashDate withHandler:(SHCallbackHandler)handler
+{
+    handler = [handler copy];
+    NSError *skipError = [self errorForSkippedCrashReport];
+    if (skipError != nil)
+    {
+        if (handler)
+        {
+            handler(nil, skipError);
+        }
         return;
+    }
     self.isSendingCrashReport = YES;
-    handler = [handler copy];
     [[SHHTTPSessionManager sharedInstance] POST:[NSString stringWithFormat:@"installs/%@/crash/", installId] hostVersion:SHHostVersion_V1 constructingBodyWithBlock:^(id<SHAFMultipartFormData> formData)
     {
         [formData appendPartWithFileData:[crashReportContent dataUsingEncoding:NSUTF8StringEncoding] name:@"exception_file" fileName:@"Crash Report" mimeType:@"text/text"];
@@ -108,4 +124,40 @@
     }];
 }
 
+- (void)sendCrashReportForInstall:(NSString *)installId withFile:(NSString *)reportFilePath onCrashDate:(NSDate *)crashDate withHandler:(SHCallbackHandler)handler
+{
+    handler = [handler copy];
+    //temporary report file is owned by this call, every exit goes through here to remove it and call handler once.
+    void (^complete)(NSError *) = ^(NSError *error)
+    {
+        [[NSFileManager defaultManager] removeItemAtPath:reportFilePath error:nil];
+        if (handler)
+        {
+            handler(nil, error);
+        }
+    };
+    NSError *skipError = [self errorForSkippedCrashReport];
+    if (skipError != nil)
+    {
+        complete(skipError);
+        return;
+    }
+    self.isSendingCrashReport = YES;
+    __block NSError *fileError = nil;
+    [[SHHTTPSessionManager sharedInstance] POST:[NSString stringWithFormat:@"installs/%@/crash/", installId] hostVersion:SHHostVersion_V1 constructingBodyWithBlock:^(id<SHAFMultipartFormData> formData)
+    {
+        //file part is read by body stream while uploading, not loaded into memory. Server reads plain text report, multipart part has no content encoding.
+        [formData appendPartWithFileURL:[NSURL fileURLWithPath:reportFilePath] name:@"exception_file" fileName:@"Crash Report" mimeType:@"text/text" error:&fileError];
+        [formData appendPartWithFormData:[shFormatISODate(crashDate) dataUsingEncoding:NSUTF8StringEncoding] name:@"created"];
+    } success:^(NSURLSessionDataTask *task, id  _Nullable responseObject)
+    {
+        self.isSendingCrashReport = NO;
+        complete(fileError);
+    } failure:^(NSURLSessionDataTask * _Nullable task, NSError *error)
+    {
+        self.isSendingCrashReport = NO;
+        complete(error);
+    }];
+}
+
 @end
@@ -22,6 +22,8 @@
 #import "SHApp.h" //for `StreetHawk.currentInstall`
 #import "SHLogger.h" //for sending logline
 #import "SHFeedObject.h" //for SHFeedObject
+#import "SHNetworkQuality.h" //for defer prefetch on poor network
+#import "SHStateStore.h" //for feed fetch time
 
 @interface SHFeedBridge ()
 
@@ -61,7 +63,7 @@
         if (serverTime != nil)
         {
             BOOL needFetch = NO;
-            NSObject *localTimeVal = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_FEED_FETCH_TIME];
+            NSObject *localTimeVal = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_FEED_FETCH_TIME];
             if (localTimeVal == nil || ![localTimeVal isKindOfClass:[NSNumber class]])
             {
                 needFetch = YES;  //local never fetched, do fetch.
@@ -74,11 +76,15 @@
                     needFetch = YES;  //local fetched, but too old, do fetch.
                 }
             }
+            if (needFetch && isPointziInclude && ![[SHNetworkQuality sharedInstance] allowPrefetch])
+            {
+                SHLog(@"Defer feed prefetch on poor network, fetch when next app_status comes.");
+                return; //not update local cache time, so next app_status triggers it again.
+            }
             if (needFetch)
             {
                 //update local cache time before notice user and send request, because this request has same format as others {app_status:..., code:0, value:...}, it will trigger `setFeedTimestamp` again.
-                [[NSUserDefaults standardUserDefaults] setObject:@([serverTime timeIntervalSinceReferenceDate] + 10/*avoid double accurate*/) forKey:APPSTATUS_FEED_FETCH_TIME];
-                [[NSUserDefaults standardUserDefaults] synchronize];
+                [[SHStateStore sharedInstance] setObject:@([serverTime timeIntervalSinceReferenceDate] + 10/*avoid double accurate*/) forKey:APPSTATUS_FEED_FETCH_TIME];
                 if (isPointziInclude)
                 {
                     //always do a fetch when new feeds available, because feeds is automatically displays as tip.
@@ -21,6 +21,7 @@
 #import "SHFeedBridge.h" //for APPSTATUS_FEED_FETCH_TIME
 #import "SHUtils.h" //for streetHawkIsEnabled
 #import "SHLogger.h" //for sending logline
+#import "SHStateStore.h" //for feed fetch time
 //header from System
 #import <objc/runtime.h> //for associate object
 
@@ -60,33 +61,31 @@
     }
     //use v3 endpoint and it doesn't have app_status in v3 any more, so not update APPSTATUS_FEED_FETCH_TIME. 
     handler = [handler copy];
+    NSMutableArray *arrayFeeds = [NSMutableArray array]; //feed page can be large, build SHFeedObject directly from each item while decoding, not keep whole json tree.
     [[SHHTTPSessionManager sharedInstance] GET:@"/feeds/"
                                    hostVersion:SHHostVersion_V3
                                     parameters:@{@"app_key": NONULL(StreetHawk.appKey),
                                                  @"offset": @(offset)}
+                                     streamKey:@"results"
+                                elementHandler:^(NSString * _Nullable key, id  _Nonnull element)
+     {
+         NSAssert([element isKindOfClass:[NSDictionary class]], @"Feed item should be dictionary, got %@.", element);
+         if ([element isKindOfClass:[NSDictionary class]])
+         {
+             SHFeedObject *feedObj = [SHFeedObject createFromDictionary:(NSDictionary *)element];
+             [arrayFeeds addObject:feedObj];
+         }
+     }
                                        success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
      {
-         SHLog(@"Fetch feeds: %@.", responseObject);
+         SHLog(@"Fetch feeds: %lu items.", (unsigned long)arrayFeeds.count);
          NSDictionary *dictResponse = (NSDictionary *)responseObject;
          NSAssert([dictResponse isKindOfClass:[NSDictionary class]],
                   @"Feed response should be dictionary, got %@.", responseObject);
-         NSMutableArray *arrayFeeds = [NSMutableArray array];
          NSError *error = nil;
          NSAssert([dictResponse[@"results"] isKindOfClass:[NSArray class]],
                   @"Feed result should be array, got %@.", dictResponse[@"results"]);
-         if ([dictResponse[@"results"] isKindOfClass:[NSArray class]])
-         {
-             for (id obj in (NSArray *)dictResponse[@"results"])
-             {
-                 NSAssert([obj isKindOfClass:[NSDictionary class]], @"Feed item should be dictionary, got %@.", obj);
-                 if ([obj isKindOfClass:[NSDictionary class]])
-                 {
-                     SHFeedObject *feedObj = [SHFeedObject createFromDictionary:(NSDictionary *)obj];
-                     [arrayFeeds addObject:feedObj];
-                 }
-             }
-         }
-         else
+         if (![dictResponse isKindOfClass:[NSDictionary class]] || ![dictResponse[@"results"] isKindOfClass:[NSArray class]]) //items are already parsed into `arrayFeeds`.
          {
              error = [NSError errorWithDomain:SHErrorDomain code:INT_MIN userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Feed result should be array, got %@.", responseObject]}];
          }
@@ -96,8 +95,7 @@
          }
      } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
      {
-         [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:APPSTATUS_FEED_FETCH_TIME]; //make next fetch happen as this time fail.
-         [[NSUserDefaults standardUserDefaults] synchronize];
+         [[SHStateStore sharedInstance] setObject:@(0) forKey:APPSTATUS_FEED_FETCH_TIME]; //make next fetch happen as this time fail.
          if (handler)
          {
              handler(nil, error);
@@ -21,9 +21,11 @@
 #import "SHInstall.h" //for `StreetHawk.currentInstall.suid`
 #import "SHTypes.h" //for NONULL
 #import "SHHTTPSessionManager.h" //for sending request
+#import "SHRequestOutbox.h" //for retry growth register
 #import "SHAlertView.h" //for choose channel
 #import "SHUtils.h" //for strIsEmpty
 #import "SHDeepLinking.h" //for handling deeplinking url
+#import "SHStateStore.h" //for growth host and registered flag
 //header from System
 #import <MessageUI/MessageUI.h> //for sending SMS and email
 #import <Social/Social.h> //for sharing to Facebook, twitter etc
@@ -39,8 +41,10 @@
 //notification
 - (void)installRegistrationSucceededForGrowth:(NSNotification *)notification;
 - (void)installUpdateSucceededForGrowth:(NSNotification *)notification;
+- (void)registerResultForGrowth:(NSNotification *)notification; //growth register sent by outbox later. notification name: SH_GrowthBridge_RegisterResult_Notification; user info: @{result: responseObject}.
 - (void)handleGrowthRegister;
 - (NSString *)parseGrowthResult:(id)result withError:(NSError *)error;
+- (NSString *)currentGrowthHost; //growth host from app status, or stand-in server if `StreetHawk.hostOverride` is set.
 
 @end
 
@@ -54,7 +58,7 @@
     {
         NSMutableDictionary *initialDefaults = [NSMutableDictionary dictionary];
         initialDefaults[GROWTH_REGISTERED] = @(NO);
-        [[NSUserDefaults standardUserDefaults] registerDefaults:initialDefaults];
+        [[SHStateStore sharedInstance] registerDefaults:initialDefaults];
     }
 }
 
@@ -64,13 +68,12 @@
 
 - (void)setIsGrowthRegistered:(BOOL)isGrowthRegistered
 {
-    [[NSUserDefaults standardUserDefaults] setObject:[NSNumber numberWithBool:isGrowthRegistered] forKey:GROWTH_REGISTERED];
-    [[NSUserDefaults standardUserDefaults] synchronize];
+    [[SHStateStore sharedInstance] setObject:[NSNumber numberWithBool:isGrowthRegistered] forKey:GROWTH_REGISTERED];
 }
 
 - (BOOL)isGrowthRegistered
 {
-    NSObject *obj = [[NSUserDefaults standardUserDefaults] objectForKey:GROWTH_REGISTERED];
+    NSObject *obj = [[SHStateStore sharedInstance] objectForKey:GROWTH_REGISTERED];
     if (obj != nil && [obj isKindOfClass:[NSNumber class]])
     {
         return [(NSNumber *)obj boolValue];
@@ -139,7 +142,7 @@
     {
         [dictParam setObject:NONULL(default_url.absoluteString) forKey:@"destination_url_default"];
     }
-    NSString *growthHost = [[NSUserDefaults standardUserDefaults] objectForKey:@"APPSTATUS_GROWTH_HOST"]; //SHAppStatus is private
+    NSString *growthHost = [self currentGrowthHost];
     NSAssert(!shStrIsEmpty(growthHost), @"Fail to share because cannot find growth host in app status.");
     if (shStrIsEmpty(growthHost))
     {
@@ -362,7 +365,7 @@
     [dictParam setObject:NONULL([UIDevice currentDevice].identifierForVendor.UUIDString) forKey:@"installid"];
     [dictParam setObject:NONULL(StreetHawk.currentInstall.suid) forKey:@"sh_cuid"];
     [dictParam setObject:@([[NSTimeZone localTimeZone] secondsFromGMT]/60) forKey:@"timezone"];
-    NSString *growthHost = [[NSUserDefaults standardUserDefaults] objectForKey:@"APPSTATUS_GROWTH_HOST"]; //SHAppStatus is private
+    NSString *growthHost = [self currentGrowthHost];
     NSAssert(!shStrIsEmpty(growthHost), @"Fail to register because cannot find growth host in app status.");
     if (shStrIsEmpty(growthHost))
     {
@@ -394,6 +397,11 @@
     } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
     {
         //self.isGrowthRegistered = NO; //this time register fail, do it next time. //Server side throw error when meet duplication, and client side cannot retry.
+        //Duplication is rejected by server so not retryable; but if request not reach server, put into outbox and the result is handled by `registerResultForGrowth:`. Idempotency key per install avoids duplication.
+        if ([SHRequestOutbox isRetryableError:error forTask:task])
+        {
+            [[SHRequestOutbox sharedInstance] enqueueMethod:@"GET" path:[NSString stringWithFormat:@"%@/i/", growthHost] hostVersion:SHHostVersion_Unknown body:dictParam useJSON:NO idempotencyKey:[NSString stringWithFormat:@"growth_register_%@", StreetHawk.currentInstall.suid] coalesceKey:@"growth_register" resultNotification:@"SH_GrowthBridge_RegisterResult_Notification"];
+        }
         if (handler)
         {
             handler(nil, error);
@@ -456,7 +464,7 @@
         }
         [dictParam setObject:NONULL(uri) forKey:@"uri"];
     }
-    NSString *growthHost = [[NSUserDefaults standardUserDefaults] objectForKey:@"APPSTATUS_GROWTH_HOST"]; //SHAppStatus is private
+    NSString *growthHost = [self currentGrowthHost];
     NSAssert(!shStrIsEmpty(growthHost), @"Fail to increase because cannot find growth host in app status.");
     if (shStrIsEmpty(growthHost))
     {
@@ -509,6 +517,17 @@
     [self handleGrowthRegister];
 }
 
+- (void)registerResultForGrowth:(NSNotification *)notification
+{
+    id result = notification.userInfo[@"result"];
+    if (result == nil)
+    {
+        return;
+    }
+    SHLog(@"Growth register (retried) try to open: %@.", result);
+    [self parseGrowthResult:result withError:nil];
+}
+
 - (void)handleGrowthRegister
 {
     [[SHGrowth sharedInstance] registerGrowth:^(NSObject *result, NSError *error) //Growth register automatically after install/register or install/upate.
@@ -522,6 +541,20 @@
      }];
 }
 
+- (NSString *)currentGrowthHost
+{
+    if (!shStrIsEmpty(StreetHawk.hostOverride))
+    {
+        NSString *hostOverride = StreetHawk.hostOverride;
+        if ([hostOverride hasSuffix:@"/"])
+        {
+            hostOverride = [hostOverride substringToIndex:hostOverride.length - 1]; //remove last "/"
+        }
+        return [NSString stringWithFormat:@"%@/growth", hostOverride];
+    }
+    return [[SHStateStore sharedInstance] objectForKey:@"APPSTATUS_GROWTH_HOST"]; //SHAppStatus is private
+}
+
 - (NSString *)parseGrowthResult:(id)result withError:(NSError *)error
 {
     if (error == nil && result != nil && [result isKindOfClass:[NSDictionary class]])
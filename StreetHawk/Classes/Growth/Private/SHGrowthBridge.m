@@ -36,6 +36,7 @@
     
     [[NSNotificationCenter defaultCenter] addObserver:[SHGrowth sharedInstance] selector:@selector(installRegistrationSucceededForGrowth:) name:SHInstallRegistrationSuccessNotification object:nil];
     [[NSNotificationCenter defaultCenter] addObserver:[SHGrowth sharedInstance] selector:@selector(installUpdateSucceededForGrowth:) name:SHInstallUpdateSuccessNotification object:nil];
+    [[NSNotificationCenter defaultCenter] addObserver:[SHGrowth sharedInstance] selector:@selector(registerResultForGrowth:) name:@"SH_GrowthBridge_RegisterResult_Notification" object:nil];
 }
 
 #pragma mark - private
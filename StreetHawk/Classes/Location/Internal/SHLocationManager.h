@@ -38,6 +38,42 @@ enum SHGeoLocationMonitorState
 };
 typedef enum SHGeoLocationMonitorState SHGeoLocationMonitorState;
 
+@protocol SHLocationSourceDelegate;
+
+/**
+ Source of location events. CLLocationManager is the source on device, `SHLocationReplay` is a source replaying a trace without walking around.
+ */
+@protocol SHLocationSource <NSObject>
+
+/**
+ Regions the source reports state for, same as `CLLocationManager.monitoredRegions`.
+ */
+@property (nonatomic, readonly, copy) NSSet *monitoredRegions;
+
+@end
+
+/**
+ Receiver of location events from a `SHLocationSource`. These are the events geofence, iBeacon and location logging handle, `SHLocationManager` implements it and its `CLLocationManagerDelegate` functions pass CLLocationManager's events here.
+ */
+@protocol SHLocationSourceDelegate <NSObject>
+
+/**
+ New locations, same as `locationManager:didUpdateLocations:`.
+ */
+- (void)locationSource:(id<SHLocationSource>)source didUpdateLocations:(NSArray *)locations;
+
+/**
+ State of a monitored region is determined, as entering and exiting it.
+ */
+- (void)locationSource:(id<SHLocationSource>)source didDetermineState:(CLRegionState)state forRegion:(CLRegion *)region;
+
+/**
+ Result of one ranging of an iBeacon region, `beacons` is empty if none found.
+ */
+- (void)locationSource:(id<SHLocationSource>)source didRangeBeacons:(NSArray *)beacons inRegion:(CLBeaconRegion *)region;
+
+@end
+
 /**
 A core class to monitor location change. By default process of StreetHawk SDK, it works in the following way:
 
@@ -58,7 +94,7 @@ A core class to monitor location change. By default process of StreetHawk SDK, i
  
  Normally caller does not need to start/stop location service, or set the properties. Caller just need to visit the location properties. But the control API also provided.
  */
-@interface SHLocationManager : NSObject<CLLocationManagerDelegate>
+@interface SHLocationManager : NSObject<CLLocationManagerDelegate, SHLocationSourceDelegate>
 
 /** @name Creator */
 
@@ -113,6 +149,36 @@ A core class to monitor location change. By default process of StreetHawk SDK, i
  */
 @property (nonatomic) float bgMinDistanceBetweenEvents;
 
+/**
+ Maximum time geo locations are buffered before sending as one logline, which is also latency of location reaching server. 0 means not buffer, each location passing above minimum time and distance is sent as one logline. When set, every location is buffered instead, and above minimum time and distance not apply. Buffered trajectory is simplified within 50 metres, keeping at least one location each 10 minutes, and sent when the oldest one reaches this time even no new location comes, or buffer reaches 100 locations, or App goes to background. default = 0 (second).
+ */
+@property (nonatomic) NSTimeInterval geoLocationBatchInterval;
+
+/**
+ Number of continuous ranging results without an iBeacon before it's treated as out, to avoid a pair of out/in logs when an iBeacon is missed in one ranging. Ranging happens about once a second. Must be at least 1, 1 means out at first miss. default = 3.
+ */
+@property (nonatomic) NSInteger iBeaconExitMisses;
+
+/**
+ Minimum time between logs of one iBeacon's distance band change. Distance of an iBeacon in range is smoothed from ranging results, and bands are immediate (< 0.5 metre), near (< 3 metres) and far. When the smoothed distance moves to another band, the new distance is logged but not more often than this. 0 means not log band change, only log in/out. default = 0 (second).
+ */
+@property (nonatomic) NSTimeInterval iBeaconBandInterval;
+
+/**
+ Clock of time gates: minimum time between location logs, batch window and stationary check. Returns seconds since 1970. nil means wall clock, replay sets a virtual clock so gates follow trace time. default = nil.
+ */
+@property (nonatomic, copy) NSTimeInterval (^nowBlock)(void);
+
+/**
+ Whether accuracy, distance filter and monitor mode follow movement. Movement is guessed from speed and accuracy of recent fixes as stationary, walking or driving. While moving, distance filter is half of the distance to next report, which is max(minimum distance, speed * minimum time), and desired accuracy is the coarsest not larger than it, so driving needs fewer and rougher fixes than walking for same reports. When staying within 50 metres for 3 minutes, desired accuracy is hundred metres and distance filter is 50 metres, so leaving is still seen at once in foreground; in background standard location update is replaced by significant location update until device moves again. It overrides `desiredAccuracy` and `distanceFilter`, and turning it off restores their defaults. default = NO.
+ */
+@property (nonatomic) BOOL adaptiveSampling;
+
+/**
+ Counters for measuring adaptive sampling, counted whether `adaptiveSampling` is on or off so both can be compared. Key is movement "unknown", "stationary", "walking" or "driving", value is dictionary with "fixes" (number of locations received), "cpu" (CPU seconds of main thread handling them) and "duration" (seconds in this movement).
+ */
+@property (nonatomic, readonly) NSDictionary *samplingStatistics;
+
 /**
  Current monitoring regions, either geo-location region or iBeacon region. This returns system internal `CLLocationManager.monitoredRegions`. When App re-launch previously monitored region recover, so only system knows what are the real monitored regions. Add it by `- (BOOL)startMonitorRegion:(CLRegion *)region` and removed by `- (void)stopmonitorRegion:(CLRegion *)region`.
  */
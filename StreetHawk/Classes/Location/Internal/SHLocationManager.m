@@ -21,6 +21,10 @@
 #import "SHAppStatus.h" //for check streethawkEnabled
 #import "SHLogger.h" //for sending logline
 #import "SHUtils.h" //for streetHawkIsEnabled
+#import "SHStateStore.h" //for location denied and network recover flags
+#import "SHSamplingPolicy.h" //for adaptive sampling
+#import "SHTrajectory.h" //for simplifying batch locations
+#import "SHGeoDistance.h" //for distance between locations
 //header from System
 #import <UIKit/UIKit.h> //for `[UIApplication sharedApplication]`
 //header from Third-party
@@ -29,10 +33,29 @@
 #define LOCATION_DENIED_SENT        @"LOCATION_DENIED_SENT" //a flag indicates this App has sent location denied log to avoid send one more time.
 #define NETWORK_RECOVER_TIME        @"NETWORK_RECOVER_TIME" //Record time when network from not-connected to connected(either cellura or Wifi). If it's 0 means current network not connected; if it's number means last time from non-connected to connected.
 
+#define GEOLOCATION_BATCH_TOLERANCE     50 //metres, buffered trajectory is simplified within this distance
+#define GEOLOCATION_BATCH_MAX_GAP       600 //seconds, simplified trajectory keeps at least one location in this time so staying still is kept
+#define GEOLOCATION_BATCH_MAX_POINTS    100 //send when buffer reaches this count, also bound of buffer when no network
+
 #define SH_FG_INTERVAL  @"SH_FG_INTERVAL" //value for location update time interval in FG
 #define SH_FG_DISTANCE  @"SH_FG_DISTANCE" //value for location update distance in FG
 #define SH_BG_INTERVAL  @"SH_BG_INTERVAL" //value for location update time interval in BG
 #define SH_BG_DISTANCE  @"SH_BG_DISTANCE" //value for location update distance in BG
+#define SH_BATCH_INTERVAL   @"SH_BATCH_INTERVAL" //value for maximum seconds buffering geo locations
+#define SH_IBEACON_EXIT_MISSES  @"SH_IBEACON_EXIT_MISSES" //value for continuous ranging misses before iBeacon out
+#define SH_IBEACON_BAND_INTERVAL    @"SH_IBEACON_BAND_INTERVAL" //value for minimum seconds between iBeacon distance band change logs
+#define SH_ADAPTIVE_SAMPLING    @"SH_ADAPTIVE_SAMPLING" //value for whether accuracy, distance filter and monitor mode follow movement
+
+/**
+ CLLocationManager is the location source on device, it already has `monitoredRegions`.
+ */
+@interface CLLocationManager (SHLocationSource) <SHLocationSource>
+
+@end
+
+@implementation CLLocationManager (SHLocationSource)
+
+@end
 
 @interface SHLocationManager()
 
@@ -40,10 +63,23 @@
 @property (nonatomic) CLLocationCoordinate2D currentGeoLocationValue; //extent read-write access
 @property (nonatomic) CLLocationCoordinate2D sentGeoLocationValue; //sent by log location 20
 @property (nonatomic) NSTimeInterval sentGeoLocationTime;  //for calculate time delta to prevent too often location update notification send.
+@property (nonatomic, strong) NSMutableArray *arrayBatchLocations; //CLLocation buffered when `geoLocationBatchInterval` > 0, only accessed in main thread.
+@property (nonatomic, strong) SHSamplingPolicy *samplingPolicy; //guess movement from fixes, counts even when `adaptiveSampling` is off for comparing.
+@property (nonatomic) BOOL isStandardRequested; //last mode asked by `startMonitorGeoLocationStandard:`, adaptive sampling only uses significant instead of standard when staying in background, never reverse.
 
 - (void)createLocationManager;  //create internal operating iOS object.
+- (NSTimeInterval)now; //seconds since 1970 by `nowBlock`, or wall clock.
 - (double)distanceSquaredForLat1:(double)lat1 lng1:(double)lng1 lat2:(double)lat2 lng2:(double)lng2; //Calculates the square of distance between two lat/longs. Geared for speed over accuracy.
 - (void)sendGeoLocationUpdate;
+- (void)bufferGeoLocations:(NSArray *)locations; //add CLLocation into batch buffer.
+- (NSArray *)simplifyBatchLocations; //buffered locations kept after simplifying trajectory.
+- (void)sendBatchLocations:(BOOL)isForce; //send buffered locations as one logline when window is due or `isForce`.
+- (void)scheduleBatchDeadline; //flush when oldest buffered location is due even no new fix comes, cancel if buffer is empty.
+- (void)batchDeadlineHandler; //window of oldest buffered location is due.
+- (void)appDidEnterBackgroundHandler:(NSNotification *)notification; //send buffered locations as App may be killed in background, and apply sampling for background.
+- (BOOL)monitorGeoLocationStandard:(BOOL)standard; //start standard or significant location update in the mode decided.
+- (void)applySamplingPolicy; //set accuracy, distance filter and monitor mode for current movement when `adaptiveSampling`.
+- (void)stationaryCheckHandler; //no fix comes with distance filter when staying, check it after a while.
 
 - (NSString *)formatBeaconRegion:(CLBeaconRegion *)region;  //format beacon region to a string in format UUID-major-minor-identifier.
 - (BOOL)isRegionSame:(CLRegion *)r1 with:(CLRegion *)r2;  //compare two iBeacon region is same.
@@ -68,6 +104,10 @@
         initialDefaults[SH_FG_DISTANCE] = @(SHLocation_FG_Distance);
         initialDefaults[SH_BG_INTERVAL] = @(SHLocation_BG_Interval);
         initialDefaults[SH_BG_DISTANCE] = @(SHLocation_BG_Distance);
+        initialDefaults[SH_BATCH_INTERVAL] = @(SHLocation_Batch_Interval);
+        initialDefaults[SH_IBEACON_EXIT_MISSES] = @(SHLocation_iBeacon_ExitMisses);
+        initialDefaults[SH_IBEACON_BAND_INTERVAL] = @(SHLocation_iBeacon_BandInterval);
+        initialDefaults[SH_ADAPTIVE_SAMPLING] = @(SHLocation_AdaptiveSampling);
         [[NSUserDefaults standardUserDefaults] registerDefaults:initialDefaults];
     }
 }
@@ -88,6 +128,9 @@
     {
         [self createLocationManager];
         [self createNetworkMonitor];
+        self.arrayBatchLocations = [NSMutableArray array];
+        self.samplingPolicy = [[SHSamplingPolicy alloc] init];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appDidEnterBackgroundHandler:) name:UIApplicationDidEnterBackgroundNotification object:nil];
     }
     return self;
 }
@@ -131,6 +174,7 @@
 {
     self.locationManager.delegate = nil;
     [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(stationaryCheckHandler) object:nil];
     [self.reachability stopNotifier];
 }
 
@@ -166,12 +210,11 @@
     }
     if (isEnabled)
     {
-        NSString *sentFlag = [[NSUserDefaults standardUserDefaults] objectForKey:LOCATION_DENIED_SENT];
+        NSString *sentFlag = [[SHStateStore sharedInstance] objectForKey:LOCATION_DENIED_SENT];
         if (sentFlag != nil && sentFlag.length > 0)
         {
             //clear location denied flag
-            [[NSUserDefaults standardUserDefaults] setObject:@"" forKey:LOCATION_DENIED_SENT];
-            [[NSUserDefaults standardUserDefaults] synchronize];
+            [[SHStateStore sharedInstance] setObject:@"" forKey:LOCATION_DENIED_SENT];
         }
     }
     return isEnabled;
@@ -305,6 +348,116 @@
     }
 }
 
+- (NSTimeInterval)geoLocationBatchInterval
+{
+    NSTimeInterval value = [[[NSUserDefaults standardUserDefaults] objectForKey:SH_BATCH_INTERVAL] doubleValue];
+    NSAssert(value >= 0, @"Not find suitable value for SH_BATCH_INTERVAL");
+    if (value >= 0)
+    {
+        return value;
+    }
+    else
+    {
+        return SHLocation_Batch_Interval;
+    }
+}
+
+- (void)setGeoLocationBatchInterval:(NSTimeInterval)geoLocationBatchInterval
+{
+    if (geoLocationBatchInterval >= 0)
+    {
+        [[NSUserDefaults standardUserDefaults] setObject:@(geoLocationBatchInterval) forKey:SH_BATCH_INTERVAL];
+        [[NSUserDefaults standardUserDefaults] synchronize];
+    }
+}
+
+- (NSInteger)iBeaconExitMisses
+{
+    NSInteger value = [[[NSUserDefaults standardUserDefaults] objectForKey:SH_IBEACON_EXIT_MISSES] integerValue];
+    NSAssert(value >= 1, @"Not find suitable value for SH_IBEACON_EXIT_MISSES");
+    if (value >= 1)
+    {
+        return value;
+    }
+    else
+    {
+        return SHLocation_iBeacon_ExitMisses;
+    }
+}
+
+- (void)setIBeaconExitMisses:(NSInteger)iBeaconExitMisses
+{
+    if (iBeaconExitMisses >= 1)
+    {
+        [[NSUserDefaults standardUserDefaults] setObject:@(iBeaconExitMisses) forKey:SH_IBEACON_EXIT_MISSES];
+        [[NSUserDefaults standardUserDefaults] synchronize];
+    }
+}
+
+- (NSTimeInterval)iBeaconBandInterval
+{
+    NSTimeInterval value = [[[NSUserDefaults standardUserDefaults] objectForKey:SH_IBEACON_BAND_INTERVAL] doubleValue];
+    NSAssert(value >= 0, @"Not find suitable value for SH_IBEACON_BAND_INTERVAL");
+    if (value >= 0)
+    {
+        return value;
+    }
+    else
+    {
+        return SHLocation_iBeacon_BandInterval;
+    }
+}
+
+- (void)setIBeaconBandInterval:(NSTimeInterval)iBeaconBandInterval
+{
+    if (iBeaconBandInterval >= 0)
+    {
+        [[NSUserDefaults standardUserDefaults] setObject:@(iBeaconBandInterval) forKey:SH_IBEACON_BAND_INTERVAL];
+        [[NSUserDefaults standardUserDefaults] synchronize];
+    }
+}
+
+- (BOOL)adaptiveSampling
+{
+    return [[[NSUserDefaults standardUserDefaults] objectForKey:SH_ADAPTIVE_SAMPLING] boolValue];
+}
+
+- (void)setAdaptiveSampling:(BOOL)adaptiveSampling
+{
+    if (adaptiveSampling == self.adaptiveSampling)
+    {
+        return;
+    }
+    [[NSUserDefaults standardUserDefaults] setObject:@(adaptiveSampling) forKey:SH_ADAPTIVE_SAMPLING];
+    [[NSUserDefaults standardUserDefaults] synchronize];
+    if (adaptiveSampling)
+    {
+        [self applySamplingPolicy];
+    }
+    else
+    {
+        //back to fixed sampling as `createLocationManager`, and the mode asked.
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(stationaryCheckHandler) object:nil];
+        self.desiredAccuracy = kCLLocationAccuracyHundredMeters;
+        self.distanceFilter = 10.0f;
+        if (self.geolocationMonitorState != SHGeoLocationMonitorState_Stopped)
+        {
+            [self monitorGeoLocationStandard:self.isStandardRequested];
+        }
+    }
+}
+
+- (void)setNowBlock:(NSTimeInterval (^)(void))nowBlock
+{
+    _nowBlock = [nowBlock copy];
+    self.samplingPolicy.nowBlock = _nowBlock; //stationary check follows same clock.
+}
+
+- (NSDictionary *)samplingStatistics
+{
+    return self.samplingPolicy.statistics;
+}
+
 #pragma mark - detecting result
 
 - (NSArray *)monitoredRegions
@@ -346,6 +499,13 @@
 }
 
 - (BOOL)startMonitorGeoLocationStandard:(BOOL)standard
+{
+    self.isStandardRequested = standard;
+    BOOL isStationaryInBG = (self.adaptiveSampling && self.samplingPolicy.mode == SHSamplingMode_Stationary && [UIApplication sharedApplication].applicationState == UIApplicationStateBackground);
+    return [self monitorGeoLocationStandard:(standard && !isStationaryInBG)];
+}
+
+- (BOOL)monitorGeoLocationStandard:(BOOL)standard
 {
     if (!streetHawkIsEnabled())
     {
@@ -582,16 +742,17 @@
 
 #pragma mark - private functions
 
+- (NSTimeInterval)now
+{
+    return (self.nowBlock != nil) ? self.nowBlock() : [[NSDate date] timeIntervalSince1970];
+}
+
 - (double)distanceSquaredForLat1:(double)lat1 lng1:(double)lng1 lat2:(double)lat2 lng2:(double)lng2
 {
-    double radius = (3.14159265358979323846 / 180.0);
-    double nauticalMilesPerLatitude = 60.00721;
-    double nauticalMilesPerLongitude = 60.10793;
-    double metersPerNauticalMile = 1852;
-    // simple pythagorean formula - for efficiency
-    float yDistance = (lat2 - lat1) * nauticalMilesPerLatitude;
-    float xDistance = (cos(lat1 * radius) + cos(lat2 * radius)) * (lng2 - lng1) * (nauticalMilesPerLongitude / 2.0);
-    return ((yDistance * yDistance) + (xDistance * xDistance)) * (metersPerNauticalMile * metersPerNauticalMile);
+    double distanceSquared = 0;
+    double cosLat2 = shCosLatitude(lat2);
+    shDistancesSquared(lat1, lng1, shCosLatitude(lat1), &lat2, &lng2, &cosLat2, 1, &distanceSquared);
+    return distanceSquared;
 }
 
 - (void)sendGeoLocationUpdate
@@ -604,6 +765,11 @@
     {
         return; //if current location is not detected, not send log 20.
     }
+    if (self.geoLocationBatchInterval > 0 || self.arrayBatchLocations.count > 0) //batching mode, or just turned off and have left locations.
+    {
+        [self sendBatchLocations:(self.geoLocationBatchInterval == 0)];
+        return;
+    }
     if (self.reachability.currentReachabilityStatus != ReachableViaWiFi && self.reachability.currentReachabilityStatus != ReachableViaWWAN)
     {
         return; //only do location 20 when network available
@@ -611,7 +777,7 @@
     BOOL isFG = ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground); //When asking for permission it's InActive
     double minTimeBWEvents = isFG ? self.fgMinTimeBetweenEvents * 60 : self.bgMinTimeBetweenEvents * 60;
     double minDistanceBWEvents = isFG ? self.fgMinDistanceBetweenEvents : self.bgMinDistanceBetweenEvents;
-    NSTimeInterval timeDelta = [[NSDate date] timeIntervalSince1970] - self.sentGeoLocationTime;
+    NSTimeInterval timeDelta = [self now] - self.sentGeoLocationTime;
     double distSquared = [self distanceSquaredForLat1:self.currentGeoLocation.latitude lng1:self.currentGeoLocation.longitude lat2:self.sentGeoLocationValue.latitude lng2:self.sentGeoLocationValue.longitude];
     double distanceDelta = sqrt(distSquared);
     if ((self.sentGeoLocationValue.latitude == 0 || self.sentGeoLocationValue.longitude == 0) //if not send before, do it anyway
@@ -621,13 +787,184 @@
         NSString *lmLog = [NSString stringWithFormat:@"LocationManager Delegate: FG (%@), new location (%f, %f), old location (%f, %f), distance (%f >= %f), last time (%@), time delta (%f >= %f).", (isFG ? @"Yes" : @"No"), self.currentGeoLocation.latitude, self.currentGeoLocation.longitude, self.sentGeoLocationValue.latitude, self.sentGeoLocationValue.longitude, distanceDelta, minDistanceBWEvents, [NSDate dateWithTimeIntervalSince1970:self.sentGeoLocationTime], timeDelta, minTimeBWEvents];
         SHLog(lmLog);
         self.sentGeoLocationValue = self.currentGeoLocation; //do it early
-        self.sentGeoLocationTime = [[NSDate date] timeIntervalSince1970];
+        self.sentGeoLocationTime = [self now];
         //Only send logline 20 when have location bridge. Above check must kept here because the internal variables cannot move to SHLocationBridge.
         [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_SendGeoLocationLogline" object:nil userInfo:@{@"comment": NONULL(shSerializeObjToJson(dictLoc))}];
 
     }
 }
 
+- (void)bufferGeoLocations:(NSArray *)locations
+{
+    for (CLLocation *location in locations)
+    {
+        if (location.horizontalAccuracy < 0 || location.coordinate.latitude == 0 || location.coordinate.longitude == 0)
+        {
+            continue; //invalid location.
+        }
+        CLLocation *lastLocation = self.arrayBatchLocations.lastObject;
+        if (lastLocation != nil && [location.timestamp timeIntervalSinceDate:lastLocation.timestamp] < GEOLOCATION_BATCH_MAX_GAP
+            && [self distanceSquaredForLat1:lastLocation.coordinate.latitude lng1:lastLocation.coordinate.longitude lat2:location.coordinate.latitude lng2:location.coordinate.longitude] < GEOLOCATION_BATCH_TOLERANCE * GEOLOCATION_BATCH_TOLERANCE)
+        {
+            continue; //staying still, simplifying would drop it anyway.
+        }
+        [self.arrayBatchLocations addObject:location];
+    }
+}
+
+- (NSArray *)simplifyBatchLocations
+{
+    NSUInteger count = self.arrayBatchLocations.count;
+    if (count <= 2)
+    {
+        return [self.arrayBatchLocations copy];
+    }
+    NSMutableData *dataLatitudes = [NSMutableData dataWithLength:count * sizeof(double)];
+    NSMutableData *dataLongitudes = [NSMutableData dataWithLength:count * sizeof(double)];
+    NSMutableData *dataTimes = [NSMutableData dataWithLength:count * sizeof(double)];
+    NSMutableData *dataKeep = [NSMutableData dataWithLength:count];
+    double *latitudes = (double *)dataLatitudes.mutableBytes;
+    double *longitudes = (double *)dataLongitudes.mutableBytes;
+    double *times = (double *)dataTimes.mutableBytes;
+    unsigned char *keep = (unsigned char *)dataKeep.mutableBytes;
+    for (NSUInteger i = 0; i < count; i ++)
+    {
+        CLLocation *location = self.arrayBatchLocations[i];
+        latitudes[i] = location.coordinate.latitude;
+        longitudes[i] = location.coordinate.longitude;
+        times[i] = location.timestamp.timeIntervalSinceReferenceDate;
+    }
+    size_t keptCount = shSimplifyTrajectory(latitudes, longitudes, times, count, GEOLOCATION_BATCH_TOLERANCE, GEOLOCATION_BATCH_MAX_GAP, keep);
+    NSMutableArray *arrayKept = [NSMutableArray arrayWithCapacity:keptCount];
+    for (NSUInteger i = 0; i < count; i ++)
+    {
+        if (keep[i])
+        {
+            [arrayKept addObject:self.arrayBatchLocations[i]];
+        }
+    }
+    return arrayKept;
+}
+
+- (void)sendBatchLocations:(BOOL)isForce
+{
+    if (self.arrayBatchLocations.count == 0)
+    {
+        return;
+    }
+    if (StreetHawk.reportWorkHomeLocationOnly)
+    {
+        [self.arrayBatchLocations removeAllObjects];
+        [self scheduleBatchDeadline];
+        return; //not send logline 20.
+    }
+    CLLocation *firstLocation = self.arrayBatchLocations.firstObject;
+    BOOL isDue = ([self now] - firstLocation.timestamp.timeIntervalSince1970 >= self.geoLocationBatchInterval || self.arrayBatchLocations.count >= GEOLOCATION_BATCH_MAX_POINTS);
+    BOOL isReachable = (self.reachability.currentReachabilityStatus == ReachableViaWiFi || self.reachability.currentReachabilityStatus == ReachableViaWWAN);
+    if (!isForce && (!isDue || !isReachable))
+    {
+        if (self.arrayBatchLocations.count >= GEOLOCATION_BATCH_MAX_POINTS) //no network for long, keep buffer bounded.
+        {
+            NSArray *arrayKept = [self simplifyBatchLocations];
+            NSUInteger dropCount = (arrayKept.count >= GEOLOCATION_BATCH_MAX_POINTS) ? arrayKept.count - GEOLOCATION_BATCH_MAX_POINTS / 2 : 0;
+            self.arrayBatchLocations = [NSMutableArray arrayWithArray:[arrayKept subarrayWithRange:NSMakeRange(dropCount, arrayKept.count - dropCount)]];
+        }
+        [self scheduleBatchDeadline]; //oldest may change, or not due yet.
+        return;
+    }
+    NSArray *arrayKept = [self simplifyBatchLocations];
+    [self.arrayBatchLocations removeAllObjects];
+    [self scheduleBatchDeadline];
+    NSMutableArray *arrayPoints = [NSMutableArray arrayWithCapacity:arrayKept.count];
+    for (CLLocation *location in arrayKept)
+    {
+        [arrayPoints addObject:@{@"lat": @(location.coordinate.latitude), @"lng": @(location.coordinate.longitude), @"time": NONULL(shFormatISODate(location.timestamp))}];
+    }
+    CLLocation *lastLocation = arrayKept.lastObject;
+    //"lat" and "lng" are latest location, same as single location logline so server not knowing batch still works.
+    NSDictionary *dictLoc = @{@"lat": @(lastLocation.coordinate.latitude), @"lng": @(lastLocation.coordinate.longitude), @"points": arrayPoints};
+    SHLog(@"LocationManager Delegate: send %lu locations simplified from buffer.", (unsigned long)arrayKept.count);
+    self.sentGeoLocationValue = lastLocation.coordinate;
+    self.sentGeoLocationTime = [self now];
+    [[NSNotificationCenter defaultCenter] postNotificationName:@"SH_LMBridge_SendGeoLocationLogline" object:nil userInfo:@{@"comment": NONULL(shSerializeObjToJson(dictLoc))}];
+}
+
+- (void)scheduleBatchDeadline
+{
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(batchDeadlineHandler) object:nil];
+    CLLocation *firstLocation = self.arrayBatchLocations.firstObject;
+    if (firstLocation == nil)
+    {
+        return;
+    }
+    NSTimeInterval delay = self.geoLocationBatchInterval - ([self now] - firstLocation.timestamp.timeIntervalSince1970);
+    if (delay > 0) //already due means waiting for network, network recover sends it.
+    {
+        [self performSelector:@selector(batchDeadlineHandler) withObject:nil afterDelay:delay];
+    }
+}
+
+- (void)batchDeadlineHandler
+{
+    [self sendBatchLocations:(self.geoLocationBatchInterval == 0)];
+}
+
+- (void)appDidEnterBackgroundHandler:(NSNotification *)notification
+{
+    [self sendBatchLocations:YES];
+    [self applySamplingPolicy]; //staying switches to significant update in background.
+}
+
+- (void)applySamplingPolicy
+{
+    if (!self.adaptiveSampling || self.geolocationMonitorState == SHGeoLocationMonitorState_Stopped)
+    {
+        return;
+    }
+    BOOL isFG = ([UIApplication sharedApplication].applicationState != UIApplicationStateBackground); //same as `sendGeoLocationUpdate`
+    double minTimeBWEvents = isFG ? self.fgMinTimeBetweenEvents * 60 : self.bgMinTimeBetweenEvents * 60;
+    double minDistanceBWEvents = isFG ? self.fgMinDistanceBetweenEvents : self.bgMinDistanceBetweenEvents;
+    if (self.geoLocationBatchInterval > 0) //batching keeps every location within trajectory tolerance instead of minimum time and distance.
+    {
+        minTimeBWEvents = 0;
+        minDistanceBWEvents = GEOLOCATION_BATCH_TOLERANCE;
+    }
+    CLLocationAccuracy accuracy = [self.samplingPolicy desiredAccuracyForMinDistance:minDistanceBWEvents minTime:minTimeBWEvents];
+    if (accuracy != self.desiredAccuracy)
+    {
+        SHLog(@"LocationManager Action: Sampling mode %d, desired accuracy %f.", self.samplingPolicy.mode, accuracy);
+        self.desiredAccuracy = accuracy;
+    }
+    CLLocationDistance filter = [self.samplingPolicy distanceFilterForMinDistance:minDistanceBWEvents minTime:minTimeBWEvents];
+    if (fabs(filter - self.distanceFilter) >= 1) //speed changes a little each fix, not reset location manager for it.
+    {
+        self.distanceFilter = filter;
+    }
+    BOOL isStationary = (self.samplingPolicy.mode == SHSamplingMode_Stationary);
+    if (self.isStandardRequested)
+    {
+        //In foreground staying keeps standard update with hundred metres accuracy and 50 metres distance filter set above, so leaving is seen at once. Significant update only saves battery in background, where its delay is acceptable.
+        [self monitorGeoLocationStandard:!(isStationary && !isFG)]; //same mode returns directly.
+    }
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(stationaryCheckHandler) object:nil];
+    if (!isStationary)
+    {
+        [self performSelector:@selector(stationaryCheckHandler) withObject:nil afterDelay:SH_SAMPLING_STATIONARY_TIME];
+    }
+}
+
+- (void)stationaryCheckHandler
+{
+    if ([self.samplingPolicy checkStationary])
+    {
+        [self applySamplingPolicy];
+    }
+    else if (self.adaptiveSampling && self.samplingPolicy.mode != SHSamplingMode_Stationary)
+    {
+        [self performSelector:@selector(stationaryCheckHandler) withObject:nil afterDelay:SH_SAMPLING_STATIONARY_TIME];
+    }
+}
+
 - (NSString *)formatBeaconRegion:(CLBeaconRegion *)region
 {
     //major and minor can be null or int value, int value is from 0~65535. Check nil as nil.intValue=0.
@@ -689,7 +1026,7 @@
 - (BOOL)updateRecoverTime
 {
     NSTimeInterval recoverTime = 0;
-    NSObject *recoverTimeValue = [[NSUserDefaults standardUserDefaults] objectForKey:NETWORK_RECOVER_TIME];
+    NSObject *recoverTimeValue = [[SHStateStore sharedInstance] objectForKey:NETWORK_RECOVER_TIME];
     if (recoverTimeValue != nil && [recoverTimeValue isKindOfClass:[NSNumber class]])
     {
         recoverTime = [(NSNumber *)recoverTimeValue doubleValue];
@@ -698,8 +1035,7 @@
     {
         if (recoverTime != 0)
         {
-            [[NSUserDefaults standardUserDefaults] setDouble:0 forKey:NETWORK_RECOVER_TIME]; //not connected
-            [[NSUserDefaults standardUserDefaults] synchronize];
+            [[SHStateStore sharedInstance] setDouble:0 forKey:NETWORK_RECOVER_TIME]; //not connected
             return YES;
         }
     }
@@ -707,8 +1043,7 @@
     {
         if (recoverTime == 0)
         {
-            [[NSUserDefaults standardUserDefaults] setDouble:[[NSDate date] timeIntervalSinceReferenceDate] forKey:NETWORK_RECOVER_TIME]; //connected
-            [[NSUserDefaults standardUserDefaults] synchronize];
+            [[SHStateStore sharedInstance] setDouble:[[NSDate date] timeIntervalSinceReferenceDate] forKey:NETWORK_RECOVER_TIME]; //connected
             return YES;
         }
     }
@@ -719,25 +1054,7 @@
 
 - (void)locationManager:(CLLocationManager *)manager didUpdateLocations:(NSArray *)locations  //since iOS 6.0
 {
-    if (!streetHawkIsEnabled())
-    {
-        return;
-    }
-    if (!StreetHawk.isLocationServiceEnabled)
-    {
-        return;  //initialize CLLocationManager but cannot call any function to avoid promote.
-    }
-    if (locations.count > 0)
-    {
-        CLLocationCoordinate2D previousLocation = self.currentGeoLocation;
-        self.currentGeoLocationValue = ((CLLocation *)locations[0]).coordinate;  //no matter sent log or not, keep current geo location fresh.
-        [self sendGeoLocationUpdate];
-        //send out notification for location change
-        CLLocation *oldLocation = [[CLLocation alloc] initWithLatitude:previousLocation.latitude longitude:previousLocation.longitude];
-        NSDictionary *userInfo = @{SHLMNotification_kNewLocation:locations[0], SHLMNotification_kOldLocation: oldLocation};
-        NSNotification *notification = [NSNotification notificationWithName:SHLMUpdateLocationSuccessNotification object:self userInfo:userInfo];
-        [[NSNotificationCenter defaultCenter] postNotification:notification];
-    }
+    [self locationSource:manager didUpdateLocations:locations];
 }
 
 - (void)locationManager:(CLLocationManager *)manager didFailWithError:(NSError *)error
@@ -752,12 +1069,11 @@
     }
     if (error.code == kCLErrorDenied)  //location service is denied by user
     {
-        NSString *sentFlag = [[NSUserDefaults standardUserDefaults] objectForKey:LOCATION_DENIED_SENT];
+        NSString *sentFlag = [[SHStateStore sharedInstance] objectForKey:LOCATION_DENIED_SENT];
         if (StreetHawk.currentInstall != nil && (sentFlag == nil || sentFlag.length == 0))
         {
             [StreetHawk sendLogForCode:LOG_CODE_LOCATION_DENIED withComment:@"Location service denied by user."];
-            [[NSUserDefaults standardUserDefaults] setObject:@"Sent" forKey:LOCATION_DENIED_SENT];
-            [[NSUserDefaults standardUserDefaults] synchronize];
+            [[SHStateStore sharedInstance] setObject:@"Sent" forKey:LOCATION_DENIED_SENT];
         }
     }
     else
@@ -844,49 +1160,12 @@
 
 - (void)locationManager:(CLLocationManager *)manager didDetermineState:(CLRegionState)state forRegion:(CLRegion *)region
 {
-    if (!streetHawkIsEnabled())
-    {
-        return;
-    }
-    if (!StreetHawk.isLocationServiceEnabled)
-    {
-        return;  //initialize CLLocationManager but cannot call any function to avoid promote.
-    }
-    NSString *strState = nil;
-    switch (state)
-    {
-        case CLRegionStateUnknown:
-            strState = @"\"unknown\"";
-            break;
-        case CLRegionStateInside:
-            strState = @"\"inside\"";
-            break;
-        case CLRegionStateOutside:
-            strState = @"\"outside\"";
-            break;
-        default:
-            break;
-    }
-    SHLog(@"LocationManager Delegate: Determine State %@ for Region %@", strState, region);
-    NSDictionary *userInfo = @{SHLMNotification_kRegion: region, SHLMNotification_kRegionState: @(state)};
-    NSNotification *notification = [NSNotification notificationWithName:SHLMRegionStateChangeNotification object:self userInfo:userInfo];
-    [[NSNotificationCenter defaultCenter] postNotification:notification];
+    [self locationSource:manager didDetermineState:state forRegion:region];
 }
 
 - (void)locationManager:(CLLocationManager *)manager didRangeBeacons:(NSArray *)beacons inRegion:(CLBeaconRegion *)region
 {
-    if (!streetHawkIsEnabled())
-    {
-        return;
-    }
-    if (!StreetHawk.isLocationServiceEnabled)
-    {
-        return;  //initialize CLLocationManager but cannot call any function to avoid promote.
-    }
-    SHLog(@"LocationManager Delegate: did range beacons: %@ for region: %@.", beacons, region);
-    NSDictionary *userInfo = @{SHLMNotification_kRegion: region, SHLMNotification_kBeacons: beacons};
-    NSNotification *notification = [NSNotification notificationWithName:SHLMRangeiBeaconChangedNotification object:self userInfo:userInfo];
-    [[NSNotificationCenter defaultCenter] postNotification:notification];
+    [self locationSource:manager didRangeBeacons:beacons inRegion:region];
 }
 
 - (void)locationManager:(CLLocationManager *)manager rangingBeaconsDidFailForRegion:(CLBeaconRegion *)region withError:(NSError *)error
@@ -948,4 +1227,88 @@
     [[NSNotificationCenter defaultCenter] postNotification:notification];
 }
 
+
+#pragma mark - SHLocationSourceDelegate implementation
+
+- (void)locationSource:(id<SHLocationSource>)source didUpdateLocations:(NSArray *)locations
+{
+    if (!streetHawkIsEnabled())
+    {
+        return;
+    }
+    if (!StreetHawk.isLocationServiceEnabled)
+    {
+        return;  //initialize CLLocationManager but cannot call any function to avoid promote.
+    }
+    if (locations.count > 0)
+    {
+        double cpuStart = shThreadCPUTime();
+        for (CLLocation *location in locations)
+        {
+            [self.samplingPolicy addLocation:location];
+        }
+        [self applySamplingPolicy];
+        CLLocationCoordinate2D previousLocation = self.currentGeoLocation;
+        self.currentGeoLocationValue = ((CLLocation *)locations[0]).coordinate;  //no matter sent log or not, keep current geo location fresh.
+        if (self.geoLocationBatchInterval > 0 && !StreetHawk.reportWorkHomeLocationOnly)
+        {
+            [self bufferGeoLocations:locations];
+        }
+        [self sendGeoLocationUpdate];
+        //send out notification for location change
+        CLLocation *oldLocation = [[CLLocation alloc] initWithLatitude:previousLocation.latitude longitude:previousLocation.longitude];
+        NSDictionary *userInfo = @{SHLMNotification_kNewLocation:locations[0], SHLMNotification_kOldLocation: oldLocation};
+        NSNotification *notification = [NSNotification notificationWithName:SHLMUpdateLocationSuccessNotification object:self userInfo:userInfo];
+        [[NSNotificationCenter defaultCenter] postNotification:notification];
+        [self.samplingPolicy addCPUTime:shThreadCPUTime() - cpuStart];
+    }
+}
+
+- (void)locationSource:(id<SHLocationSource>)source didDetermineState:(CLRegionState)state forRegion:(CLRegion *)region
+{
+    if (!streetHawkIsEnabled())
+    {
+        return;
+    }
+    if (!StreetHawk.isLocationServiceEnabled)
+    {
+        return;  //initialize CLLocationManager but cannot call any function to avoid promote.
+    }
+    NSString *strState = nil;
+    switch (state)
+    {
+        case CLRegionStateUnknown:
+            strState = @"\"unknown\"";
+            break;
+        case CLRegionStateInside:
+            strState = @"\"inside\"";
+            break;
+        case CLRegionStateOutside:
+            strState = @"\"outside\"";
+            break;
+        default:
+            break;
+    }
+    SHLog(@"LocationManager Delegate: Determine State %@ for Region %@", strState, region);
+    NSDictionary *userInfo = @{SHLMNotification_kRegion: region, SHLMNotification_kRegionState: @(state)};
+    NSNotification *notification = [NSNotification notificationWithName:SHLMRegionStateChangeNotification object:self userInfo:userInfo];
+    [[NSNotificationCenter defaultCenter] postNotification:notification];
+}
+
+- (void)locationSource:(id<SHLocationSource>)source didRangeBeacons:(NSArray *)beacons inRegion:(CLBeaconRegion *)region
+{
+    if (!streetHawkIsEnabled())
+    {
+        return;
+    }
+    if (!StreetHawk.isLocationServiceEnabled)
+    {
+        return;  //initialize CLLocationManager but cannot call any function to avoid promote.
+    }
+    SHLog(@"LocationManager Delegate: did range beacons: %@ for region: %@.", beacons, region);
+    NSDictionary *userInfo = @{SHLMNotification_kRegion: region, SHLMNotification_kBeacons: beacons};
+    NSNotification *notification = [NSNotification notificationWithName:SHLMRangeiBeaconChangedNotification object:self userInfo:userInfo];
+    [[NSNotificationCenter defaultCenter] postNotification:notification];
+}
+
 @end
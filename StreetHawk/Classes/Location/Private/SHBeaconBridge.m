@@ -66,13 +66,11 @@
 + (void)updateBluetoothStatusHandler:(NSNotification *)notification
 {
     [[NSUserDefaults standardUserDefaults] setObject:@([SHBeaconStatus sharedInstance].bluetoothState) forKey:SH_BEACON_BLUETOOTH];
-    [[NSUserDefaults standardUserDefaults] synchronize];
 }
 
 + (void)updateiBeaconStatusHandler:(NSNotification *)notification
 {
     [[NSUserDefaults standardUserDefaults] setObject:@([SHBeaconStatus sharedInstance].iBeaconSupportState) forKey:SH_BEACON_iBEACON];
-    [[NSUserDefaults standardUserDefaults] synchronize];
 }
 
 + (void)setIBeaconTimestampStatusHandler:(NSNotification *)notification
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#include "SHBeaconFilter.h"
+//header from System
+#include <string.h>
+
+#define IBEACON_SMOOTH_FACTOR               0.3 //weight of new ranging accuracy in exponential moving average of distance
+#define IBEACON_OUTLIER_RATIO               3.0 //ranging accuracy more than this times farther or nearer than smoothed distance is outlier
+#define IBEACON_OUTLIER_ACCEPT              3 //continuous outliers means iBeacon really moved, restart smoothing from latest accuracy
+#define IBEACON_ENTER_SAMPLES               2 //first accuracy and one smoothing step before reporting enter distance
+#define IBEACON_ENTER_UNKNOWN_RANGINGS      3 //report enter at 1 metre after these rangings without any valid accuracy
+#define IBEACON_ENTER_MAX_RANGINGS          10 //report enter anyway after these rangings, when accuracy keeps jumping between outliers
+#define IBEACON_BAND_IMMEDIATE              0.5 //smoothed distance less than this metres is immediate band
+#define IBEACON_BAND_NEAR                   3.0 //smoothed distance less than this metres is near band, otherwise far band
+
+void shBeaconFilterReset(SHBeaconFilter *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+int shBeaconFilterAdd(SHBeaconFilter *filter, double accuracy)
+{
+    filter->rangeCount ++;
+    if (accuracy <= 0)
+    {
+        return 0; //unknown, happens when RSSI is 0.
+    }
+    if (filter->smoothedDistance <= 0)
+    {
+        filter->smoothedDistance = accuracy;
+        filter->sampleCount = 1;
+        filter->outlierCount = 0;
+        return 1;
+    }
+    if (accuracy > filter->smoothedDistance * IBEACON_OUTLIER_RATIO || accuracy * IBEACON_OUTLIER_RATIO < filter->smoothedDistance)
+    {
+        filter->outlierCount ++;
+        if (filter->outlierCount < IBEACON_OUTLIER_ACCEPT)
+        {
+            return 0;
+        }
+        filter->smoothedDistance = accuracy;
+        filter->sampleCount = 1;
+        filter->outlierCount = 0;
+        return 1;
+    }
+    filter->outlierCount = 0;
+    filter->smoothedDistance += IBEACON_SMOOTH_FACTOR * (accuracy - filter->smoothedDistance);
+    filter->sampleCount ++;
+    return 1;
+}
+
+int shBeaconBand(double distance)
+{
+    if (distance < IBEACON_BAND_IMMEDIATE)
+    {
+        return SHBeaconBand_Immediate;
+    }
+    return (distance < IBEACON_BAND_NEAR) ? SHBeaconBand_Near : SHBeaconBand_Far;
+}
+
+double shBeaconFilterEnterDistance(SHBeaconFilter *filter, double now)
+{
+    int isReady = (filter->sampleCount >= IBEACON_ENTER_SAMPLES || filter->rangeCount >= IBEACON_ENTER_MAX_RANGINGS || (filter->smoothedDistance <= 0 && filter->rangeCount >= IBEACON_ENTER_UNKNOWN_RANGINGS));
+    if (!isReady)
+    {
+        return 0;
+    }
+    double distance = (filter->smoothedDistance > 0) ? filter->smoothedDistance : 1;
+    filter->band = shBeaconBand(distance);
+    filter->bandTime = now;
+    return distance;
+}
+
+int shBeaconFilterCheckBand(SHBeaconFilter *filter, double now, double interval)
+{
+    if (filter->smoothedDistance <= 0)
+    {
+        return 0;
+    }
+    int band = shBeaconBand(filter->smoothedDistance);
+    if (filter->bandTime == 0) //inside from previous launch, no band logged yet.
+    {
+        filter->band = band;
+        filter->bandTime = now;
+        return 0;
+    }
+    if (interval > 0 && band != filter->band && now - filter->bandTime >= interval)
+    {
+        filter->band = band;
+        filter->bandTime = now;
+        return 1;
+    }
+    return 0;
+}
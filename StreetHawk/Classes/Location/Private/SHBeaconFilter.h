@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_BEACON_FILTER_H
+#define SH_BEACON_FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Distance band of smoothed distance. Same partition as CLProximity but from smoothed distance, so not jump with each ranging.
+ */
+enum SHBeaconBand
+{
+    SHBeaconBand_Immediate = 0, //less than 0.5 metres
+    SHBeaconBand_Near = 1, //less than 3 metres
+    SHBeaconBand_Far = 2,
+};
+
+/**
+ Ranging state of one iBeacon in range: exponential moving average of ranging accuracy with outlier rejection, and the distance band last logged. Plain C so recorded ranging can be replayed without CoreLocation. Not persisted, ranging restarts after re-launch.
+ A zero filled filter is same as reset.
+ */
+typedef struct
+{
+    double smoothedDistance; //0 if no valid ranging yet.
+    int sampleCount; //accuracy taken into smoothing since reset or restart, including the first one.
+    int outlierCount; //continuous accuracy rejected as outlier.
+    int rangeCount; //rangings having this iBeacon since reset, including unknown accuracy.
+    int band; //`SHBeaconBand` last logged.
+    double bandTime; //system uptime when band logged, 0 if not yet.
+} SHBeaconFilter;
+
+/**
+ Clear ranging state when iBeacon goes out.
+ */
+void shBeaconFilterReset(SHBeaconFilter *filter);
+
+/**
+ Add one ranging accuracy into `smoothedDistance`. Non-positive accuracy means unknown (RSSI is 0) and is ignored. Accuracy more than 3 times farther or nearer than smoothed distance is an outlier; 3 continuous outliers mean iBeacon really moved, smoothing restarts from latest accuracy.
+ @return 1 if accuracy is taken into smoothing, 0 if ignored or rejected.
+ */
+int shBeaconFilterAdd(SHBeaconFilter *filter, double accuracy);
+
+/**
+ Distance band of distance in metres.
+ */
+int shBeaconBand(double distance);
+
+/**
+ Distance to report when iBeacon newly enters. It waits till smoothing takes at least one step after the first accuracy, so not report a single raw ranging. If no valid accuracy after 3 rangings it reports 1, and if accuracy keeps jumping as outliers it reports smoothed distance after 10 rangings.
+ @param now System uptime, recorded as band time when ready.
+ @return Distance in metres, or 0 if not ready and should wait next ranging.
+ */
+double shBeaconFilterEnterDistance(SHBeaconFilter *filter, double now);
+
+/**
+ Whether band of smoothed distance changed and should log, at most once per `interval` seconds. First check after re-launch only records the band.
+ @param now System uptime.
+ @param interval Minimum seconds between band logs of this iBeacon, 0 means not log band.
+ @return 1 if band changed and is recorded as logged at `now`.
+ */
+int shBeaconFilterCheckBand(SHBeaconFilter *filter, double now, double interval);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,13 +22,74 @@
 #import "SHLogger.h" //for sending logline
 #import "SHHTTPSessionManager.h" //for sending request
 #import "SHLocationManager.h"
+#import "SHStateStore.h" //for iBeacon fetch cache
+#import "SHBeaconFilter.h" //for smoothing ranging distance
 //header from System
 #ifdef SH_FEATURE_IBEACON
 #import <CoreBluetooth/CoreBluetooth.h>
 #endif
 
 #define APPSTATUS_IBEACON_FETCH_TIME        @"APPSTATUS_IBEACON_FETCH_TIME"  //last successfully fetch iBeacon list time
-#define APPSTATUS_IBEACON_FETCH_LIST        @"APPSTATUS_IBEACON_FETCH_LIST"  //iBeacon list fetched from server, it contains array for object: UUID, major, minor, id. This is used as iBeacon monitor region.
+#define APPSTATUS_IBEACON_FETCH_LIST        @"APPSTATUS_IBEACON_FETCH_LIST"  //iBeacon list fetched from server, data of sorted records by `IBEACON_RECORD_SIZE`: UUID, major, minor, id. Previous version saved array of string "[id]UUID,major,minor/distance". This is used as iBeacon monitor region.
+#define APPSTATUS_IBEACON_DISTANCE          @"APPSTATUS_IBEACON_DISTANCE"  //dictionary of server id to distance for iBeacons in range. Saved on each in/out instead of whole fetch list, distance in fetch list is only used when this is not saved yet.
+
+#define IBEACON_RECORD_SIZE                 24 //packed iBeacon in fetch list: 16 bytes UUID, 2 bytes major, 2 bytes minor, 4 bytes server id, all big endian
+#define IBEACON_RECORD_KEY_SIZE             20 //UUID, major and minor. Records sorted by these bytes, so same UUID is continuous.
+#define IBEACON_RECORD_UUID_SIZE            16
+
+/**
+ Compare function for sorting fetch list records. Big endian major and minor make byte order same as number order.
+ */
+static int shCompareiBeaconRecord(const void *record1, const void *record2)
+{
+    return memcmp(record1, record2, IBEACON_RECORD_KEY_SIZE);
+}
+
+/**
+ Walk two sorted fetch list records once, call `handler` with each UUID only in one of them. `isAdded` is YES if UUID only in `newData`, NO if only in `oldData`.
+ */
+static void shDiffiBeaconUuids(NSData *oldData, NSData *newData, void (^handler)(NSString *uuid, BOOL isAdded))
+{
+    const uint8_t *oldBytes = oldData.bytes;
+    const uint8_t *newBytes = newData.bytes;
+    NSUInteger oldCount = oldData.length / IBEACON_RECORD_SIZE;
+    NSUInteger newCount = newData.length / IBEACON_RECORD_SIZE;
+    NSUInteger oldIndex = 0;
+    NSUInteger newIndex = 0;
+    while (oldIndex < oldCount || newIndex < newCount)
+    {
+        const uint8_t *oldUuid = (oldIndex < oldCount) ? oldBytes + oldIndex * IBEACON_RECORD_SIZE : NULL;
+        const uint8_t *newUuid = (newIndex < newCount) ? newBytes + newIndex * IBEACON_RECORD_SIZE : NULL;
+        int result = (oldUuid == NULL) ? 1 : ((newUuid == NULL) ? -1 : memcmp(oldUuid, newUuid, IBEACON_RECORD_UUID_SIZE));
+        if (result != 0)
+        {
+            handler([[NSUUID alloc] initWithUUIDBytes:(result < 0) ? oldUuid : newUuid].UUIDString, result > 0);
+        }
+        //skip rest records of the UUID
+        if (result <= 0)
+        {
+            while (oldIndex < oldCount && memcmp(oldBytes + oldIndex * IBEACON_RECORD_SIZE, oldUuid, IBEACON_RECORD_UUID_SIZE) == 0)
+            {
+                oldIndex ++;
+            }
+        }
+        if (result >= 0)
+        {
+            while (newIndex < newCount && memcmp(newBytes + newIndex * IBEACON_RECORD_SIZE, newUuid, IBEACON_RECORD_UUID_SIZE) == 0)
+            {
+                newIndex ++;
+            }
+        }
+    }
+}
+
+/**
+ Pack an iBeacon into one integer for hash lookup: index of its UUID in fetch list at high 32 bits, major and minor 16 bits each.
+ */
+static uint64_t shBeaconKey(uint32_t uuidIndex, int major, int minor)
+{
+    return ((uint64_t)uuidIndex << 32) | ((uint64_t)(major & 0xFFFF) << 16) | (uint64_t)(minor & 0xFFFF);
+}
 
 /**
  An object to represent server fetched iBeacon information. It's different from CLBeaconRegion and CLBeacon, so create an object to store it.
@@ -60,6 +121,21 @@
  */
 @property (nonatomic) double distance;
 
+/**
+ Continuous ranging results not having this iBeacon while it's in range. Not persisted, ranging restarts after re-launch.
+ */
+@property (nonatomic) NSInteger missCount;
+
+/**
+ Smoothing of ranging accuracy and band last logged, owned by this object. Not persisted.
+ */
+@property (nonatomic, readonly) SHBeaconFilter *rangingFilter;
+
+/**
+ Clear ranging state when this iBeacon goes out.
+ */
+- (void)resetRanging;
+
 /**
  Compare function.
  */
@@ -71,12 +147,17 @@
 + (CLBeaconRegion *)getBeaconRegionForUUid:(NSString *)uuid;
 
 /**
- Make this object array to string array for store to NSUserDefaults.
+ Pack this object array to sorted records for store to state store and diff. Object with invalid UUID is dropped, it cannot create region either. Distance is not included, it's saved separately.
  */
-+ (NSArray *)serializeToStringArray:(NSArray *)objArray;
++ (NSData *)serializeToData:(NSArray *)objArray;
 
 /**
- When read from NSUserDefaults, parse back to object array.
+ Parse records back to object array, in record order.
+ */
++ (NSArray *)deserializeFromData:(NSData *)data;
+
+/**
+ Parse string array saved by previous version back to object array.
  */
 + (NSArray *)deserializeToObjArray:(NSArray *)stringArray;
 
@@ -85,9 +166,17 @@
 @interface SHBeaconStatus ()
 
 @property (strong, nonatomic) NSMutableArray *arrayiBeaconFetchList;  //Server controls client to monitor a certain iBeacon list by request "/ibeacons", this list is cached locally and returned by this property. It's array of `SHServeriBeacon`. "app_status"'s "ibeacon" timestamp controls when to fetch this list again.
+@property (strong, nonatomic) NSData *dataiBeaconFetchList; //sorted records of `arrayiBeaconFetchList`, same as cached APPSTATUS_IBEACON_FETCH_LIST. Used to diff with new fetched list.
+- (void)replaceiBeaconFetchList:(NSData *)dataList; //update memory and local cache with new fetch list records.
 - (void)sendLogForiBeacons:(NSArray *)arrayServeriBeacons isInside:(BOOL)isInside; //Send install/log for enter or exit(stop monitor) server iBeacons. If enter region, distance = ranged first distance or 1; if exit region, distance = `null`. If not enter or exit but only distance change, not send this install/log. code=21, comment formatted as {serverid: distance}.
 - (NSArray *)findServeriBeaconsInsideRegion:(CLBeaconRegion *)region onlyWithDistance:(BOOL)requireDistance needSetOutside:(BOOL)setOutside;  //get SHServeriBeacon list, subset of self.arrayiBeaconFetchList, which match this region. If `requireDistance` means get those with distance, otherwise get all SHServeriBeacon inside this region.
 - (void)regionRangeNotificationHandler:(NSNotification *)notification; //when range a region to know exact iBeacons.
+- (void)saveDistanceState; //save distance of in range iBeacons, a small record for each in/out instead of whole fetch list.
+- (void)sendLogForBandChangediBeacons:(NSArray *)arrayServeriBeacons; //send smoothed distance of iBeacons still in range but moved to another band.
+@property (strong, nonatomic) NSDictionary *dictUuidIndex; //upper case UUID -> NSNumber index, built when first used and cleared when fetch list changes.
+@property (strong, nonatomic) NSDictionary *dictiBeaconByKey; //NSNumber of `shBeaconKey` -> SHServeriBeacon.
+@property (strong, nonatomic) NSDictionary *dictiBeaconsByUuid; //NSNumber of UUID index -> NSArray of SHServeriBeacon with this UUID.
+- (void)buildIndexIfNeeded; //build above index from self.arrayiBeaconFetchList.
 - (void)regionStateChangeNotificationHandler:(NSNotification *)notification; //monitor when a region state change.
 
 #ifdef SH_FEATURE_IBEACON
@@ -160,7 +249,7 @@
         if (serverTime != nil)
         {
             BOOL needFetch = NO;
-            NSObject *localTimeVal = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_IBEACON_FETCH_TIME];
+            NSObject *localTimeVal = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_IBEACON_FETCH_TIME];
             if (localTimeVal == nil || ![localTimeVal isKindOfClass:[NSNumber class]])
             {
                 needFetch = YES;  //local never fetched, do fetch.
@@ -176,124 +265,85 @@
             if (needFetch)
             {
                 //update local cache time before send request, because this request has same format as others {app_status:..., code:0, value:...}, it will trigger `setIBeaconTimestamp` again. If fail to get request, clear local cache time in callback handler, make next fetch happen.
-                [[NSUserDefaults standardUserDefaults] setObject:@([serverTime timeIntervalSinceReferenceDate] + 60/*avoid double accurate*/) forKey:APPSTATUS_IBEACON_FETCH_TIME];
-                [[NSUserDefaults standardUserDefaults] synchronize];
-                [[SHHTTPSessionManager sharedInstance] GET:@"/ibeacons/" hostVersion:SHHostVersion_V1 parameters:nil success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+                [[SHStateStore sharedInstance] setObject:@([serverTime timeIntervalSinceReferenceDate] + 60/*avoid double accurate*/) forKey:APPSTATUS_IBEACON_FETCH_TIME];
+                //iBeacon list can be large, build SHServeriBeacon directly from each UUID element while decoding, not keep whole json tree.
+                NSMutableArray *arrayList = [NSMutableArray array];
+                [[SHHTTPSessionManager sharedInstance] GET:@"/ibeacons/" hostVersion:SHHostVersion_V1 parameters:nil streamKey:@"value" elementHandler:^(NSString * _Nullable key, id  _Nonnull element)
                 {
-                    //successfully fetch server's iBeacon list. local cache time is already updated, store fetch list and active monitor.
-                    SHLog(@"Fetch server iBeacon list: %@.", responseObject);
-                    NSAssert([responseObject isKindOfClass:[NSDictionary class]], @"Server return should be dictionary.");
-                    if ([responseObject isKindOfClass:[NSDictionary class]])
+                    NSAssert(key != nil && [element isKindOfClass:[NSDictionary class]], @"UUID dictionary invalid: %@.", key);
+                    if (key != nil && [element isKindOfClass:[NSDictionary class]])
                     {
-                        NSMutableArray *arrayList = [NSMutableArray array];
-                        NSDictionary *dictList = (NSDictionary *)responseObject;
-                        for (NSObject *uuidValue in dictList.allKeys)
+                        NSDictionary *dictuuid = (NSDictionary *)element;
+                        for (NSObject *majorValue in dictuuid.allKeys)
                         {
-                            NSAssert([uuidValue isKindOfClass:[NSString class]] && [dictList[uuidValue] isKindOfClass:[NSDictionary class]], @"UUID dictionary invalid: %@.", uuidValue);
-                            if ([uuidValue isKindOfClass:[NSString class]] && [dictList[uuidValue] isKindOfClass:[NSDictionary class]])
+                            NSAssert(([majorValue isKindOfClass:[NSNumber class]] || [majorValue isKindOfClass:[NSString class]]) && [dictuuid[majorValue] isKindOfClass:[NSDictionary class]], @"Major dictionary invalid: %@.", majorValue);
+                            if (([majorValue isKindOfClass:[NSNumber class]] || [majorValue isKindOfClass:[NSString class]]) && [dictuuid[majorValue] isKindOfClass:[NSDictionary class]])
                             {
-                                NSDictionary *dictuuid = (NSDictionary *)dictList[uuidValue];
-                                for (NSObject *majorValue in dictuuid.allKeys)
+                                NSDictionary *dictMajor = (NSDictionary *)dictuuid[majorValue];
+                                for (NSObject *minorValue in dictMajor.allKeys)
                                 {
-                                    NSAssert(([majorValue isKindOfClass:[NSNumber class]] || [majorValue isKindOfClass:[NSString class]]) && [dictuuid[majorValue] isKindOfClass:[NSDictionary class]], @"Major dictionary invalid: %@.", majorValue);
-                                    if (([majorValue isKindOfClass:[NSNumber class]] || [majorValue isKindOfClass:[NSString class]]) && [dictuuid[majorValue] isKindOfClass:[NSDictionary class]])
+                                    NSAssert(([minorValue isKindOfClass:[NSNumber class]] || [minorValue isKindOfClass:[NSString class]]) && ([dictMajor[minorValue] isKindOfClass:[NSNumber class]] || [dictMajor[minorValue] isKindOfClass:[NSString class]]), @"Minor dictionary invalid: %@.", minorValue);
+                                    if (([minorValue isKindOfClass:[NSNumber class]] || [minorValue isKindOfClass:[NSString class]]) && ([dictMajor[minorValue] isKindOfClass:[NSNumber class]] || [dictMajor[minorValue] isKindOfClass:[NSString class]]))
                                     {
-                                        NSDictionary *dictMajor = (NSDictionary *)dictuuid[majorValue];
-                                        for (NSObject *minorValue in dictMajor.allKeys)
+                                        SHServeriBeacon *serveriBeacon = [[SHServeriBeacon alloc] init];
+                                        serveriBeacon.uuid = key;
+                                        if ([majorValue isKindOfClass:[NSNumber class]])
+                                        {
+                                            serveriBeacon.major = [(NSNumber *)majorValue intValue];
+                                        }
+                                        else if ([majorValue isKindOfClass:[NSString class]])
                                         {
-                                            NSAssert(([minorValue isKindOfClass:[NSNumber class]] || [minorValue isKindOfClass:[NSString class]]) && ([dictMajor[minorValue] isKindOfClass:[NSNumber class]] || [dictMajor[minorValue] isKindOfClass:[NSString class]]), @"Minor dictionary invalid: %@.", minorValue);
-                                            if (([minorValue isKindOfClass:[NSNumber class]] || [minorValue isKindOfClass:[NSString class]]) && ([dictMajor[minorValue] isKindOfClass:[NSNumber class]] || [dictMajor[minorValue] isKindOfClass:[NSString class]]))
-                                            {
-                                                SHServeriBeacon *serveriBeacon = [[SHServeriBeacon alloc] init];
-                                                serveriBeacon.uuid = (NSString *)uuidValue;
-                                                if ([majorValue isKindOfClass:[NSNumber class]])
-                                                {
-                                                    serveriBeacon.major = [(NSNumber *)majorValue intValue];
-                                                }
-                                                else if ([majorValue isKindOfClass:[NSString class]])
-                                                {
-                                                    serveriBeacon.major = [(NSString *)majorValue intValue];
-                                                }
-                                                if ([minorValue isKindOfClass:[NSNumber class]])
-                                                {
-                                                    serveriBeacon.minor = [(NSNumber *)minorValue intValue];
-                                                }
-                                                else if ([minorValue isKindOfClass:[NSString class]])
-                                                {
-                                                    serveriBeacon.minor = [(NSString *)minorValue intValue];
-                                                }
-                                                serveriBeacon.serverId = [dictMajor[minorValue] intValue];
-                                                [arrayList addObject:serveriBeacon];
-                                            }
+                                            serveriBeacon.major = [(NSString *)majorValue intValue];
                                         }
+                                        if ([minorValue isKindOfClass:[NSNumber class]])
+                                        {
+                                            serveriBeacon.minor = [(NSNumber *)minorValue intValue];
+                                        }
+                                        else if ([minorValue isKindOfClass:[NSString class]])
+                                        {
+                                            serveriBeacon.minor = [(NSString *)minorValue intValue];
+                                        }
+                                        serveriBeacon.serverId = [dictMajor[minorValue] intValue];
+                                        [arrayList addObject:serveriBeacon];
                                     }
                                 }
                             }
                         }
+                    }
+                } success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+                {
+                    //successfully fetch server's iBeacon list. local cache time is already updated, store fetch list and active monitor.
+                    SHLog(@"Fetch server iBeacon list: %lu iBeacons.", (unsigned long)arrayList.count);
+                    NSAssert([responseObject isKindOfClass:[NSDictionary class]], @"Server return should be dictionary.");
+                    if ([responseObject isKindOfClass:[NSDictionary class]]) //its elements are already parsed into `arrayList`.
+                    {
                         //compare current memory's `arrayiBeaconFetchList` (same as cached APPSTATUS_IBEACON_FETCH_LIST), if not in new list, stop monitor; if find new, add monitor. Note: start/stop iBeacon region uses wild-match, that is ONLY uuid is used to create the region, major and minor not provided. This is because same identifier causes previous region removed, so must create unique identifier, the less region the better. CLLocationManager only supports 19 iBeacon regions. When find match, use major and minor to match to server id.
-                        NSMutableArray *serverUUids = [[NSMutableArray alloc] init];
-                        NSMutableArray *localUUids = [[NSMutableArray alloc] init];
-                        for (SHServeriBeacon *ibeacon in arrayList)
-                        {
-                            if (![serverUUids containsObject:ibeacon.uuid])
-                            {
-                                [serverUUids addObject:ibeacon.uuid];
-                            }
-                        }
-                        for (SHServeriBeacon *ibeacon in self.arrayiBeaconFetchList)
+                        //Both lists are sorted records, so one merge walk finds UUIDs added or removed.
+                        NSData *dataList = [SHServeriBeacon serializeToData:arrayList];
+                        shDiffiBeaconUuids(self.dataiBeaconFetchList, dataList, ^(NSString *uuid, BOOL isAdded)
                         {
-                            if (![localUUids containsObject:ibeacon.uuid])
+                            if (isAdded) //server return one not in local cache, start monitor.
                             {
-                                [localUUids addObject:ibeacon.uuid];
+                                SHLog(@"Start monitor server's iBeacon region for UUid: %@.", uuid);
+                                [StreetHawk.locationManager startMonitorRegion:[SHServeriBeacon getBeaconRegionForUUid:uuid]];
                             }
-                        }
-                        for (NSString *serverUUid in serverUUids)
-                        {
-                            BOOL findInLocal = NO;
-                            for (NSString *localUUid in localUUids)
+                            else //local has one not in server, stop monitor.
                             {
-                                if ([serverUUid compare:localUUid options:NSCaseInsensitiveSearch] == NSOrderedSame)  //only consider uuid, wild-match
-                                {
-                                    findInLocal = YES;
-                                    break;
-                                }
-                            }
-                            if (!findInLocal) //server return one not in local cache, start monitor.
-                            {
-                                SHLog(@"Start monitor server's iBeacon region for UUid: %@.", serverUUid);
-                                [StreetHawk.locationManager startMonitorRegion:[SHServeriBeacon getBeaconRegionForUUid:serverUUid]];
-                            }
-                        }
-                        for (NSString *localUUid in localUUids)
-                        {
-                            BOOL findInServer = NO;
-                            for (NSString *serverUUid in serverUUids)
-                            {
-                                if ([serverUUid compare:localUUid options:NSCaseInsensitiveSearch] == NSOrderedSame)
-                                {
-                                    findInServer = YES;
-                                    break;
-                                }
-                            }
-                            if (!findInServer) //local has one not in server, stop monitor.
-                            {
-                                CLBeaconRegion *stopRegion = [SHServeriBeacon getBeaconRegionForUUid:localUUid];
+                                CLBeaconRegion *stopRegion = [SHServeriBeacon getBeaconRegionForUUid:uuid];
                                 [StreetHawk.locationManager stopMonitorRegion:stopRegion];
                                 NSArray *arrayStopMonitorServeriBeacons = [self findServeriBeaconsInsideRegion:stopRegion onlyWithDistance:NO/*all, not from inside to outside*/ needSetOutside:YES];
                                 NSAssert(arrayStopMonitorServeriBeacons.count != 0, @"Fail to find matching server iBeacons for region %@.", stopRegion);
                                 [self sendLogForiBeacons:arrayStopMonitorServeriBeacons isInside:NO]; //need this because "stop monitor" not trigger any delegate.
-                                SHLog(@"Stop monitor server's iBeacon region for UUid: %@.", localUUid);
+                                SHLog(@"Stop monitor server's iBeacon region for UUid: %@.", uuid);
                             }
-                        }
+                        });
                         //store server's list into local cache and update memory
-                        self.arrayiBeaconFetchList = arrayList;
-                        [[NSUserDefaults standardUserDefaults] setObject:[SHServeriBeacon serializeToStringArray:arrayList] forKey:APPSTATUS_IBEACON_FETCH_LIST];
-                        [[NSUserDefaults standardUserDefaults] synchronize];
+                        [self replaceiBeaconFetchList:dataList];
+                        [self saveDistanceState];
                     }
                 } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
                 {
-                    [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:APPSTATUS_IBEACON_FETCH_TIME]; //make next fetch happen as this time fail.
-                    [[NSUserDefaults standardUserDefaults] synchronize];
+                    [[SHStateStore sharedInstance] setObject:@(0) forKey:APPSTATUS_IBEACON_FETCH_TIME]; //make next fetch happen as this time fail.
                 }];
             }
             return;
@@ -305,9 +355,8 @@
         [StreetHawk.locationManager stopMonitorRegion:[SHServeriBeacon getBeaconRegionForUUid:localiBeacon.uuid]]; //harmless for duplicate call
     }
     [self sendLogForiBeacons:self.arrayiBeaconFetchList isInside:NO]; //set all to be distance=null in server, need this because "stop monitor" not trigger any delegate.
-    self.arrayiBeaconFetchList = [NSMutableArray array]; //cannot set to nil, as nil will read from NSUserDefaults again.
-    [[NSUserDefaults standardUserDefaults] setObject:[NSArray array] forKey:APPSTATUS_IBEACON_FETCH_LIST];  //clear local cache, not start when kill and launch App.
-    [[NSUserDefaults standardUserDefaults] synchronize];
+    [self replaceiBeaconFetchList:[NSData data]]; //clear local cache, not start when kill and launch App.
+    [self saveDistanceState];
 }
 
 #pragma mark - private functions
@@ -316,11 +365,88 @@
 {
     if (_arrayiBeaconFetchList == nil) //never initialized
     {
-        _arrayiBeaconFetchList = [NSMutableArray arrayWithArray:[SHServeriBeacon deserializeToObjArray:[[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_IBEACON_FETCH_LIST]]]; //it will not get nil even empty
+        NSObject *fetchList = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_IBEACON_FETCH_LIST];
+        if ([fetchList isKindOfClass:[NSData class]])
+        {
+            _arrayiBeaconFetchList = [NSMutableArray arrayWithArray:[SHServeriBeacon deserializeFromData:(NSData *)fetchList]];
+        }
+        else //saved by previous version, or never saved.
+        {
+            _arrayiBeaconFetchList = [NSMutableArray arrayWithArray:[SHServeriBeacon deserializeToObjArray:[fetchList isKindOfClass:[NSArray class]] ? (NSArray *)fetchList : nil]]; //it will not get nil even empty
+        }
+        NSDictionary *dictDistance = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_IBEACON_DISTANCE];
+        if ([dictDistance isKindOfClass:[NSDictionary class]]) //otherwise saved by previous version, distance is in fetch list.
+        {
+            for (SHServeriBeacon *serveriBeacon in _arrayiBeaconFetchList)
+            {
+                NSNumber *distance = dictDistance[[NSString stringWithFormat:@"%d", serveriBeacon.serverId]];
+                serveriBeacon.distance = [distance isKindOfClass:[NSNumber class]] ? distance.doubleValue : INT64_MIN;
+            }
+        }
     }
     return _arrayiBeaconFetchList;
 }
 
+- (NSData *)dataiBeaconFetchList
+{
+    if (_dataiBeaconFetchList == nil)
+    {
+        NSObject *fetchList = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_IBEACON_FETCH_LIST];
+        _dataiBeaconFetchList = [fetchList isKindOfClass:[NSData class]] ? (NSData *)fetchList : [SHServeriBeacon serializeToData:self.arrayiBeaconFetchList]; //previous version saved string array.
+    }
+    return _dataiBeaconFetchList;
+}
+
+- (void)replaceiBeaconFetchList:(NSData *)dataList
+{
+    self.dataiBeaconFetchList = dataList;
+    self.arrayiBeaconFetchList = [NSMutableArray arrayWithArray:[SHServeriBeacon deserializeFromData:dataList]]; //cannot set to nil, as nil will read from local cache again.
+    [[SHStateStore sharedInstance] setObject:dataList forKey:APPSTATUS_IBEACON_FETCH_LIST];
+}
+
+- (void)setArrayiBeaconFetchList:(NSMutableArray *)arrayiBeaconFetchList
+{
+    _arrayiBeaconFetchList = arrayiBeaconFetchList;
+    self.dictUuidIndex = nil; //rebuild when used.
+    self.dictiBeaconByKey = nil;
+    self.dictiBeaconsByUuid = nil;
+}
+
+- (void)buildIndexIfNeeded
+{
+    if (self.dictUuidIndex != nil)
+    {
+        return;
+    }
+    NSMutableDictionary *dictUuidIndex = [NSMutableDictionary dictionary];
+    NSMutableDictionary *dictiBeaconByKey = [NSMutableDictionary dictionary];
+    NSMutableDictionary *dictiBeaconsByUuid = [NSMutableDictionary dictionary];
+    for (SHServeriBeacon *serveriBeacon in self.arrayiBeaconFetchList)
+    {
+        NSString *uuid = serveriBeacon.uuid.uppercaseString; //CLBeaconRegion's UUIDString is upper case.
+        if (uuid == nil)
+        {
+            continue;
+        }
+        NSNumber *uuidIndex = dictUuidIndex[uuid];
+        if (uuidIndex == nil)
+        {
+            uuidIndex = @(dictUuidIndex.count);
+            dictUuidIndex[uuid] = uuidIndex;
+            dictiBeaconsByUuid[uuidIndex] = [NSMutableArray array];
+        }
+        [dictiBeaconsByUuid[uuidIndex] addObject:serveriBeacon];
+        NSNumber *key = @(shBeaconKey(uuidIndex.unsignedIntValue, serveriBeacon.major, serveriBeacon.minor));
+        if (dictiBeaconByKey[key] == nil) //first one wins, same as searching list.
+        {
+            dictiBeaconByKey[key] = serveriBeacon;
+        }
+    }
+    self.dictUuidIndex = dictUuidIndex;
+    self.dictiBeaconByKey = dictiBeaconByKey;
+    self.dictiBeaconsByUuid = dictiBeaconsByUuid;
+}
+
 - (void)sendLogForiBeacons:(NSArray *)arrayServeriBeacons isInside:(BOOL)isInside
 {
     if (arrayServeriBeacons != nil && arrayServeriBeacons.count > 0)
@@ -347,20 +473,35 @@
     }
 }
 
+- (void)sendLogForBandChangediBeacons:(NSArray *)arrayServeriBeacons
+{
+    //Same log as in, server updates distance of iBeacon. Not notify customer App as it's not enter or exit.
+    NSMutableDictionary *dictDistance = [[NSMutableDictionary alloc] init];
+    for (SHServeriBeacon *iBeacon in arrayServeriBeacons)
+    {
+        [dictDistance setObject:[NSNumber numberWithDouble:iBeacon.distance] forKey:[NSString stringWithFormat:@"%d", iBeacon.serverId]/*must use string for key, cannot use NSNumber*/];
+    }
+    NSString *distanceStr = shSerializeObjToJson(dictDistance);
+    if (!shStrIsEmpty(distanceStr))
+    {
+        [StreetHawk sendLogForCode:LOG_CODE_LOCATION_IBEACON withComment:distanceStr];
+    }
+}
+
 - (NSArray *)findServeriBeaconsInsideRegion:(CLBeaconRegion *)region onlyWithDistance:(BOOL)requireDistance needSetOutside:(BOOL)setOutside
 {
     NSMutableArray *arrayMatchServeriBeacons = [[NSMutableArray alloc] init];
-    for (SHServeriBeacon *serveriBeacon in self.arrayiBeaconFetchList)
+    [self buildIndexIfNeeded];
+    NSNumber *uuidIndex = (region.proximityUUID != nil) ? self.dictUuidIndex[region.proximityUUID.UUIDString.uppercaseString] : nil;
+    for (SHServeriBeacon *serveriBeacon in (uuidIndex != nil) ? self.dictiBeaconsByUuid[uuidIndex] : nil)
     {
-        if ([serveriBeacon.uuid compare:region.proximityUUID.UUIDString options:NSCaseInsensitiveSearch] == NSOrderedSame)
+        if (!requireDistance || serveriBeacon.distance > 0)
         {
-            if (!requireDistance || serveriBeacon.distance > 0)
+            [arrayMatchServeriBeacons addObject:serveriBeacon];
+            if (setOutside)
             {
-                [arrayMatchServeriBeacons addObject:serveriBeacon];
-                if (setOutside)
-                {
-                    serveriBeacon.distance = INT64_MIN; //set to outside, used for exit region.
-                }
+                serveriBeacon.distance = INT64_MIN; //set to outside, used for exit region.
+                [serveriBeacon resetRanging];
             }
         }
     }
@@ -372,50 +513,72 @@
     CLBeaconRegion *region = notification.userInfo[SHLMNotification_kRegion];
     NSArray *arrayThisRanging = notification.userInfo[SHLMNotification_kBeacons];
     //inside one region must keep ranging, because in case iBeacon1 and iBeacon2 have same UUID so in same region, when iBeacon1 out and iBeacon2 still in, the region state won't change until iBeacon2 out. To know exactly what iBeacons inside must keep ranging until exit this region. But server does not expect receive duplicated logs, so only when one iBeacon int or out send log.
-    NSArray *arrayPreviousRanging = [self findServeriBeaconsInsideRegion:region onlyWithDistance:NO needSetOutside:NO]; //all server iBeacon inside this region.
+    //Ranging happens every second, match by hash key instead of comparing each ranged iBeacon with each server iBeacon.
+    [self buildIndexIfNeeded];
+    NSNumber *uuidIndex = (region.proximityUUID != nil) ? self.dictUuidIndex[region.proximityUUID.UUIDString.uppercaseString] : nil;
+    if (uuidIndex == nil)
+    {
+        return; //not server iBeacon region.
+    }
     NSMutableArray *arrayChangeIn = [NSMutableArray array];
     NSMutableArray *arrayChangeOut = [NSMutableArray array];
+    NSMutableArray *arrayChangeBand = [NSMutableArray array];
+    NSTimeInterval bandInterval = StreetHawk.locationManager.iBeaconBandInterval;
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    NSMutableSet *setRangedKeys = [NSMutableSet setWithCapacity:arrayThisRanging.count];
     for (CLBeacon *iBeacon in arrayThisRanging)
     {
-        SHServeriBeacon *matchingServeriBeacon = nil;
-        for (SHServeriBeacon *serveriBeacon in arrayPreviousRanging)
+        NSAssert([iBeacon.proximityUUID.UUIDString compare:region.proximityUUID.UUIDString options:NSCaseInsensitiveSearch] == NSOrderedSame, @"Range should in same region.");
+        NSNumber *key = @(shBeaconKey(uuidIndex.unsignedIntValue, iBeacon.major.intValue, iBeacon.minor.intValue));
+        SHServeriBeacon *matchingServeriBeacon = self.dictiBeaconByKey[key];
+        if (matchingServeriBeacon != nil) //possible to monitor other iBeacon not added into streethawk server
         {
-            NSAssert([iBeacon.proximityUUID.UUIDString compare:serveriBeacon.uuid options:NSCaseInsensitiveSearch] == NSOrderedSame, @"Range should in same region.");
-            if (iBeacon.major.intValue == serveriBeacon.major && iBeacon.minor.intValue == serveriBeacon.minor)
+            [setRangedKeys addObject:key];
+            matchingServeriBeacon.missCount = 0;
+            //Single ranging accuracy jitters a lot, report smoothed distance. By testing accuracy occassionally negative, it's ignored by smoothing.
+            SHBeaconFilter *filter = matchingServeriBeacon.rangingFilter;
+            shBeaconFilterAdd(filter, iBeacon.accuracy);
+            if (matchingServeriBeacon.distance < 0) //not inside yet
             {
-                matchingServeriBeacon = serveriBeacon;
-                break;
+                double enterDistance = shBeaconFilterEnterDistance(filter, now); //0 until smoothed one step, so enter not report a single raw ranging.
+                if (enterDistance > 0) //means newly inside
+                {
+                    matchingServeriBeacon.distance = enterDistance; //self.arrayiBeaconFetchList object's distance also updated
+                    [arrayChangeIn addObject:matchingServeriBeacon];
+                }
             }
-        }
-        if (matchingServeriBeacon != nil) //possible to monitor other iBeacon not added into streethawk server
-        {
-            if (matchingServeriBeacon.distance < 0) //means newly inside
+            else if (filter->smoothedDistance > 0)
             {
-                matchingServeriBeacon.distance = iBeacon.accuracy > 0/*by testing it occassionally negative*/ ? iBeacon.accuracy : 1; //self.arrayiBeaconFetchList object's distance also updated
-                [arrayChangeIn addObject:matchingServeriBeacon];
+                matchingServeriBeacon.distance = filter->smoothedDistance;
+                if (shBeaconFilterCheckBand(filter, now, bandInterval))
+                {
+                    [arrayChangeBand addObject:matchingServeriBeacon];
+                }
             }
         }
     }
-    for (SHServeriBeacon *serveriBeacon in arrayPreviousRanging)
+    //Ranging occasionally misses an iBeacon which is still nearby, only out after missing it several times continuously, otherwise it sends a pair of out/in logs.
+    NSInteger exitMisses = StreetHawk.locationManager.iBeaconExitMisses;
+    for (SHServeriBeacon *serveriBeacon in self.dictiBeaconsByUuid[uuidIndex])
     {
-        if (serveriBeacon.distance > 0 && ![arrayChangeIn containsObject:serveriBeacon])
+        if ([setRangedKeys containsObject:@(shBeaconKey(uuidIndex.unsignedIntValue, serveriBeacon.major, serveriBeacon.minor))])
         {
-            BOOL findInThis = NO;
-            for (CLBeacon *iBeacon in arrayThisRanging)
-            {
-                NSAssert([iBeacon.proximityUUID.UUIDString compare:serveriBeacon.uuid options:NSCaseInsensitiveSearch] == NSOrderedSame, @"Range should in same region.");
-                if (iBeacon.major.intValue == serveriBeacon.major && iBeacon.minor.intValue == serveriBeacon.minor)
-                {
-                    findInThis = YES;
-                    break;
-                }
-            }
-            if (!findInThis) //means newly outside
+            continue;
+        }
+        if (serveriBeacon.distance > 0)
+        {
+            serveriBeacon.missCount ++;
+            if (serveriBeacon.missCount >= exitMisses) //means newly outside
             {
                 serveriBeacon.distance = INT64_MIN;
+                [serveriBeacon resetRanging];
                 [arrayChangeOut addObject:serveriBeacon];
             }
         }
+        else if (serveriBeacon.rangingFilter->rangeCount > 0) //missed before enter reported, start again next time.
+        {
+            [serveriBeacon resetRanging];
+        }
     }
     if (arrayChangeIn.count > 0)
     {
@@ -425,11 +588,14 @@
     {
         [self sendLogForiBeacons:arrayChangeOut isInside:NO];
     }
-    if (arrayChangeIn.count > 0 || arrayChangeOut.count > 0)
+    if (arrayChangeBand.count > 0)
+    {
+        [self sendLogForBandChangediBeacons:arrayChangeBand];
+    }
+    if (arrayChangeIn.count > 0 || arrayChangeOut.count > 0 || arrayChangeBand.count > 0)
     {
         //distance should be serialize to disk, in case re-launch and exit region, should find match server ibeacon from disk with distance.
-        [[NSUserDefaults standardUserDefaults] setObject:[SHServeriBeacon serializeToStringArray:self.arrayiBeaconFetchList] forKey:APPSTATUS_IBEACON_FETCH_LIST];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [self saveDistanceState];
     }
 }
 
@@ -456,14 +622,27 @@
             if (arrayServeriBeacons.count > 0)
             {
                 //distance should be serialize to disk, in case re-launch and exit region, should find match server ibeacon from disk with distance.
-                [[NSUserDefaults standardUserDefaults] setObject:[SHServeriBeacon serializeToStringArray:self.arrayiBeaconFetchList] forKey:APPSTATUS_IBEACON_FETCH_LIST];
-                [[NSUserDefaults standardUserDefaults] synchronize];
+                [self saveDistanceState];
             }
         }
     }
     //do nothing for state=unknown.
 }
 
+- (void)saveDistanceState
+{
+    //Fetch list is saved only when fetched. State store journals this small dictionary and compacts by itself.
+    NSMutableDictionary *dictDistance = [NSMutableDictionary dictionary];
+    for (SHServeriBeacon *serveriBeacon in self.arrayiBeaconFetchList)
+    {
+        if (serveriBeacon.distance > 0)
+        {
+            dictDistance[[NSString stringWithFormat:@"%d", serveriBeacon.serverId]/*must use string for key, cannot use NSNumber*/] = @(serveriBeacon.distance);
+        }
+    }
+    [[SHStateStore sharedInstance] setObject:dictDistance forKey:APPSTATUS_IBEACON_DISTANCE];
+}
+
 #pragma mark - detecting result
 
 - (void)createBluetoothManager
@@ -512,6 +691,9 @@
 @end
 
 @implementation SHServeriBeacon
+{
+    SHBeaconFilter _rangingFilter;
+}
 
 @synthesize uuid = _uuid;
 @synthesize major = _major;
@@ -548,8 +730,19 @@
     _minor = minor;
 }
 
+- (SHBeaconFilter *)rangingFilter
+{
+    return &_rangingFilter;
+}
+
 #pragma mark - public functions
 
+- (void)resetRanging
+{
+    self.missCount = 0;
+    shBeaconFilterReset(&_rangingFilter);
+}
+
 - (NSString *)description
 {
     return [NSString stringWithFormat:@"[%d]%@,%d,%d/%f", self.serverId, self.uuid, self.major, self.minor, self.distance];
@@ -604,14 +797,54 @@
     return region;
 }
 
-+ (NSArray *)serializeToStringArray:(NSArray *)objArray
++ (NSData *)serializeToData:(NSArray *)objArray
 {
-    NSMutableArray *strArray = [NSMutableArray array];
+    NSMutableData *data = [NSMutableData dataWithLength:objArray.count * IBEACON_RECORD_SIZE];
+    uint8_t *record = data.mutableBytes;
+    NSUInteger count = 0;
     for (SHServeriBeacon *obj in objArray)
     {
-        [strArray addObject:obj.description];
+        NSUUID *uuid = !shStrIsEmpty(obj.uuid) ? [[NSUUID alloc] initWithUUIDString:obj.uuid] : nil;
+        NSAssert(uuid != nil, @"Invalid UUID: %@.", obj.uuid);
+        if (uuid == nil)
+        {
+            continue;
+        }
+        [uuid getUUIDBytes:record];
+        uint16_t major = CFSwapInt16HostToBig((uint16_t)obj.major);
+        uint16_t minor = CFSwapInt16HostToBig((uint16_t)obj.minor);
+        uint32_t serverId = CFSwapInt32HostToBig((uint32_t)obj.serverId);
+        memcpy(record + 16, &major, sizeof(major));
+        memcpy(record + 18, &minor, sizeof(minor));
+        memcpy(record + 20, &serverId, sizeof(serverId));
+        record += IBEACON_RECORD_SIZE;
+        count ++;
+    }
+    data.length = count * IBEACON_RECORD_SIZE;
+    qsort(data.mutableBytes, count, IBEACON_RECORD_SIZE, shCompareiBeaconRecord);
+    return data;
+}
+
++ (NSArray *)deserializeFromData:(NSData *)data
+{
+    NSUInteger count = data.length / IBEACON_RECORD_SIZE;
+    NSMutableArray *objArray = [NSMutableArray arrayWithCapacity:count];
+    const uint8_t *record = data.bytes;
+    for (NSUInteger i = 0; i < count; i ++, record += IBEACON_RECORD_SIZE)
+    {
+        uint16_t major, minor;
+        uint32_t serverId;
+        memcpy(&major, record + 16, sizeof(major));
+        memcpy(&minor, record + 18, sizeof(minor));
+        memcpy(&serverId, record + 20, sizeof(serverId));
+        SHServeriBeacon *obj = [[SHServeriBeacon alloc] init];
+        obj.uuid = [[NSUUID alloc] initWithUUIDBytes:record].UUIDString;
+        obj.major = CFSwapInt16BigToHost(major);
+        obj.minor = CFSwapInt16BigToHost(minor);
+        obj.serverId = (int)CFSwapInt32BigToHost(serverId);
+        [objArray addObject:obj];
     }
-    return strArray;
+    return objArray;
 }
 
 + (NSArray *)deserializeToObjArray:(NSArray *)stringArray
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+
+#include "SHGeoDistance.h"
+//header from System
+#include <math.h>
+
+#define DEGREE_TO_RADIAN        (3.14159265358979323846 / 180.0)
+
+void shDistancesSquared(double lat, double lng, double cosLat, const double * restrict lats, const double * restrict lngs, const double * restrict cosLats, size_t count, double * restrict results)
+{
+    for (size_t i = 0; i < count; i ++)
+    {
+        double yDistance = (lats[i] - lat) * SH_METERS_PER_LATITUDE;
+        double xDistance = (cosLat + cosLats[i]) * (lngs[i] - lng) * (SH_METERS_PER_LONGITUDE / 2.0);
+        results[i] = (yDistance * yDistance) + (xDistance * xDistance);
+    }
+}
+
+double shCosLatitude(double latitude)
+{
+    return cos(latitude * DEGREE_TO_RADIAN);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+
+#ifndef SH_GEO_DISTANCE_H
+#define SH_GEO_DISTANCE_H
+
+#include <stddef.h>
+
+#define SH_METERS_PER_LATITUDE      (60.00721 * 1852) //nautical miles per latitude * meters per nautical mile
+#define SH_METERS_PER_LONGITUDE     (60.10793 * 1852) //nautical miles per longitude at equator * meters per nautical mile
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Square of equirectangular distance in meters from one location to each target, simple pythagorean formula for efficiency. Good within a few hundred kilometers, and does not wrap longitude at 180.
+ Targets are in separate arrays and the loop has no function call, so compiler vectorizes it (`restrict` is on the definition only, header stays valid C++). All in double, float loses meters at large longitude. Plain C so accuracy and throughput are measured without CoreLocation.
+ @param lat Latitude of the location.
+ @param lng Longitude of the location.
+ @param cosLat `cos` of `lat` in radian.
+ @param lats Latitude of each target.
+ @param lngs Longitude of each target.
+ @param cosLats `cos` of each target's latitude in radian.
+ @param count Number of targets.
+ @param results Out parameter, square of distance to each target, room for `count`. Must not overlap the inputs.
+ */
+void shDistancesSquared(double lat, double lng, double cosLat, const double *lats, const double *lngs, const double *cosLats, size_t count, double *results);
+
+/**
+ `cos` of latitude in degree, as `cosLat` and `cosLats` of `shDistancesSquared`.
+ */
+double shCosLatitude(double latitude);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,7 @@
 #import "SHLocationManager.h"
 #import "SHLogger.h" //for sendLogForCode
 #import "SHGeofenceStatus.h"
+#import "SHStateStore.h" //for last location and sent time
 
 #define SH_GEOFENCE_LATLNG_SENTTIME @"SH_GEOFENCE_LATLNG_SENTTIME" //timestamp for recording last lat/lng sent time
 
@@ -64,7 +65,11 @@
 + (void)setGeofenceTimestampHandler:(NSNotification *)notification
 {
     NSString *timestamp = notification.userInfo[@"timestamp"];
-    [SHGeofenceStatus sharedInstance].geofenceTimestamp = timestamp;
+    //app_status may come in network queue, geofence list and its index are only changed in main thread.
+    dispatch_async(dispatch_get_main_queue(), ^
+    {
+        [SHGeofenceStatus sharedInstance].geofenceTimestamp = timestamp;
+    });
 }
 
 + (void)startMonitorGeoLocationHandler:(NSNotification *)notification
@@ -90,7 +95,6 @@
     {
         [[NSUserDefaults standardUserDefaults] setObject:@(StreetHawk.locationManager.currentGeoLocation.latitude) forKey:SH_GEOLOCATION_LAT];
         [[NSUserDefaults standardUserDefaults] setObject:@(StreetHawk.locationManager.currentGeoLocation.longitude) forKey:SH_GEOLOCATION_LNG];
-        [[NSUserDefaults standardUserDefaults] synchronize];
     }
 }
 
@@ -99,7 +103,7 @@
     if (NSClassFromString(@"SHLocationBridge") == nil) //Geofence only do this when Locations module is absent.
     {
         //Geofence lat/lng logline 19, 20 is sent every one hour.
-        NSObject *sentTime = [[NSUserDefaults standardUserDefaults] objectForKey:SH_GEOFENCE_LATLNG_SENTTIME];
+        NSObject *sentTime = [[SHStateStore sharedInstance] objectForKey:SH_GEOFENCE_LATLNG_SENTTIME];
         if (sentTime != nil && [sentTime isKindOfClass:[NSNumber class]])
         {
             double sentTimestamp = [(NSNumber *)sentTime doubleValue];
@@ -112,8 +116,7 @@
         NSAssert(comment != nil, @"\"comment\" in sendGeolocationUpdateHandler should not be nil.");
         [StreetHawk sendLogForCode:LOG_CODE_LOCATION_MORE withComment:comment]; //send logline 19
         [StreetHawk sendLogForCode:LOG_CODE_LOCATION_GEO withComment:comment]; //send logline 20
-        [[NSUserDefaults standardUserDefaults] setObject:@([[NSDate date] timeIntervalSince1970]) forKey:SH_GEOFENCE_LATLNG_SENTTIME];
-        [[NSUserDefaults standardUserDefaults] synchronize];
+        [[SHStateStore sharedInstance] setObject:@([[NSDate date] timeIntervalSince1970]) forKey:SH_GEOFENCE_LATLNG_SENTTIME];
     }
 }
 
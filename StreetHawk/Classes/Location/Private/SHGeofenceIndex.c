@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#include "SHGeofenceIndex.h"
+//header from StreetHawk
+#include "SHGeoDistance.h" //for distance kernel
+//header from System
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GEOHASH_BITS            12  //bits for latitude and for longitude.
+#define GEOHASH_CELLS           (1 << GEOHASH_BITS)  //cells in each direction.
+#define DISTANCE_CHUNK          64  //fences measured by one `shDistancesSquared` call, results stay in stack.
+
+/**
+ A fence found by query.
+ */
+typedef struct
+{
+    double distance;
+    uint32_t index;
+} SHGeofenceCandidate;
+
+/**
+ Max heap keeping the nearest `capacity` candidates, farthest of them on top.
+ */
+typedef struct
+{
+    SHGeofenceCandidate *items;
+    size_t size;
+    size_t capacity;
+} SHGeofenceHeap;
+
+static uint32_t shGeohashRow(double latitude)
+{
+    int row = (int)floor((latitude + 90) / 180 * GEOHASH_CELLS);
+    return (uint32_t)((row < 0) ? 0 : ((row > GEOHASH_CELLS - 1) ? GEOHASH_CELLS - 1 : row));
+}
+
+static uint32_t shGeohashColumn(double longitude)
+{
+    int column = (int)floor((longitude + 180) / 360 * GEOHASH_CELLS) % GEOHASH_CELLS;
+    return (uint32_t)((column < 0) ? column + GEOHASH_CELLS : column);
+}
+
+//Interleave bits as geohash does, longitude bit first, so near cells have near values.
+static uint32_t shGeohash(uint32_t row, uint32_t column)
+{
+    uint32_t geohash = 0;
+    for (int bit = GEOHASH_BITS - 1; bit >= 0; bit --)
+    {
+        geohash = (geohash << 1) | ((column >> bit) & 1);
+        geohash = (geohash << 1) | ((row >> bit) & 1);
+    }
+    return geohash;
+}
+
+static double shWrapLongitude(double longitude, double reference) //same longitude within 180 of reference, so distance crosses 180 longitude.
+{
+    if (longitude - reference > 180)
+    {
+        return longitude - 360;
+    }
+    if (longitude - reference < -180)
+    {
+        return longitude + 360;
+    }
+    return longitude;
+}
+
+double shGeofenceEdgeDistance(double latitude, double longitude, double fenceLatitude, double fenceLongitude, double fenceRadius)
+{
+    double wrappedLongitude = shWrapLongitude(fenceLongitude, longitude);
+    double cosFenceLatitude = shCosLatitude(fenceLatitude);
+    double squared;
+    shDistancesSquared(latitude, longitude, shCosLatitude(latitude), &fenceLatitude, &wrappedLongitude, &cosFenceLatitude, 1, &squared);
+    return sqrt(squared) - fenceRadius;
+}
+
+static void shHeapPush(SHGeofenceHeap *heap, double distance, uint32_t index)
+{
+    size_t position;
+    if (heap->size < heap->capacity)
+    {
+        position = heap->size ++;
+        while (position > 0 && heap->items[(position - 1) / 2].distance < distance) //sift up
+        {
+            heap->items[position] = heap->items[(position - 1) / 2];
+            position = (position - 1) / 2;
+        }
+    }
+    else if (distance < heap->items[0].distance)
+    {
+        position = 0;
+        while (1) //replace top and sift down
+        {
+            size_t child = position * 2 + 1;
+            if (child >= heap->size)
+            {
+                break;
+            }
+            if (child + 1 < heap->size && heap->items[child + 1].distance > heap->items[child].distance)
+            {
+                child ++;
+            }
+            if (heap->items[child].distance <= distance)
+            {
+                break;
+            }
+            heap->items[position] = heap->items[child];
+            position = child;
+        }
+    }
+    else
+    {
+        return; //farther than all kept.
+    }
+    heap->items[position].distance = distance;
+    heap->items[position].index = index;
+}
+
+static int shCompareCellEntry(const void *a, const void *b)
+{
+    uint32_t geohashA = ((const SHGeofenceCellEntry *)a)->geohash;
+    uint32_t geohashB = ((const SHGeofenceCellEntry *)b)->geohash;
+    return (geohashA < geohashB) ? -1 : ((geohashA > geohashB) ? 1 : 0);
+}
+
+static int shCompareCandidate(const void *a, const void *b)
+{
+    double distanceA = ((const SHGeofenceCandidate *)a)->distance;
+    double distanceB = ((const SHGeofenceCandidate *)b)->distance;
+    return (distanceA < distanceB) ? -1 : ((distanceA > distanceB) ? 1 : 0);
+}
+
+static void shVisitEntries(const SHGeofenceIndex *index, size_t begin, size_t end, double latitude, double longitude, double cosLatitude, SHGeofenceHeap *heap)
+{
+    double squared[DISTANCE_CHUNK];
+    for (size_t chunk = begin; chunk < end; chunk += DISTANCE_CHUNK)
+    {
+        size_t length = (end - chunk < DISTANCE_CHUNK) ? end - chunk : DISTANCE_CHUNK;
+        shDistancesSquared(latitude, longitude, cosLatitude, index->latitudes + chunk, index->longitudes + chunk, index->cosLatitudes + chunk, length, squared);
+        for (size_t i = 0; i < length; i ++)
+        {
+            size_t entry = chunk + i;
+            if (fabs(index->longitudes[entry] - longitude) > 180) //kernel does not wrap, measure again across 180 longitude.
+            {
+                double wrappedLongitude = shWrapLongitude(index->longitudes[entry], longitude);
+                shDistancesSquared(latitude, longitude, cosLatitude, index->latitudes + entry, &wrappedLongitude, index->cosLatitudes + entry, 1, squared + i);
+            }
+            shHeapPush(heap, sqrt(squared[i]) - index->radiuses[entry], index->entries[entry].index);
+        }
+    }
+}
+
+static void shVisitCell(const SHGeofenceIndex *index, uint32_t geohash, double latitude, double longitude, double cosLatitude, SHGeofenceHeap *heap) //push all fences in this cell to heap.
+{
+    const SHGeofenceCellEntry *entries = index->entries;
+    //binary search the first entry of this cell.
+    size_t low = 0;
+    size_t high = index->count;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (entries[middle].geohash < geohash)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    size_t end = low;
+    while (end < index->count && entries[end].geohash == geohash)
+    {
+        end ++;
+    }
+    shVisitEntries(index, low, end, latitude, longitude, cosLatitude, heap);
+}
+
+int shGeofenceIndexInit(SHGeofenceIndex *index, const double *latitudes, const double *longitudes, const double *radiuses, size_t count)
+{
+    memset(index, 0, sizeof(*index));
+    if (count == 0)
+    {
+        return 1;
+    }
+    SHGeofenceCellEntry *entries = malloc(count * sizeof(SHGeofenceCellEntry));
+    double *coordinates = malloc(count * 4 * sizeof(double)); //one block for latitudes, longitudes, cosLatitudes and radiuses.
+    if (entries == NULL || coordinates == NULL)
+    {
+        free(entries);
+        free(coordinates);
+        return 0;
+    }
+    double maxRadius = 0;
+    for (size_t i = 0; i < count; i ++)
+    {
+        entries[i].geohash = shGeohash(shGeohashRow(latitudes[i]), shGeohashColumn(longitudes[i]));
+        entries[i].index = (uint32_t)i;
+        if (radiuses[i] > maxRadius)
+        {
+            maxRadius = radiuses[i];
+        }
+    }
+    qsort(entries, count, sizeof(SHGeofenceCellEntry), shCompareCellEntry);
+    index->latitudes = coordinates;
+    index->longitudes = coordinates + count;
+    index->cosLatitudes = coordinates + 2 * count;
+    index->radiuses = coordinates + 3 * count;
+    size_t occupiedCells = 0;
+    for (size_t i = 0; i < count; i ++)
+    {
+        uint32_t fence = entries[i].index;
+        index->latitudes[i] = latitudes[fence];
+        index->longitudes[i] = longitudes[fence];
+        index->cosLatitudes[i] = shCosLatitude(latitudes[fence]);
+        index->radiuses[i] = radiuses[fence];
+        if (i == 0 || entries[i].geohash != entries[i - 1].geohash)
+        {
+            occupiedCells ++;
+        }
+    }
+    index->entries = entries;
+    index->count = count;
+    index->occupiedCells = occupiedCells;
+    index->maxRadius = maxRadius;
+    return 1;
+}
+
+void shGeofenceIndexDestroy(SHGeofenceIndex *index)
+{
+    free(index->entries);
+    free(index->latitudes); //block of all coordinate arrays.
+    memset(index, 0, sizeof(*index));
+}
+
+size_t shGeofenceIndexNearest(const SHGeofenceIndex *index, size_t count, double latitude, double longitude, uint32_t *results, double *nextDistance)
+{
+    //find one more than asked, its distance is `nextDistance`.
+    size_t capacity = (count + 1 < index->count) ? count + 1 : index->count;
+    if (capacity == 0)
+    {
+        if (nextDistance != NULL)
+        {
+            *nextDistance = DBL_MAX;
+        }
+        return 0;
+    }
+    SHGeofenceHeap heap;
+    heap.items = malloc(capacity * sizeof(SHGeofenceCandidate));
+    if (heap.items == NULL)
+    {
+        return (size_t)-1;
+    }
+    heap.size = 0;
+    heap.capacity = capacity;
+    int centerRow = (int)shGeohashRow(latitude);
+    int centerColumn = (int)shGeohashColumn(longitude);
+    double cosLatitude = shCosLatitude(latitude);
+    double cellHeight = 180.0 / GEOHASH_CELLS * SH_METERS_PER_LATITUDE;
+    size_t visitedCells = 0;
+    for (int ring = 0; ; ring ++)
+    {
+        if (ring > 0 && heap.size == heap.capacity)
+        {
+            //Location is somewhere in center cell, so cells of this ring are at least (ring - 1) cells away. Cell is narrowest at the latitude nearest to pole, and `shDistancesSquared` scales longitude by mean cos of both latitudes, not less than cos there.
+            double poleLatitude = fmin(90, fabs(latitude) + ring * 180.0 / GEOHASH_CELLS);
+            double cellWidth = 360.0 / GEOHASH_CELLS * SH_METERS_PER_LONGITUDE * shCosLatitude(poleLatitude);
+            if ((ring - 1) * fmin(cellHeight, cellWidth) - index->maxRadius > heap.items[0].distance)
+            {
+                break; //no fence in this ring or farther can be nearer than those kept.
+            }
+        }
+        size_t ringCells = (ring == 0) ? 1 : 8 * (size_t)ring;
+        if (visitedCells + ringCells > index->occupiedCells || 2 * ring + 1 > GEOHASH_CELLS)
+        {
+            //Cheaper to check every fence than keep searching empty cells, such as location far away from all fences.
+            heap.size = 0;
+            shVisitEntries(index, 0, index->count, latitude, longitude, cosLatitude, &heap);
+            break;
+        }
+        for (int deltaRow = -ring; deltaRow <= ring; deltaRow ++)
+        {
+            int row = centerRow + deltaRow;
+            if (row < 0 || row >= GEOHASH_CELLS)
+            {
+                continue;
+            }
+            int isEdgeRow = (deltaRow == -ring || deltaRow == ring);
+            int step = (isEdgeRow || ring == 0) ? 1 : 2 * ring;
+            for (int deltaColumn = -ring; deltaColumn <= ring; deltaColumn += step)
+            {
+                int column = (centerColumn + deltaColumn + GEOHASH_CELLS) % GEOHASH_CELLS; //longitude wraps at 180.
+                shVisitCell(index, shGeohash((uint32_t)row, (uint32_t)column), latitude, longitude, cosLatitude, &heap);
+            }
+        }
+        visitedCells += ringCells;
+    }
+    qsort(heap.items, heap.size, sizeof(SHGeofenceCandidate), shCompareCandidate);
+    size_t resultCount = (count < heap.size) ? count : heap.size;
+    for (size_t i = 0; i < resultCount; i ++)
+    {
+        results[i] = heap.items[i].index;
+    }
+    if (nextDistance != NULL)
+    {
+        *nextDistance = (heap.size > count) ? heap.items[count].distance : DBL_MAX;
+    }
+    free(heap.items);
+    return resultCount;
+}
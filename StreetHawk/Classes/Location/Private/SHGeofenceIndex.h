@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_GEOFENCE_INDEX_H
+#define SH_GEOFENCE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Cell of a fence in grid. Entries are sorted by geohash so fences of one cell are continuous, and coordinates are kept in arrays of same order so distance of a cell is one `shDistancesSquared` run.
+ */
+typedef struct
+{
+    uint32_t geohash;
+    uint32_t index; //index of fence when index is built.
+} SHGeofenceCellEntry;
+
+/**
+ Spatial index of circular fences for finding the nearest ones to a location.
+
+ Fences are bucketed into a geohash grid (12 bits each for latitude and longitude, a cell is about 4.9km high and 9.8km wide at equator), the cells are sorted by geohash so each cell is a range of a flat array. A query visits cells ring by ring around the location and stops once no farther ring can hold a nearer fence. When the rings to visit outnumber occupied cells, such as location far from all fences, it scans all fences instead. Distance is from location to fence edge by `shDistancesSquared`, same as other location distances in SDK, so a fence the location is inside has negative distance.
+
+ Plain C so it builds and is measured without Foundation. It's immutable after built, build a new one when fences change.
+ */
+typedef struct
+{
+    SHGeofenceCellEntry *entries; //sorted by geohash.
+    double *latitudes; //same order as entries, so are following arrays.
+    double *longitudes;
+    double *cosLatitudes;
+    double *radiuses; //meters
+    size_t count;
+    size_t occupiedCells; //number of different geohash in entries.
+    double maxRadius; //fence edge can be this far out of its cell.
+} SHGeofenceIndex;
+
+/**
+ Build index, coordinates are copied. A zero filled index is empty and can be destroyed.
+ @param latitudes Latitude of each fence.
+ @param longitudes Longitude of each fence.
+ @param radiuses Radius in meters of each fence.
+ @param count Number of fences.
+ @return 1 if OK, 0 if out of memory and index is empty.
+ */
+int shGeofenceIndexInit(SHGeofenceIndex *index, const double *latitudes, const double *longitudes, const double *radiuses, size_t count);
+
+/**
+ Free memory of index, it becomes empty.
+ */
+void shGeofenceIndexDestroy(SHGeofenceIndex *index);
+
+/**
+ Find the nearest fences.
+ @param count Maximum number of fences to return.
+ @param latitude Latitude of location.
+ @param longitude Longitude of location.
+ @param results Out parameter, index of found fences nearest first, room for `count`.
+ @param nextDistance Out parameter, distance in meters from location to edge of the nearest fence not returned; `DBL_MAX` if all fences are returned. Pass NULL if not needed.
+ @return Number of fences in `results`, or (size_t)-1 if out of memory.
+ */
+size_t shGeofenceIndexNearest(const SHGeofenceIndex *index, size_t count, double latitude, double longitude, uint32_t *results, double *nextDistance);
+
+/**
+ Equirectangular distance from location to fence edge by `shDistancesSquared`, longitude wraps at 180. Enough for ranking fences within a few hundred kilometers.
+ */
+double shGeofenceEdgeDistance(double latitude, double longitude, double fenceLatitude, double fenceLongitude, double fenceRadius);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
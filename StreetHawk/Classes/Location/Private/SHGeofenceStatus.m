@@ -22,9 +22,19 @@
 #import "SHLogger.h" //for sending logline
 #import "SHHTTPSessionManager.h" //for sending request
 #import "SHLocationManager.h"
+#import "SHNetworkQuality.h" //for defer refresh on poor network
+#import "SHStateStore.h" //for geofence fetch cache
+#import "SHGeofenceIndex.h" //for nearest geofences
+//header from System
+#import <float.h> //for DBL_MAX
 
 #define APPSTATUS_GEOFENCE_FETCH_TIME       @"APPSTATUS_GEOFENCE_FETCH_TIME"  //last successfully fetch geofence list time
 #define APPSTATUS_GEOFENCE_FETCH_LIST       @"APPSTATUS_GEOFENCE_FETCH_LIST"  //geofence list fetched from server, it contains parent geofence with child node. This is used as geofence monitor region.
+#define APPSTATUS_GEOFENCE_INSIDE_LIST      @"APPSTATUS_GEOFENCE_INSIDE_LIST"  //server id of geofences device is inside. Saved on each enter/exit instead of whole fetch list, its "inside" is only used when this is not saved yet.
+
+#define GEOFENCE_REGION_LIMIT               20  //iOS allows an App to monitor 20 regions, shared by geofence, iBeacon and regions from other source.
+#define GEOFENCE_REFRESH_ID                 @"_SH_GEOFENCE_REFRESH"  //identifier of the region around device when monitoring nearest geofences, exit it to select again. Starts with "_" so never a leave geofence.
+#define GEOFENCE_REFRESH_MIN_RADIUS         100  //meters, iOS not reliably report smaller region.
 
 /**
  An object to represend server fetch geofence region. It's two levels: parent fence and child fence.
@@ -104,7 +114,7 @@
 + (SHServerGeofence *)parseGeofenceFromDict:(NSDictionary *)dict;
 
 /**
- Make this object array to string array for store to NSUserDefaults.
+ Make this object array to string array for store to state store.
  */
 + (NSArray *)serializeToArrayDict:(NSArray *)parentFences;
 
@@ -118,20 +128,39 @@
 @interface SHGeofenceStatus ()
 
 @property (strong, nonatomic) NSMutableArray *arrayGeofenceFetchList; //simiar as above but for geofence fetch list.
+@property (strong, nonatomic) NSMutableSet *setInsideIds; //server id of inside geofences, same as `isInside` of geofences in self.arrayGeofenceFetchList.
+@property (strong, nonatomic) NSDictionary *dictGeofenceById; //server id -> SHServerGeofence of all nodes in self.arrayGeofenceFetchList, built when first used and cleared when list changes.
+@property (strong, nonatomic) NSArray *arrayLeaveGeofences; //leave geofences in self.arrayGeofenceFetchList, built together with spatial index when first used and cleared when list changes.
+@property (nonatomic) BOOL isNearestMode; //YES when too many geofences to monitor tree, monitoring nearest leave geofences instead.
+@property (nonatomic) CLLocationCoordinate2D selectLocation; //location where nearest geofences were selected, center of refresh region.
+@property (nonatomic) double refreshRadius; //radius of refresh region, before device moves out no unselected geofence can be entered.
 - (void)sendLogForGeoFence:(SHServerGeofence *)geoFence isInside:(BOOL)isInside; //Send install/log for enter/exit server geofence.
-- (SHServerGeofence *)findServerGeofenceForRegion:(CLRegion *)region;  //get SHServerGeofence list, subset of self.arrayGeofenceFetchList, which match this region. It searches both parent and child list.
+- (SHServerGeofence *)findServerGeofenceForRegion:(CLRegion *)region;  //get SHServerGeofence, subset of self.arrayGeofenceFetchList, which match this region. It finds both parent and child.
 - (void)stopMonitorPreviousGeofencesOnlyForOutside:(BOOL)onlyForOutside parentCanKeepChild:(BOOL)parentKeep;  //Geofence monitor region need to change, stop previous monitor for server's geofence. If `onlyForOutside`=YES, only stop monitor those outside; otherwise stop all regardless inside or outside. `parentKeep`=YES take effect when `onlyForOutside`=YES, if it's parent fence is inside, child fence not stop although it's outside.
 - (void)startMonitorGeofences:(NSArray *)arrayGeofences;  //Give an array of SHServerGeofence and convert to be monitored. It doesn't create region for child nodes.
 - (void)markSelfAndChildGeofenceOutside:(SHServerGeofence *)geofence; //When a geofence outside, mark itself and child (if has) to be outside, send out geofene logline for previous inside leave geofence too. Make it a separate function because it's recurisive.
 - (void)stopMonitorSelfAndChildGeofence:(SHServerGeofence *)geofence; //when stop monitor inner geofence, stop monitor its child too. As child not stop when exit due to parent keep it.
-- (SHServerGeofence *)searchSelfAndChild:(SHServerGeofence *)geofence forRegion:(CLCircularRegion *)geoRegion; //search recursively to match
+- (void)addSelfAndChild:(SHServerGeofence *)geofence toDictionary:(NSMutableDictionary *)dictGeofences; //add recursively with server id as key.
+- (void)setGeofence:(SHServerGeofence *)geofence inside:(BOOL)isInside; //change `isInside` and keep self.setInsideIds same.
+- (void)saveInsideState; //save self.setInsideIds, a small record for each enter/exit instead of whole fetch list.
 - (void)regionStateChangeNotificationHandler:(NSNotification *)notification; //monitor when a region state change.
+- (void)addLeaveGeofences:(SHServerGeofence *)geofence toArray:(NSMutableArray *)arrayLeaves; //collect leave geofences recursively.
+- (NSInteger)regionCountExcept:(NSArray *)arrayGeofences includeGeofence:(BOOL)includeGeofence; //number of monitored regions not in `arrayGeofences`, excluding refresh region. If `includeGeofence`=NO, excluding all server geofences too.
+- (BOOL)checkNearestMode; //whether monitoring nearest geofences. After App re-launch, it's recovered from monitored refresh region.
+- (NSArray *)nearestGeofences:(NSUInteger)count toLocation:(CLLocationCoordinate2D)location nextDistance:(double *)nextDistance; //nearest leave geofences by spatial index, nearest first. `nextDistance` is edge distance of nearest one not returned, DBL_MAX if all returned.
+- (void)selectNearestGeofences; //monitor nearest leave geofences within region limit and a refresh region around device, stop others.
+- (void)locationUpdateNotificationHandler:(NSNotification *)notification; //select nearest geofences again when device moves far.
 
 @end
 
 @implementation SHGeofenceStatus
+{
+    SHGeofenceIndex _geofenceIndex; //spatial index of self.arrayLeaveGeofences, fence index is index in that array. Only built, queried and destroyed in main thread, same as location delegate.
+}
 
 @synthesize arrayGeofenceFetchList = _arrayGeofenceFetchList;
+@synthesize dictGeofenceById = _dictGeofenceById;
+@synthesize arrayLeaveGeofences = _arrayLeaveGeofences;
 
 #pragma mark - life cycle
 
@@ -151,6 +180,8 @@
     if (self = [super init])
     {
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(regionStateChangeNotificationHandler:) name:SHLMRegionStateChangeNotification object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(locationUpdateNotificationHandler:) name:SHLMUpdateLocationSuccessNotification object:nil];
+        self.isNearestMode = NO;
     }
     return self;
 }
@@ -158,6 +189,7 @@
 - (void)dealloc
 {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
+    shGeofenceIndexDestroy(&_geofenceIndex);
 }
 
 #pragma mark - properties
@@ -189,7 +221,7 @@
         if (serverTime != nil)
         {
             BOOL needFetch = NO;
-            NSObject *localTimeVal = [[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_GEOFENCE_FETCH_TIME];
+            NSObject *localTimeVal = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_GEOFENCE_FETCH_TIME];
             if (localTimeVal == nil || ![localTimeVal isKindOfClass:[NSNumber class]])
             {
                 needFetch = YES;  //local never fetched, do fetch.
@@ -202,49 +234,58 @@
                     needFetch = YES;  //local fetched, but too old, do fetch.
                 }
             }
+            if (needFetch && localTimeVal != nil && ![[SHNetworkQuality sharedInstance] allowPrefetch])
+            {
+                SHLog(@"Defer geofence refresh on poor network, keep monitoring current geofences.");
+                return; //has geofence already, refresh when next app_status comes. First fetch always goes as nothing is monitored without it.
+            }
             if (needFetch)
             {
                 //update local cache time before send request, because this request has same format as others {app_status:..., code:0, value:...}, it will trigger `setGeofenceTimestamp` again. If fail to get request, clear local cache time in callback handler, make next fetch happen.
-                [[NSUserDefaults standardUserDefaults] setObject:@([serverTime timeIntervalSinceReferenceDate] + 60/*avoid double accurate*/) forKey:APPSTATUS_GEOFENCE_FETCH_TIME];
-                [[NSUserDefaults standardUserDefaults] synchronize];
-                [[SHHTTPSessionManager sharedInstance] GET:@"/geofences/tree/" hostVersion:SHHostVersion_V1 parameters:nil success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+                [[SHStateStore sharedInstance] setObject:@([serverTime timeIntervalSinceReferenceDate] + 60/*avoid double accurate*/) forKey:APPSTATUS_GEOFENCE_FETCH_TIME];
+                //Geofence tree can be large, build SHServerGeofence directly from each parent element while decoding, not keep whole json tree.
+                NSMutableArray *arrayList = [NSMutableArray array];
+                [[SHHTTPSessionManager sharedInstance] GET:@"/geofences/tree/" hostVersion:SHHostVersion_V1 parameters:nil streamKey:@"value" elementHandler:^(NSString * _Nullable key, id  _Nonnull element)
                 {
-                    //successfully fetch server's geofence list. local cache time is already updated, store fetch list and active monitor.
-                    SHLog(@"Fetch server geofence list: %@.", responseObject);
-                    NSAssert([responseObject isKindOfClass:[NSArray class]] || [responseObject isKindOfClass:[NSDictionary class]], @"Server return should be array or empty dictionary.");
-                    if ([responseObject isKindOfClass:[NSArray class]] || [responseObject isKindOfClass:[NSDictionary class]])
+                    NSAssert(key == nil && [element isKindOfClass:[NSDictionary class]], @"Geofence parent should be dictionary inside array, got %@.", element);
+                    if (key == nil && [element isKindOfClass:[NSDictionary class]])
                     {
-                        //Geofence would monitor parent or child, and it's possible `id` not change but latitude/longitude/radius change. When timestamp change, stop monitor existing geofences and start to monitor from new list totally.
-                        [self stopMonitorPreviousGeofencesOnlyForOutside:NO parentCanKeepChild:NO]; //server's geofence change, stop monitor all.
-                        if ([responseObject isKindOfClass:[NSArray class]]) //array means there is new geofence list from server
+                        SHServerGeofence *geofence = [SHServerGeofence parseGeofenceFromDict:(NSDictionary *)element];
+                        NSAssert(geofence != nil, @"Fail to parse geofence from %@.", element);
+                        if (geofence != nil)
                         {
-                            NSMutableArray *arrayList = [NSMutableArray array];
-                            for (NSDictionary *dictParent in (NSArray *)responseObject)
-                            {
-                                SHServerGeofence *geofence = [SHServerGeofence parseGeofenceFromDict:dictParent];
-                                NSAssert(geofence != nil, @"Fail to parse geofence from %@.", dictParent);
-                                if (geofence != nil)
-                                {
-                                    [arrayList addObject:geofence];
-                                }
-                            }
-                            //Update local cache and memory, start monitor parent.
-                            self.arrayGeofenceFetchList = arrayList;
-                            [[NSUserDefaults standardUserDefaults] setObject:[SHServerGeofence serializeToArrayDict:arrayList] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];
-                            [[NSUserDefaults standardUserDefaults] synchronize];
-                            [self startMonitorGeofences:arrayList];
+                            [arrayList addObject:geofence];
                         }
-                        else //dictionary means empty geofence list from server.
+                    }
+                } success:^(NSURLSessionDataTask * _Nullable task, id  _Nullable responseObject)
+                {
+                    //Completion is in network queue, while location handlers query the index in main thread. Hand over the parsed list, leave geofences and index are only touched in main thread.
+                    dispatch_async(dispatch_get_main_queue(), ^
+                    {
+                        //successfully fetch server's geofence list. local cache time is already updated, store fetch list and active monitor.
+                        SHLog(@"Fetch server geofence list: %lu parent geofences.", (unsigned long)arrayList.count);
+                        NSAssert([responseObject isKindOfClass:[NSArray class]] || [responseObject isKindOfClass:[NSDictionary class]], @"Server return should be array or empty dictionary.");
+                        if ([responseObject isKindOfClass:[NSArray class]] || [responseObject isKindOfClass:[NSDictionary class]])
                         {
-                            self.arrayGeofenceFetchList = [NSMutableArray array]; //cannot set to nil, as nil will read from NSUserDefaults again.
-                            [[NSUserDefaults standardUserDefaults] setObject:[NSArray array] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];  //clear local cache, not start when kill and launch App.
-                            [[NSUserDefaults standardUserDefaults] synchronize];
+                            //Geofence would monitor parent or child, and it's possible `id` not change but latitude/longitude/radius change. When timestamp change, stop monitor existing geofences and start to monitor from new list totally.
+                            [self stopMonitorPreviousGeofencesOnlyForOutside:NO parentCanKeepChild:NO]; //server's geofence change, stop monitor all.
+                            if ([responseObject isKindOfClass:[NSArray class]]) //array means there is new geofence list from server, its elements are already parsed into `arrayList`.
+                            {
+                                //Update local cache and memory, start monitor parent.
+                                self.arrayGeofenceFetchList = arrayList;
+                                [[SHStateStore sharedInstance] setObject:[SHServerGeofence serializeToArrayDict:arrayList] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];
+                                [self startMonitorGeofences:arrayList];
+                            }
+                            else //dictionary means empty geofence list from server.
+                            {
+                                self.arrayGeofenceFetchList = [NSMutableArray array]; //cannot set to nil, as nil will read from NSUserDefaults again.
+                                [[SHStateStore sharedInstance] setObject:[NSArray array] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];  //clear local cache, not start when kill and launch App.
+                            }
                         }
-                    }
+                    });
                 } failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
                 {
-                    [[NSUserDefaults standardUserDefaults] setObject:@(0) forKey:APPSTATUS_GEOFENCE_FETCH_TIME]; //make next fetch happen as this time fail.
-                    [[NSUserDefaults standardUserDefaults] synchronize];
+                    [[SHStateStore sharedInstance] setObject:@(0) forKey:APPSTATUS_GEOFENCE_FETCH_TIME]; //make next fetch happen as this time fail.
                 }];
             }
             return;
@@ -253,8 +294,7 @@
     //when meet this, means server return nil or invalid timestamp. Clear local fetch list and stop monitor.
     [self stopMonitorPreviousGeofencesOnlyForOutside:NO parentCanKeepChild:NO];
     self.arrayGeofenceFetchList = [NSMutableArray array]; //cannot set to nil, as nil will read from NSUserDefaults again.
-    [[NSUserDefaults standardUserDefaults] setObject:[NSArray array] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];  //clear local cache, not start when kill and launch App.
-    [[NSUserDefaults standardUserDefaults] synchronize];
+    [[SHStateStore sharedInstance] setObject:[NSArray array] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];  //clear local cache, not start when kill and launch App.
 }
 
 #pragma mark - private functions
@@ -263,11 +303,96 @@
 {
     if (_arrayGeofenceFetchList == nil) //never initialized
     {
-        _arrayGeofenceFetchList = [NSMutableArray arrayWithArray:[SHServerGeofence deserializeToArrayObj:[[NSUserDefaults standardUserDefaults] objectForKey:APPSTATUS_GEOFENCE_FETCH_LIST]]]; //it will not get nil even empty
+        _arrayGeofenceFetchList = [NSMutableArray arrayWithArray:[SHServerGeofence deserializeToArrayObj:[[SHStateStore sharedInstance] objectForKey:APPSTATUS_GEOFENCE_FETCH_LIST]]]; //it will not get nil even empty
+        NSArray *arrayInsideIds = [[SHStateStore sharedInstance] objectForKey:APPSTATUS_GEOFENCE_INSIDE_LIST];
+        NSSet *setSavedIds = [arrayInsideIds isKindOfClass:[NSArray class]] ? [NSSet setWithArray:arrayInsideIds] : nil; //nil if saved by previous version, "inside" is in fetch list.
+        self.setInsideIds = [NSMutableSet set];
+        for (SHServerGeofence *geofence in self.dictGeofenceById.allValues)
+        {
+            if (setSavedIds != nil)
+            {
+                geofence.isInside = [setSavedIds containsObject:geofence.serverId];
+            }
+            if (geofence.isInside)
+            {
+                [self.setInsideIds addObject:geofence.serverId];
+            }
+        }
     }
     return _arrayGeofenceFetchList;
 }
 
+- (void)setArrayGeofenceFetchList:(NSMutableArray *)arrayGeofenceFetchList
+{
+    _arrayGeofenceFetchList = arrayGeofenceFetchList;
+    self.dictGeofenceById = nil; //rebuild when used.
+    self.arrayLeaveGeofences = nil;
+    self.setInsideIds = [NSMutableSet set];
+    for (SHServerGeofence *geofence in self.dictGeofenceById.allValues)
+    {
+        if (geofence.isInside)
+        {
+            [self.setInsideIds addObject:geofence.serverId];
+        }
+    }
+    [self saveInsideState];
+}
+
+- (NSDictionary *)dictGeofenceById
+{
+    if (_dictGeofenceById == nil)
+    {
+        NSMutableDictionary *dictGeofences = [NSMutableDictionary dictionary];
+        for (SHServerGeofence *geofence in self.arrayGeofenceFetchList)
+        {
+            [self addSelfAndChild:geofence toDictionary:dictGeofences];
+        }
+        _dictGeofenceById = [dictGeofences copy];
+    }
+    return _dictGeofenceById;
+}
+
+- (NSArray *)arrayLeaveGeofences
+{
+    NSAssert([NSThread isMainThread], @"Geofence index must be used in main thread.");
+    if (_arrayLeaveGeofences == nil)
+    {
+        NSMutableArray *arrayLeaves = [NSMutableArray array];
+        for (SHServerGeofence *geofence in self.arrayGeofenceFetchList)
+        {
+            [self addLeaveGeofences:geofence toArray:arrayLeaves];
+        }
+        NSMutableData *dataLatitudes = [NSMutableData dataWithLength:arrayLeaves.count * sizeof(double)];
+        NSMutableData *dataLongitudes = [NSMutableData dataWithLength:arrayLeaves.count * sizeof(double)];
+        NSMutableData *dataRadiuses = [NSMutableData dataWithLength:arrayLeaves.count * sizeof(double)];
+        double *latitudes = (double *)dataLatitudes.mutableBytes;
+        double *longitudes = (double *)dataLongitudes.mutableBytes;
+        double *radiuses = (double *)dataRadiuses.mutableBytes;
+        for (NSUInteger i = 0; i < arrayLeaves.count; i ++)
+        {
+            SHServerGeofence *geofence = arrayLeaves[i];
+            latitudes[i] = geofence.latitude;
+            longitudes[i] = geofence.longitude;
+            radiuses[i] = geofence.radius;
+        }
+        shGeofenceIndexDestroy(&_geofenceIndex);
+        if (!shGeofenceIndexInit(&_geofenceIndex, latitudes, longitudes, radiuses, arrayLeaves.count))
+        {
+            [arrayLeaves removeAllObjects]; //keep same as empty index.
+        }
+        _arrayLeaveGeofences = [arrayLeaves copy];
+    }
+    return _arrayLeaveGeofences;
+}
+
+- (void)setArrayLeaveGeofences:(NSArray *)arrayLeaveGeofences
+{
+    NSAssert(arrayLeaveGeofences == nil, @"Leave geofences only built by getter.");
+    NSAssert([NSThread isMainThread], @"Geofence index must be used in main thread.");
+    _arrayLeaveGeofences = nil;
+    shGeofenceIndexDestroy(&_geofenceIndex); //rebuild when used.
+}
+
 - (void)sendLogForGeoFence:(SHServerGeofence *)geoFence isInside:(BOOL)isInside
 {
     NSInteger index = [geoFence.serverId rangeOfString:@"-"].location;
@@ -301,16 +426,8 @@
     {
         return nil;
     }
-    CLCircularRegion *geoRegion = (CLCircularRegion *)region;
-    for (SHServerGeofence *geofence in self.arrayGeofenceFetchList)
-    {
-        SHServerGeofence *matchGeofence = [self searchSelfAndChild:geofence forRegion:geoRegion];
-        if (matchGeofence != nil)
-        {
-            return matchGeofence;
-        }
-    }
-    return nil;
+    //region only compares by `identifier`, same as `isEqualToCircleRegion:`.
+    return (region.identifier != nil) ? self.dictGeofenceById[region.identifier] : nil;
 }
 
 - (void)stopMonitorPreviousGeofencesOnlyForOutside:(BOOL)onlyForOutside parentCanKeepChild:(BOOL)parentKeep
@@ -342,11 +459,25 @@
                 [self stopMonitorSelfAndChildGeofence:matchGeofence];
             }
         }
+        else if (!onlyForOutside && [monitorRegion.identifier isEqualToString:GEOFENCE_REFRESH_ID]) //stop all also ends monitoring nearest geofences.
+        {
+            [StreetHawk.locationManager stopMonitorRegion:monitorRegion];
+        }
+    }
+    if (!onlyForOutside)
+    {
+        self.isNearestMode = NO;
     }
 }
 
 - (void)startMonitorGeofences:(NSArray *)arrayGeofences
 {
+    if (self.isNearestMode || arrayGeofences.count + [self regionCountExcept:arrayGeofences includeGeofence:YES] > GEOFENCE_REGION_LIMIT)
+    {
+        //Not all can be monitored, iOS would fail silently. Monitor nearest leave geofences instead of tree.
+        [self selectNearestGeofences];
+        return;
+    }
     for (SHServerGeofence *geofence in arrayGeofences)
     {
         [StreetHawk.locationManager startMonitorRegion:[geofence getGeoRegion]];
@@ -357,7 +488,7 @@
 {
     if (geofence.isInside)
     {
-        geofence.isInside = NO;
+        [self setGeofence:geofence inside:NO];
         if (geofence.isLeaves) //for leave go outside, send logline.
         {
             [self sendLogForGeoFence:geofence isInside:NO];
@@ -384,21 +515,35 @@
     }
 }
 
-- (SHServerGeofence *)searchSelfAndChild:(SHServerGeofence *)geofence forRegion:(CLCircularRegion *)geoRegion
+- (void)addSelfAndChild:(SHServerGeofence *)geofence toDictionary:(NSMutableDictionary *)dictGeofences
 {
-    if ([geofence isEqualToCircleRegion:geoRegion])
+    if (geofence.serverId != nil && dictGeofences[geofence.serverId] == nil) //server id should not duplicate, first one wins same as searching tree.
     {
-        return geofence;
+        dictGeofences[geofence.serverId] = geofence;
     }
-    for (SHServerGeofence *childGeoFence in geofence.arrayNodes)
+    for (SHServerGeofence *childGeofence in geofence.arrayNodes)
     {
-        SHServerGeofence *match = [self searchSelfAndChild:childGeoFence forRegion:geoRegion];
-        if (match != nil)
-        {
-            return match;
-        }
+        [self addSelfAndChild:childGeofence toDictionary:dictGeofences]; //recurisively do it as child geofence may contains child too.
     }
-    return nil;
+}
+
+- (void)setGeofence:(SHServerGeofence *)geofence inside:(BOOL)isInside
+{
+    geofence.isInside = isInside;
+    if (isInside)
+    {
+        [self.setInsideIds addObject:geofence.serverId];
+    }
+    else
+    {
+        [self.setInsideIds removeObject:geofence.serverId];
+    }
+}
+
+- (void)saveInsideState
+{
+    //Fetch list is saved only when fetched. State store journals this small array and compacts by itself.
+    [[SHStateStore sharedInstance] setObject:self.setInsideIds.allObjects forKey:APPSTATUS_GEOFENCE_INSIDE_LIST];
 }
 
 - (void)regionStateChangeNotificationHandler:(NSNotification *)notification
@@ -406,6 +551,22 @@
     //use state change instead of didEnterRegion/didExitRegion because when startMonitorRegion, state change delegate is called, didEnter/ExitRegion delegate not called until next enter/exit.
     CLRegion *region = notification.userInfo[SHLMNotification_kRegion];
     CLRegionState regionState = [notification.userInfo[SHLMNotification_kRegionState] intValue];
+    if ([region.identifier isEqualToString:GEOFENCE_REFRESH_ID])
+    {
+        if (regionState == CLRegionStateOutside && [region isKindOfClass:[CLCircularRegion class]] && [self checkNearestMode])
+        {
+            //Always select again: device is out of refresh region, so unselected geofences may be near. Location update may be off in background and never come.
+            [self selectNearestGeofences];
+            //Current location may not update yet when region exit, if it's still inside the exited region the selection is around old location, select again at next location update.
+            CLLocationCoordinate2D location = StreetHawk.locationManager.currentGeoLocation;
+            CLLocationCoordinate2D center = ((CLCircularRegion *)region).center;
+            if ([[[CLLocation alloc] initWithLatitude:location.latitude longitude:location.longitude] distanceFromLocation:[[CLLocation alloc] initWithLatitude:center.latitude longitude:center.longitude]] < ((CLCircularRegion *)region).radius)
+            {
+                self.refreshRadius = 0;
+            }
+        }
+        return;
+    }
     if (regionState == CLRegionStateInside)
     {
         if ([region isKindOfClass:[CLCircularRegion class]])
@@ -413,9 +574,8 @@
             SHServerGeofence *geofence = [self findServerGeofenceForRegion:region];
             if (geofence != nil && !geofence.isInside/*only take action if change*/)
             {
-                geofence.isInside = YES;
-                [[NSUserDefaults standardUserDefaults] setObject:[SHServerGeofence serializeToArrayDict:self.arrayGeofenceFetchList] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];
-                [[NSUserDefaults standardUserDefaults] synchronize];
+                [self setGeofence:geofence inside:YES];
+                [self saveInsideState];
                 if (geofence.isLeaves) //if this is actual geofence, send enter logline and it's done
                 {
                     [self sendLogForGeoFence:geofence isInside:YES];
@@ -436,8 +596,7 @@
             if (geofence != nil && geofence.isInside/*only take action if change*/)
             {
                 [self markSelfAndChildGeofenceOutside:geofence]; //recursively mark this geofence and its child all outside. It also sends exit logline for child if necessary, because if parent exit before child leave, child will be marked as outside, and this logic will not enter when child leave detect outside.
-                [[NSUserDefaults standardUserDefaults] setObject:[SHServerGeofence serializeToArrayDict:self.arrayGeofenceFetchList] forKey:APPSTATUS_GEOFENCE_FETCH_LIST];
-                [[NSUserDefaults standardUserDefaults] synchronize];
+                [self saveInsideState];
                 if (!geofence.isLeaves) //if this is inner geofence, stop monitor its child geofence, add itself and it's same level.
                 {
                     [self stopMonitorPreviousGeofencesOnlyForOutside:YES parentCanKeepChild:YES]; //in case overlap and in another parent geofence, this will keep it un-affected.
@@ -457,6 +616,151 @@
     //do nothing for state=unknown.
 }
 
+- (void)addLeaveGeofences:(SHServerGeofence *)geofence toArray:(NSMutableArray *)arrayLeaves
+{
+    if (geofence.isLeaves)
+    {
+        [arrayLeaves addObject:geofence];
+    }
+    else
+    {
+        for (SHServerGeofence *childGeofence in geofence.arrayNodes)
+        {
+            [self addLeaveGeofences:childGeofence toArray:arrayLeaves]; //recurisively do it as child geofence may contains child too.
+        }
+    }
+}
+
+- (NSInteger)regionCountExcept:(NSArray *)arrayGeofences includeGeofence:(BOOL)includeGeofence
+{
+    NSMutableSet *setIds = [NSMutableSet setWithCapacity:arrayGeofences.count + 1];
+    for (SHServerGeofence *geofence in arrayGeofences)
+    {
+        [setIds addObject:geofence.serverId];
+    }
+    [setIds addObject:GEOFENCE_REFRESH_ID];
+    NSInteger count = 0;
+    for (CLRegion *monitorRegion in StreetHawk.locationManager.monitoredRegions)
+    {
+        if (![setIds containsObject:monitorRegion.identifier] && (includeGeofence || [self findServerGeofenceForRegion:monitorRegion] == nil))
+        {
+            count ++;
+        }
+    }
+    return count;
+}
+
+- (BOOL)checkNearestMode
+{
+    if (!self.isNearestMode)
+    {
+        for (CLRegion *monitorRegion in StreetHawk.locationManager.monitoredRegions)
+        {
+            if ([monitorRegion.identifier isEqualToString:GEOFENCE_REFRESH_ID] && [monitorRegion isKindOfClass:[CLCircularRegion class]])
+            {
+                self.isNearestMode = YES;
+                self.selectLocation = ((CLCircularRegion *)monitorRegion).center;
+                self.refreshRadius = ((CLCircularRegion *)monitorRegion).radius;
+                break;
+            }
+        }
+    }
+    return self.isNearestMode;
+}
+
+- (NSArray *)nearestGeofences:(NSUInteger)count toLocation:(CLLocationCoordinate2D)location nextDistance:(double *)nextDistance
+{
+    NSArray *arrayLeaves = self.arrayLeaveGeofences; //build index if not yet.
+    NSMutableData *dataResults = [NSMutableData dataWithLength:MAX(1, count) * sizeof(uint32_t)];
+    uint32_t *results = (uint32_t *)dataResults.mutableBytes;
+    size_t resultCount = shGeofenceIndexNearest(&_geofenceIndex, count, location.latitude, location.longitude, results, nextDistance);
+    if (resultCount == (size_t)-1)
+    {
+        if (nextDistance != NULL)
+        {
+            *nextDistance = 0; //out of memory, select again at next location update.
+        }
+        return [NSArray array];
+    }
+    NSMutableArray *arrayNearest = [NSMutableArray arrayWithCapacity:resultCount];
+    for (size_t i = 0; i < resultCount; i ++)
+    {
+        [arrayNearest addObject:arrayLeaves[results[i]]];
+    }
+    return arrayNearest;
+}
+
+- (void)selectNearestGeofences
+{
+    self.isNearestMode = YES;
+    CLLocationCoordinate2D location = StreetHawk.locationManager.currentGeoLocation;
+    if (location.latitude == 0 && location.longitude == 0)
+    {
+        SHLog(@"Too many geofences to monitor, wait for location to select nearest ones.");
+        self.refreshRadius = 0; //select at first location update.
+        return;
+    }
+    //Regions of iBeacon or other source are kept, one region is reserved for refresh region.
+    NSInteger availableCount = GEOFENCE_REGION_LIMIT - 1 - [self regionCountExcept:nil includeGeofence:NO];
+    double nextDistance = DBL_MAX;
+    NSArray *arrayNearest = [self nearestGeofences:MAX(0, availableCount) toLocation:location nextDistance:&nextDistance];
+    NSMutableSet *setNearestIds = [NSMutableSet setWithCapacity:arrayNearest.count];
+    for (SHServerGeofence *geofence in arrayNearest)
+    {
+        [setNearestIds addObject:geofence.serverId];
+    }
+    //Stop geofences not selected, including inner geofences and previous selected ones. Geofence inside has negative distance so it's selected.
+    for (CLRegion *monitorRegion in StreetHawk.locationManager.monitoredRegions)
+    {
+        if (![setNearestIds containsObject:monitorRegion.identifier] && [self findServerGeofenceForRegion:monitorRegion] != nil)
+        {
+            [StreetHawk.locationManager stopMonitorRegion:monitorRegion];
+        }
+    }
+    for (SHServerGeofence *geofence in arrayNearest)
+    {
+        [StreetHawk.locationManager startMonitorRegion:[geofence getGeoRegion]]; //already monitored one is ignored.
+    }
+    self.selectLocation = location;
+    if (nextDistance == DBL_MAX) //all leave geofences monitored, no need to select again.
+    {
+        self.refreshRadius = DBL_MAX;
+        [StreetHawk.locationManager stopMonitorRegion:[[CLCircularRegion alloc] initWithCenter:location radius:GEOFENCE_REFRESH_MIN_RADIUS identifier:GEOFENCE_REFRESH_ID]];
+    }
+    else if (nextDistance >= GEOFENCE_REFRESH_MIN_RADIUS)
+    {
+        //Device cannot enter any unselected geofence before moving `nextDistance`, which is the edge of nearest unselected one. Refresh region never larger than it, otherwise that geofence could be entered before exit.
+        self.refreshRadius = MIN(nextDistance, StreetHawk.locationManager.geofenceMaximumRadius);
+        [StreetHawk.locationManager startMonitorRegion:[[CLCircularRegion alloc] initWithCenter:location radius:self.refreshRadius identifier:GEOFENCE_REFRESH_ID]];
+    }
+    else
+    {
+        //Unselected geofence is nearer than smallest reliable region, even inside it when too many geofences overlap. Not monitor refresh region, select again by location update.
+        self.refreshRadius = MAX(0, nextDistance);
+        [StreetHawk.locationManager stopMonitorRegion:[[CLCircularRegion alloc] initWithCenter:location radius:GEOFENCE_REFRESH_MIN_RADIUS identifier:GEOFENCE_REFRESH_ID]];
+    }
+    SHLog(@"Monitor nearest %lu of %lu geofences, select again after moving %.0f meters.", (unsigned long)arrayNearest.count, (unsigned long)self.arrayLeaveGeofences.count, self.refreshRadius);
+}
+
+- (void)locationUpdateNotificationHandler:(NSNotification *)notification
+{
+    if (![self checkNearestMode])
+    {
+        return;
+    }
+    CLLocation *newLocation = notification.userInfo[SHLMNotification_kNewLocation];
+    if (newLocation == nil)
+    {
+        return;
+    }
+    //Not wait till exit refresh region: after half way, geofences ahead may be nearer than those selected behind.
+    CLLocation *selectLocation = [[CLLocation alloc] initWithLatitude:self.selectLocation.latitude longitude:self.selectLocation.longitude];
+    if (self.refreshRadius == 0 || (self.refreshRadius != DBL_MAX && [newLocation distanceFromLocation:selectLocation] >= self.refreshRadius / 2))
+    {
+        [self selectNearestGeofences];
+    }
+}
+
 @end
 
 @implementation SHServerGeofence
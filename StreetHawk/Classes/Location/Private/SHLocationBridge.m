@@ -21,6 +21,7 @@
 #import "SHLocationManager.h"
 #import "SHLogger.h" //for sendLogForCode
 #import "SHUtils.h" //for shSerializeObjToJson
+#import "SHStateStore.h" //for last location
 
 @interface SHLocationBridge ()
 
@@ -78,7 +79,7 @@ typedef void (^RegularTaskCompletionHandler)(UIBackgroundFetchResult);
     BOOL needLocationLog = ([SHLocationManager locationServiceEnabledForApp:NO/*must allowed location already*/] && StreetHawk.locationManager.currentGeoLocation.latitude != 0 && StreetHawk.locationManager.currentGeoLocation.longitude != 0); //log current geo location if location service is enabled and already detect location.
     if (needLocationLog)
     {
-        NSObject *lastPostLocationLogsVal = [[NSUserDefaults standardUserDefaults] objectForKey:REGULAR_LOCATION_LOGTIME];
+        NSObject *lastPostLocationLogsVal = [[SHStateStore sharedInstance] objectForKey:REGULAR_LOCATION_LOGTIME];
         if (lastPostLocationLogsVal != nil && [lastPostLocationLogsVal isKindOfClass:[NSNumber class]])
         {
             NSTimeInterval lastPostLocationLogs = [(NSNumber *)lastPostLocationLogsVal doubleValue];
@@ -142,7 +143,6 @@ typedef void (^RegularTaskCompletionHandler)(UIBackgroundFetchResult);
 {
     [[NSUserDefaults standardUserDefaults] setObject:@(StreetHawk.locationManager.currentGeoLocation.latitude) forKey:SH_GEOLOCATION_LAT];
     [[NSUserDefaults standardUserDefaults] setObject:@(StreetHawk.locationManager.currentGeoLocation.longitude) forKey:SH_GEOLOCATION_LNG];
-    [[NSUserDefaults standardUserDefaults] synchronize];
 }
 
 + (void)sendGeolocationUpdateHandler:(NSNotification *)notification
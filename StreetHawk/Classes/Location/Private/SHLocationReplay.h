@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SHLocationManager.h" //for SHLocationSource
+
+/**
+ Key of replay event: seconds from trace start, NSNumber. Events must be in time order.
+ */
+#define SHReplayTimeKey             @"time"
+
+/**
+ Key of replay event: event type, NSString, one of `SHReplayType_Location`, `SHReplayType_State` and `SHReplayType_Range`.
+ */
+#define SHReplayTypeKey             @"type"
+
+/**
+ Location update, with keys "lat", "lng" and optional "accuracy" (meters, default 10).
+ */
+#define SHReplayType_Location       @"location"
+
+/**
+ Region state determined, with keys "region" (identifier of a monitored region) and "state" ("inside" or "outside").
+ */
+#define SHReplayType_State          @"state"
+
+/**
+ iBeacons ranged, with keys "uuid" and "beacons" (array of dictionary with "major", "minor" and "accuracy" in meters, negative if unknown). Empty "beacons" is a ranging finding none.
+ */
+#define SHReplayType_Range          @"range"
+
+/**
+ Key of replay result: seconds of trace, from first event to last event, NSNumber.
+ */
+#define SHReplayResultDurationKey   @"duration"
+
+/**
+ Key of replay result: number of events replayed, NSNumber. Events with unknown type or not monitored region are skipped.
+ */
+#define SHReplayResultEventsKey     @"events"
+
+/**
+ Key of replay result: CPU seconds of main thread in handlers, NSNumber.
+ */
+#define SHReplayResultCPUKey        @"cpu"
+
+/**
+ Key of replay result: loglines produced, NSNumber.
+ */
+#define SHReplayResultLogsKey       @"logs"
+
+/**
+ Key of replay result: state store writes, NSNumber.
+ */
+#define SHReplayResultWritesKey     @"writes"
+
+/**
+ Key of replay result: dictionary of cpu, logs and writes per hour of trace.
+ */
+#define SHReplayResultPerHourKey    @"per_hour"
+
+/**
+ Replay a recorded or synthetic trace into geofence and iBeacon handling without walking around with a device, and measure its cost.
+
+ Replay is a `SHLocationSource` taking place of CLLocationManager: it sends events to its `delegate`, `SHLocationManager` by default, so the same notifications reach `SHGeofenceStatus`, `SHBeaconStatus` and location logging as on device. Region state events use regions currently monitored, so replay after geofence and iBeacon lists are fetched.
+
+ Replay keeps a virtual clock of trace time. Locations carry virtual timestamps, `SHLocationManager.nowBlock` reads the virtual clock during `run` so time gates follow the trace, and the result is normalized per hour of virtual time. Events are replayed one after another without waiting, so timers scheduled by handlers still fire by wall clock after replay. It must run in main thread, same as location delegate, and location service must be enabled.
+ */
+@interface SHLocationReplay : NSObject<SHLocationSource>
+
+/** @name Creator */
+
+/**
+ Create replay for a trace.
+ @param arrayEvents Array of event dictionary, see `SHReplayTypeKey` for format.
+ */
+- (instancetype)initWithEvents:(NSArray *)arrayEvents;
+
+/**
+ Parse track points and way points of GPX into location events. Time is from point's "time", or 1 second after previous point if not have.
+ @param gpxData Content of GPX file.
+ @return Array of location events, empty if fail to parse.
+ */
++ (NSArray *)eventsFromGPX:(NSData *)gpxData;
+
+/** @name Replay */
+
+/**
+ Receiver of replayed events, default is `StreetHawk.locationManager`.
+ */
+@property (nonatomic, weak) id<SHLocationSourceDelegate> delegate;
+
+/**
+ Regions state events are for, same as `StreetHawk.locationManager.monitoredRegions`.
+ */
+@property (nonatomic, readonly, copy) NSSet *monitoredRegions;
+
+/**
+ Virtual date of trace start, default is the time replay created.
+ */
+@property (nonatomic, strong) NSDate *startDate;
+
+/**
+ Virtual clock, seconds from trace start of the event being replayed.
+ */
+@property (nonatomic, readonly) NSTimeInterval virtualTime;
+
+/**
+ Replay all events.
+ @return Dictionary of result, see `SHReplayResultDurationKey` for keys.
+ */
+- (NSDictionary *)run;
+
+@end
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHLocationReplay.h"
+//header from StreetHawk
+#import "SHApp+Location.h" //for `StreetHawk.locationManager`
+#import "SHLogger.h" //for log count
+#import "SHStateStore.h" //for write count
+#import "SHUtils.h" //for shParseDate
+#import "SHSamplingPolicy.h" //for shThreadCPUTime
+//header from System
+#import <CoreLocation/CoreLocation.h>
+
+#define REPLAY_DEFAULT_ACCURACY     10 //meters, for location event not having accuracy
+#define REPLAY_BEACON_REGION_ID     @"SHReplay" //identifier of iBeacon region created for ranging a UUID not monitored
+
+/**
+ CLBeacon cannot be created, replay ranging result by a subclass returning trace values.
+ */
+@interface SHReplayBeacon : CLBeacon
+
+@property (nonatomic, strong) NSUUID *replayUUID;
+@property (nonatomic, strong) NSNumber *replayMajor;
+@property (nonatomic, strong) NSNumber *replayMinor;
+@property (nonatomic) CLLocationAccuracy replayAccuracy;
+
+@end
+
+@implementation SHReplayBeacon
+
+- (NSUUID *)proximityUUID
+{
+    return self.replayUUID;
+}
+
+- (NSNumber *)major
+{
+    return self.replayMajor;
+}
+
+- (NSNumber *)minor
+{
+    return self.replayMinor;
+}
+
+- (CLLocationAccuracy)accuracy
+{
+    return self.replayAccuracy;
+}
+
+- (CLProximity)proximity
+{
+    if (self.replayAccuracy < 0)
+    {
+        return CLProximityUnknown;
+    }
+    return (self.replayAccuracy < 0.5) ? CLProximityImmediate : ((self.replayAccuracy < 3) ? CLProximityNear : CLProximityFar);
+}
+
+- (NSInteger)rssi
+{
+    return (self.replayAccuracy < 0) ? 0 : -59/*typical measured power at 1 meter*/ - (NSInteger)(20 * log10(MAX(self.replayAccuracy, 0.1)));
+}
+
+@end
+
+/**
+ Collect points of GPX.
+ */
+@interface SHGPXParser : NSObject<NSXMLParserDelegate>
+
+@property (nonatomic, strong) NSMutableArray *arrayPoints; //dictionary of "lat", "lng" and optional "date".
+@property (nonatomic, strong) NSMutableDictionary *dictCurrentPoint;
+@property (nonatomic, strong) NSMutableString *timeText; //not nil when inside point's "time" element.
+
+@end
+
+@implementation SHGPXParser
+
+- (void)parser:(NSXMLParser *)parser didStartElement:(NSString *)elementName namespaceURI:(NSString *)namespaceURI qualifiedName:(NSString *)qName attributes:(NSDictionary *)attributeDict
+{
+    if ([elementName isEqualToString:@"trkpt"] || [elementName isEqualToString:@"wpt"] || [elementName isEqualToString:@"rtept"])
+    {
+        if (attributeDict[@"lat"] != nil && attributeDict[@"lon"] != nil)
+        {
+            self.dictCurrentPoint = [NSMutableDictionary dictionaryWithDictionary:@{@"lat": @([attributeDict[@"lat"] doubleValue]), @"lng": @([attributeDict[@"lon"] doubleValue])}];
+        }
+    }
+    else if ([elementName isEqualToString:@"time"] && self.dictCurrentPoint != nil)
+    {
+        self.timeText = [NSMutableString string];
+    }
+}
+
+- (void)parser:(NSXMLParser *)parser foundCharacters:(NSString *)string
+{
+    [self.timeText appendString:string];
+}
+
+- (void)parser:(NSXMLParser *)parser didEndElement:(NSString *)elementName namespaceURI:(NSString *)namespaceURI qualifiedName:(NSString *)qName
+{
+    if ([elementName isEqualToString:@"time"] && self.timeText != nil)
+    {
+        NSString *timeText = [self.timeText stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        NSDate *date = shParseDate([timeText stringByReplacingOccurrencesOfString:@"Z" withString:@"+0000"], 0);
+        if (date != nil)
+        {
+            self.dictCurrentPoint[@"date"] = date;
+        }
+        self.timeText = nil;
+    }
+    else if (([elementName isEqualToString:@"trkpt"] || [elementName isEqualToString:@"wpt"] || [elementName isEqualToString:@"rtept"]) && self.dictCurrentPoint != nil)
+    {
+        [self.arrayPoints addObject:self.dictCurrentPoint];
+        self.dictCurrentPoint = nil;
+    }
+}
+
+@end
+
+@interface SHLocationReplay ()
+
+@property (nonatomic, strong) NSArray *arrayEvents;
+@property (nonatomic) NSTimeInterval virtualTime;
+
+- (dispatch_block_t)deliveryForEvent:(NSDictionary *)event; //block calling location delegate for this event, nil if event should be skipped.
+- (CLRegion *)monitoredRegionForIdentifier:(NSString *)identifier;
+- (CLBeaconRegion *)beaconRegionForUUID:(NSUUID *)uuid; //monitored iBeacon region of this UUID, or a new one if not monitored.
+
+@end
+
+@implementation SHLocationReplay
+
+#pragma mark - life cycle
+
+- (instancetype)initWithEvents:(NSArray *)arrayEvents
+{
+    if (self = [super init])
+    {
+        self.arrayEvents = (arrayEvents != nil) ? [arrayEvents copy] : @[];
+        self.delegate = StreetHawk.locationManager;
+        self.startDate = [NSDate date];
+        self.virtualTime = 0;
+    }
+    return self;
+}
+
++ (NSArray *)eventsFromGPX:(NSData *)gpxData
+{
+    if (gpxData == nil)
+    {
+        return @[];
+    }
+    SHGPXParser *gpxParser = [[SHGPXParser alloc] init];
+    gpxParser.arrayPoints = [NSMutableArray array];
+    NSXMLParser *parser = [[NSXMLParser alloc] initWithData:gpxData];
+    parser.delegate = gpxParser;
+    if (![parser parse])
+    {
+        SHLog(@"Fail to parse GPX: %@.", parser.parserError);
+        return @[];
+    }
+    NSMutableArray *arrayEvents = [NSMutableArray arrayWithCapacity:gpxParser.arrayPoints.count];
+    NSDate *firstDate = nil;
+    NSTimeInterval time = -1;
+    for (NSDictionary *dictPoint in gpxParser.arrayPoints)
+    {
+        NSDate *date = dictPoint[@"date"];
+        if (date != nil && firstDate == nil)
+        {
+            firstDate = [date dateByAddingTimeInterval:-MAX(0, time + 1)]; //points before it have no time, keep their spacing.
+        }
+        NSTimeInterval pointTime = (date != nil) ? [date timeIntervalSinceDate:firstDate] : time + 1;
+        time = MAX(time, pointTime); //events must be in time order.
+        [arrayEvents addObject:@{SHReplayTimeKey: @(time), SHReplayTypeKey: SHReplayType_Location, @"lat": dictPoint[@"lat"], @"lng": dictPoint[@"lng"]}];
+    }
+    return arrayEvents;
+}
+
+#pragma mark - properties
+
+- (NSSet *)monitoredRegions
+{
+    return [NSSet setWithArray:StreetHawk.locationManager.monitoredRegions];
+}
+
+#pragma mark - public functions
+
+- (NSDictionary *)run
+{
+    NSAssert([NSThread isMainThread], @"Replay location events must be in main thread.");
+    SHLocationManager *locationManager = StreetHawk.locationManager;
+    NSTimeInterval (^previousNowBlock)(void) = locationManager.nowBlock;
+    __weak SHLocationReplay *weakSelf = self;
+    locationManager.nowBlock = ^NSTimeInterval
+    {
+        return weakSelf.startDate.timeIntervalSince1970 + weakSelf.virtualTime;
+    };
+    NSUInteger startLogCount = StreetHawk.logger.logCount;
+    NSUInteger startWriteCount = [SHStateStore sharedInstance].writeCount;
+    double cpuTime = 0;
+    NSUInteger eventCount = 0;
+    NSTimeInterval firstTime = 0;
+    NSTimeInterval lastTime = 0;
+    for (NSDictionary *event in self.arrayEvents)
+    {
+        if (![event isKindOfClass:[NSDictionary class]])
+        {
+            continue;
+        }
+        self.virtualTime = [event[SHReplayTimeKey] doubleValue];
+        dispatch_block_t delivery = [self deliveryForEvent:event];
+        if (delivery == nil)
+        {
+            continue;
+        }
+        if (eventCount == 0)
+        {
+            firstTime = self.virtualTime;
+        }
+        lastTime = self.virtualTime;
+        double start = shThreadCPUTime();
+        delivery(); //notifications are delivered synchronously, handlers finish before it returns.
+        cpuTime += shThreadCPUTime() - start;
+        eventCount ++;
+    }
+    locationManager.nowBlock = previousNowBlock;
+    NSUInteger logCount = StreetHawk.logger.logCount - startLogCount;
+    NSUInteger writeCount = [SHStateStore sharedInstance].writeCount - startWriteCount; //after writes dispatched by handlers.
+    NSTimeInterval duration = lastTime - firstTime;
+    double hours = duration / 3600;
+    NSDictionary *dictPerHour = (hours > 0) ? @{SHReplayResultCPUKey: @(cpuTime / hours), SHReplayResultLogsKey: @(logCount / hours), SHReplayResultWritesKey: @(writeCount / hours)} : @{};
+    NSDictionary *dictResult = @{SHReplayResultDurationKey: @(duration), SHReplayResultEventsKey: @(eventCount), SHReplayResultCPUKey: @(cpuTime), SHReplayResultLogsKey: @(logCount), SHReplayResultWritesKey: @(writeCount), SHReplayResultPerHourKey: dictPerHour};
+    SHLog(@"Location replay: %@.", dictResult);
+    return dictResult;
+}
+
+#pragma mark - private functions
+
+- (dispatch_block_t)deliveryForEvent:(NSDictionary *)event
+{
+    id<SHLocationSourceDelegate> delegate = self.delegate;
+    NSString *type = event[SHReplayTypeKey];
+    if ([type isEqualToString:SHReplayType_Location])
+    {
+        double accuracy = (event[@"accuracy"] != nil) ? [event[@"accuracy"] doubleValue] : REPLAY_DEFAULT_ACCURACY;
+        CLLocation *location = [[CLLocation alloc] initWithCoordinate:CLLocationCoordinate2DMake([event[@"lat"] doubleValue], [event[@"lng"] doubleValue]) altitude:0 horizontalAccuracy:accuracy verticalAccuracy:-1 timestamp:[self.startDate dateByAddingTimeInterval:self.virtualTime]];
+        return ^
+        {
+            [delegate locationSource:self didUpdateLocations:@[location]];
+        };
+    }
+    if ([type isEqualToString:SHReplayType_State])
+    {
+        CLRegion *region = [self monitoredRegionForIdentifier:event[@"region"]];
+        if (region == nil)
+        {
+            SHLog(@"Location replay: skip state of region %@ not monitored.", event[@"region"]);
+            return nil;
+        }
+        CLRegionState state = [event[@"state"] isEqualToString:@"inside"] ? CLRegionStateInside : ([event[@"state"] isEqualToString:@"outside"] ? CLRegionStateOutside : CLRegionStateUnknown);
+        return ^
+        {
+            [delegate locationSource:self didDetermineState:state forRegion:region];
+        };
+    }
+    if ([type isEqualToString:SHReplayType_Range])
+    {
+        NSUUID *uuid = [event[@"uuid"] isKindOfClass:[NSString class]] ? [[NSUUID alloc] initWithUUIDString:event[@"uuid"]] : nil;
+        if (uuid == nil)
+        {
+            return nil;
+        }
+        CLBeaconRegion *region = [self beaconRegionForUUID:uuid];
+        NSMutableArray *arrayBeacons = [NSMutableArray array];
+        for (NSDictionary *dictBeacon in event[@"beacons"])
+        {
+            SHReplayBeacon *beacon = [[SHReplayBeacon alloc] init];
+            beacon.replayUUID = uuid;
+            beacon.replayMajor = @([dictBeacon[@"major"] intValue]);
+            beacon.replayMinor = @([dictBeacon[@"minor"] intValue]);
+            beacon.replayAccuracy = (dictBeacon[@"accuracy"] != nil) ? [dictBeacon[@"accuracy"] doubleValue] : -1;
+            [arrayBeacons addObject:beacon];
+        }
+        return ^
+        {
+            [delegate locationSource:self didRangeBeacons:arrayBeacons inRegion:region];
+        };
+    }
+    return nil;
+}
+
+- (CLRegion *)monitoredRegionForIdentifier:(NSString *)identifier
+{
+    if (![identifier isKindOfClass:[NSString class]])
+    {
+        return nil;
+    }
+    for (CLRegion *region in self.monitoredRegions)
+    {
+        if ([region.identifier isEqualToString:identifier])
+        {
+            return region;
+        }
+    }
+    return nil;
+}
+
+- (CLBeaconRegion *)beaconRegionForUUID:(NSUUID *)uuid
+{
+    for (CLRegion *region in self.monitoredRegions)
+    {
+        if ([region isKindOfClass:[CLBeaconRegion class]] && [((CLBeaconRegion *)region).proximityUUID isEqual:uuid])
+        {
+            return (CLBeaconRegion *)region;
+        }
+    }
+    return [[CLBeaconRegion alloc] initWithProximityUUID:uuid identifier:REPLAY_BEACON_REGION_ID];
+}
+
+@end
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+/**
+ Movement of device guessed from recent fixes.
+ */
+enum SHSamplingMode
+{
+    /**
+     Not enough fixes to guess yet.
+     */
+    SHSamplingMode_Unknown,
+    /**
+     Staying within a small circle for a while.
+     */
+    SHSamplingMode_Stationary,
+    /**
+     Moving in walking speed.
+     */
+    SHSamplingMode_Walking,
+    /**
+     Moving in vehicle speed.
+     */
+    SHSamplingMode_Driving,
+};
+typedef enum SHSamplingMode SHSamplingMode;
+
+#define SH_SAMPLING_STATIONARY_TIME     180 //seconds, staying in a small circle this long is stationary
+
+/**
+ CPU seconds used by current thread so far, for measuring cost of handlers.
+ */
+double shThreadCPUTime(void);
+
+/**
+ Guess movement from recent fixes and decide how often fixes are needed.
+
+ A fix is used when its horizontal accuracy is known and not worse than 200 metres. Speed is from the fix, or from distance to previous fix when system not provide, and smoothed. Stationary is when no fix leaves a 50 metres circle for `SH_SAMPLING_STATIONARY_TIME`, otherwise below 3 m/s is walking and above is driving. Leaving the circle ends stationary at once, while walking and driving switch only after two fixes agree.
+
+ Locations are only reported after both minimum time and minimum distance, so while moving at `speed` the next report is at least max(minDistance, speed * minTime) away. Fixes are needed at half of that distance to keep the same reports, and accuracy need not be finer than it. It's not thread safe, use it in main thread same as location delegate.
+ */
+@interface SHSamplingPolicy : NSObject
+
+/** @name Movement */
+
+/**
+ Current movement mode.
+ */
+@property (nonatomic, readonly) SHSamplingMode mode;
+
+/**
+ Smoothed speed in m/s, negative if not known yet.
+ */
+@property (nonatomic, readonly) double speed;
+
+/**
+ Clock of stationary check and mode durations, returns seconds since 1970. nil means wall clock. default = nil.
+ */
+@property (nonatomic, copy) NSTimeInterval (^nowBlock)(void);
+
+/**
+ Add a fix from location update.
+ @param location The fix.
+ @return YES if `mode` changes.
+ */
+- (BOOL)addLocation:(CLLocation *)location;
+
+/**
+ Check stationary by `nowBlock` clock. When distance filter is set no fix comes while device stays, so call this some time after last fix.
+ @return YES if `mode` changes to stationary.
+ */
+- (BOOL)checkStationary;
+
+/** @name Sampling */
+
+/**
+ Distance filter for current mode.
+ @param minDistance Minimum distance in metres between reports.
+ @param minTime Minimum time in seconds between reports.
+ @return Distance filter in metres.
+ */
+- (CLLocationDistance)distanceFilterForMinDistance:(double)minDistance minTime:(double)minTime;
+
+/**
+ Desired accuracy for current mode, the coarsest of ten metres, hundred metres and kilometre not larger than report distance.
+ @param minDistance Minimum distance in metres between reports.
+ @param minTime Minimum time in seconds between reports.
+ @return Desired accuracy.
+ */
+- (CLLocationAccuracy)desiredAccuracyForMinDistance:(double)minDistance minTime:(double)minTime;
+
+/** @name Counters */
+
+/**
+ Add CPU seconds spent handling fixes into current mode.
+ */
+- (void)addCPUTime:(double)cpuTime;
+
+/**
+ Counters since created. Key is mode name "unknown", "stationary", "walking" or "driving", value is dictionary with "fixes" (number of fixes received), "cpu" (CPU seconds handling fixes) and "duration" (seconds in this mode).
+ */
+@property (nonatomic, readonly) NSDictionary *statistics;
+
+@end
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#import "SHSamplingPolicy.h"
+//header from System
+#import <mach/mach.h> //for thread cpu time
+
+#define SAMPLING_MAX_ACCURACY       200 //metres, fix worse than this is not used
+#define SAMPLING_STATIONARY_RADIUS  50 //metres, fixes within this circle is staying
+#define SAMPLING_WALKING_SPEED      3.0 //m/s, faster than this is driving
+#define SAMPLING_SMOOTH_FACTOR      0.5 //weight of new speed in smoothed speed
+#define SAMPLING_AGREE_FIXES        2 //continuous fixes suggesting same mode before walking and driving switch
+#define SAMPLING_MIN_FILTER         10 //metres, same as default distance filter
+#define SAMPLING_MAX_FILTER         1000 //metres, still see turns when driving fast
+#define SAMPLING_MODE_COUNT         4 //number of SHSamplingMode
+
+double shThreadCPUTime(void)
+{
+    mach_port_t thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    kern_return_t result = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (result != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return info.user_time.seconds + info.user_time.microseconds / 1e6 + info.system_time.seconds + info.system_time.microseconds / 1e6;
+}
+
+@interface SHSamplingPolicy ()
+{
+    NSUInteger fixCounts[SAMPLING_MODE_COUNT]; //fixes received in each mode
+    double cpuTimes[SAMPLING_MODE_COUNT]; //CPU seconds handling fixes in each mode
+    double durations[SAMPLING_MODE_COUNT]; //seconds in each mode, not include current period
+}
+
+@property (nonatomic, readwrite) SHSamplingMode mode;
+@property (nonatomic, readwrite) double speed;
+@property (nonatomic, strong) CLLocation *previousLocation; //last used fix, for speed when fix not have one.
+@property (nonatomic, strong) CLLocation *anchorLocation; //center of stationary circle, moves to a fix leaving it.
+@property (nonatomic) SHSamplingMode candidateMode; //mode suggested by recent fixes but not agreed yet.
+@property (nonatomic) NSInteger candidateCount; //continuous fixes suggesting `candidateMode`.
+@property (nonatomic) NSTimeInterval modeTime; //clock when current mode starts.
+
+- (NSTimeInterval)now; //seconds since 1970 by `nowBlock`, or wall clock.
+- (void)changeMode:(SHSamplingMode)mode; //switch mode and count duration of previous one.
+- (double)reportDistanceForMinDistance:(double)minDistance minTime:(double)minTime; //distance of next report at current speed.
+
+@end
+
+@implementation SHSamplingPolicy
+
+#pragma mark - life cycle
+
+- (id)init
+{
+    if ((self = [super init]))
+    {
+        self.mode = SHSamplingMode_Unknown;
+        self.speed = -1;
+        self.candidateMode = SHSamplingMode_Unknown;
+        self.candidateCount = 0;
+        self.modeTime = [self now];
+    }
+    return self;
+}
+
+#pragma mark - properties
+
+- (void)setNowBlock:(NSTimeInterval (^)(void))nowBlock
+{
+    NSTimeInterval elapsed = [self now] - self.modeTime;
+    _nowBlock = [nowBlock copy];
+    self.modeTime = [self now] - elapsed; //current mode keeps its duration when clock switches.
+}
+
+#pragma mark - public functions
+
+- (BOOL)addLocation:(CLLocation *)location
+{
+    fixCounts[self.mode] ++;
+    if (location.horizontalAccuracy < 0 || location.horizontalAccuracy > SAMPLING_MAX_ACCURACY)
+    {
+        return NO; //invalid or too rough, neither speed nor circle is reliable.
+    }
+    double speed = location.speed;
+    if (speed < 0 && self.previousLocation != nil)
+    {
+        NSTimeInterval interval = [location.timestamp timeIntervalSinceDate:self.previousLocation.timestamp];
+        CLLocationDistance distance = [location distanceFromLocation:self.previousLocation];
+        if (interval > 0 && distance > location.horizontalAccuracy + self.previousLocation.horizontalAccuracy) //shorter move cannot tell from noise.
+        {
+            speed = distance / interval;
+        }
+    }
+    self.previousLocation = location;
+    if (speed >= 0)
+    {
+        self.speed = (self.speed < 0) ? speed : (SAMPLING_SMOOTH_FACTOR * speed + (1 - SAMPLING_SMOOTH_FACTOR) * self.speed);
+    }
+    if (self.anchorLocation == nil || [location distanceFromLocation:self.anchorLocation] > MAX(SAMPLING_STATIONARY_RADIUS, location.horizontalAccuracy))
+    {
+        self.anchorLocation = location;
+    }
+    SHSamplingMode candidate;
+    if ([location.timestamp timeIntervalSinceDate:self.anchorLocation.timestamp] >= SH_SAMPLING_STATIONARY_TIME)
+    {
+        candidate = SHSamplingMode_Stationary;
+    }
+    else
+    {
+        candidate = (self.speed > SAMPLING_WALKING_SPEED) ? SHSamplingMode_Driving : SHSamplingMode_Walking; //unknown speed takes walking, the finer sampling.
+    }
+    if (candidate == self.mode)
+    {
+        self.candidateCount = 0;
+        return NO;
+    }
+    if (self.candidateMode == candidate)
+    {
+        self.candidateCount ++;
+    }
+    else
+    {
+        self.candidateMode = candidate;
+        self.candidateCount = 1;
+    }
+    //first guess, entering stationary and leaving the circle are sure, only walking and driving flip by speed noise.
+    if (self.mode == SHSamplingMode_Unknown || self.mode == SHSamplingMode_Stationary || candidate == SHSamplingMode_Stationary || self.candidateCount >= SAMPLING_AGREE_FIXES)
+    {
+        [self changeMode:candidate];
+        return YES;
+    }
+    return NO;
+}
+
+- (BOOL)checkStationary
+{
+    if (self.mode == SHSamplingMode_Stationary || self.anchorLocation == nil)
+    {
+        return NO;
+    }
+    if ([self now] - self.anchorLocation.timestamp.timeIntervalSince1970 >= SH_SAMPLING_STATIONARY_TIME)
+    {
+        [self changeMode:SHSamplingMode_Stationary];
+        return YES;
+    }
+    return NO;
+}
+
+- (CLLocationDistance)distanceFilterForMinDistance:(double)minDistance minTime:(double)minTime
+{
+    if (self.mode == SHSamplingMode_Stationary)
+    {
+        return SAMPLING_STATIONARY_RADIUS; //only need to see leaving the circle.
+    }
+    double filter = [self reportDistanceForMinDistance:minDistance minTime:minTime] / 2;
+    return MAX(SAMPLING_MIN_FILTER, MIN(filter, SAMPLING_MAX_FILTER));
+}
+
+- (CLLocationAccuracy)desiredAccuracyForMinDistance:(double)minDistance minTime:(double)minTime
+{
+    if (self.mode == SHSamplingMode_Stationary)
+    {
+        return kCLLocationAccuracyHundredMeters; //enough to tell leaving the circle, and same as default.
+    }
+    double reportDistance = [self reportDistanceForMinDistance:minDistance minTime:minTime];
+    if (reportDistance >= 1000)
+    {
+        return kCLLocationAccuracyKilometer;
+    }
+    if (reportDistance >= 100)
+    {
+        return kCLLocationAccuracyHundredMeters;
+    }
+    return kCLLocationAccuracyNearestTenMeters;
+}
+
+- (void)addCPUTime:(double)cpuTime
+{
+    cpuTimes[self.mode] += cpuTime;
+}
+
+- (NSDictionary *)statistics
+{
+    NSArray *arrayNames = @[@"unknown", @"stationary", @"walking", @"driving"];
+    NSMutableDictionary *dictStatistics = [NSMutableDictionary dictionary];
+    NSTimeInterval now = [self now];
+    for (int i = 0; i < SAMPLING_MODE_COUNT; i ++)
+    {
+        double duration = durations[i];
+        if (i == self.mode)
+        {
+            duration += now - self.modeTime;
+        }
+        dictStatistics[arrayNames[i]] = @{@"fixes": @(fixCounts[i]), @"cpu": @(cpuTimes[i]), @"duration": @(duration)};
+    }
+    return dictStatistics;
+}
+
+#pragma mark - private functions
+
+- (NSTimeInterval)now
+{
+    return (self.nowBlock != nil) ? self.nowBlock() : [[NSDate date] timeIntervalSince1970];
+}
+
+- (void)changeMode:(SHSamplingMode)mode
+{
+    NSTimeInterval now = [self now];
+    durations[self.mode] += now - self.modeTime;
+    self.modeTime = now;
+    self.mode = mode;
+    self.candidateMode = SHSamplingMode_Unknown;
+    self.candidateCount = 0;
+    if (mode == SHSamplingMode_Stationary)
+    {
+        self.speed = 0;
+    }
+}
+
+- (double)reportDistanceForMinDistance:(double)minDistance minTime:(double)minTime
+{
+    return MAX(minDistance, MAX(self.speed, 0) * minTime);
+}
+
+@end
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#include "SHTrajectory.h"
+//header from System
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEGREE_TO_RADIAN        (3.14159265358979323846 / 180.0)
+#define METERS_PER_LATITUDE     110540.0
+#define METERS_PER_LONGITUDE    111320.0 //at equator
+
+//Douglas-Peucker in metres, set `keep` for points kept. Use a stack of segments instead of recursion.
+static int shDouglasPeucker(const double *x, const double *y, size_t count, double tolerance, unsigned char *keep)
+{
+    size_t *stack = malloc(count * 2 * sizeof(size_t)); //segments in stack not overlap, at most count - 1 of them.
+    if (stack == NULL)
+    {
+        return 0;
+    }
+    size_t top = 0;
+    stack[top ++] = 0;
+    stack[top ++] = count - 1;
+    double toleranceSquared = tolerance * tolerance;
+    while (top > 0)
+    {
+        size_t last = stack[-- top];
+        size_t first = stack[-- top];
+        double dx = x[last] - x[first];
+        double dy = y[last] - y[first];
+        double lengthSquared = dx * dx + dy * dy;
+        double maxDistanceSquared = 0;
+        size_t maxIndex = first;
+        for (size_t i = first + 1; i < last; i ++)
+        {
+            double px = x[i] - x[first];
+            double py = y[i] - y[first];
+            double cross = px * dy - py * dx;
+            double distanceSquared = (lengthSquared > 0) ? cross * cross / lengthSquared : px * px + py * py; //distance to line, or to point when segment starts and ends at same place.
+            if (distanceSquared > maxDistanceSquared)
+            {
+                maxDistanceSquared = distanceSquared;
+                maxIndex = i;
+            }
+        }
+        if (maxDistanceSquared > toleranceSquared)
+        {
+            keep[maxIndex] = 1;
+            stack[top ++] = first;
+            stack[top ++] = maxIndex;
+            stack[top ++] = maxIndex;
+            stack[top ++] = last;
+        }
+    }
+    free(stack);
+    return 1;
+}
+
+size_t shSimplifyTrajectory(const double *latitudes, const double *longitudes, const double *times, size_t count, double tolerance, double maxGap, unsigned char *keep)
+{
+    if (count <= 2)
+    {
+        memset(keep, 1, count);
+        return count;
+    }
+    double *x = malloc(count * sizeof(double));
+    double *y = malloc(count * sizeof(double));
+    memset(keep, 0, count);
+    keep[0] = 1;
+    keep[count - 1] = 1;
+    int isSimplified = 0;
+    if (x != NULL && y != NULL)
+    {
+        double metersPerLongitude = METERS_PER_LONGITUDE * cos(latitudes[0] * DEGREE_TO_RADIAN);
+        for (size_t i = 0; i < count; i ++)
+        {
+            x[i] = (longitudes[i] - longitudes[0]) * metersPerLongitude;
+            y[i] = (latitudes[i] - latitudes[0]) * METERS_PER_LATITUDE;
+        }
+        isSimplified = shDouglasPeucker(x, y, count, tolerance, keep);
+    }
+    free(x);
+    free(y);
+    if (!isSimplified)
+    {
+        memset(keep, 1, count);
+        return count;
+    }
+    //Keep time bound: a location dropped is kept back if too long since previous kept one.
+    size_t keptCount = 0;
+    double lastKeptTime = times[0];
+    for (size_t i = 0; i < count; i ++)
+    {
+        if (keep[i] || times[i] - lastKeptTime >= maxGap)
+        {
+            keep[i] = 1;
+            lastKeptTime = times[i];
+            keptCount ++;
+        }
+    }
+    return keptCount;
+}
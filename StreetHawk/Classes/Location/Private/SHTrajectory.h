@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_TRAJECTORY_H
+#define SH_TRAJECTORY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Simplify a trajectory of geo locations before sending them in one logline. Plain C so it's measured and checked without CoreLocation.
+ Douglas-Peucker on an equirectangular projection around the first location keeps the shape within `tolerance`, it's accurate enough in a flush window. Then a location dropped is kept back if it's `maxGap` or more after previous kept one, so server still knows where it stays. First and last are always kept, and trajectory of 2 or less is not changed.
+ @param latitudes Latitude of each location.
+ @param longitudes Longitude of each location.
+ @param times Time of each location in seconds, ascending.
+ @param count Number of locations.
+ @param tolerance Metres a dropped location can be away from the simplified trajectory.
+ @param maxGap Seconds of longest gap between kept locations when dropped ones are in it.
+ @param keep Out parameter, 1 for kept and 0 for dropped, room for `count`. All kept if out of memory.
+ @return Number of kept locations.
+ */
+size_t shSimplifyTrajectory(const double *latitudes, const double *longitudes, const double *times, size_t count, double tolerance, double maxGap, unsigned char *keep);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -136,6 +136,10 @@ extern int const SHLocation_FG_Interval; //Default minimum time interval for upd
 extern int const SHLocation_FG_Distance; //Default minimum distance for updating location when App in FG, 100 meters.
 extern int const SHLocation_BG_Interval; //Default minimum time interval for updating location when App in BG, 5 mins.
 extern int const SHLocation_BG_Distance; //Default minimum distance for updating location when App in BG, 500 meters.
+extern int const SHLocation_Batch_Interval; //Default maximum time buffering geo locations before sending one logline, 0 means not buffer and send each location.
+extern int const SHLocation_iBeacon_ExitMisses; //Default number of continuous ranging without an iBeacon before it's out, 3 times.
+extern int const SHLocation_iBeacon_BandInterval; //Default minimum time interval for logging an iBeacon's distance band change, 0 means not log.
+extern int const SHLocation_AdaptiveSampling; //Default whether location sampling follows movement, 0 means fixed accuracy and distance filter.
 
 @class SHLocationManager;
 
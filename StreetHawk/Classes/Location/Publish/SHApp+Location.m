@@ -56,6 +56,10 @@ int const SHLocation_FG_Interval = 1;
 int const SHLocation_FG_Distance = 100;
 int const SHLocation_BG_Interval = 5;
 int const SHLocation_BG_Distance = 500;
+int const SHLocation_Batch_Interval = 0;
+int const SHLocation_iBeacon_ExitMisses = 3;
+int const SHLocation_iBeacon_BandInterval = 0;
+int const SHLocation_AdaptiveSampling = 0;
 
 #define ENABLE_LOCATION_SERVICE             @"ENABLE_LOCATION_SERVICE"  //key for record user manually set isLocationServiceEnabled
 #define REPORT_WORKHOME_LOCATION_ONLY       @"REPORT_WORKHOME_LOCATION_ONLY" //key for only report work home location
@@ -19,7 +19,7 @@
 //header from StreetHawk
 #import "SHUtils.h" //for shLocalizedString
 #import "SHApp+Notification.h" //for StreetHawk
-#import "SHHTTPSessionManager.h" //for send request
+#import "SHRequestOutbox.h" //for send request
 
 @implementation SHInteractiveButtons
 
@@ -503,11 +503,9 @@
         //If has pairs to submit, do it.
         if (dictButtons.allKeys.count > 0)
         {
-            SHJSONSessionManager *sessionManager = [SHJSONSessionManager sharedInstance];
-            [sessionManager POST:@"apps/submit_interactive_button/" hostVersion:SHHostVersion_V2 body:@{@"installid": NONULL(StreetHawk.currentInstall.suid), @"button": dictButtons} success:nil failure:^(NSURLSessionDataTask * _Nullable task, NSError * _Nullable error)
-             {
-                 SHLog(@"Fail to submit interactive button pairs: %@", error); //submit button pairs not show error dialog to bother customer.
-             }];
+            //submit button pairs not show error dialog to bother customer. Go through outbox so it's retried when offline, and only latest pairs are submitted.
+            NSDictionary *body = @{@"installid": NONULL(StreetHawk.currentInstall.suid), @"button": dictButtons};
+            [[SHRequestOutbox sharedInstance] enqueueMethod:@"POST" path:@"apps/submit_interactive_button/" hostVersion:SHHostVersion_V2 body:body useJSON:YES idempotencyKey:[NSString stringWithFormat:@"submit_interactive_button_%@", [shSerializeObjToJson(body) md5]] coalesceKey:@"submit_interactive_button" resultNotification:nil];
         }
     }
 }
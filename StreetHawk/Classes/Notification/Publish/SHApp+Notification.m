@@ -25,6 +25,7 @@
 #import "SHHTTPSessionManager.h" //for sending request
 #import "SHAppStatus.h" //for appStatusChange
 #import "SHInteractiveButtons.h" //for interactive pair buttons
+#import "SHStateStore.h" //for sent disable timestamp
 //header from System
 #import <objc/runtime.h> //for associate object
 
@@ -202,7 +203,7 @@ NSString * const SHNMNotification_kPayload = @"Payload";
         }
         else
         {
-            NSNumber *sentDisableTimestamp = [[NSUserDefaults standardUserDefaults] objectForKey:APNS_SENT_DISABLE_TIMESTAMP];
+            NSNumber *sentDisableTimestamp = [[SHStateStore sharedInstance] objectForKey:APNS_SENT_DISABLE_TIMESTAMP];
             if (sentDisableTimestamp == nil || sentDisableTimestamp.doubleValue != disableTimestamp.doubleValue)
             {
                 needUpdate = YES;  //for some reason (is registering and may ignore one update) not upload previous one successful, double check here.
@@ -40,6 +40,17 @@ _out:
 }
 #endif
 
+static NSData * SHAFSecKeyGetLookupData(SecKeyRef key) {
+#if TARGET_OS_IOS || TARGET_OS_WATCH || TARGET_OS_TV
+    if (&SecKeyCopyExternalRepresentation == NULL) { // before iOS 10
+        return nil;
+    }
+    return (__bridge_transfer NSData *)SecKeyCopyExternalRepresentation(key, NULL);
+#else
+    return SHAFSecKeyGetData(key);
+#endif
+}
+
 static BOOL SHAFSecKeyIsEqualToKey(SecKeyRef key1, SecKeyRef key2) {
 #if TARGET_OS_IOS || TARGET_OS_WATCH || TARGET_OS_TV
     return [(__bridge id)key1 isEqual:(__bridge id)key2];
@@ -151,6 +162,7 @@ static NSArray * SHAFPublicKeyTrustChainForServerTrust(SecTrustRef serverTrust)
 @interface SHAFSecurityPolicy()
 @property (readwrite, nonatomic, assign) SHAFSSLPinningMode SSLPinningMode;
 @property (readwrite, nonatomic, strong) NSSet *pinnedPublicKeys;
+@property (readwrite, nonatomic, strong) NSSet *pinnedPublicKeyData;
 @end
 
 @implementation SHAFSecurityPolicy
@@ -222,8 +234,21 @@ static NSArray * SHAFPublicKeyTrustChainForServerTrust(SecTrustRef serverTrust)
             [mutablePinnedPublicKeys addObject:publicKey];
         }
         self.pinnedPublicKeys = [NSSet setWithSet:mutablePinnedPublicKeys];
+
+        // hashed lookup by key data, if any key cannot export its data fall back to comparing keys one by one.
+        NSMutableSet *mutablePinnedPublicKeyData = [NSMutableSet setWithCapacity:[self.pinnedPublicKeys count]];
+        for (id publicKey in self.pinnedPublicKeys) {
+            NSData *publicKeyData = SHAFSecKeyGetLookupData((__bridge SecKeyRef)publicKey);
+            if (!publicKeyData) {
+                mutablePinnedPublicKeyData = nil;
+                break;
+            }
+            [mutablePinnedPublicKeyData addObject:publicKeyData];
+        }
+        self.pinnedPublicKeyData = mutablePinnedPublicKeyData ? [NSSet setWithSet:mutablePinnedPublicKeyData] : nil;
     } else {
         self.pinnedPublicKeys = nil;
+        self.pinnedPublicKeyData = nil;
     }
 }
 
@@ -287,17 +312,25 @@ static NSArray * SHAFPublicKeyTrustChainForServerTrust(SecTrustRef serverTrust)
             return NO;
         }
         case SHAFSSLPinningModePublicKey: {
-            NSUInteger trustedPublicKeyCount = 0;
+            BOOL isPinned = NO;
             NSArray *publicKeys = SHAFPublicKeyTrustChainForServerTrust(serverTrust);
-
             for (id trustChainPublicKey in publicKeys) {
-                for (id pinnedPublicKey in self.pinnedPublicKeys) {
-                    if (SHAFSecKeyIsEqualToKey((__bridge SecKeyRef)trustChainPublicKey, (__bridge SecKeyRef)pinnedPublicKey)) {
-                        trustedPublicKeyCount += 1;
+                if (self.pinnedPublicKeyData) {
+                    NSData *trustChainPublicKeyData = SHAFSecKeyGetLookupData((__bridge SecKeyRef)trustChainPublicKey);
+                    isPinned = (trustChainPublicKeyData && [self.pinnedPublicKeyData containsObject:trustChainPublicKeyData]);
+                } else {
+                    for (id pinnedPublicKey in self.pinnedPublicKeys) {
+                        if (SHAFSecKeyIsEqualToKey((__bridge SecKeyRef)trustChainPublicKey, (__bridge SecKeyRef)pinnedPublicKey)) {
+                            isPinned = YES;
+                            break;
+                        }
                     }
                 }
+                if (isPinned) {
+                    break;
+                }
             }
-            return trustedPublicKeyCount > 0;
+            return isPinned;
         }
     }
     
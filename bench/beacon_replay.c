@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Replay of iBeacon ranging through SHBeaconFilter, same steps as SHBeaconStatus does for each ranging of a region: smooth accuracy, report enter after smoothing, log band change with rate limit, and out after missing several rangings.
+
+ Without a trace file it replays built-in traces and checks: enter distance is smoothed and not a first raw spike, unknown accuracy still enters, single spikes are rejected, a real move restarts smoothing and logs band change not more often than the interval, and smoothed distance jitters less than raw accuracy.
+ With a trace file it prints the events. Trace is CSV of "seconds,minor,accuracy", one line for each iBeacon in a ranging, rangings in time order and lines of one ranging having same seconds. Accuracy not positive means unknown, same as CLBeacon.
+
+ Usage: beacon_replay [trace.csv [band_interval [exit_misses]]]
+ Exit code is not 0 if a check fails.
+ */
+
+#include "SHBeaconFilter.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BEACONS         64
+#define MAX_EVENTS          256
+
+typedef enum
+{
+    Event_In,
+    Event_Band,
+    Event_Out,
+} EventType;
+
+typedef struct
+{
+    EventType type;
+    double time;
+    int minor;
+    double distance;
+} Event;
+
+typedef struct
+{
+    int minor;
+    double distance; //reported distance, negative when outside, same as SHServeriBeacon.
+    int missCount;
+    SHBeaconFilter filter;
+} Beacon;
+
+typedef struct
+{
+    Beacon beacons[MAX_BEACONS];
+    int beaconCount;
+    double bandInterval;
+    int exitMisses;
+    Event events[MAX_EVENTS];
+    int eventCount;
+    int printEvents;
+} Replay;
+
+typedef struct
+{
+    int minor;
+    double accuracy;
+} Ranged;
+
+static const char *eventNames[] = {"in", "band", "out"};
+
+static void initReplay(Replay *replay, double bandInterval, int exitMisses)
+{
+    memset(replay, 0, sizeof(*replay));
+    replay->bandInterval = bandInterval;
+    replay->exitMisses = exitMisses;
+}
+
+static Beacon *findBeacon(Replay *replay, int minor) //server iBeacon list, added when first seen.
+{
+    for (int i = 0; i < replay->beaconCount; i++)
+    {
+        if (replay->beacons[i].minor == minor)
+        {
+            return &replay->beacons[i];
+        }
+    }
+    if (replay->beaconCount == MAX_BEACONS)
+    {
+        return NULL;
+    }
+    Beacon *beacon = &replay->beacons[replay->beaconCount++];
+    beacon->minor = minor;
+    beacon->distance = -1;
+    return beacon;
+}
+
+static void addEvent(Replay *replay, EventType type, double time, const Beacon *beacon)
+{
+    if (replay->printEvents)
+    {
+        printf("%8.1f %-4s minor %d distance %.2f\n", time, eventNames[type], beacon->minor, beacon->distance);
+    }
+    if (replay->eventCount < MAX_EVENTS)
+    {
+        Event *event = &replay->events[replay->eventCount++];
+        event->type = type;
+        event->time = time;
+        event->minor = beacon->minor;
+        event->distance = beacon->distance;
+    }
+}
+
+static void replayRanging(Replay *replay, double now, const Ranged *ranged, int rangedCount) //same as regionRangeNotificationHandler.
+{
+    for (int r = 0; r < rangedCount; r++)
+    {
+        Beacon *beacon = findBeacon(replay, ranged[r].minor);
+        if (beacon == NULL)
+        {
+            continue;
+        }
+        beacon->missCount = 0;
+        shBeaconFilterAdd(&beacon->filter, ranged[r].accuracy);
+        if (beacon->distance < 0)
+        {
+            double enterDistance = shBeaconFilterEnterDistance(&beacon->filter, now);
+            if (enterDistance > 0)
+            {
+                beacon->distance = enterDistance;
+                addEvent(replay, Event_In, now, beacon);
+            }
+        }
+        else if (beacon->filter.smoothedDistance > 0)
+        {
+            beacon->distance = beacon->filter.smoothedDistance;
+            if (shBeaconFilterCheckBand(&beacon->filter, now, replay->bandInterval))
+            {
+                addEvent(replay, Event_Band, now, beacon);
+            }
+        }
+    }
+    for (int i = 0; i < replay->beaconCount; i++)
+    {
+        Beacon *beacon = &replay->beacons[i];
+        int isRanged = 0;
+        for (int r = 0; r < rangedCount && !isRanged; r++)
+        {
+            isRanged = (ranged[r].minor == beacon->minor);
+        }
+        if (isRanged)
+        {
+            continue;
+        }
+        if (beacon->distance > 0)
+        {
+            beacon->missCount++;
+            if (beacon->missCount >= replay->exitMisses)
+            {
+                beacon->distance = -1;
+                addEvent(replay, Event_Out, now, beacon);
+                beacon->missCount = 0;
+                shBeaconFilterReset(&beacon->filter);
+            }
+        }
+        else if (beacon->filter.rangeCount > 0)
+        {
+            beacon->missCount = 0;
+            shBeaconFilterReset(&beacon->filter);
+        }
+    }
+}
+
+static int replayFile(const char *path, double bandInterval, int exitMisses)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    Replay *replay = malloc(sizeof(Replay));
+    initReplay(replay, bandInterval, exitMisses);
+    replay->printEvents = 1;
+    Ranged ranged[MAX_BEACONS];
+    int rangedCount = 0;
+    double rangingTime = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        double time = 0;
+        int minor = 0;
+        double accuracy = 0;
+        if (sscanf(line, "%lf,%d,%lf", &time, &minor, &accuracy) != 3)
+        {
+            continue; //header or comment
+        }
+        if (rangedCount > 0 && time != rangingTime)
+        {
+            replayRanging(replay, rangingTime, ranged, rangedCount);
+            rangedCount = 0;
+        }
+        rangingTime = time;
+        if (rangedCount < MAX_BEACONS)
+        {
+            ranged[rangedCount].minor = minor;
+            ranged[rangedCount].accuracy = accuracy;
+            rangedCount++;
+        }
+    }
+    if (rangedCount > 0)
+    {
+        replayRanging(replay, rangingTime, ranged, rangedCount);
+    }
+    fclose(file);
+    free(replay);
+    return 0;
+}
+
+static uint32_t randomState = 12345;
+
+static double randomGaussian(void)
+{
+    double sum = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        randomState = randomState * 1103515245 + 12345;
+        sum += (randomState >> 8) / 16777216.0;
+    }
+    return sum - 6;
+}
+
+static double noisyAccuracy(double distance) //ranging accuracy grows with distance and jitters about 30%.
+{
+    return distance * exp(0.3 * randomGaussian());
+}
+
+static int failCount = 0;
+
+static void check(int condition, const char *message)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAIL: %s\n", message);
+        failCount++;
+    }
+}
+
+static void testFirstSpike(void)
+{
+    Replay replay;
+    initReplay(&replay, 0, 3);
+    double accuracies[] = {9.0, 2.1, 1.9, 2.0, 2.2, 1.8};
+    for (int t = 0; t < 6; t++)
+    {
+        Ranged ranged = {1, accuracies[t]};
+        replayRanging(&replay, t, &ranged, 1);
+    }
+    check(replay.eventCount == 1 && replay.events[0].type == Event_In, "first spike: one in event");
+    check(replay.events[0].distance < 3.0, "first spike: enter distance not the raw spike");
+    check(replay.events[0].distance != 2.1, "first spike: enter distance smoothed, not a raw sample");
+}
+
+static void testEnterAfterSmoothing(void)
+{
+    Replay replay;
+    initReplay(&replay, 0, 3);
+    Ranged ranged = {1, 2.0};
+    replayRanging(&replay, 0, &ranged, 1);
+    check(replay.eventCount == 0, "enter: not report single raw ranging");
+    ranged.accuracy = 3.0;
+    replayRanging(&replay, 1, &ranged, 1);
+    check(replay.eventCount == 1 && fabs(replay.events[0].distance - 2.3) < 1e-9, "enter: report after one smoothing step");
+}
+
+static void testUnknownAccuracy(void)
+{
+    Replay replay;
+    initReplay(&replay, 0, 3);
+    Ranged ranged = {1, -1};
+    for (int t = 0; t < 3; t++)
+    {
+        replayRanging(&replay, t, &ranged, 1);
+    }
+    check(replay.eventCount == 1 && replay.events[0].distance == 1, "unknown: enter at 1 metre after 3 rangings");
+}
+
+static void testMissBeforeEnter(void)
+{
+    Replay replay;
+    initReplay(&replay, 0, 3);
+    Ranged ranged = {1, 2.0};
+    replayRanging(&replay, 0, &ranged, 1);
+    replayRanging(&replay, 1, NULL, 0);
+    ranged.accuracy = 4.0;
+    replayRanging(&replay, 2, &ranged, 1);
+    check(replay.eventCount == 0, "miss before enter: smoothing starts again");
+}
+
+static void testStationaryAndMove(void)
+{
+    Replay replay;
+    initReplay(&replay, 10, 3);
+    double rawError = 0;
+    double smoothError = 0;
+    int samples = 0;
+    int rawBandChanges = 0;
+    int previousRawBand = -1;
+    for (int t = 0; t < 120; t++) //stationary at 2 metres with a spike every 15 seconds.
+    {
+        double accuracy = (t % 15 == 7) ? 12.0 : noisyAccuracy(2.0);
+        Ranged ranged = {1, accuracy};
+        replayRanging(&replay, t, &ranged, 1);
+        int rawBand = shBeaconBand(accuracy);
+        rawBandChanges += (previousRawBand >= 0 && rawBand != previousRawBand);
+        previousRawBand = rawBand;
+        if (replay.beacons[0].distance > 0)
+        {
+            rawError += (accuracy - 2.0) * (accuracy - 2.0);
+            smoothError += (replay.beacons[0].distance - 2.0) * (replay.beacons[0].distance - 2.0);
+            samples++;
+        }
+    }
+    int bandEvents = 0;
+    for (int i = 0; i < replay.eventCount; i++)
+    {
+        bandEvents += (replay.events[i].type == Event_Band);
+    }
+    check(bandEvents == 0, "stationary: no band change from jitter and spikes");
+    printf("stationary 2 m: raw rms error %.2f m, %d raw band changes; smoothed rms error %.2f m, %d band logs\n", sqrt(rawError / samples), rawBandChanges, sqrt(smoothError / samples), bandEvents);
+    check(smoothError < rawError / 4, "stationary: smoothed error much less than raw");
+    int eventsBefore = replay.eventCount;
+    double moveTime = 120;
+    for (int t = 120; t < 160; t++) //walk away to 8 metres and stay.
+    {
+        Ranged ranged = {1, noisyAccuracy(8.0)};
+        replayRanging(&replay, t, &ranged, 1);
+    }
+    int bandEvents2 = 0;
+    double lastBandTime = -1;
+    for (int i = eventsBefore; i < replay.eventCount; i++)
+    {
+        if (replay.events[i].type == Event_Band)
+        {
+            check(lastBandTime < 0 || replay.events[i].time - lastBandTime >= 10, "move: band logs rate limited");
+            check(replay.events[i].time - moveTime <= 6, "move: real move accepted after a few outliers");
+            lastBandTime = replay.events[i].time;
+            bandEvents2++;
+        }
+    }
+    check(bandEvents2 == 1, "move: one band log from near to far");
+    for (int t = 160; t < 163; t++) //gone
+    {
+        replayRanging(&replay, t, NULL, 0);
+    }
+    check(replay.eventCount > 0 && replay.events[replay.eventCount - 1].type == Event_Out && replay.events[replay.eventCount - 1].time == 162, "out after 3 misses");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        double bandInterval = (argc > 2) ? atof(argv[2]) : 10;
+        int exitMisses = (argc > 3) ? atoi(argv[3]) : 3;
+        return replayFile(argv[1], bandInterval, (exitMisses >= 1) ? exitMisses : 3);
+    }
+    testFirstSpike();
+    testEnterAfterSmoothing();
+    testUnknownAccuracy();
+    testMissBeforeEnter();
+    testStationaryAndMove();
+    if (failCount > 0)
+    {
+        return 1;
+    }
+    printf("all ranging checks OK\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+#ifndef SH_BENCH_UTIL_H
+#define SH_BENCH_UTIL_H
+
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ Monotonic clock in seconds.
+ */
+static inline double benchNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t benchCurrentBytes = 0;
+static size_t benchPeakBytes = 0;
+static size_t benchBaseBytes = 0;
+
+/**
+ Counting allocator, each block keeps its size ahead of the returned pointer so peak memory can be tracked.
+ */
+static inline void *benchAlloc(size_t size)
+{
+    size_t *block = malloc(sizeof(size_t) * 2 + size); //two words keep returned pointer aligned for double.
+    block[0] = size;
+    benchCurrentBytes += size;
+    if (benchCurrentBytes > benchPeakBytes)
+    {
+        benchPeakBytes = benchCurrentBytes;
+    }
+    return block + 2;
+}
+
+static inline void benchFree(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+    size_t *block = (size_t *)ptr - 2;
+    benchCurrentBytes -= block[0];
+    free(block);
+}
+
+static inline void *benchRealloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return benchAlloc(size);
+    }
+    size_t *block = (size_t *)ptr - 2;
+    size_t oldSize = block[0];
+    block = realloc(block, sizeof(size_t) * 2 + size);
+    block[0] = size;
+    benchCurrentBytes = benchCurrentBytes - oldSize + size;
+    if (benchCurrentBytes > benchPeakBytes)
+    {
+        benchPeakBytes = benchCurrentBytes;
+    }
+    return block + 2;
+}
+
+/**
+ Start measuring peak from memory in use now.
+ */
+static inline void benchResetMemory(void)
+{
+    benchBaseBytes = benchCurrentBytes;
+    benchPeakBytes = benchCurrentBytes;
+}
+
+/**
+ Peak bytes since `benchResetMemory`, excluding memory in use when reset.
+ */
+static inline size_t benchPeakMemory(void)
+{
+    return benchPeakBytes - benchBaseBytes;
+}
+
+#endif
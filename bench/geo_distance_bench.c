@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Distance of SHLocationManager and SHGeofenceIndex, `shDistancesSquared` against haversine.
+
+ Accuracy: pairs at distances from 10 metres to 500 kilometres, in random directions, at latitudes from equator to 80 degrees. Relative error of the square root against haversine on mean Earth radius is checked per distance and latitude band; the equirectangular error grows with distance and latitude, and the constants are WGS84 metres per degree at equator, so a small constant bias against the sphere is expected.
+ Throughput: distances from one location to a batch of targets, which is what SHGeofenceIndex does for fences of a cell, against the scalar call per target that SHLocationManager used before and against haversine per target.
+
+ Usage: geo_distance_bench [targets] [rounds]
+ Exit code is not 0 if error is out of bound.
+ */
+
+#include "SHGeoDistance.h"
+#include "bench_util.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EARTH_RADIUS        6371008.8 //mean radius in metres
+#define DEGREE_TO_RADIAN    (3.14159265358979323846 / 180.0)
+#define PAIRS               2000 //random pairs for each distance and latitude band
+
+static uint32_t randomState = 12345;
+
+static double randomUniform(void) //[0, 1)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) / 16777216.0;
+}
+
+static double haversine(double lat1, double lng1, double lat2, double lng2)
+{
+    double sinLat = sin((lat2 - lat1) * DEGREE_TO_RADIAN / 2);
+    double sinLng = sin((lng2 - lng1) * DEGREE_TO_RADIAN / 2);
+    double a = sinLat * sinLat + cos(lat1 * DEGREE_TO_RADIAN) * cos(lat2 * DEGREE_TO_RADIAN) * sinLng * sinLng;
+    return 2 * EARTH_RADIUS * asin(sqrt(a));
+}
+
+static void destination(double lat, double lng, double bearing, double distance, double *lat2, double *lng2) //great circle destination on sphere.
+{
+    double angle = distance / EARTH_RADIUS;
+    double phi = lat * DEGREE_TO_RADIAN;
+    double phi2 = asin(sin(phi) * cos(angle) + cos(phi) * sin(angle) * cos(bearing));
+    double lambda = atan2(sin(bearing) * sin(angle) * cos(phi), cos(angle) - sin(phi) * sin(phi2));
+    *lat2 = phi2 / DEGREE_TO_RADIAN;
+    *lng2 = lng + lambda / DEGREE_TO_RADIAN;
+}
+
+static double distance(double lat1, double lng1, double lat2, double lng2) //same as SHLocationManager distanceSquaredForLat1, square root.
+{
+    double cosLat2 = shCosLatitude(lat2);
+    double distanceSquared = 0;
+    shDistancesSquared(lat1, lng1, shCosLatitude(lat1), &lat2, &lng2, &cosLat2, 1, &distanceSquared);
+    return sqrt(distanceSquared);
+}
+
+static int checkAccuracy(void)
+{
+    //Bound of relative error: about 0.11% is the bias of WGS84 constants against the sphere. Within 0.2% up to 10 km anywhere and up to 100 km below 60 degrees, within 0.5% up to 500 km below 60 degrees, within 2% otherwise.
+    const double distances[] = {10, 100, 1000, 10000, 100000, 500000};
+    const double latitudes[] = {0, 30, 45, 60, 80};
+    const int distanceCount = sizeof(distances) / sizeof(distances[0]);
+    const int latitudeCount = sizeof(latitudes) / sizeof(latitudes[0]);
+    int ok = 1;
+    printf("max relative error against haversine, %%\n%10s", "lat\\m");
+    for (int d = 0; d < distanceCount; d++)
+    {
+        printf("%10.0f", distances[d]);
+    }
+    printf("\n");
+    for (int l = 0; l < latitudeCount; l++)
+    {
+        printf("%10.0f", latitudes[l]);
+        for (int d = 0; d < distanceCount; d++)
+        {
+            double maxError = 0;
+            for (int p = 0; p < PAIRS; p++)
+            {
+                double lat1 = latitudes[l] + (randomUniform() - 0.5) * 2;
+                double lng1 = randomUniform() * 300 - 150;
+                double lat2 = 0;
+                double lng2 = 0;
+                destination(lat1, lng1, randomUniform() * 6.283185307, distances[d], &lat2, &lng2);
+                double expected = haversine(lat1, lng1, lat2, lng2);
+                double error = fabs(distance(lat1, lng1, lat2, lng2) - expected) / expected;
+                maxError = fmax(maxError, error);
+            }
+            printf("%10.3f", maxError * 100);
+            double bound = 0.02;
+            if (distances[d] <= 10000 || (distances[d] <= 100000 && latitudes[l] <= 60))
+            {
+                bound = 0.002;
+            }
+            else if (latitudes[l] <= 60)
+            {
+                bound = 0.005;
+            }
+            if (maxError > bound)
+            {
+                ok = 0;
+            }
+        }
+        printf("\n");
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL: relative error out of bound\n");
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    long targets = (argc > 1) ? atol(argv[1]) : 10000;
+    long rounds = (argc > 2) ? atol(argv[2]) : 1000;
+    if (targets <= 0 || rounds <= 0)
+    {
+        fprintf(stderr, "usage: geo_distance_bench [targets] [rounds]\n");
+        return 1;
+    }
+    if (!checkAccuracy())
+    {
+        return 1;
+    }
+    size_t count = (size_t)targets;
+    double *lats = malloc(count * sizeof(double));
+    double *lngs = malloc(count * sizeof(double));
+    double *cosLats = malloc(count * sizeof(double));
+    double *results = malloc(count * sizeof(double));
+    for (size_t i = 0; i < count; i++)
+    {
+        lats[i] = -33.87 + (randomUniform() - 0.5) * 0.5;
+        lngs[i] = 151.2 + (randomUniform() - 0.5) * 0.5;
+        cosLats[i] = shCosLatitude(lats[i]);
+    }
+    double lat = -33.87;
+    double lng = 151.2;
+    double sum = 0; //use results so loops are not optimized away.
+
+    double start = benchNow();
+    for (long r = 0; r < rounds; r++)
+    {
+        double queryLat = lat + r * 1e-6;
+        shDistancesSquared(queryLat, lng, shCosLatitude(queryLat), lats, lngs, cosLats, count, results);
+        sum += results[r % count];
+    }
+    double batchTime = benchNow() - start;
+
+    start = benchNow();
+    for (long r = 0; r < rounds; r++)
+    {
+        double queryLat = lat + r * 1e-6;
+        for (size_t i = 0; i < count; i++)
+        {
+            double d = distance(queryLat, lng, lats[i], lngs[i]);
+            results[i] = d * d;
+        }
+        sum += results[r % count];
+    }
+    double scalarTime = benchNow() - start;
+
+    start = benchNow();
+    for (long r = 0; r < rounds; r++)
+    {
+        double queryLat = lat + r * 1e-6;
+        for (size_t i = 0; i < count; i++)
+        {
+            results[i] = haversine(queryLat, lng, lats[i], lngs[i]);
+        }
+        sum += results[r % count];
+    }
+    double haversineTime = benchNow() - start;
+
+    double perTarget = 1e9 / ((double)rounds * count);
+    printf("accuracy OK; %zu targets x %ld rounds (checksum %.0f)\n", count, rounds, sum);
+    printf("batch    : %8.3f ns/target\n", batchTime * perTarget);
+    printf("scalar   : %8.3f ns/target\n", scalarTime * perTarget);
+    printf("haversine: %8.3f ns/target\n", haversineTime * perTarget);
+    free(results);
+    free(cosLats);
+    free(lngs);
+    free(lats);
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Nearest geofence selection of SHGeofenceStatus, SHGeofenceIndex against a plain scan of all fences.
+
+ Fences are clustered like store chains in cities, plus some spread over the world and around longitude 180 so wrapping is covered. Queries are mostly in cities and some anywhere, which uses the scan fallback of the index. Each query asks the nearest 19 as SHGeofenceStatus does (20 regions, one for refresh region), and every result and next distance is checked against the scan.
+
+ Usage: geofence_index_bench [fences] [queries]
+ Exit code is not 0 if index and scan disagree.
+ */
+
+#include "SHGeofenceIndex.h"
+#include "bench_util.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SELECT_COUNT        19
+#define CITY_COUNT          40
+
+static uint32_t randomState = 12345;
+
+static double randomUniform(void) //[0, 1)
+{
+    randomState = randomState * 1103515245 + 12345;
+    uint32_t high = randomState >> 8;
+    randomState = randomState * 1103515245 + 12345;
+    return (high * 65536.0 + (randomState >> 16)) / (16777216.0 * 65536.0);
+}
+
+static double wrapLongitude(double longitude)
+{
+    return (longitude >= 180) ? longitude - 360 : ((longitude < -180) ? longitude + 360 : longitude);
+}
+
+static void scanNearest(const double *latitudes, const double *longitudes, const double *radiuses, size_t count, double latitude, double longitude, double *selected, double *nextDistance) //distances of nearest SELECT_COUNT in `selected`, kept sorted with one more as next.
+{
+    double kept[SELECT_COUNT + 1];
+    size_t keptCount = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double distance = shGeofenceEdgeDistance(latitude, longitude, latitudes[i], longitudes[i], radiuses[i]);
+        if (keptCount == SELECT_COUNT + 1 && distance >= kept[SELECT_COUNT])
+        {
+            continue;
+        }
+        size_t position = (keptCount < SELECT_COUNT + 1) ? keptCount++ : SELECT_COUNT;
+        while (position > 0 && kept[position - 1] > distance)
+        {
+            kept[position] = kept[position - 1];
+            position--;
+        }
+        kept[position] = distance;
+    }
+    size_t resultCount = (keptCount < SELECT_COUNT) ? keptCount : SELECT_COUNT;
+    memcpy(selected, kept, resultCount * sizeof(double));
+    *nextDistance = (keptCount > SELECT_COUNT) ? kept[SELECT_COUNT] : DBL_MAX;
+}
+
+int main(int argc, char *argv[])
+{
+    long fenceCount = (argc > 1) ? atol(argv[1]) : 100000;
+    long queries = (argc > 2) ? atol(argv[2]) : 2000;
+    if (fenceCount <= 0 || queries <= 0)
+    {
+        fprintf(stderr, "usage: geofence_index_bench [fences] [queries]\n");
+        return 1;
+    }
+    size_t count = (size_t)fenceCount;
+    double *latitudes = malloc(count * sizeof(double));
+    double *longitudes = malloc(count * sizeof(double));
+    double *radiuses = malloc(count * sizeof(double));
+    double cityLatitudes[CITY_COUNT];
+    double cityLongitudes[CITY_COUNT];
+    for (int c = 0; c < CITY_COUNT; c++)
+    {
+        cityLatitudes[c] = randomUniform() * 120 - 60;
+        cityLongitudes[c] = (c == 0) ? 179.9 : randomUniform() * 360 - 180; //one city across longitude 180.
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i % 10 == 0) //spread over world
+        {
+            latitudes[i] = randomUniform() * 160 - 80;
+            longitudes[i] = randomUniform() * 360 - 180;
+        }
+        else //city of about 30km
+        {
+            int c = (int)(randomUniform() * CITY_COUNT);
+            latitudes[i] = cityLatitudes[c] + (randomUniform() - 0.5) * 0.3;
+            longitudes[i] = wrapLongitude(cityLongitudes[c] + (randomUniform() - 0.5) * 0.3);
+        }
+        radiuses[i] = 50 + randomUniform() * 450;
+    }
+    double *queryLatitudes = malloc((size_t)queries * sizeof(double));
+    double *queryLongitudes = malloc((size_t)queries * sizeof(double));
+    for (long q = 0; q < queries; q++)
+    {
+        if (q % 10 == 0) //anywhere, mostly far from fences
+        {
+            queryLatitudes[q] = randomUniform() * 160 - 80;
+            queryLongitudes[q] = randomUniform() * 360 - 180;
+        }
+        else
+        {
+            int c = (int)(randomUniform() * CITY_COUNT);
+            queryLatitudes[q] = cityLatitudes[c] + (randomUniform() - 0.5) * 0.4;
+            queryLongitudes[q] = wrapLongitude(cityLongitudes[c] + (randomUniform() - 0.5) * 0.4);
+        }
+    }
+
+    double start = benchNow();
+    SHGeofenceIndex index;
+    if (!shGeofenceIndexInit(&index, latitudes, longitudes, radiuses, count))
+    {
+        fprintf(stderr, "FAIL: out of memory\n");
+        return 1;
+    }
+    double buildTime = benchNow() - start;
+
+    uint32_t results[SELECT_COUNT];
+    double *indexNext = malloc((size_t)queries * sizeof(double));
+    uint32_t *indexResults = malloc((size_t)queries * SELECT_COUNT * sizeof(uint32_t));
+    size_t *indexCounts = malloc((size_t)queries * sizeof(size_t));
+    double indexTime[2] = {0, 0}; //in city, anywhere
+    for (long q = 0; q < queries; q++)
+    {
+        start = benchNow();
+        indexCounts[q] = shGeofenceIndexNearest(&index, SELECT_COUNT, queryLatitudes[q], queryLongitudes[q], results, &indexNext[q]);
+        indexTime[q % 10 == 0] += benchNow() - start;
+        memcpy(indexResults + q * SELECT_COUNT, results, sizeof(results));
+    }
+
+    double selected[SELECT_COUNT];
+    double scanNext = 0;
+    double scanTime[2] = {0, 0};
+    size_t expectedCount = (count < SELECT_COUNT) ? count : SELECT_COUNT;
+    for (long q = 0; q < queries; q++)
+    {
+        start = benchNow();
+        scanNearest(latitudes, longitudes, radiuses, count, queryLatitudes[q], queryLongitudes[q], selected, &scanNext);
+        scanTime[q % 10 == 0] += benchNow() - start;
+        if (indexCounts[q] != expectedCount || indexNext[q] != scanNext)
+        {
+            fprintf(stderr, "FAIL: query %ld (%f, %f) found %zu next %f, scan %zu next %f\n", q, queryLatitudes[q], queryLongitudes[q], indexCounts[q], indexNext[q], expectedCount, scanNext);
+            return 1;
+        }
+        for (size_t i = 0; i < expectedCount; i++)
+        {
+            uint32_t fence = indexResults[q * SELECT_COUNT + i];
+            double distance = shGeofenceEdgeDistance(queryLatitudes[q], queryLongitudes[q], latitudes[fence], longitudes[fence], radiuses[fence]);
+            if (distance != selected[i]) //compare distance, equal distances may come in any order.
+            {
+                fprintf(stderr, "FAIL: query %ld result %zu distance %f, scan %f\n", q, i, distance, selected[i]);
+                return 1;
+            }
+        }
+    }
+
+    printf("%zu fences in %zu cells, %ld queries of nearest %d, results same as scan\n", count, index.occupiedCells, queries, SELECT_COUNT);
+    printf("build: %8.2f ms, %zu KB\n", buildTime * 1e3, count * (sizeof(SHGeofenceCellEntry) + 4 * sizeof(double)) / 1024);
+    long anywhereQueries = (queries + 9) / 10;
+    long cityQueries = queries - anywhereQueries;
+    printf("index: %8.2f us/query in city, %8.2f us/query anywhere\n", cityQueries > 0 ? indexTime[0] / cityQueries * 1e6 : 0, indexTime[1] / anywhereQueries * 1e6);
+    printf("scan : %8.2f us/query in city, %8.2f us/query anywhere\n", cityQueries > 0 ? scanTime[0] / cityQueries * 1e6 : 0, scanTime[1] / anywhereQueries * 1e6);
+    shGeofenceIndexDestroy(&index);
+    free(indexCounts);
+    free(indexResults);
+    free(indexNext);
+    free(queryLongitudes);
+    free(queryLatitudes);
+    free(radiuses);
+    free(longitudes);
+    free(latitudes);
+    return 0;
+}
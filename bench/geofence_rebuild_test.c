@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Geofence list rebuilt while location handlers query the nearest geofences, same threading as SHGeofenceStatus.
+
+ A network thread parses new geofence lists and hands each one over to the main thread, as the `/geofences/tree/` completion dispatches to main queue. The main thread keeps querying as location updates do, and between queries takes the newest list, destroys the old index and builds a new one. Index is never touched by the network thread. Each query result is checked against a scan of the list the index is built from, so a stale or freed index shows as a wrong result; built with ThreadSanitizer when compiler supports it, a data race on the index fails the run.
+
+ Usage: geofence_rebuild_test [rebuilds] [fences]
+ Exit code is not 0 if a check fails.
+ */
+
+#include "SHGeofenceIndex.h"
+
+#include <float.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SELECT_COUNT        19
+
+typedef struct
+{
+    double *latitudes;
+    double *longitudes;
+    double *radiuses;
+    size_t count;
+} FenceList;
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    FenceList *pending; //newest list not taken by main thread yet, as a block in main queue.
+    long posted;
+    long taken;
+    int finished;
+} MainQueue;
+
+typedef struct
+{
+    MainQueue *queue;
+    long rebuilds;
+    size_t fenceCount;
+} NetworkArgs;
+
+static uint32_t nextRandom(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static double randomUniform(uint32_t *state)
+{
+    return nextRandom(state) / 16777216.0;
+}
+
+static FenceList *parseList(size_t count, uint32_t *state) //stands for elements decoded from response.
+{
+    FenceList *list = malloc(sizeof(FenceList));
+    list->latitudes = malloc(count * sizeof(double));
+    list->longitudes = malloc(count * sizeof(double));
+    list->radiuses = malloc(count * sizeof(double));
+    list->count = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        list->latitudes[i] = -33.87 + (randomUniform(state) - 0.5) * 0.2;
+        list->longitudes[i] = 151.2 + (randomUniform(state) - 0.5) * 0.2;
+        list->radiuses[i] = 50 + randomUniform(state) * 450;
+    }
+    return list;
+}
+
+static void freeList(FenceList *list)
+{
+    if (list == NULL)
+    {
+        return;
+    }
+    free(list->latitudes);
+    free(list->longitudes);
+    free(list->radiuses);
+    free(list);
+}
+
+static void *networkThread(void *arg) //completion of each fetch hands the list to main thread.
+{
+    NetworkArgs *args = arg;
+    uint32_t state = 777;
+    for (long r = 0; r < args->rebuilds; r++)
+    {
+        size_t count = args->fenceCount / 2 + nextRandom(&state) % (args->fenceCount / 2 + 1); //list size changes, so a stale index reads out of range.
+        FenceList *list = parseList(count, &state);
+        pthread_mutex_lock(&args->queue->mutex);
+        while (r % 4 != 0 && args->queue->pending != NULL) //mostly wait for main thread to take it, each 4th fetch may supersede a pending list.
+        {
+            pthread_cond_wait(&args->queue->condition, &args->queue->mutex);
+        }
+        freeList(args->queue->pending); //superseded before main thread takes it.
+        args->queue->pending = list;
+        args->queue->posted++;
+        pthread_cond_signal(&args->queue->condition);
+        pthread_mutex_unlock(&args->queue->mutex);
+    }
+    pthread_mutex_lock(&args->queue->mutex);
+    args->queue->finished = 1;
+    pthread_cond_signal(&args->queue->condition);
+    pthread_mutex_unlock(&args->queue->mutex);
+    return NULL;
+}
+
+static int checkQuery(const SHGeofenceIndex *index, const FenceList *list, double latitude, double longitude)
+{
+    uint32_t results[SELECT_COUNT];
+    double nextDistance = 0;
+    size_t count = shGeofenceIndexNearest(index, SELECT_COUNT, latitude, longitude, results, &nextDistance);
+    size_t expected = (list->count < SELECT_COUNT) ? list->count : SELECT_COUNT;
+    if (count != expected)
+    {
+        fprintf(stderr, "FAIL: found %zu of %zu fences\n", count, list->count);
+        return 0;
+    }
+    double farthest = -DBL_MAX;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (results[i] >= list->count)
+        {
+            fprintf(stderr, "FAIL: result %u out of list of %zu\n", results[i], list->count);
+            return 0;
+        }
+        double distance = shGeofenceEdgeDistance(latitude, longitude, list->latitudes[results[i]], list->longitudes[results[i]], list->radiuses[results[i]]);
+        farthest = (distance > farthest) ? distance : farthest;
+    }
+    size_t nearer = 0;
+    for (size_t i = 0; i < list->count; i++) //no fence out of results is nearer than farthest result.
+    {
+        nearer += (shGeofenceEdgeDistance(latitude, longitude, list->latitudes[i], list->longitudes[i], list->radiuses[i]) < farthest);
+    }
+    if (nearer >= count)
+    {
+        fprintf(stderr, "FAIL: %zu fences nearer than farthest of %zu results\n", nearer, count);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    long rebuilds = (argc > 1) ? atol(argv[1]) : 2000;
+    long fenceCount = (argc > 2) ? atol(argv[2]) : 2000;
+    if (rebuilds <= 0 || fenceCount <= 0)
+    {
+        fprintf(stderr, "usage: geofence_rebuild_test [rebuilds] [fences]\n");
+        return 1;
+    }
+    MainQueue queue = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0};
+    NetworkArgs args = {&queue, rebuilds, (size_t)fenceCount};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, networkThread, &args) != 0)
+    {
+        fprintf(stderr, "FAIL: cannot create thread\n");
+        return 1;
+    }
+    SHGeofenceIndex index;
+    memset(&index, 0, sizeof(index)); //zero filled index is empty.
+    FenceList *list = NULL;
+    uint32_t state = 12345;
+    long queries = 0;
+    int ok = 1;
+    while (ok)
+    {
+        pthread_mutex_lock(&queue.mutex);
+        while (list == NULL && queue.pending == NULL && !queue.finished)
+        {
+            pthread_cond_wait(&queue.condition, &queue.mutex); //no list yet, nothing to query.
+        }
+        FenceList *newList = queue.pending;
+        queue.pending = NULL;
+        queue.taken += (newList != NULL);
+        pthread_cond_signal(&queue.condition);
+        int finished = queue.finished;
+        pthread_mutex_unlock(&queue.mutex);
+        if (newList != NULL) //same as setArrayGeofenceFetchList then arrayLeaveGeofences in main thread.
+        {
+            shGeofenceIndexDestroy(&index);
+            freeList(list);
+            list = newList;
+            if (!shGeofenceIndexInit(&index, list->latitudes, list->longitudes, list->radiuses, list->count))
+            {
+                fprintf(stderr, "FAIL: out of memory\n");
+                ok = 0;
+                break;
+            }
+        }
+        else if (finished)
+        {
+            break;
+        }
+        for (int q = 0; q < 8 && ok; q++) //location updates between two completions.
+        {
+            ok = checkQuery(&index, list, -33.87 + (randomUniform(&state) - 0.5) * 0.3, 151.2 + (randomUniform(&state) - 0.5) * 0.3);
+            queries++;
+        }
+    }
+    pthread_join(thread, NULL);
+    shGeofenceIndexDestroy(&index);
+    freeList(list);
+    freeList(queue.pending);
+    if (!ok)
+    {
+        return 1;
+    }
+    printf("%ld lists posted, %ld rebuilt in main thread, %ld queries checked\n", queue.posted, queue.taken, queries);
+    return 0;
+}
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Memory and throughput of decoding a large geofence tree response, with the same lexer as SHJSONStreamParser.
+
+ "tree" is the old way: decode whole body into a tree keeping nulls, copy it without null keys (`SHAFJSONObjectByRemovingKeysWithNullValues`), then build models from it.
+ "stream" is SHJSONStreamParser with streamKey "value": nulls are dropped while decoding, each parent geofence is decoded, turned into a model and released.
+
+ Usage: json_stream_bench [parent_count] [children_per_parent]
+ Exit code is not 0 if two ways build different models.
+ */
+
+#include "SHJSONLexer.h"
+#include "bench_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { NodeNull, NodeBool, NodeNumber, NodeString, NodeArray, NodeObject };
+
+typedef struct Node
+{
+    int type;
+    double number;
+    char *string; //also key for object member
+    size_t count;
+    struct Node **children; //array elements or object values
+    char **keys; //object keys
+} Node;
+
+typedef struct
+{
+    long long id;
+    double latitude;
+    double longitude;
+    double radius;
+    size_t childCount;
+} Geofence; //same fields SHServerGeofence keeps
+
+typedef struct
+{
+    Geofence *items;
+    size_t count;
+    size_t capacity;
+    double checksum;
+} GeofenceList;
+
+static Node *parseValue(SHJSONCursor *cursor, int keepNull);
+
+static char *parseString(SHJSONCursor *cursor)
+{
+    size_t start, end;
+    int hasEscape;
+    if (!shJSONScanString(cursor, &start, &end, &hasEscape))
+    {
+        return NULL;
+    }
+    char *str = benchAlloc(end - start + 1);
+    size_t len = end - start;
+    if (hasEscape)
+    {
+        len = shJSONUnescapeString(cursor, start, end, (uint8_t *)str);
+        if (len == (size_t)-1)
+        {
+            benchFree(str);
+            return NULL;
+        }
+    }
+    else
+    {
+        memcpy(str, cursor->bytes + start, len);
+    }
+    str[len] = '\0';
+    return str;
+}
+
+static Node *newNode(int type)
+{
+    Node *node = benchAlloc(sizeof(Node));
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    return node;
+}
+
+static void freeNode(Node *node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    for (size_t i = 0; i < node->count; i++)
+    {
+        freeNode(node->children[i]);
+        if (node->keys != NULL)
+        {
+            benchFree(node->keys[i]);
+        }
+    }
+    benchFree(node->children);
+    benchFree(node->keys);
+    benchFree(node->string);
+    benchFree(node);
+}
+
+static void appendChild(Node *node, char *key, Node *child, size_t *capacity)
+{
+    if (node->count == *capacity)
+    {
+        size_t newCapacity = *capacity ? *capacity * 2 : 4;
+        node->children = benchRealloc(node->children, newCapacity * sizeof(Node *));
+        if (node->type == NodeObject)
+        {
+            node->keys = benchRealloc(node->keys, newCapacity * sizeof(char *));
+        }
+        *capacity = newCapacity;
+    }
+    node->children[node->count] = child;
+    if (node->type == NodeObject)
+    {
+        node->keys[node->count] = key;
+    }
+    node->count++;
+}
+
+//`keepNull` 1 keeps null members as NSJSONSerialization does, 0 drops them as SHJSONStreamParser does.
+static Node *parseContainer(SHJSONCursor *cursor, int keepNull, int isObject)
+{
+    if (++cursor->depth > SH_JSON_MAX_DEPTH)
+    {
+        cursor->errorReason = "too deep nesting";
+        return NULL;
+    }
+    cursor->pos++;
+    Node *node = newNode(isObject ? NodeObject : NodeArray);
+    size_t capacity = 0;
+    shJSONSkipWhitespace(cursor);
+    if (cursor->pos < cursor->length && cursor->bytes[cursor->pos] == (isObject ? '}' : ']'))
+    {
+        cursor->pos++;
+        cursor->depth--;
+        return node;
+    }
+    while (1)
+    {
+        char *key = NULL;
+        if (isObject)
+        {
+            shJSONSkipWhitespace(cursor);
+            if (cursor->pos >= cursor->length || cursor->bytes[cursor->pos] != '"' || (key = parseString(cursor)) == NULL)
+            {
+                freeNode(node);
+                return NULL;
+            }
+            shJSONSkipWhitespace(cursor);
+            if (cursor->pos >= cursor->length || cursor->bytes[cursor->pos++] != ':')
+            {
+                benchFree(key);
+                freeNode(node);
+                return NULL;
+            }
+        }
+        Node *child = parseValue(cursor, keepNull);
+        if (child == NULL)
+        {
+            benchFree(key);
+            freeNode(node);
+            return NULL;
+        }
+        if (isObject && child->type == NodeNull && !keepNull)
+        {
+            benchFree(key);
+            freeNode(child);
+        }
+        else
+        {
+            appendChild(node, key, child, &capacity);
+        }
+        shJSONSkipWhitespace(cursor);
+        uint8_t ch = (cursor->pos < cursor->length) ? cursor->bytes[cursor->pos++] : 0;
+        if (ch == (isObject ? '}' : ']'))
+        {
+            break;
+        }
+        if (ch != ',')
+        {
+            cursor->errorReason = "expect separator";
+            freeNode(node);
+            return NULL;
+        }
+    }
+    cursor->depth--;
+    return node;
+}
+
+static Node *parseValue(SHJSONCursor *cursor, int keepNull)
+{
+    shJSONSkipWhitespace(cursor);
+    if (cursor->pos >= cursor->length)
+    {
+        cursor->errorReason = "unexpected end of data";
+        return NULL;
+    }
+    uint8_t ch = cursor->bytes[cursor->pos];
+    Node *node = NULL;
+    switch (ch)
+    {
+        case '{':
+            return parseContainer(cursor, keepNull, 1);
+        case '[':
+            return parseContainer(cursor, keepNull, 0);
+        case '"':
+        {
+            char *str = parseString(cursor);
+            if (str == NULL)
+            {
+                return NULL;
+            }
+            node = newNode(NodeString);
+            node->string = str;
+            return node;
+        }
+        case 't':
+        case 'f':
+            if (!shJSONMatchLiteral(cursor, ch == 't' ? "true" : "false", ch == 't' ? 4 : 5))
+            {
+                return NULL;
+            }
+            node = newNode(NodeBool);
+            node->number = (ch == 't');
+            return node;
+        case 'n':
+            return shJSONMatchLiteral(cursor, "null", 4) ? newNode(NodeNull) : NULL;
+        default:
+        {
+            long long integerValue = 0;
+            unsigned long long unsignedValue = 0;
+            double doubleValue = 0;
+            switch (shJSONParseNumber(cursor, &integerValue, &unsignedValue, &doubleValue))
+            {
+                case SHJSONNumberType_Integer:
+                    doubleValue = (double)integerValue;
+                    break;
+                case SHJSONNumberType_Unsigned:
+                    doubleValue = (double)unsignedValue;
+                    break;
+                case SHJSONNumberType_Double:
+                    break;
+                default:
+                    return NULL;
+            }
+            node = newNode(NodeNumber);
+            node->number = doubleValue;
+            return node;
+        }
+    }
+}
+
+static Node *copyWithoutNull(const Node *node) //as SHAFJSONObjectByRemovingKeysWithNullValues, every container is copied.
+{
+    Node *copy = newNode(node->type);
+    copy->number = node->number;
+    if (node->string != NULL)
+    {
+        size_t len = strlen(node->string) + 1;
+        copy->string = benchAlloc(len);
+        memcpy(copy->string, node->string, len);
+    }
+    size_t capacity = 0;
+    for (size_t i = 0; i < node->count; i++)
+    {
+        if (node->type == NodeObject && node->children[i]->type == NodeNull)
+        {
+            continue;
+        }
+        char *key = NULL;
+        if (node->type == NodeObject)
+        {
+            size_t len = strlen(node->keys[i]) + 1;
+            key = benchAlloc(len);
+            memcpy(key, node->keys[i], len);
+        }
+        appendChild(copy, key, copyWithoutNull(node->children[i]), &capacity);
+    }
+    return copy;
+}
+
+static const Node *memberForKey(const Node *node, const char *key)
+{
+    for (size_t i = 0; node->type == NodeObject && i < node->count; i++)
+    {
+        if (strcmp(node->keys[i], key) == 0)
+        {
+            return node->children[i];
+        }
+    }
+    return NULL;
+}
+
+static double numberForKey(const Node *node, const char *key)
+{
+    const Node *member = memberForKey(node, key);
+    if (member == NULL)
+    {
+        return 0;
+    }
+    return (member->type == NodeString) ? atof(member->string) : member->number; //server sends id as string
+}
+
+static void addGeofence(GeofenceList *list, const Node *dict)
+{
+    if (list->count == list->capacity)
+    {
+        size_t newCapacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = benchRealloc(list->items, newCapacity * sizeof(Geofence));
+        list->capacity = newCapacity;
+    }
+    Geofence *geofence = &list->items[list->count++];
+    geofence->id = (long long)numberForKey(dict, "id");
+    geofence->latitude = numberForKey(dict, "latitude");
+    geofence->longitude = numberForKey(dict, "longitude");
+    geofence->radius = numberForKey(dict, "radius");
+    const Node *children = memberForKey(dict, "geofences");
+    geofence->childCount = (children != NULL) ? children->count : 0;
+    list->checksum += geofence->id + geofence->latitude + geofence->longitude + geofence->radius + geofence->childCount;
+}
+
+static int decodeTree(const uint8_t *bytes, size_t length, GeofenceList *list)
+{
+    SHJSONCursor cursor;
+    shJSONCursorInit(&cursor, bytes, length);
+    Node *raw = parseValue(&cursor, 1);
+    if (raw == NULL)
+    {
+        return 0;
+    }
+    Node *clean = copyWithoutNull(raw);
+    const Node *value = memberForKey(clean, "value");
+    for (size_t i = 0; value != NULL && i < value->count; i++)
+    {
+        addGeofence(list, value->children[i]);
+    }
+    freeNode(raw);
+    freeNode(clean);
+    return 1;
+}
+
+static int decodeStream(const uint8_t *bytes, size_t length, GeofenceList *list)
+{
+    SHJSONCursor cursor;
+    shJSONCursorInit(&cursor, bytes, length);
+    shJSONSkipWhitespace(&cursor);
+    if (cursor.pos >= cursor.length || cursor.bytes[cursor.pos] != '{')
+    {
+        return 0;
+    }
+    cursor.pos++;
+    while (1)
+    {
+        shJSONSkipWhitespace(&cursor);
+        if (cursor.pos >= cursor.length || cursor.bytes[cursor.pos] != '"')
+        {
+            return 0;
+        }
+        char *key = parseString(&cursor);
+        shJSONSkipWhitespace(&cursor);
+        if (key == NULL || cursor.pos >= cursor.length || cursor.bytes[cursor.pos++] != ':')
+        {
+            benchFree(key);
+            return 0;
+        }
+        shJSONSkipWhitespace(&cursor);
+        if (strcmp(key, "value") == 0 && cursor.pos < cursor.length && cursor.bytes[cursor.pos] == '[')
+        {
+            cursor.pos++;
+            shJSONSkipWhitespace(&cursor);
+            if (cursor.pos < cursor.length && cursor.bytes[cursor.pos] == ']')
+            {
+                cursor.pos++;
+            }
+            else
+            {
+                while (1)
+                {
+                    Node *element = parseValue(&cursor, 0); //one parent geofence, released after model is built.
+                    if (element == NULL)
+                    {
+                        benchFree(key);
+                        return 0;
+                    }
+                    addGeofence(list, element);
+                    freeNode(element);
+                    shJSONSkipWhitespace(&cursor);
+                    uint8_t ch = (cursor.pos < cursor.length) ? cursor.bytes[cursor.pos++] : 0;
+                    if (ch == ']')
+                    {
+                        break;
+                    }
+                    if (ch != ',')
+                    {
+                        benchFree(key);
+                        return 0;
+                    }
+                }
+            }
+        }
+        else
+        {
+            freeNode(parseValue(&cursor, 0));
+        }
+        benchFree(key);
+        shJSONSkipWhitespace(&cursor);
+        uint8_t ch = (cursor.pos < cursor.length) ? cursor.bytes[cursor.pos++] : 0;
+        if (ch == '}')
+        {
+            return 1;
+        }
+        if (ch != ',')
+        {
+            return 0;
+        }
+    }
+}
+
+static char *buildPayload(size_t parentCount, size_t childCount, size_t *length)
+{
+    size_t capacity = 1024 + parentCount * (childCount + 1) * 256;
+    char *buffer = malloc(capacity);
+    size_t len = (size_t)sprintf(buffer, "{\"app_status\": {\"geofences\": \"2016-01-01 00:00:00\", \"ibeacon\": null}, \"code\": 0, \"value\": [");
+    unsigned int seed = 1;
+    for (size_t i = 0; i < parentCount; i++)
+    {
+        double lat = -45 + (rand_r(&seed) % 90000) / 1000.0;
+        double lng = -180 + (rand_r(&seed) % 360000) / 1000.0;
+        len += (size_t)sprintf(buffer + len, "%s{\"id\": \"%zu\", \"latitude\": %.6f, \"longitude\": %.6f, \"radius\": %d, \"title\": \"Store \\\"%zu\\\" \\u00e9\", \"description\": null, \"geofences\": [", i ? ", " : "", i + 1, lat, lng, 500 + rand_r(&seed) % 5000, i);
+        for (size_t j = 0; j < childCount; j++)
+        {
+            len += (size_t)sprintf(buffer + len, "%s{\"id\": \"%zu\", \"latitude\": %.6f, \"longitude\": %.6f, \"radius\": %d, \"title\": null, \"geofences\": []}", j ? ", " : "", (i + 1) * 1000 + j, lat + j * 0.001, lng - j * 0.001, 50 + rand_r(&seed) % 200);
+        }
+        len += (size_t)sprintf(buffer + len, "]}");
+    }
+    len += (size_t)sprintf(buffer + len, "]}");
+    *length = len;
+    return buffer;
+}
+
+int main(int argc, char **argv)
+{
+    size_t parentCount = (argc > 1) ? (size_t)atol(argv[1]) : 20000;
+    size_t childCount = (argc > 2) ? (size_t)atol(argv[2]) : 5;
+    size_t length = 0;
+    char *payload = buildPayload(parentCount, childCount, &length);
+    printf("payload: %zu parents, %zu children each, %.2f MB\n", parentCount, childCount, length / 1e6);
+
+    GeofenceList treeList = {0};
+    benchResetMemory();
+    double start = benchNow();
+    int treeOK = decodeTree((const uint8_t *)payload, length, &treeList);
+    double treeTime = benchNow() - start;
+    size_t treePeak = benchPeakMemory();
+
+    GeofenceList streamList = {0};
+    benchResetMemory();
+    start = benchNow();
+    int streamOK = decodeStream((const uint8_t *)payload, length, &streamList);
+    double streamTime = benchNow() - start;
+    size_t streamPeak = benchPeakMemory();
+
+    printf("tree:   %8.1f ms  %8.1f MB/s  peak %10zu bytes\n", treeTime * 1e3, length / treeTime / 1e6, treePeak);
+    printf("stream: %8.1f ms  %8.1f MB/s  peak %10zu bytes (%.1fx less)\n", streamTime * 1e3, length / streamTime / 1e6, streamPeak, (double)treePeak / streamPeak);
+    int same = treeOK && streamOK && treeList.count == parentCount && streamList.count == parentCount && treeList.checksum == streamList.checksum;
+    printf("models: %s\n", same ? "same" : "DIFFERENT");
+    benchFree(treeList.items);
+    benchFree(streamList.items);
+    free(payload);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Linux harness replaying location events through the C kernels of geofence, iBeacon and location logging, with a virtual clock, same steps as SHLocationReplay drives SHLocationManager on device.
+
+ - Location fix: select nearest geofences by SHGeofenceIndex when moved half of refresh radius, log enter and exit of selected geofences, buffer the fix for batch logline and flush by SHTrajectory when buffer is full or at the deadline of the oldest fix.
+ - Ranging: smooth each iBeacon by SHBeaconFilter, log in, out after missed rangings and band change.
+ The deadline is a timer firing between events at virtual time, same as `scheduleBatchDeadline`. Result is per hour of simulated movement: CPU of handlers, loglines and state writes. It checks no geofence containing the location is left unselected and no batch waits longer than its window.
+
+ Without a trace file it generates a day of staying, walking and driving around a city with a shop of iBeacons. Trace is CSV of "seconds,location,lat,lng" and "seconds,range,minor,accuracy", in time order, lines of one ranging having same seconds. Geofences are generated around the first location.
+
+ Usage: location_replay [hours [fences [batch_interval [trace.csv]]]]
+ Exit code is not 0 if a check fails.
+ */
+
+#include "SHBeaconFilter.h"
+#include "SHGeoDistance.h"
+#include "SHGeofenceIndex.h"
+#include "SHTrajectory.h"
+#include "bench_util.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SELECT_COUNT            19 //same as SHGeofenceStatus, 20 regions and one for refresh.
+#define REFRESH_MIN_RADIUS      100 //same as GEOFENCE_REFRESH_MIN_RADIUS
+#define REGION_MAX_RADIUS       10000 //typical CLLocationManager maximumRegionMonitoringDistance
+#define BATCH_TOLERANCE         50 //same as GEOLOCATION_BATCH_TOLERANCE
+#define BATCH_MAX_GAP           600 //same as GEOLOCATION_BATCH_MAX_GAP
+#define BATCH_MAX_POINTS        100 //same as GEOLOCATION_BATCH_MAX_POINTS
+#define BEACON_EXIT_MISSES      3
+#define BEACON_BAND_INTERVAL    10
+#define MAX_BEACONS             16
+#define DEGREE_TO_RADIAN        (3.14159265358979323846 / 180.0)
+
+typedef enum
+{
+    Event_Location,
+    Event_Range,
+} EventType;
+
+typedef struct
+{
+    double time; //seconds from trace start
+    EventType type;
+    double first; //latitude, or minor of iBeacon
+    double second; //longitude, or ranging accuracy
+} Event;
+
+typedef struct
+{
+    Event *items;
+    size_t count;
+    size_t capacity;
+} Trace;
+
+typedef struct
+{
+    int minor;
+    double distance; //reported distance, negative when outside.
+    int missCount;
+    SHBeaconFilter filter;
+} Beacon;
+
+typedef struct
+{
+    double now; //virtual clock
+    //geofence
+    const double *fenceLatitudes;
+    const double *fenceLongitudes;
+    const double *fenceRadiuses;
+    size_t fenceCount;
+    SHGeofenceIndex index;
+    unsigned char *inside;
+    uint32_t selected[SELECT_COUNT];
+    size_t selectedCount;
+    double selectLatitude;
+    double selectLongitude;
+    double refreshRadius; //0 means select at next fix, DBL_MAX means all selected.
+    //batch logline
+    double batchInterval;
+    double batchLatitudes[BATCH_MAX_POINTS];
+    double batchLongitudes[BATCH_MAX_POINTS];
+    double batchTimes[BATCH_MAX_POINTS];
+    size_t batchCount;
+    double deadline; //virtual time of batch timer, negative if not scheduled.
+    //iBeacon
+    Beacon beacons[MAX_BEACONS];
+    int beaconCount;
+    //measurement
+    double cpuTime;
+    long geofenceLogs;
+    long batchLogs;
+    long beaconLogs;
+    long writes;
+    double maxFlushDelay;
+    long unselectedInside;
+} Engine;
+
+static uint32_t randomState = 12345;
+
+static double randomUniform(void)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) / 16777216.0;
+}
+
+static double randomGaussian(void)
+{
+    double sum = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        sum += randomUniform();
+    }
+    return sum - 6;
+}
+
+static double threadCPUTime(void) //same as shThreadCPUTime on device.
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double distance(double lat1, double lng1, double lat2, double lng2)
+{
+    double cosLat2 = shCosLatitude(lat2);
+    double distanceSquared = 0;
+    shDistancesSquared(lat1, lng1, shCosLatitude(lat1), &lat2, &lng2, &cosLat2, 1, &distanceSquared);
+    return sqrt(distanceSquared);
+}
+
+static void addEvent(Trace *trace, double time, EventType type, double first, double second)
+{
+    if (trace->count == trace->capacity)
+    {
+        trace->capacity = (trace->capacity == 0) ? 1024 : trace->capacity * 2;
+        trace->items = realloc(trace->items, trace->capacity * sizeof(Event));
+    }
+    Event *event = &trace->items[trace->count++];
+    event->time = time;
+    event->type = type;
+    event->first = first;
+    event->second = second;
+}
+
+//A day around a city: stay, walk, drive in turns, and some stays are in a shop with 3 iBeacons ranged each second.
+static void generateTrace(Trace *trace, double hours)
+{
+    double latitude = -33.87;
+    double longitude = 151.2;
+    double heading = 0;
+    double time = 0;
+    int segment = 0;
+    while (time < hours * 3600)
+    {
+        int mode = segment % 4; //0 stay, 1 walk, 2 drive, 3 stay in shop
+        double duration = (mode == 2) ? 1200 : 600 + randomUniform() * 600;
+        double speed = (mode == 1) ? 1.4 : ((mode == 2) ? 14 : 0);
+        double interval = (mode == 1) ? 5 : ((mode == 2) ? 2 : 60); //distance filter gives few fixes when staying.
+        double end = time + duration;
+        double nextFix = time;
+        for (double t = time; t < end; t += 1)
+        {
+            heading += randomGaussian() * ((mode == 2) ? 0.02 : 0.05);
+            latitude += speed * cos(heading) / 110540.0;
+            longitude += speed * sin(heading) / (111320.0 * cos(latitude * DEGREE_TO_RADIAN));
+            if (fabs(latitude + 33.87) > 0.12 || fabs(longitude - 151.2) > 0.12) //turn back into city
+            {
+                heading = atan2(151.2 - longitude, -33.87 - latitude);
+            }
+            if (t >= nextFix)
+            {
+                addEvent(trace, t, Event_Location, latitude + 10 * randomGaussian() / 110540.0, longitude + 10 * randomGaussian() / 92000.0);
+                nextFix = t + interval;
+            }
+            if (mode == 3)
+            {
+                const double shelfDistances[3] = {1.5, 4, 8};
+                for (int b = 0; b < 3; b++)
+                {
+                    if (randomUniform() < 0.9) //missed in some rangings
+                    {
+                        addEvent(trace, t, Event_Range, b + 1, shelfDistances[b] * exp(0.3 * randomGaussian()));
+                    }
+                }
+            }
+        }
+        time = end;
+        segment++;
+    }
+}
+
+static int loadTrace(Trace *trace, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        double time = 0;
+        char type[16];
+        double first = 0;
+        double second = 0;
+        if (sscanf(line, "%lf,%15[a-z],%lf,%lf", &time, type, &first, &second) != 4)
+        {
+            continue; //header or comment
+        }
+        if (strcmp(type, "location") == 0)
+        {
+            addEvent(trace, time, Event_Location, first, second);
+        }
+        else if (strcmp(type, "range") == 0)
+        {
+            addEvent(trace, time, Event_Range, first, second);
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+static void scheduleDeadline(Engine *engine) //same as scheduleBatchDeadline.
+{
+    engine->deadline = (engine->batchCount > 0) ? engine->batchTimes[0] + engine->batchInterval : -1;
+}
+
+static void flushBatch(Engine *engine) //simplify and send buffer as one logline.
+{
+    unsigned char keep[BATCH_MAX_POINTS];
+    shSimplifyTrajectory(engine->batchLatitudes, engine->batchLongitudes, engine->batchTimes, engine->batchCount, BATCH_TOLERANCE, BATCH_MAX_GAP, keep);
+    double delay = engine->now - engine->batchTimes[0];
+    engine->maxFlushDelay = fmax(engine->maxFlushDelay, delay);
+    engine->batchLogs++;
+    engine->batchCount = 0;
+    scheduleDeadline(engine);
+}
+
+static void bufferLocation(Engine *engine, double latitude, double longitude) //same as bufferGeoLocations and sendBatchLocations.
+{
+    size_t last = engine->batchCount - 1;
+    if (engine->batchCount > 0 && engine->now - engine->batchTimes[last] < BATCH_MAX_GAP
+        && distance(engine->batchLatitudes[last], engine->batchLongitudes[last], latitude, longitude) < BATCH_TOLERANCE)
+    {
+        return; //staying still
+    }
+    engine->batchLatitudes[engine->batchCount] = latitude;
+    engine->batchLongitudes[engine->batchCount] = longitude;
+    engine->batchTimes[engine->batchCount] = engine->now;
+    engine->batchCount++;
+    if (engine->batchCount >= BATCH_MAX_POINTS || engine->now - engine->batchTimes[0] >= engine->batchInterval)
+    {
+        flushBatch(engine);
+    }
+    else
+    {
+        scheduleDeadline(engine);
+    }
+}
+
+static void selectGeofences(Engine *engine, double latitude, double longitude) //same as selectNearestGeofences.
+{
+    double nextDistance = DBL_MAX;
+    size_t count = shGeofenceIndexNearest(&engine->index, SELECT_COUNT, latitude, longitude, engine->selected, &nextDistance);
+    if (count == (size_t)-1)
+    {
+        count = 0;
+        nextDistance = 0; //out of memory, select again at next fix.
+    }
+    engine->selectedCount = count;
+    engine->selectLatitude = latitude;
+    engine->selectLongitude = longitude;
+    if (nextDistance == DBL_MAX)
+    {
+        engine->refreshRadius = DBL_MAX;
+    }
+    else if (nextDistance >= REFRESH_MIN_RADIUS)
+    {
+        engine->refreshRadius = fmin(nextDistance, REGION_MAX_RADIUS);
+    }
+    else
+    {
+        engine->refreshRadius = fmax(0, nextDistance);
+    }
+}
+
+static void replayLocation(Engine *engine, double latitude, double longitude)
+{
+    if (engine->refreshRadius == 0 || (engine->refreshRadius != DBL_MAX && distance(latitude, longitude, engine->selectLatitude, engine->selectLongitude) >= engine->refreshRadius / 2))
+    {
+        selectGeofences(engine, latitude, longitude);
+    }
+    for (size_t i = 0; i < engine->selectedCount; i++) //region state of monitored geofences.
+    {
+        uint32_t fence = engine->selected[i];
+        unsigned char inside = (shGeofenceEdgeDistance(latitude, longitude, engine->fenceLatitudes[fence], engine->fenceLongitudes[fence], engine->fenceRadiuses[fence]) < 0);
+        if (inside != engine->inside[fence])
+        {
+            engine->inside[fence] = inside;
+            engine->geofenceLogs++;
+            engine->writes++; //geofence status is persisted.
+        }
+    }
+    if (engine->batchInterval > 0)
+    {
+        bufferLocation(engine, latitude, longitude);
+    }
+}
+
+static Beacon *findBeacon(Engine *engine, int minor)
+{
+    for (int i = 0; i < engine->beaconCount; i++)
+    {
+        if (engine->beacons[i].minor == minor)
+        {
+            return &engine->beacons[i];
+        }
+    }
+    if (engine->beaconCount == MAX_BEACONS)
+    {
+        return NULL;
+    }
+    Beacon *beacon = &engine->beacons[engine->beaconCount++];
+    memset(beacon, 0, sizeof(*beacon));
+    beacon->minor = minor;
+    beacon->distance = -1;
+    return beacon;
+}
+
+static void replayRanging(Engine *engine, const Event *events, size_t count) //same as regionRangeNotificationHandler, events are one ranging.
+{
+    for (size_t r = 0; r < count; r++)
+    {
+        Beacon *beacon = findBeacon(engine, (int)events[r].first);
+        if (beacon == NULL)
+        {
+            continue;
+        }
+        beacon->missCount = 0;
+        shBeaconFilterAdd(&beacon->filter, events[r].second);
+        if (beacon->distance < 0)
+        {
+            double enterDistance = shBeaconFilterEnterDistance(&beacon->filter, engine->now);
+            if (enterDistance > 0)
+            {
+                beacon->distance = enterDistance;
+                engine->beaconLogs++;
+            }
+        }
+        else if (beacon->filter.smoothedDistance > 0)
+        {
+            beacon->distance = beacon->filter.smoothedDistance;
+            engine->beaconLogs += shBeaconFilterCheckBand(&beacon->filter, engine->now, BEACON_BAND_INTERVAL);
+        }
+    }
+    for (int i = 0; i < engine->beaconCount; i++)
+    {
+        Beacon *beacon = &engine->beacons[i];
+        int isRanged = 0;
+        for (size_t r = 0; r < count && !isRanged; r++)
+        {
+            isRanged = ((int)events[r].first == beacon->minor);
+        }
+        if (isRanged)
+        {
+            continue;
+        }
+        if (beacon->distance > 0 && ++beacon->missCount >= BEACON_EXIT_MISSES)
+        {
+            beacon->distance = -1;
+            beacon->missCount = 0;
+            shBeaconFilterReset(&beacon->filter);
+            engine->beaconLogs++;
+        }
+        else if (beacon->distance < 0 && beacon->filter.rangeCount > 0)
+        {
+            shBeaconFilterReset(&beacon->filter);
+        }
+    }
+}
+
+static void checkSelected(Engine *engine, double latitude, double longitude) //every geofence containing location must be selected, not timed.
+{
+    for (size_t fence = 0; fence < engine->fenceCount; fence++)
+    {
+        if (shGeofenceEdgeDistance(latitude, longitude, engine->fenceLatitudes[fence], engine->fenceLongitudes[fence], engine->fenceRadiuses[fence]) >= 0)
+        {
+            continue;
+        }
+        int isSelected = 0;
+        for (size_t i = 0; i < engine->selectedCount && !isSelected; i++)
+        {
+            isSelected = (engine->selected[i] == fence);
+        }
+        engine->unselectedInside += !isSelected;
+    }
+}
+
+static void fireTimers(Engine *engine, double time) //timers due before next event fire at their virtual time.
+{
+    if (engine->deadline >= 0 && engine->deadline <= time)
+    {
+        engine->now = engine->deadline;
+        double start = threadCPUTime();
+        flushBatch(engine);
+        engine->cpuTime += threadCPUTime() - start;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double hours = (argc > 1) ? atof(argv[1]) : 24;
+    long fenceCount = (argc > 2) ? atol(argv[2]) : 5000;
+    double batchInterval = (argc > 3) ? atof(argv[3]) : 300;
+    if (hours <= 0 || fenceCount <= 0 || batchInterval < 0)
+    {
+        fprintf(stderr, "usage: location_replay [hours [fences [batch_interval [trace.csv]]]]\n");
+        return 1;
+    }
+    Trace trace = {NULL, 0, 0};
+    if (argc > 4)
+    {
+        if (!loadTrace(&trace, argv[4]))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        generateTrace(&trace, hours);
+    }
+    double centerLatitude = -33.87;
+    double centerLongitude = 151.2;
+    for (size_t i = 0; i < trace.count; i++)
+    {
+        if (trace.items[i].type == Event_Location)
+        {
+            centerLatitude = trace.items[i].first;
+            centerLongitude = trace.items[i].second;
+            break;
+        }
+    }
+    size_t count = (size_t)fenceCount;
+    double *latitudes = malloc(count * sizeof(double));
+    double *longitudes = malloc(count * sizeof(double));
+    double *radiuses = malloc(count * sizeof(double));
+    for (size_t i = 0; i < count; i++) //stores over 30 km of city
+    {
+        latitudes[i] = centerLatitude + (randomUniform() - 0.5) * 0.3;
+        longitudes[i] = centerLongitude + (randomUniform() - 0.5) * 0.3;
+        radiuses[i] = 50 + randomUniform() * 250;
+    }
+
+    Engine *engine = calloc(1, sizeof(Engine));
+    engine->fenceLatitudes = latitudes;
+    engine->fenceLongitudes = longitudes;
+    engine->fenceRadiuses = radiuses;
+    engine->fenceCount = count;
+    engine->inside = calloc(count, 1);
+    engine->batchInterval = batchInterval;
+    engine->deadline = -1;
+    if (!shGeofenceIndexInit(&engine->index, latitudes, longitudes, radiuses, count))
+    {
+        fprintf(stderr, "FAIL: out of memory\n");
+        return 1;
+    }
+
+    size_t i = 0;
+    while (i < trace.count)
+    {
+        const Event *event = &trace.items[i];
+        fireTimers(engine, event->time);
+        engine->now = event->time;
+        size_t next = i + 1;
+        double start = threadCPUTime();
+        if (event->type == Event_Location)
+        {
+            replayLocation(engine, event->first, event->second);
+        }
+        else
+        {
+            while (next < trace.count && trace.items[next].type == Event_Range && trace.items[next].time == event->time)
+            {
+                next++;
+            }
+            replayRanging(engine, event, next - i);
+        }
+        engine->cpuTime += threadCPUTime() - start;
+        if (event->type == Event_Location)
+        {
+            checkSelected(engine, event->first, event->second);
+        }
+        i = next;
+    }
+    double duration = (trace.count > 0) ? trace.items[trace.count - 1].time - trace.items[0].time : 0;
+    fireTimers(engine, DBL_MAX); //buffer left flushes at its deadline after trace ends.
+
+    double perHour = (duration > 0) ? 3600 / duration : 0;
+    long logs = engine->geofenceLogs + engine->batchLogs + engine->beaconLogs;
+    printf("%.1f hours, %zu events, %zu geofences, batch window %.0f s\n", duration / 3600, trace.count, count, batchInterval);
+    printf("per hour: cpu %.3f ms, loglines %.1f (geofence %.1f, batch %.1f, iBeacon %.1f), writes %.1f\n", engine->cpuTime * 1e3 * perHour, logs * perHour, engine->geofenceLogs * perHour, engine->batchLogs * perHour, engine->beaconLogs * perHour, engine->writes * perHour);
+    printf("longest batch wait %.1f s\n", engine->maxFlushDelay);
+    int ok = 1;
+    if (engine->unselectedInside > 0)
+    {
+        fprintf(stderr, "FAIL: location inside %ld unselected geofences\n", engine->unselectedInside);
+        ok = 0;
+    }
+    if (batchInterval > 0 && engine->maxFlushDelay > batchInterval)
+    {
+        fprintf(stderr, "FAIL: batch waits %.1f s, longer than window\n", engine->maxFlushDelay);
+        ok = 0;
+    }
+    shGeofenceIndexDestroy(&engine->index);
+    free(engine->inside);
+    free(engine);
+    free(radiuses);
+    free(longitudes);
+    free(latitudes);
+    free(trace.items);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Replay of SHRequestOutbox retry timing with a fake clock, same steps as the outbox: send due entries on enqueue and when timer fires, back off after retryable failure, and move the one timer to the earliest deadline each time entries change.
+
+ First a fixed case: a fresh entry fails behind an entry in long backoff, and timer must move from the long backoff to the fresh entry's short retry. Then random entries are enqueued and fail or succeed, and every entry must be sent not later than its deadline plus the minimum timer delay.
+
+ Usage: outbox_replay [entries [seconds]]
+ Exit code is not 0 if a check fails.
+ */
+
+#include "SHOutboxSchedule.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BASE_DELAY          30 //same as OUTBOX_BASE_DELAY
+#define MAX_DELAY           (6 * 60 * 60) //same as OUTBOX_MAX_DELAY
+#define MAX_ATTEMPTS        10 //same as OUTBOX_MAX_ATTEMPTS
+#define MIN_TIMER_DELAY     1 //same as OUTBOX_MIN_TIMER_DELAY
+
+typedef struct
+{
+    double *nextTimes;
+    unsigned char *isSending;
+    double *doneTimes; //when sending finishes, HUGE_VAL if not sending.
+    long *attempts;
+    size_t count;
+    SHOutboxTimer timer;
+    double worstLate; //longest an entry waited after its deadline.
+    long sent;
+} Outbox;
+
+static uint32_t randomState = 4242;
+
+static double randomUniform(void)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) / 16777216.0;
+}
+
+static void scheduleNextFlush(Outbox *outbox, double now)
+{
+    shOutboxTimerSchedule(&outbox->timer, shOutboxNextDeadline(outbox->nextTimes, outbox->isSending, outbox->count), now, MIN_TIMER_DELAY);
+}
+
+static void removeEntry(Outbox *outbox, size_t i)
+{
+    outbox->count--;
+    outbox->nextTimes[i] = outbox->nextTimes[outbox->count];
+    outbox->isSending[i] = outbox->isSending[outbox->count];
+    outbox->doneTimes[i] = outbox->doneTimes[outbox->count];
+    outbox->attempts[i] = outbox->attempts[outbox->count];
+}
+
+static void flush(Outbox *outbox, double now) //same as flushInQueue, sending takes up to 10 seconds.
+{
+    for (size_t i = 0; i < outbox->count; i++)
+    {
+        if (!outbox->isSending[i] && outbox->nextTimes[i] <= now)
+        {
+            double late = now - outbox->nextTimes[i];
+            outbox->worstLate = (late > outbox->worstLate) ? late : outbox->worstLate;
+            outbox->isSending[i] = 1;
+            outbox->doneTimes[i] = now + randomUniform() * 10;
+            outbox->sent++;
+        }
+    }
+    scheduleNextFlush(outbox, now);
+}
+
+static void finish(Outbox *outbox, size_t i, double now, int isSuccess) //same as finishEntryForKey, retryable failure.
+{
+    outbox->isSending[i] = 0;
+    outbox->doneTimes[i] = HUGE_VAL;
+    outbox->attempts[i]++;
+    if (isSuccess || outbox->attempts[i] >= MAX_ATTEMPTS)
+    {
+        removeEntry(outbox, i);
+    }
+    else
+    {
+        outbox->nextTimes[i] = now + shOutboxRetryDelay(outbox->attempts[i], BASE_DELAY, MAX_DELAY);
+    }
+    scheduleNextFlush(outbox, now);
+}
+
+static size_t enqueue(Outbox *outbox, double now)
+{
+    size_t i = outbox->count++;
+    outbox->nextTimes[i] = now; //due now, enqueue time is the deadline.
+    outbox->isSending[i] = 0;
+    outbox->doneTimes[i] = HUGE_VAL;
+    outbox->attempts[i] = 0;
+    flush(outbox, now);
+    return i;
+}
+
+static int checkDelays(void)
+{
+    double expected[] = {0, 30, 60, 120, 240, 480, 960, 1920, 3840, 7680, 15360, MAX_DELAY, MAX_DELAY};
+    for (long attempts = 0; attempts < 13; attempts++)
+    {
+        if (shOutboxRetryDelay(attempts, BASE_DELAY, MAX_DELAY) != expected[attempts])
+        {
+            fprintf(stderr, "FAIL: retry delay after %ld failures is %.0f, expect %.0f\n", attempts, shOutboxRetryDelay(attempts, BASE_DELAY, MAX_DELAY), expected[attempts]);
+            return 0;
+        }
+    }
+    if (shOutboxRetryDelay(100000, BASE_DELAY, MAX_DELAY) != MAX_DELAY)
+    {
+        fprintf(stderr, "FAIL: many failures must wait max delay\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int checkFreshBehindLongBackoff(void)
+{
+    double nextTimes[2];
+    unsigned char isSending[2];
+    double doneTimes[2];
+    long attempts[2];
+    Outbox outbox = {nextTimes, isSending, doneTimes, attempts, 0, {HUGE_VAL}, 0, 0};
+    double now = 1000;
+    enqueue(&outbox, now); //entry 0 keeps failing until it waits max delay.
+    finish(&outbox, 0, now, 0);
+    outbox.attempts[0] = MAX_ATTEMPTS - 1;
+    outbox.nextTimes[0] = now + MAX_DELAY;
+    scheduleNextFlush(&outbox, now);
+    if (outbox.timer.fireTime != now + MAX_DELAY)
+    {
+        fprintf(stderr, "FAIL: timer at %.0f, expect long backoff %.0f\n", outbox.timer.fireTime, now + MAX_DELAY);
+        return 0;
+    }
+    now += 5;
+    size_t fresh = enqueue(&outbox, now); //sent at once, timer stays for entry 0.
+    if (!outbox.isSending[fresh] || outbox.timer.fireTime != 1000 + MAX_DELAY)
+    {
+        fprintf(stderr, "FAIL: fresh entry not sent at once, or timer moved while sending\n");
+        return 0;
+    }
+    now += 2;
+    finish(&outbox, fresh, now, 0);
+    if (outbox.timer.fireTime != now + BASE_DELAY)
+    {
+        fprintf(stderr, "FAIL: fresh entry retries at %.0f behind long backoff, expect %.0f\n", outbox.timer.fireTime, now + BASE_DELAY);
+        return 0;
+    }
+    now = outbox.timer.fireTime; //timer fires, fresh entry sent and succeeds, timer goes back to long backoff.
+    shOutboxTimerFired(&outbox.timer);
+    flush(&outbox, now);
+    finish(&outbox, fresh, now + 1, 1);
+    if (outbox.count != 1 || outbox.timer.fireTime != 1000 + MAX_DELAY)
+    {
+        fprintf(stderr, "FAIL: after fresh entry sent, timer at %.0f, expect %.0f\n", outbox.timer.fireTime, 1000.0 + MAX_DELAY);
+        return 0;
+    }
+    outbox.count = 0;
+    if (!shOutboxTimerSchedule(&outbox.timer, shOutboxNextDeadline(nextTimes, isSending, 0), now, MIN_TIMER_DELAY) || outbox.timer.fireTime != HUGE_VAL)
+    {
+        fprintf(stderr, "FAIL: empty outbox must cancel timer\n");
+        return 0;
+    }
+    if (!shOutboxTimerSchedule(&outbox.timer, now - 50, now, MIN_TIMER_DELAY) || outbox.timer.fireTime != now + MIN_TIMER_DELAY)
+    {
+        fprintf(stderr, "FAIL: overdue entry must fire after min delay\n");
+        return 0;
+    }
+    if (shOutboxTimerSchedule(&outbox.timer, now + MIN_TIMER_DELAY, now, MIN_TIMER_DELAY))
+    {
+        fprintf(stderr, "FAIL: same fire time must not re-arm\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    long entries = (argc > 1) ? atol(argv[1]) : 2000;
+    double duration = (argc > 2) ? atof(argv[2]) : 3 * 24 * 60 * 60;
+    if (entries <= 0 || duration <= 0)
+    {
+        fprintf(stderr, "usage: outbox_replay [entries [seconds]]\n");
+        return 1;
+    }
+    if (!checkDelays() || !checkFreshBehindLongBackoff())
+    {
+        return 1;
+    }
+    Outbox outbox = {malloc(entries * sizeof(double)), malloc(entries), malloc(entries * sizeof(double)), malloc(entries * sizeof(long)), 0, {HUGE_VAL}, 0, 0};
+    double now = 0;
+    double nextEnqueue = 0;
+    long enqueued = 0;
+    long timerFires = 0;
+    while (now < duration || outbox.count > 0)
+    {
+        size_t done = outbox.count;
+        double doneTime = HUGE_VAL;
+        for (size_t i = 0; i < outbox.count; i++)
+        {
+            if (outbox.doneTimes[i] < doneTime)
+            {
+                doneTime = outbox.doneTimes[i];
+                done = i;
+            }
+        }
+        double enqueueTime = (enqueued < entries && nextEnqueue < duration) ? nextEnqueue : HUGE_VAL;
+        if (enqueueTime == HUGE_VAL && doneTime == HUGE_VAL && outbox.timer.fireTime == HUGE_VAL)
+        {
+            break;
+        }
+        if (enqueueTime <= doneTime && enqueueTime <= outbox.timer.fireTime)
+        {
+            now = enqueueTime;
+            enqueue(&outbox, now);
+            enqueued++;
+            nextEnqueue = now + randomUniform() * 2 * duration / entries;
+        }
+        else if (doneTime <= outbox.timer.fireTime)
+        {
+            now = doneTime;
+            finish(&outbox, done, now, randomUniform() < 0.3); //mostly offline, so entries reach long backoff.
+        }
+        else
+        {
+            now = outbox.timer.fireTime;
+            shOutboxTimerFired(&outbox.timer);
+            timerFires++;
+            flush(&outbox, now);
+        }
+    }
+    int ok = (outbox.worstLate <= MIN_TIMER_DELAY + 1e-6);
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL: entry sent %.0f seconds after its deadline\n", outbox.worstLate);
+    }
+    else
+    {
+        printf("checks OK: %ld entries, %ld sends, %ld timer fires, worst %.2f s after deadline\n", enqueued, outbox.sent, timerFires, outbox.worstLate);
+    }
+    free(outbox.attempts);
+    free(outbox.doneTimes);
+    free(outbox.isSending);
+    free(outbox.nextTimes);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Page transition of shNotifyPageEnter/shNotifyPageExit, replayed on SHPageTransition the same way SHApp calls SHPageTracker.
+
+ First a scripted navigation checks recovery rules across relaunch: App killed in foreground exits previous page first, App killed in background (even twice) sends no duplicated exit, and exit already sent is not sent again.
+ Then a random navigation measures time spent by caller per transition for two ways of persisting history:
+ "sync" is the old way: every changed key written and synced to disk before returning, as NSUserDefaults synchronize on main thread.
+ "async" changes memory only and hands a snapshot to a writer thread, which writes and syncs the latest one, as SHStateStore flush.
+ Relaunch in the script happens after pending write lands, a kill inside the write window loses the last change in both ways.
+
+ Usage: page_transition_bench [transitions] [history_file]
+ Exit code is not 0 if a recovery rule fails.
+ */
+
+#include "SHPageTransition.h"
+#include "bench_util.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAGE_COUNT          20
+#define MAX_PAGE_NAME       64
+#define MAX_LOGS            16
+
+typedef enum
+{
+    Persist_Sync,
+    Persist_Async,
+} PersistMode;
+
+typedef struct
+{
+    char enterPage[MAX_PAGE_NAME];
+    char enterBackupPage[MAX_PAGE_NAME];
+    char exitPage[MAX_PAGE_NAME];
+} Snapshot;
+
+typedef struct
+{
+    const char *path;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Snapshot pending;
+    unsigned long pendingGeneration;
+    unsigned long writtenGeneration;
+    int stop;
+} Writer;
+
+typedef struct
+{
+    SHPageHistory history;
+    PersistMode mode;
+    const char *path;
+    Writer writer; //only for Persist_Async.
+    char logs[MAX_LOGS][MAX_PAGE_NAME + 2]; //"E page" for 8108, "X page" for 8109.
+    int logCount;
+} App;
+
+static void takeSnapshot(const SHPageHistory *history, Snapshot *snapshot)
+{
+    snprintf(snapshot->enterPage, MAX_PAGE_NAME, "%s", history->enterPage);
+    snprintf(snapshot->enterBackupPage, MAX_PAGE_NAME, "%s", history->enterBackupPage);
+    snprintf(snapshot->exitPage, MAX_PAGE_NAME, "%s", history->exitPage);
+}
+
+static void writeSnapshot(const char *path, const Snapshot *snapshot)
+{
+    char buffer[MAX_PAGE_NAME * 3 + 4];
+    int length = snprintf(buffer, sizeof(buffer), "%s\n%s\n%s\n", snapshot->enterPage, snapshot->enterBackupPage, snapshot->exitPage);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, buffer, (size_t)length) != length || fsync(fd) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
+
+static void readSnapshot(const char *path, Snapshot *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return; //fresh install
+    }
+    char *fields[3] = {snapshot->enterPage, snapshot->enterBackupPage, snapshot->exitPage};
+    for (int i = 0; i < 3 && fgets(fields[i], MAX_PAGE_NAME, file) != NULL; i++)
+    {
+        fields[i][strcspn(fields[i], "\n")] = '\0';
+    }
+    fclose(file);
+}
+
+static void *writerMain(void *arg)
+{
+    Writer *writer = arg;
+    pthread_mutex_lock(&writer->lock);
+    while (1)
+    {
+        while (!writer->stop && writer->writtenGeneration == writer->pendingGeneration)
+        {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (writer->writtenGeneration == writer->pendingGeneration)
+        {
+            break; //stopped and nothing pending
+        }
+        Snapshot snapshot = writer->pending; //changes arriving while writing coalesce into next write.
+        unsigned long generation = writer->pendingGeneration;
+        pthread_mutex_unlock(&writer->lock);
+        writeSnapshot(writer->path, &snapshot);
+        pthread_mutex_lock(&writer->lock);
+        writer->writtenGeneration = generation;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+static void persist(App *app, int changes)
+{
+    if (changes == SHPageHistoryChange_None)
+    {
+        return;
+    }
+    if (app->mode == Persist_Sync)
+    {
+        Snapshot snapshot;
+        takeSnapshot(&app->history, &snapshot);
+        for (int bit = SHPageHistoryChange_Enter; bit <= SHPageHistoryChange_Exit; bit <<= 1)
+        {
+            if (changes & bit)
+            {
+                writeSnapshot(app->path, &snapshot); //one synchronize per changed key, as old code.
+            }
+        }
+        return;
+    }
+    Writer *writer = &app->writer;
+    pthread_mutex_lock(&writer->lock);
+    takeSnapshot(&app->history, &writer->pending);
+    writer->pendingGeneration++;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+}
+
+static void drain(App *app) //wait pending write lands, as if flush finished before App is killed.
+{
+    if (app->mode != Persist_Async)
+    {
+        return;
+    }
+    Writer *writer = &app->writer;
+    pthread_mutex_lock(&writer->lock);
+    while (writer->writtenGeneration != writer->pendingGeneration)
+    {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+static void launch(App *app, PersistMode mode, const char *path)
+{
+    memset(app, 0, sizeof(*app));
+    app->mode = mode;
+    app->path = path;
+    Snapshot saved;
+    readSnapshot(path, &saved);
+    if (!shPageHistoryInit(&app->history, saved.enterPage, saved.enterBackupPage, saved.exitPage))
+    {
+        fprintf(stderr, "FAIL: out of memory\n");
+        exit(1);
+    }
+    if (mode == Persist_Async)
+    {
+        app->writer.path = path;
+        pthread_mutex_init(&app->writer.lock, NULL);
+        pthread_cond_init(&app->writer.changed, NULL);
+        pthread_create(&app->writer.thread, NULL, writerMain, &app->writer);
+    }
+}
+
+static void killApp(App *app)
+{
+    drain(app);
+    if (app->mode == Persist_Async)
+    {
+        pthread_mutex_lock(&app->writer.lock);
+        app->writer.stop = 1;
+        pthread_cond_broadcast(&app->writer.changed);
+        pthread_mutex_unlock(&app->writer.lock);
+        pthread_join(app->writer.thread, NULL);
+        pthread_mutex_destroy(&app->writer.lock);
+        pthread_cond_destroy(&app->writer.changed);
+    }
+    shPageHistoryDestroy(&app->history);
+}
+
+static void sendLog(App *app, char code, const char *page)
+{
+    if (app->logCount < MAX_LOGS)
+    {
+        snprintf(app->logs[app->logCount++], MAX_PAGE_NAME + 2, "%c %s", code, page);
+    }
+}
+
+static void notifyPageExit(App *app, const char *page, int needClear) //same as shNotifyPageExit:clearEnterHistory:logCompleteView:
+{
+    char current[MAX_PAGE_NAME];
+    if (page == NULL || page[0] == '\0')
+    {
+        snprintf(current, sizeof(current), "%s", app->history.enterPage); //App go BG
+        page = current;
+    }
+    if (page[0] != '\0')
+    {
+        if (shPageIsExitSent(&app->history, page))
+        {
+            return; //ignore duplicated exit log
+        }
+        sendLog(app, 'X', page);
+        persist(app, shPageExit(&app->history, page, needClear));
+    }
+}
+
+static void notifyPageEnter(App *app, const char *page, int doEnter, int doExit) //same as shNotifyPageEnter:sendEnter:sendExit:
+{
+    char current[MAX_PAGE_NAME];
+    if (page == NULL || page[0] == '\0')
+    {
+        snprintf(current, sizeof(current), "%s", app->history.enterPage); //App go FG
+        page = current;
+    }
+    if (doExit)
+    {
+        const char *previousEnterPage = shPageToExitBeforeEnter(&app->history, page);
+        if (previousEnterPage != NULL)
+        {
+            char previous[MAX_PAGE_NAME];
+            snprintf(previous, sizeof(previous), "%s", previousEnterPage); //history changes during exit.
+            notifyPageExit(app, previous, 1);
+        }
+    }
+    if (page[0] != '\0')
+    {
+        if (doEnter)
+        {
+            sendLog(app, 'E', page);
+        }
+        persist(app, shPageEnter(&app->history, page, doEnter));
+    }
+}
+
+static void willAppear(App *app, const char *page)
+{
+    persist(app, shPageWillAppear(&app->history, page));
+}
+
+static int expectLogs(App *app, const char *step, const char *expected[], int count)
+{
+    int ok = (app->logCount == count);
+    for (int i = 0; ok && i < count; i++)
+    {
+        ok = (strcmp(app->logs[i], expected[i]) == 0);
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL: %s, logs:", step);
+        for (int i = 0; i < app->logCount; i++)
+        {
+            fprintf(stderr, " [%s]", app->logs[i]);
+        }
+        fprintf(stderr, "\n");
+    }
+    app->logCount = 0;
+    return ok;
+}
+
+static int runScript(PersistMode mode, const char *path)
+{
+    App app;
+    unlink(path);
+    launch(&app, mode, path);
+    int ok = 1;
+    //Fresh launch at home page A, go to B.
+    willAppear(&app, "HomeVC");
+    notifyPageEnter(&app, "HomeVC", 1, 1);
+    notifyPageExit(&app, "HomeVC", 1);
+    notifyPageEnter(&app, "DetailVC", 1, 1);
+    ok &= expectLogs(&app, "navigate", (const char *[]){"E HomeVC", "X HomeVC", "E DetailVC"}, 3);
+    //Killed in FG at B, next launch exits B first even without its exit, then enters A.
+    killApp(&app);
+    launch(&app, mode, path);
+    notifyPageEnter(&app, "HomeVC", 1, 1);
+    ok &= expectLogs(&app, "FG kill", (const char *[]){"X DetailVC", "E HomeVC"}, 2);
+    //Go to C, go BG. Enter history keeps C so App coming FG enters it again.
+    notifyPageExit(&app, "homevc", 1); //case differs from enter, same page.
+    notifyPageEnter(&app, "SettingVC", 1, 1);
+    notifyPageExit(&app, NULL, 0);
+    ok &= expectLogs(&app, "go BG", (const char *[]){"X homevc", "E SettingVC", "X SettingVC"}, 3);
+    //Killed in BG, launched in BG: A appears, exit of C already sent, nothing sent and enter history becomes A.
+    killApp(&app);
+    launch(&app, mode, path);
+    notifyPageEnter(&app, "HomeVC", 0, 1);
+    ok &= expectLogs(&app, "BG kill", NULL, 0);
+    //Killed in BG again: enter history A but exit history C, must not try to exit A.
+    killApp(&app);
+    launch(&app, mode, path);
+    if (shPageToExitBeforeEnter(&app.history, "HomeVC") != NULL)
+    {
+        fprintf(stderr, "FAIL: second BG kill tries to exit %s\n", app.history.enterPage);
+        ok = 0;
+    }
+    notifyPageEnter(&app, "HomeVC", 0, 1);
+    ok &= expectLogs(&app, "second BG kill", NULL, 0);
+    //Come FG, enter A; go BG and exit A once; duplicated exit is ignored.
+    notifyPageEnter(&app, NULL, 1, 0);
+    notifyPageExit(&app, NULL, 0);
+    notifyPageExit(&app, "HomeVC", 1);
+    ok &= expectLogs(&app, "duplicated exit", (const char *[]){"E HomeVC", "X HomeVC"}, 2);
+    killApp(&app);
+    unlink(path);
+    return ok;
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void measure(PersistMode mode, const char *path, long transitions)
+{
+    static char names[PAGE_COUNT][MAX_PAGE_NAME];
+    for (int i = 0; i < PAGE_COUNT; i++)
+    {
+        snprintf(names[i], MAX_PAGE_NAME, "Page%02dViewController", i);
+    }
+    double *costs = malloc(sizeof(double) * (size_t)transitions);
+    uint32_t randomState = 12345;
+    App app;
+    unlink(path);
+    launch(&app, mode, path);
+    int current = 0;
+    willAppear(&app, names[current]);
+    notifyPageEnter(&app, names[current], 1, 1);
+    for (long i = 0; i < transitions; i++)
+    {
+        randomState = randomState * 1103515245 + 12345;
+        int next = (int)((randomState >> 16) % PAGE_COUNT);
+        int goBackground = ((randomState >> 8) % 10 == 0);
+        double start = benchNow();
+        if (goBackground) //BG and FG again as one transition.
+        {
+            notifyPageExit(&app, NULL, 0);
+            notifyPageEnter(&app, NULL, 1, 0);
+        }
+        else
+        {
+            willAppear(&app, names[next]);
+            notifyPageExit(&app, names[current], 1);
+            notifyPageEnter(&app, names[next], 1, 1);
+            current = next;
+        }
+        costs[i] = benchNow() - start;
+        app.logCount = 0;
+    }
+    double total = 0;
+    for (long i = 0; i < transitions; i++)
+    {
+        total += costs[i];
+    }
+    qsort(costs, (size_t)transitions, sizeof(double), compareDouble);
+    printf("%-5s: mean %8.2f us, p50 %8.2f us, p99 %8.2f us per transition\n", (mode == Persist_Sync) ? "sync" : "async", total / transitions * 1e6, costs[transitions / 2] * 1e6, costs[transitions * 99 / 100] * 1e6);
+    killApp(&app);
+    unlink(path);
+    free(costs);
+}
+
+int main(int argc, char *argv[])
+{
+    long transitions = (argc > 1) ? atol(argv[1]) : 2000;
+    const char *path = (argc > 2) ? argv[2] : "page_history.bench";
+    if (transitions <= 0)
+    {
+        fprintf(stderr, "usage: page_transition_bench [transitions] [history_file]\n");
+        return 1;
+    }
+    if (!runScript(Persist_Sync, path) || !runScript(Persist_Async, path))
+    {
+        return 1;
+    }
+    printf("recovery rules OK, %ld transitions over %d pages, 1 in 10 goes BG and FG\n", transitions, PAGE_COUNT);
+    measure(Persist_Sync, path, transitions);
+    measure(Persist_Async, path, transitions);
+    return 0;
+}
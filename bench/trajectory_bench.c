@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) StreetHawk, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/*
+ Trajectory simplification of batch geo locations in SHLocationManager, same tolerance and time bound.
+
+ Tracks are generated as a day of moving: walking with GPS noise, driving along curved roads and staying still. Each simplified track is checked: first and last kept, every dropped location within tolerance of the line between kept neighbours, and no dropped location 10 minutes or more after previous kept one. Time is measured for buffers of 100 locations, which is the most SHLocationManager simplifies at once, and for one long track.
+
+ Usage: trajectory_bench [buffers] [long_track_length]
+ Exit code is not 0 if a check fails.
+ */
+
+#include "SHTrajectory.h"
+#include "bench_util.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TOLERANCE           50 //same as GEOLOCATION_BATCH_TOLERANCE
+#define MAX_GAP             600 //same as GEOLOCATION_BATCH_MAX_GAP
+#define BUFFER_SIZE         100 //same as GEOLOCATION_BATCH_MAX_POINTS
+#define DEGREE_TO_RADIAN    (3.14159265358979323846 / 180.0)
+
+static uint32_t randomState = 12345;
+
+static double randomUniform(void)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) / 16777216.0;
+}
+
+static double randomGaussian(void)
+{
+    double sum = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        sum += randomUniform();
+    }
+    return sum - 6;
+}
+
+static void generateTrack(double *latitudes, double *longitudes, double *times, size_t count) //alternate staying, walking and driving, location every few seconds to minutes.
+{
+    double latitude = -33.87 + randomUniform();
+    double longitude = 151.2 + randomUniform();
+    double heading = randomUniform() * 6.283;
+    double time = 0;
+    int mode = 0;
+    size_t modeLeft = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (modeLeft == 0)
+        {
+            mode = (int)(randomUniform() * 3);
+            modeLeft = 10 + (size_t)(randomUniform() * 60);
+        }
+        modeLeft--;
+        double speed = (mode == 0) ? 0 : ((mode == 1) ? 1.4 : 14);
+        double interval = (mode == 0) ? 60 + randomUniform() * 240 : 5 + randomUniform() * 25;
+        heading += randomGaussian() * ((mode == 2) ? 0.15 : 0.4);
+        double meters = speed * interval;
+        latitude += meters * cos(heading) / 110540.0;
+        longitude += meters * sin(heading) / (111320.0 * cos(latitude * DEGREE_TO_RADIAN));
+        time += interval;
+        double noise = (mode == 2) ? 10 : 15; //horizontal accuracy of fix
+        latitudes[i] = latitude + noise * randomGaussian() / 110540.0;
+        longitudes[i] = longitude + noise * randomGaussian() / (111320.0 * cos(latitude * DEGREE_TO_RADIAN));
+        times[i] = time;
+    }
+}
+
+static double lineDistance(const double *latitudes, const double *longitudes, size_t first, size_t last, size_t i, size_t origin) //metres from location i to line through first and last, same projection as simplifying.
+{
+    double metersPerLongitude = 111320.0 * cos(latitudes[origin] * DEGREE_TO_RADIAN);
+    double x1 = (longitudes[first] - longitudes[origin]) * metersPerLongitude, y1 = (latitudes[first] - latitudes[origin]) * 110540.0;
+    double x2 = (longitudes[last] - longitudes[origin]) * metersPerLongitude, y2 = (latitudes[last] - latitudes[origin]) * 110540.0;
+    double px = (longitudes[i] - longitudes[origin]) * metersPerLongitude - x1, py = (latitudes[i] - latitudes[origin]) * 110540.0 - y1;
+    double dx = x2 - x1, dy = y2 - y1;
+    double length = sqrt(dx * dx + dy * dy);
+    return (length > 0) ? fabs(px * dy - py * dx) / length : sqrt(px * px + py * py);
+}
+
+static int checkSimplified(const double *times, size_t count, const unsigned char *keep, size_t keptCount)
+{
+    size_t counted = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        counted += keep[i];
+    }
+    if (counted != keptCount || (count > 0 && (!keep[0] || !keep[count - 1])))
+    {
+        fprintf(stderr, "FAIL: kept %zu counted %zu, first and last must be kept\n", keptCount, counted);
+        return 0;
+    }
+    size_t previous = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (!keep[i])
+        {
+            continue;
+        }
+        for (size_t j = previous + 1; j < i; j++)
+        {
+            if (times[j] - times[previous] >= MAX_GAP)
+            {
+                fprintf(stderr, "FAIL: location %zu dropped %.0f seconds after kept %zu\n", j, times[j] - times[previous], previous);
+                return 0;
+            }
+        }
+        previous = i;
+    }
+    return 1;
+}
+
+static int checkTolerance(const double *latitudes, const double *longitudes, const double *times, size_t count) //Douglas-Peucker alone (no time bound) keeps every dropped location within tolerance of its segment line.
+{
+    unsigned char *keep = malloc(count);
+    shSimplifyTrajectory(latitudes, longitudes, times, count, TOLERANCE, 1e300, keep);
+    size_t previous = 0;
+    int ok = 1;
+    for (size_t i = 1; i < count && ok; i++)
+    {
+        if (!keep[i])
+        {
+            continue;
+        }
+        for (size_t j = previous + 1; j < i; j++)
+        {
+            double distance = lineDistance(latitudes, longitudes, previous, i, j, 0);
+            if (distance > TOLERANCE + 1e-6)
+            {
+                fprintf(stderr, "FAIL: location %zu is %.1f metres from simplified line\n", j, distance);
+                ok = 0;
+                break;
+            }
+        }
+        previous = i;
+    }
+    free(keep);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    long buffers = (argc > 1) ? atol(argv[1]) : 10000;
+    long longLength = (argc > 2) ? atol(argv[2]) : 100000;
+    if (buffers <= 0 || longLength <= 2)
+    {
+        fprintf(stderr, "usage: trajectory_bench [buffers] [long_track_length]\n");
+        return 1;
+    }
+    size_t total = (size_t)buffers * BUFFER_SIZE;
+    double *latitudes = malloc(total * sizeof(double));
+    double *longitudes = malloc(total * sizeof(double));
+    double *times = malloc(total * sizeof(double));
+    unsigned char *keep = malloc(total);
+    generateTrack(latitudes, longitudes, times, total);
+
+    size_t keptTotal = 0;
+    double start = benchNow();
+    for (long b = 0; b < buffers; b++)
+    {
+        size_t offset = (size_t)b * BUFFER_SIZE;
+        keptTotal += shSimplifyTrajectory(latitudes + offset, longitudes + offset, times + offset, BUFFER_SIZE, TOLERANCE, MAX_GAP, keep + offset);
+    }
+    double bufferTime = benchNow() - start;
+    for (long b = 0; b < buffers; b++)
+    {
+        size_t offset = (size_t)b * BUFFER_SIZE;
+        size_t kept = 0;
+        for (size_t i = 0; i < BUFFER_SIZE; i++)
+        {
+            kept += keep[offset + i];
+        }
+        if (!checkSimplified(times + offset, BUFFER_SIZE, keep + offset, kept) || !checkTolerance(latitudes + offset, longitudes + offset, times + offset, BUFFER_SIZE))
+        {
+            return 1;
+        }
+    }
+
+    unsigned char small[2] = {0, 0};
+    if (shSimplifyTrajectory(latitudes, longitudes, times, 2, TOLERANCE, MAX_GAP, small) != 2 || !small[0] || !small[1])
+    {
+        fprintf(stderr, "FAIL: 2 locations must be kept\n");
+        return 1;
+    }
+    double stillLatitudes[60], stillLongitudes[60], stillTimes[60];
+    unsigned char stillKeep[60];
+    for (int i = 0; i < 60; i++) //staying still for an hour, location each minute.
+    {
+        stillLatitudes[i] = -33.87 + 5 * randomGaussian() / 110540.0;
+        stillLongitudes[i] = 151.2 + 5 * randomGaussian() / 92000.0;
+        stillTimes[i] = i * 60.0;
+    }
+    size_t stillKept = shSimplifyTrajectory(stillLatitudes, stillLongitudes, stillTimes, 60, TOLERANCE, MAX_GAP, stillKeep);
+    if (stillKept < 6 || stillKept > 8 || !checkSimplified(stillTimes, 60, stillKeep, stillKept))
+    {
+        fprintf(stderr, "FAIL: staying an hour keeps %zu, expect one each 10 minutes\n", stillKept);
+        return 1;
+    }
+
+    size_t longCount = ((size_t)longLength < total) ? (size_t)longLength : total;
+    start = benchNow();
+    size_t longKept = shSimplifyTrajectory(latitudes, longitudes, times, longCount, TOLERANCE, MAX_GAP, keep);
+    double longTime = benchNow() - start;
+    if (!checkSimplified(times, longCount, keep, longKept))
+    {
+        return 1;
+    }
+
+    printf("checks OK: tolerance %d m, gap %d s\n", TOLERANCE, MAX_GAP);
+    printf("buffers of %d: %8.2f us each, kept %.1f%%\n", BUFFER_SIZE, bufferTime / buffers * 1e6, 100.0 * keptTotal / total);
+    printf("one track of %zu: %8.2f ms, kept %zu\n", longCount, longTime * 1e3, longKept);
+    free(keep);
+    free(times);
+    free(longitudes);
+    free(latitudes);
+    return 0;
+}
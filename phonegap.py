@@ -15,7 +15,8 @@ src_root = opts.get('<path>', 'StreetHawk/Classes')
 
 files = sorted(
     glob(join(src_root, '**/*.h'), recursive=True) +
-    glob(join(src_root, '**/*.m'), recursive=True)
+    glob(join(src_root, '**/*.m'), recursive=True) +
+    glob(join(src_root, '**/*.c'), recursive=True)
 )
 for file_ in files:
     path_ = pathlib.Path(file_).relative_to(src_root)
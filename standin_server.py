@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for StreetHawk server, for load and regression testing of the SDK.
+
+Point the SDK to it by `StreetHawk.hostOverride = @"http://<ip>:<port>"` (or
+Info.plist key SH_HOST_OVERRIDE) before `registerInstallForApp`. All host
+versions map to path prefixes of this server:
+
+    /v1 /v2 /v3    api host versions
+    /growth        growth host
+    /v1/apps/status  route check
+
+Usage:
+
+    standin_server.py serve --port 8080 --latency 200 --error-rate 0.1 --record traffic.jsonl
+    standin_server.py serve --replay traffic.jsonl
+    standin_server.py replay traffic.jsonl http://127.0.0.1:8080 --concurrency 16 --repeat 10
+
+Run `standin_server.py <command> -h` for all options. Only Python 3 standard library is needed.
+"""
+import argparse
+import json
+import random
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+from collections import defaultdict, deque
+from concurrent.futures import ThreadPoolExecutor
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlsplit
+
+HOST_PREFIXES = ('/v1', '/v2', '/v3', '/growth')
+
+APP_STATUS = {
+    'streethawk': True,
+    'location_updates': True,
+    'submit_views': True,
+    'submit_interactive_button': True,
+    'ibeacon': '2016-01-01 00:00:00',  # timestamps make SDK fetch geofences and iBeacons once
+    'geofences': '2016-01-01 00:00:00',
+    'reregister': False,
+}
+
+# canned bodies in StreetHawk {code, value, app_status} format, keyed by "METHOD /path".
+CANNED = {
+    'GET /apps/status': {'code': 0, 'value': APP_STATUS},
+    'POST /installs/register': {'code': 0, 'value': {'installid': 'STANDIN0000000001'}},
+    'POST /installs/update': {'code': 0, 'value': {'installid': 'STANDIN0000000001'}},
+    'POST /installs/log': {'code': 0, 'value': None},
+    'POST /installs/crash': {'code': 0, 'value': None},  # multipart, exception_file part is plain text report
+    'POST /apps/submit_views': {'code': 0, 'value': None},
+    'POST /apps/submit_interactive_button': {'code': 0, 'value': None},
+    'POST /feedback/submit': {'code': 0, 'value': None},
+    'GET /installs/alert_settings': {'code': 0, 'value': {'pause_minutes': 0}},
+    'POST /installs/alert_settings': {'code': 0, 'value': None},
+    'GET /core/library': {'code': 0, 'value': {}},
+    'GET /feeds': {'count': 0, 'next': None, 'previous': None, 'results': []},  # v3, no code-value format
+    'GET /geofences/tree': {'code': 0, 'value': [
+        {'id': '1', 'latitude': -33.8688, 'longitude': 151.2093, 'radius': 5000, 'geofences': [
+            {'id': '2', 'latitude': -33.8568, 'longitude': 151.2153, 'radius': 200, 'suid': 'standin', 'title': 'Stand-in'},
+        ]},
+    ]},
+    'GET /ibeacons': {'code': 0, 'value': {
+        'B9407F30-F5F8-466E-AFF9-25556B57FE6D': {'1': {'1': 1, '2': 2}},  # uuid -> major -> minor -> server id
+    }},
+    'GET /i': {'share_guid_url': '', 'message': {}},
+    'POST /originate_viral_share': {'code': 0, 'value': {'share_guid_url': 'http://standin/share'}},
+    'POST /increase_clicks': {'code': 0, 'value': None},
+}
+
+
+def normalize(method, raw_path):
+    """Key a request by "METHOD /path", host version prefix, query and last "/" removed."""
+    path = urlsplit(raw_path).path
+    for prefix in HOST_PREFIXES:
+        if path == prefix or path.startswith(prefix + '/'):
+            path = path[len(prefix):]
+            break
+    path = '/' + path.strip('/')
+    if path.startswith('/installs/') and path.endswith('/crash'):
+        path = '/installs/crash'  # installs/<installid>/crash/
+    return '%s %s' % (method, path)
+
+
+class StandinState(object):
+
+    def __init__(self, opts):
+        self.lock = threading.Lock()
+        self.responses = dict(CANNED)
+        if opts.responses:
+            with open(opts.responses) as f:
+                self.responses.update(json.load(f))
+        self.latency = int(opts.latency) / 1000.0
+        self.jitter = int(opts.jitter) / 1000.0
+        self.error_rate = float(opts.error_rate)
+        self.error_status = int(opts.error_status)
+        self.record_file = open(opts.record, 'a') if opts.record else None
+        self.replay = defaultdict(deque)
+        if opts.replay:
+            with open(opts.replay) as f:
+                for line in f:
+                    item = json.loads(line)
+                    self.replay[item['key']].append(item)
+        self.counters = defaultdict(int)
+
+    def pick(self, key):
+        """Return (status, body) for the request key."""
+        with self.lock:
+            self.counters[key] += 1
+            queue = self.replay.get(key)
+            if queue:
+                item = queue.popleft()
+                queue.append(item)  # loop recorded responses
+                return item['status'], item['response']
+        if self.error_rate > 0 and random.random() < self.error_rate:
+            return self.error_status, {'code': self.error_status, 'value': 'Injected error.'}
+        body = self.responses.get(key)
+        if body is None:
+            return 404, {'code': 404, 'value': 'No canned response for %s.' % key}
+        return 200, body
+
+    def record(self, item):
+        if self.record_file is None:
+            return
+        with self.lock:
+            self.record_file.write(json.dumps(item) + '\n')
+            self.record_file.flush()
+
+
+class StandinHandler(BaseHTTPRequestHandler):
+
+    state = None
+    protocol_version = 'HTTP/1.1'
+
+    def handle_any(self):
+        length = int(self.headers.get('Content-Length') or 0)
+        body = self.rfile.read(length) if length else b''
+        key = normalize(self.command, self.path)
+        delay = self.state.latency + random.uniform(0, self.state.jitter)
+        if delay > 0:
+            time.sleep(delay)
+        status, response = self.state.pick(key)
+        if isinstance(response, dict) and 'code' in response and 'app_status' not in response \
+                and not key.startswith('GET /apps/status'):
+            response = dict(response, app_status=APP_STATUS)
+        data = json.dumps(response).encode('utf-8')
+        self.send_response(status)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+        self.state.record({
+            'time': time.time(),
+            'key': key,
+            'method': self.command,
+            'path': self.path,
+            'headers': {k: v for k, v in self.headers.items() if k.lower() not in ('host', 'content-length')},
+            'body': body.decode('utf-8', 'replace'),
+            'status': status,
+            'response': response,
+        })
+
+    do_GET = do_POST = do_PUT = do_DELETE = handle_any
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write('%s %s\n' % (self.log_date_time_string(), fmt % args))
+
+
+def serve(opts):
+    StandinHandler.state = StandinState(opts)
+    server = ThreadingHTTPServer(('0.0.0.0', int(opts.port)), StandinHandler)
+    print('StreetHawk stand-in listening on port %s.' % opts.port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    for key, count in sorted(StandinHandler.state.counters.items()):
+        print('%6d  %s' % (count, key))
+
+
+def replay(opts):
+    """Send recorded requests to base url again, report latency and status counts."""
+    with open(opts.record_file) as f:
+        items = [json.loads(line) for line in f if line.strip()]
+    items = items * int(opts.repeat)
+    base_url = opts.base_url.rstrip('/')
+
+    def send(item):
+        data = item['body'].encode('utf-8') if item['method'] in ('POST', 'PUT') else None
+        request = urllib.request.Request(base_url + item['path'], data=data, method=item['method'], headers=item['headers'])
+        start = time.time()
+        try:
+            with urllib.request.urlopen(request, timeout=60) as response:
+                response.read()
+                status = response.status
+        except urllib.error.HTTPError as e:
+            status = e.code
+        except Exception:
+            status = 0  # not reach server
+        return item['key'], status, time.time() - start
+
+    start = time.time()
+    with ThreadPoolExecutor(max_workers=int(opts.concurrency)) as pool:
+        results = list(pool.map(send, items))
+    elapsed = time.time() - start
+    statuses = defaultdict(int)
+    for _, status, _ in results:
+        statuses[status] += 1
+    latencies = sorted(r[2] for r in results) or [0]
+    print('Sent %d requests in %.3f seconds (%.1f req/s).' % (len(results), elapsed, len(results) / max(elapsed, 1e-6)))
+    print('Latency p50 %.3f, p95 %.3f, max %.3f seconds.' % (
+        latencies[len(latencies) // 2], latencies[min(len(latencies) - 1, int(len(latencies) * 0.95))], latencies[-1]))
+    for status, count in sorted(statuses.items()):
+        print('%6d  HTTP %s' % (count, status))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest='command', required=True)
+    serve_parser = commands.add_parser('serve', help='run stand-in server')
+    serve_parser.add_argument('--port', type=int, default=8080, help='listening port')
+    serve_parser.add_argument('--responses', help='JSON file {"METHOD /path": body} overriding canned responses, path without host version prefix and query, for example "POST /installs/log"')
+    serve_parser.add_argument('--latency', type=int, default=0, help='delay every response in milliseconds')
+    serve_parser.add_argument('--jitter', type=int, default=0, help='random extra delay up to this milliseconds')
+    serve_parser.add_argument('--error-rate', type=float, default=0, help='fraction 0..1 of requests answered with error')
+    serve_parser.add_argument('--error-status', type=int, default=503, help='HTTP status for injected errors')
+    serve_parser.add_argument('--record', help='append each request and response as a JSON line')
+    serve_parser.add_argument('--replay', help='answer with responses from a recorded file, in recorded order per "METHOD /path"')
+    serve_parser.set_defaults(func=serve)
+    replay_parser = commands.add_parser('replay', help='send recorded traffic to a server again')
+    replay_parser.add_argument('record_file')
+    replay_parser.add_argument('base_url')
+    replay_parser.add_argument('--concurrency', type=int, default=4, help='parallel clients')
+    replay_parser.add_argument('--repeat', type=int, default=1, help='times to send the recorded traffic')
+    replay_parser.set_defaults(func=replay)
+    opts = parser.parse_args()
+    opts.func(opts)
+
+
+if __name__ == '__main__':
+    main()